@@ -22,18 +22,25 @@ function(axera_example example_name)
         target_sources(${example_name} PRIVATE ${file})
     endforeach ()
 
-    target_include_directories(${example_name} PRIVATE ${CMAKE_CURRENT_SOURCE_DIR} ${CMAKE_CURRENT_BINARY_DIR} ${BSP_MSP_DIR}/include)
+    target_include_directories(${example_name} PRIVATE ${CMAKE_CURRENT_SOURCE_DIR} ${CMAKE_CURRENT_BINARY_DIR})
 
     # opencv
     target_include_directories(${example_name} PRIVATE ${OpenCV_INCLUDE_DIRS})
     target_link_libraries(${example_name} PRIVATE ${OpenCV_LIBS})
 
-    # ax_engine
-    target_link_libraries(${example_name} PRIVATE ax_engine)
+    if (AXERA_MOCK_ENGINE)
+        # host mock of ax_engine + ax_sys
+        target_link_libraries(${example_name} PRIVATE ax_mock)
+    else()
+        target_include_directories(${example_name} PRIVATE ${BSP_MSP_DIR}/include)
 
-    # sdk
-    target_link_libraries(${example_name} PRIVATE ${CMAKE_THREAD_LIBS_INIT} ax_interpreter ax_sys ax_ivps)
-    target_link_directories(${example_name} PRIVATE ${BSP_MSP_DIR}/lib)
+        # ax_engine
+        target_link_libraries(${example_name} PRIVATE ax_engine)
+
+        # sdk
+        target_link_libraries(${example_name} PRIVATE ${CMAKE_THREAD_LIBS_INIT} ax_interpreter ax_sys ax_ivps)
+        target_link_directories(${example_name} PRIVATE ${BSP_MSP_DIR}/lib)
+    endif()
 
     target_compile_options (${example_name} PUBLIC $<$<COMPILE_LANGUAGE:C,CXX>: -O3>)
 
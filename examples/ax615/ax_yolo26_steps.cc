@@ -27,6 +27,7 @@
 #include "base/common.hpp"
 #include "base/detection.hpp"
 #include "middleware/io.hpp"
+#include "middleware/session.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -60,7 +61,7 @@ namespace ax
 {
     void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
-        std::vector<detection::Object> proposals;
+        detection::Proposals proposals;
         std::vector<detection::Object> objects;
         timer timer_postprocess;
 
@@ -107,65 +108,44 @@ namespace ax
             return ret;
         }
 
-        // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
+        // 2. load model, create handle, context and io
+        middleware::session session;
+        ret = session.load(model);
+        if (0 != ret)
         {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
+            return ret;
         }
 
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating handle is done.\n");
-
-        // 4. create context
-        ret = AX_ENGINE_CreateContext(handle);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating context is done.\n");
-
-        // 5. set io
-        AX_ENGINE_IO_INFO_T* io_info;
-        ret = AX_ENGINE_GetIOInfo(handle, &io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine get io info is done. \n");
-
-        // 6. alloc io
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
-
-        // 7. insert input
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        // 3. insert input
+        ret = session.push_input(data);
+        if (0 != ret)
+        {
+            return ret;
+        }
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
-        // 8. warm up
-        for (int i = 0; i < 5; ++i)
-        {
-            AX_ENGINE_RunSync(handle, &io_data);
-        }
+        // 4. warm up
+        session.warm_up(5);
 
-        // 9. run model
+        // 5. run model
         std::vector<float> time_costs(repeat, 0);
         for (int i = 0; i < repeat; ++i)
         {
             timer tick;
-            ret = AX_ENGINE_RunSync(handle, &io_data);
+            ret = session.run();
             time_costs[i] = tick.cost();
-            SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+            if (0 != ret)
+            {
+                return ret;
+            }
         }
 
-        // 10. get result
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        // 6. get result
+        post_process(session.get_io_info(), session.get_io(), mat, input_w, input_h, time_costs);
         fprintf(stdout, "--------------------------------------\n");
 
-        middleware::free_io(&io_data);
-        return AX_ENGINE_DestroyHandle(handle);
+        return 0;
     }
 } // namespace ax
 
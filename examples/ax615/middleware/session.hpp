@@ -0,0 +1,187 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+#include "middleware/io.hpp"
+#include "utilities/model.hpp"
+#include "utilities/trace.hpp"
+
+namespace middleware
+{
+    // owns one engine handle, its context and the io buffers of that context.
+    // AX_ENGINE_Init / AX_ENGINE_Deinit stay with the caller, they are process wide.
+    class session
+    {
+    public:
+        session() = default;
+
+        ~session()
+        {
+            release();
+        }
+
+        session(const session&) = delete;
+        session& operator=(const session&) = delete;
+
+        // the model file is mapped, not read, and unmapped once the handle exists.
+        // `cache` keeps it resident for the next load of the same file.
+        int load(const std::string& model, INPUT_OUTPUT_ALLOC_STRATEGY strategy = std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED),
+                 utilities::model_cache* cache = nullptr)
+        {
+            return utilities::load_model(
+                model, [&](const void* data, size_t size) {
+                    return load(data, size, strategy);
+                },
+                cache);
+        }
+
+        int load(const void* model_data, size_t model_size, INPUT_OUTPUT_ALLOC_STRATEGY strategy = std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED))
+        {
+            AX_TRACE_SCOPE("engine_load");
+            release();
+
+            // 1. create handle
+            auto ret = AX_ENGINE_CreateHandle(&this->handle, model_data, model_size);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine creating handle failed. 0x%x\n", ret);
+                this->handle = nullptr;
+                return ret;
+            }
+            fprintf(stdout, "Engine creating handle is done.\n");
+
+            // 2. create context
+            ret = AX_ENGINE_CreateContext(this->handle);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine creating context failed. 0x%x\n", ret);
+                release();
+                return ret;
+            }
+            fprintf(stdout, "Engine creating context is done.\n");
+
+            // 3. get io info
+            ret = AX_ENGINE_GetIOInfo(this->handle, &this->io_info);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine get io info failed. 0x%x\n", ret);
+                release();
+                return ret;
+            }
+            fprintf(stdout, "Engine get io info is done. \n");
+
+            // 4. alloc io, buffers are reused by every run()
+            ret = prepare_io(this->io_info, &this->io_data, strategy);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine alloc io failed. 0x%x\n", ret);
+                release();
+                return ret;
+            }
+            this->io_ready = true;
+            fprintf(stdout, "Engine alloc io is done. \n");
+
+            return 0;
+        }
+
+        int push_input(const std::vector<uint8_t>& data)
+        {
+            AX_TRACE_SCOPE("push_input");
+            if (!this->io_ready)
+            {
+                return -1;
+            }
+            return middleware::push_input(data, &this->io_data, this->io_info);
+        }
+
+        int run()
+        {
+            AX_TRACE_SCOPE("engine_run");
+            return AX_ENGINE_RunSync(this->handle, &this->io_data);
+        }
+
+        void warm_up(int count = 5)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                run();
+            }
+        }
+
+        void release()
+        {
+            if (this->io_ready)
+            {
+                free_io(&this->io_data);
+                this->io_ready = false;
+            }
+            if (this->handle != nullptr)
+            {
+                AX_ENGINE_DestroyHandle(this->handle);
+                this->handle = nullptr;
+            }
+            this->io_info = nullptr;
+        }
+
+        bool is_loaded() const
+        {
+            return this->io_ready;
+        }
+
+        AX_ENGINE_HANDLE get_handle() const
+        {
+            return this->handle;
+        }
+
+        AX_ENGINE_IO_INFO_T* get_io_info() const
+        {
+            return this->io_info;
+        }
+
+        AX_ENGINE_IO_T* get_io()
+        {
+            return &this->io_data;
+        }
+
+        void* get_input(int index = 0)
+        {
+            return this->io_data.pInputs[index].pVirAddr;
+        }
+
+        void* get_output(int index = 0)
+        {
+            return this->io_data.pOutputs[index].pVirAddr;
+        }
+
+    private:
+        AX_ENGINE_HANDLE handle = nullptr;
+        AX_ENGINE_IO_INFO_T* io_info = nullptr;
+        AX_ENGINE_IO_T io_data = {};
+        bool io_ready = false;
+    };
+} // namespace middleware
@@ -21,8 +21,6 @@
 #include <cstdio>
 #include <cstring>
 #include <numeric>
-#include <fcntl.h>
-#include <sys/mman.h>
 
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
@@ -31,6 +29,7 @@
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
 #include "utilities/file.hpp"
+#include "utilities/model.hpp"
 #include "utilities/timer.hpp"
 
 #include <ax_sys_api.h>
@@ -87,25 +86,14 @@ namespace ax
             return ret;
         }
 
-        // 2. load model
-        auto* file_fp = fopen(model.c_str(), "r");
-        if (!file_fp)
-        {
-            fprintf(stderr, "Read model(%s) file failed.\n", model.c_str());
-            return false;
-        }
-        fseek(file_fp, 0, SEEK_END);
-        int model_size = ftell(file_fp);
-        fclose(file_fp);
-        int fd = open(model.c_str(), O_RDWR, 0644);
-        void* mmap_add = mmap(NULL, model_size, PROT_WRITE, MAP_SHARED, fd, 0);
-
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, mmap_add, model_size);
+        // 2. load model, mapped read only and unmapped once the handle exists
+        AX_ENGINE_HANDLE handle = nullptr;
+        ret = utilities::load_model(model, [&](const void* data, size_t size) {
+            // 3. create handle
+            return AX_ENGINE_CreateHandle(&handle, data, size);
+        });
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine creating handle is done.\n");
-        munmap(mmap_add, model_size);
 
         // 4. create context
         ret = AX_ENGINE_CreateContext(handle);
@@ -29,6 +29,7 @@
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
 #include "utilities/file.hpp"
+#include "utilities/model.hpp"
 #include "utilities/timer.hpp"
 
 #include <ax_sys_api.h>
@@ -53,16 +54,11 @@ namespace ax
         }
 
         // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
-        {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
-        }
-
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
+        AX_ENGINE_HANDLE handle = nullptr;
+        ret = utilities::load_model(model, [&](const void* data, size_t size) {
+            // 3. create handle, straight from the mapped file
+            return AX_ENGINE_CreateHandle(&handle, data, size);
+        });
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine creating handle is done.\n");
 
@@ -26,6 +26,7 @@
 #include "base/common.hpp"
 #include "base/detection.hpp"
 #include "middleware/io.hpp"
+#include "middleware/session.hpp"
 #include "base/pose.hpp"
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -53,39 +54,11 @@ namespace ax
 
         pose::ai_body_parts_s ai_point_result;
 
-        for (size_t p = 0; p < info_x.pShape[1]; p++)
-        {
-            float x, x_score, y, y_score;
-            float maxval = -FLT_MAX;
-            float maxidx = 0;
-            for (size_t i = 0; i < info_x.pShape[2]; i++)
-            {
-                if (output_x[i] > maxval)
-                {
-                    maxval = output_x[i];
-                    maxidx = i;
-                }
-            }
-            x = maxidx / info_x.pShape[2];
-            x_score = maxval;
-            output_x += info_x.pShape[2];
-
-            maxval = -FLT_MAX;
-            maxidx = 0;
-            for (size_t i = 0; i < info_y.pShape[2]; i++)
-            {
-                if (output_y[i] > maxval)
-                {
-                    maxval = output_y[i];
-                    maxidx = i;
-                }
-            }
-            y = maxidx / info_y.pShape[2];
-            y_score = maxval;
-            output_y += info_y.pShape[2];
-
-            ai_point_result.keypoints.push_back({x, y, (x_score + y_score) / 2});
-        }
+        // keypoints in [0, 1) of the input as draw_result wants them, so the vectors are scaled by their lengths
+        const int joints = info_x.pShape[1];
+        const pose::CropAffine normalize = {{1.f / (float)info_x.pShape[2], 0.f, 0.f, 0.f, 1.f / (float)info_y.pShape[2], 0.f}};
+        ai_point_result.keypoints.resize(joints);
+        pose::decode_simcc(output_x, output_y, 1, joints, info_x.pShape[2], info_y.pShape[2], 1.f, &normalize, ai_point_result.keypoints.data(), true);
 
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
         fprintf(stdout, "--------------------------------------\n");
@@ -115,65 +88,44 @@ namespace ax
             return ret;
         }
 
-        // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
+        // 2. load model, create handle, context and io
+        middleware::session session;
+        ret = session.load(model);
+        if (0 != ret)
         {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
+            return ret;
         }
 
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating handle is done.\n");
-
-        // 4. create context
-        ret = AX_ENGINE_CreateContext(handle);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating context is done.\n");
-
-        // 5. set io
-        AX_ENGINE_IO_INFO_T* io_info;
-        ret = AX_ENGINE_GetIOInfo(handle, &io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine get io info is done. \n");
-
-        // 6. alloc io
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
-
-        // 7. insert input
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        // 3. insert input
+        ret = session.push_input(data);
+        if (0 != ret)
+        {
+            return ret;
+        }
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
-        // 8. warm up
-        for (int i = 0; i < 5; ++i)
-        {
-            AX_ENGINE_RunSync(handle, &io_data);
-        }
+        // 4. warm up
+        session.warm_up(5);
 
-        // 9. run model
+        // 5. run model
         std::vector<float> time_costs(repeat, 0);
         for (int i = 0; i < repeat; ++i)
         {
             timer tick;
-            ret = AX_ENGINE_RunSync(handle, &io_data);
+            ret = session.run();
             time_costs[i] = tick.cost();
-            SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+            if (0 != ret)
+            {
+                return ret;
+            }
         }
 
-        // 10. get result
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        // 6. get result
+        post_process(session.get_io_info(), session.get_io(), mat, input_w, input_h, time_costs);
         fprintf(stdout, "--------------------------------------\n");
 
-        middleware::free_io(&io_data);
-        return AX_ENGINE_DestroyHandle(handle);
+        return 0;
     }
 } // namespace ax
 
@@ -30,6 +30,7 @@
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
 #include "utilities/file.hpp"
+#include "utilities/model.hpp"
 #include "utilities/timer.hpp"
 
 #include <ax_sys_api.h>
@@ -51,7 +52,7 @@ namespace ax
 {
     void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
-        std::vector<detection::Object> proposals;
+        detection::Proposals proposals;
         std::vector<detection::Object> objects;
         timer timer_postprocess;
         for (int i = 0; i < 3; ++i)
@@ -91,16 +92,11 @@ namespace ax
         }
 
         // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
-        {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
-        }
-
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
+        AX_ENGINE_HANDLE handle = nullptr;
+        ret = utilities::load_model(model, [&](const void* data, size_t size) {
+            // 3. create handle, straight from the mapped file
+            return AX_ENGINE_CreateHandle(&handle, data, size);
+        });
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine creating handle is done.\n");
 
@@ -27,7 +27,9 @@
 
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
+#include "base/segmentation.hpp"
 #include "middleware/io.hpp"
+#include "middleware/session.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -44,30 +46,6 @@ const int DEFAULT_LOOP_COUNT = 1;
 
 namespace ax
 {
-    struct ax_RGB
-    {
-        uint8_t r, g, b;
-    };
-
-    static std::vector<ax_RGB> voc_cmap(int N = 256)
-    {
-        std::vector<ax_RGB> cmap(N);
-        for (int i = 0; i < N; ++i)
-        {
-            int r = 0, g = 0, b = 0;
-            int c = i;
-            for (int j = 0; j < 8; ++j)
-            {
-                r |= ((c >> 0) & 1) << (7 - j);
-                g |= ((c >> 1) & 1) << (7 - j);
-                b |= ((c >> 2) & 1) << (7 - j);
-                c >>= 3;
-            }
-            cmap[i] = {(uint8_t)r, (uint8_t)g, (uint8_t)b};
-        }
-        return cmap;
-    }
-
     void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
         timer timer_postprocess;
@@ -77,53 +55,17 @@ namespace ax
         int channels = info.pShape[1];
         int height = info.pShape[2];
         int width = info.pShape[3];
-        int area = height * width;
 
         float* ptr = (float*)output.pVirAddr;
 
         // find it
-        cv::Mat prob_matrix(height, width, CV_8UC1);
-        for (int r = 0; r < height; ++r)
-        {
-            uint8_t* ptr_row = prob_matrix.ptr<uint8_t>(r);
-            for (int c = 0; c < width; ++c)
-            {
-                int max_idx = 0;
-                float max_val = std::numeric_limits<float>::lowest();
-                int pixel_offset = r * width + c;
-
-                for (int ch = 0; ch < channels; ++ch)
-                {
-                    float val = ptr[ch * area + pixel_offset];
-                    if (val > max_val)
-                    {
-                        max_val = val;
-                        max_idx = ch;
-                    }
-                }
-                ptr_row[c] = (uint8_t)max_idx;
-            }
-        }
+        cv::Mat labels(height, width, CV_8UC1);
+        segmentation::argmax_nchw(ptr, channels, height, width, labels.data, labels.step);
 
-        // color it
-        static std::vector<ax_RGB> palette = voc_cmap();
-        cv::Mat dst(height, width, CV_8UC3);
-        for (int r = 0; r < height; ++r)
-        {
-            uint8_t* ptr_idx = prob_matrix.ptr<uint8_t>(r);
-            cv::Vec3b* ptr_color = dst.ptr<cv::Vec3b>(r); // bgr
-            for (int c = 0; c < width; ++c)
-            {
-                int index = ptr_idx[c] >= 256 ? 255 : ptr_idx[c];
-
-                const auto& rgb = palette[index];
-                ptr_color[c][0] = rgb.b;
-                ptr_color[c][1] = rgb.g;
-                ptr_color[c][2] = rgb.r;
-            }
-        }
-
-        cv::resize(dst, dst, cv::Size(mat.cols, mat.rows), 0, 0, cv::INTER_NEAREST);
+        // color it at the image size
+        static std::vector<segmentation::LabelColor> palette = segmentation::voc_palette();
+        cv::Mat dst(mat.rows, mat.cols, CV_8UC3);
+        segmentation::render(labels.data, height, width, labels.step, palette.data(), nullptr, 0, dst.data, dst.rows, dst.cols, dst.step);
 
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
         fprintf(stdout, "--------------------------------------\n");
@@ -153,65 +95,44 @@ namespace ax
             return ret;
         }
 
-        // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
+        // 2. load model, create handle, context and io
+        middleware::session session;
+        ret = session.load(model);
+        if (0 != ret)
         {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
+            return ret;
         }
 
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating handle is done.\n");
-
-        // 4. create context
-        ret = AX_ENGINE_CreateContext(handle);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating context is done.\n");
-
-        // 5. set io
-        AX_ENGINE_IO_INFO_T* io_info;
-        ret = AX_ENGINE_GetIOInfo(handle, &io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine get io info is done. \n");
-
-        // 6. alloc io
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
-
-        // 7. insert input
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        // 3. insert input
+        ret = session.push_input(data);
+        if (0 != ret)
+        {
+            return ret;
+        }
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
-        // 8. warm up
-        for (int i = 0; i < 5; ++i)
-        {
-            AX_ENGINE_RunSync(handle, &io_data);
-        }
+        // 4. warm up
+        session.warm_up(5);
 
-        // 9. run model
+        // 5. run model
         std::vector<float> time_costs(repeat, 0);
         for (int i = 0; i < repeat; ++i)
         {
             timer tick;
-            ret = AX_ENGINE_RunSync(handle, &io_data);
+            ret = session.run();
             time_costs[i] = tick.cost();
-            SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+            if (0 != ret)
+            {
+                return ret;
+            }
         }
 
-        // 10. get result
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        // 6. get result
+        post_process(session.get_io_info(), session.get_io(), mat, input_w, input_h, time_costs);
         fprintf(stdout, "--------------------------------------\n");
 
-        middleware::free_io(&io_data);
-        return AX_ENGINE_DestroyHandle(handle);
+        return 0;
     }
 } // namespace ax
 
@@ -28,11 +28,14 @@
 
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
+#include "base/matcher.hpp"
+#include "base/superpoint.hpp"
 #include "middleware/io.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
 #include "utilities/file.hpp"
+#include "utilities/model.hpp"
 #include "utilities/timer.hpp"
 
 #include <ax_sys_api.h>
@@ -44,97 +47,13 @@ const int DEFAULT_IMG_W = 640;
 const int DEFAULT_LOOP_COUNT = 1;
 const float DEFAULT_THRESHOLD = 0.005f;
 const int DEFAULT_MAX_POINTS = 100;
-
-struct KeyPoint
-{
-    float x, y;
-    float score;
-};
+const int DEFAULT_NMS_RADIUS = 4;
 
 namespace ax
 {
-    void get_keypoints(const float* score_map, int h, int w, float threshold,
-                       std::vector<KeyPoint>& keypoints)
-    {
-        keypoints.clear();
-        for (int y = 0; y < h; ++y)
-        {
-            for (int x = 0; x < w; ++x)
-            {
-                float score = score_map[y * w + x];
-                if (score > threshold)
-                {
-                    KeyPoint kp;
-                    kp.x = (float)x;
-                    kp.y = (float)y;
-                    kp.score = score;
-                    keypoints.push_back(kp);
-                }
-            }
-        }
-    }
-
-    void get_descriptors(const std::vector<KeyPoint>& keypoints,
-                         const float* desc_map, int desc_c, int desc_h, int desc_w,
-                         std::vector<std::vector<float> >& descriptors)
-    {
-        descriptors.clear();
-        if (keypoints.empty())
-        {
-            return;
-        }
-
-        for (const auto& kp : keypoints)
-        {
-            float x = kp.x / 8.0f;
-            float y = kp.y / 8.0f;
-
-            int x0 = std::floor(x);
-            int x1 = x0 + 1;
-            int y0 = std::floor(y);
-            int y1 = y0 + 1;
-
-            x0 = std::max(0, std::min(x0, desc_w - 1));
-            x1 = std::max(0, std::min(x1, desc_w - 1));
-            y0 = std::max(0, std::min(y0, desc_h - 1));
-            y1 = std::max(0, std::min(y1, desc_h - 1));
-
-            float wa = (x1 - x) * (y1 - y);
-            float wb = (x1 - x) * (y - y0);
-            float wc = (x - x0) * (y1 - y);
-            float wd = (x - x0) * (y - y0);
-
-            std::vector<float> desc(desc_c, 0.0f);
-            for (int c = 0; c < desc_c; ++c)
-            {
-                float Q_tl = desc_map[c * desc_h * desc_w + y0 * desc_w + x0];
-                float Q_bl = desc_map[c * desc_h * desc_w + y1 * desc_w + x0];
-                float Q_tr = desc_map[c * desc_h * desc_w + y0 * desc_w + x1];
-                float Q_br = desc_map[c * desc_h * desc_w + y1 * desc_w + x1];
-
-                desc[c] = Q_tl * wa + Q_bl * wb + Q_tr * wc + Q_br * wd;
-            }
-
-            // Normalize
-            float norm = 0.0f;
-            for (int c = 0; c < desc_c; ++c)
-            {
-                norm += desc[c] * desc[c];
-            }
-            norm = std::sqrt(norm + 1e-6f);
-            for (int c = 0; c < desc_c; ++c)
-            {
-                desc[c] /= norm;
-            }
-
-            descriptors.push_back(desc);
-        }
-    }
-
     void extract_features(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data,
-                          float threshold, int max_points,
-                          std::vector<KeyPoint>& keypoints,
-                          std::vector<std::vector<float> >& descriptors)
+                          float threshold, int max_points, int nms_radius,
+                          feature::SuperPointFeatures& features)
     {
         // Get outputs: score_map and descriptor_map
         auto& score_output = io_data->pOutputs[0];
@@ -151,114 +70,34 @@ namespace ax
         int desc_w = desc_info.pShape[3];
         float* desc_map = (float*)desc_output.pVirAddr;
 
-        // Extract keypoints
-        get_keypoints(score_map, score_h, score_w, threshold, keypoints);
-
-        // Limit keypoints
-        if ((int)keypoints.size() > max_points)
-        {
-            std::sort(keypoints.begin(), keypoints.end(),
-                      [](const KeyPoint& a, const KeyPoint& b) { return a.score > b.score; });
-            keypoints.resize(max_points);
-        }
-
-        // Extract descriptors
-        get_descriptors(keypoints, desc_map, desc_c, desc_h, desc_w, descriptors);
+        // radius nms, the best max_points, then one descriptor row per keypoint
+        features.extract(score_map, score_h, score_w, desc_map, desc_c, desc_h, desc_w, threshold, max_points, nms_radius);
     }
 
     void match_and_visualize(const cv::Mat& img1, const cv::Mat& img2,
-                             const std::vector<KeyPoint>& kp1, const std::vector<std::vector<float> >& desc1,
-                             const std::vector<KeyPoint>& kp2, const std::vector<std::vector<float> >& desc2,
+                             const feature::SuperPointFeatures& features1,
+                             const feature::SuperPointFeatures& features2,
                              const std::string& output_file)
     {
-        if (kp1.empty() || kp2.empty() || desc1.empty() || desc2.empty())
+        const auto& kp1 = features1.keypoints;
+        const auto& kp2 = features2.keypoints;
+        if (kp1.empty() || kp2.empty())
         {
             fprintf(stderr, "No keypoints or descriptors to match\n");
             return;
         }
 
-        // Convert descriptors to cv::Mat for matching
-        cv::Mat desc_mat1(desc1.size(), desc1[0].size(), CV_32F);
-        cv::Mat desc_mat2(desc2.size(), desc2[0].size(), CV_32F);
-
-        for (size_t i = 0; i < desc1.size(); ++i)
-        {
-            memcpy(desc_mat1.ptr<float>(i), desc1[i].data(), desc1[i].size() * sizeof(float));
-        }
-
-        for (size_t i = 0; i < desc2.size(); ++i)
-        {
-            memcpy(desc_mat2.ptr<float>(i), desc2[i].data(), desc2[i].size() * sizeof(float));
-        }
-
-        // Manual brute force matching (L2 distance with cross-check)
-        struct Match
-        {
-            int queryIdx;
-            int trainIdx;
-            float distance;
-        };
-        std::vector<Match> matches;
-
-        // Cross-check matching: for each descriptor in img1, find best match in img2
-        // and verify that the reverse match is also the best
-        for (int i = 0; i < desc_mat1.rows; ++i)
-        {
-            float best_dist = std::numeric_limits<float>::max();
-            int best_idx = -1;
-
-            // Find best match in img2
-            for (int j = 0; j < desc_mat2.rows; ++j)
-            {
-                float dist = 0.0f;
-                for (int k = 0; k < desc_mat1.cols; ++k)
-                {
-                    float diff = desc_mat1.at<float>(i, k) - desc_mat2.at<float>(j, k);
-                    dist += diff * diff;
-                }
-                dist = std::sqrt(dist);
-
-                if (dist < best_dist)
-                {
-                    best_dist = dist;
-                    best_idx = j;
-                }
-            }
-
-            // Cross-check: verify reverse match
-            if (best_idx >= 0)
-            {
-                float reverse_best_dist = std::numeric_limits<float>::max();
-                int reverse_best_idx = -1;
-
-                for (int k = 0; k < desc_mat1.rows; ++k)
-                {
-                    float dist = 0.0f;
-                    for (int l = 0; l < desc_mat1.cols; ++l)
-                    {
-                        float diff = desc_mat1.at<float>(k, l) - desc_mat2.at<float>(best_idx, l);
-                        dist += diff * diff;
-                    }
-                    dist = std::sqrt(dist);
-
-                    if (dist < reverse_best_dist)
-                    {
-                        reverse_best_dist = dist;
-                        reverse_best_idx = k;
-                    }
-                }
-
-                // If cross-check passes, add match
-                if (reverse_best_idx == i)
-                {
-                    matches.push_back({i, best_idx, best_dist});
-                }
-            }
-        }
+        // Mutual nearest neighbours by L2 distance, the same matches as a brute force cross-check
+        feature::MatchDescriptors desc1, desc2;
+        desc1.assign(features1);
+        desc2.assign(features2);
+        feature::DescriptorMatcher matcher;
+        std::vector<feature::DescriptorMatch> matches;
+        matcher.match(desc1, desc2, matches);
 
         // Sort matches by distance
         std::sort(matches.begin(), matches.end(),
-                  [](const Match& a, const Match& b) { return a.distance < b.distance; });
+                  [](const feature::DescriptorMatch& a, const feature::DescriptorMatch& b) { return a.distance < b.distance; });
 
         fprintf(stdout, "Found %zu matches\n", matches.size());
 
@@ -279,11 +118,11 @@ namespace ax
         cv::RNG rng(12345);
         for (size_t i = 0; i < matches.size() && i < 100; ++i) // Limit to 100 matches for visualization
         {
-            const Match& m = matches[i];
+            const feature::DescriptorMatch& m = matches[i];
             cv::Scalar color(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
 
-            cv::Point2f pt1(kp1[m.queryIdx].x, kp1[m.queryIdx].y);
-            cv::Point2f pt2(kp2[m.trainIdx].x + img1_w, kp2[m.trainIdx].y);
+            cv::Point2f pt1(kp1[m.query].x, kp1[m.query].y);
+            cv::Point2f pt2(kp2[m.train].x + img1_w, kp2[m.train].y);
 
             cv::circle(match_img, pt1, 3, color, -1);
             cv::circle(match_img, pt2, 3, color, -1);
@@ -299,9 +138,8 @@ namespace ax
                    const std::vector<float>& input_data2,
                    const int& repeat,
                    cv::Mat& img1, cv::Mat& img2,
-                   float threshold, int max_points,
-                   std::vector<KeyPoint>& kp1, std::vector<std::vector<float> >& desc1,
-                   std::vector<KeyPoint>& kp2, std::vector<std::vector<float> >& desc2)
+                   float threshold, int max_points, int nms_radius,
+                   feature::SuperPointFeatures& features1, feature::SuperPointFeatures& features2)
     {
         // 1. init engine
         AX_ENGINE_NPU_ATTR_T npu_attr;
@@ -314,16 +152,11 @@ namespace ax
         }
 
         // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
-        {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
-        }
-
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
+        AX_ENGINE_HANDLE handle = nullptr;
+        ret = utilities::load_model(model, [&](const void* data, size_t size) {
+            // 3. create handle, straight from the mapped file
+            return AX_ENGINE_CreateHandle(&handle, data, size);
+        });
         SAMPLE_AX_ENGINE_DEAL_HANDLE
         fprintf(stdout, "Engine creating handle is done.\n");
 
@@ -376,9 +209,9 @@ namespace ax
 
         // 10. get result for image 1
         fprintf(stdout, "Processing image 1:\n");
-        extract_features(io_info, &io_data, threshold, max_points, kp1, desc1);
-        fprintf(stdout, "Found %zu keypoints in image 1\n", kp1.size());
-        fprintf(stdout, "Extracted %zu descriptors from image 1\n", desc1.size());
+        timer timer_features1;
+        extract_features(io_info, &io_data, threshold, max_points, nms_radius, features1);
+        fprintf(stdout, "Found %d keypoints in image 1, features cost time:%.2f ms\n", features1.size(), timer_features1.cost());
         fprintf(stdout, "--------------------------------------\n");
         auto total_time1 = std::accumulate(time_costs.begin(), time_costs.end(), 0.f);
         auto min_max_time1 = std::minmax_element(time_costs.begin(), time_costs.end());
@@ -415,9 +248,9 @@ namespace ax
 
         // 13. get result for image 2
         fprintf(stdout, "Processing image 2:\n");
-        extract_features(io_info, &io_data, threshold, max_points, kp2, desc2);
-        fprintf(stdout, "Found %zu keypoints in image 2\n", kp2.size());
-        fprintf(stdout, "Extracted %zu descriptors from image 2\n", desc2.size());
+        timer timer_features2;
+        extract_features(io_info, &io_data, threshold, max_points, nms_radius, features2);
+        fprintf(stdout, "Found %d keypoints in image 2, features cost time:%.2f ms\n", features2.size(), timer_features2.cost());
         fprintf(stdout, "--------------------------------------\n");
         auto total_time2 = std::accumulate(time_costs.begin(), time_costs.end(), 0.f);
         auto min_max_time2 = std::minmax_element(time_costs.begin(), time_costs.end());
@@ -443,6 +276,7 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
     cmd.add<float>("threshold", 't', "keypoint threshold", false, DEFAULT_THRESHOLD);
     cmd.add<int>("max_points", 'p', "max number of keypoints", false, DEFAULT_MAX_POINTS);
+    cmd.add<int>("nms_radius", 'n', "keypoint nms radius in pixels, 0 keeps every pixel above threshold", false, DEFAULT_NMS_RADIUS);
     cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
 
     cmd.parse_check(argc, argv);
@@ -484,6 +318,7 @@ int main(int argc, char* argv[])
 
     auto threshold = cmd.get<float>("threshold");
     auto max_points = cmd.get<int>("max_points");
+    auto nms_radius = cmd.get<int>("nms_radius");
     auto repeat = cmd.get<int>("repeat");
 
     // 1. print args
@@ -494,6 +329,7 @@ int main(int argc, char* argv[])
     fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
     fprintf(stdout, "threshold : %.4f\n", threshold);
     fprintf(stdout, "max_points : %d\n", max_points);
+    fprintf(stdout, "nms_radius : %d\n", nms_radius);
     fprintf(stdout, "--------------------------------------\n");
 
     // 2. read images & preprocess
@@ -539,15 +375,14 @@ int main(int argc, char* argv[])
 
     // 4. -  engine model  -  can only use AX_ENGINE** inside
     {
-        std::vector<KeyPoint> kp1, kp2;
-        std::vector<std::vector<float> > desc1, desc2;
+        feature::SuperPointFeatures features1, features2;
 
         // AX_ENGINE_NPUReset(); // todo ??
-        ax::run_model(model_file, input_data1, input_data2, repeat, img1, img2, threshold, max_points,
-                      kp1, desc1, kp2, desc2);
+        ax::run_model(model_file, input_data1, input_data2, repeat, img1, img2, threshold, max_points, nms_radius,
+                      features1, features2);
 
         // Match and visualize
-        ax::match_and_visualize(img1, img2, kp1, desc1, kp2, desc2, "superpoint_matches.jpg");
+        ax::match_and_visualize(img1, img2, features1, features2, "superpoint_matches.jpg");
 
         // 4.3 engine de init
         AX_ENGINE_Deinit();
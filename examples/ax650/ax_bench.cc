@@ -0,0 +1,713 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+/*
+* Author:
+*/
+
+// benchmark of any model: latency percentiles of the preprocess, the engine run and the post process,
+// throughput over 1..N contexts of one handle running at the same time, on 1 or 3 npu cores, the cmm
+// they take, and json / csv / markdown results the benchmark tables can be made from. built with
+// -DAXERA_MOCK_ENGINE=ON it runs on a host.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include "base/detection.hpp"
+#include "base/letterbox.hpp"
+#include "base/proposal_tiles.hpp"
+#include "middleware/cmm_pool.hpp"
+#include "middleware/io.hpp"
+
+#include "utilities/cmdline.hpp"
+#include "utilities/file.hpp"
+#include "utilities/latency.hpp"
+#include "utilities/model.hpp"
+#include "utilities/split.hpp"
+#include "utilities/timer.hpp"
+#include "utilities/trace.hpp"
+
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+const int DEFAULT_REPEAT = 100;
+const int DEFAULT_WARMUP = 5;
+const int DEFAULT_FRAME_ROWS = 1080;
+const int DEFAULT_FRAME_COLS = 1920;
+
+const float PROB_THRESHOLD = 0.45f;
+const float NMS_THRESHOLD = 0.45f;
+
+namespace ax
+{
+    enum
+    {
+        POST_NONE = 0,
+        POST_YOLOV8 = 1, // n heads of 1 x h x w x (64 + classes)
+        POST_YOLO26 = 2, // n heads of a 1 x h x w x 4 box and a 1 x h x w x classes score output
+    };
+
+    // the source frame every context letterboxes into its input, bgr
+    typedef struct
+    {
+        std::vector<uint8_t> data;
+        int rows;
+        int cols;
+    } bench_frame;
+
+    typedef struct
+    {
+        std::string model;
+        std::string input; // shape of input 0
+        int cores;
+        int contexts;
+        int frames; // timed frames over all contexts
+        int failed;
+        float wall_ms;
+        size_t cmm_model; // the handle and its contexts, AX_ENGINE_GetCMMUsage
+        size_t cmm_io;    // io buffers, the most the cmm pool held at once
+        utilities::latency_stats pre;
+        utilities::latency_stats infer;
+        utilities::latency_stats post;
+        utilities::latency_stats total;
+    } bench_result;
+
+    static std::string shape_string(const AX_ENGINE_IOMETA_T& meta)
+    {
+        std::string text;
+        for (AX_U32 i = 0; i < meta.nShapeSize; ++i)
+        {
+            text += (i == 0 ? "" : "x") + std::to_string(meta.pShape[i]);
+        }
+        return text;
+    }
+
+    // a packed uint8 nhwc image input, the one layout the letterbox can fill
+    static bool is_image_input(const AX_ENGINE_IOMETA_T& meta)
+    {
+        return meta.eDataType == AX_ENGINE_DT_UINT8 && meta.nShapeSize == 4 && meta.pShape[3] == 3;
+    }
+
+    // npu mode of AX_ENGINE_Init for a core count: 1 core is a virtual npu, 3 cores the whole npu
+    static bool npu_mode(int cores, AX_ENGINE_NPU_MODE_T& mode)
+    {
+        if (cores == 1)
+        {
+            mode = AX_ENGINE_VIRTUAL_NPU_STD;
+            return true;
+        }
+        if (cores == 3)
+        {
+            mode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+            return true;
+        }
+        return false;
+    }
+
+    // the handle every context of a run is created on, the contexts go away with it
+    class bench_handle
+    {
+    public:
+        bench_handle() = default;
+
+        ~bench_handle()
+        {
+            if (this->handle != nullptr)
+            {
+                AX_ENGINE_DestroyHandle(this->handle);
+            }
+        }
+
+        bench_handle(const bench_handle&) = delete;
+        bench_handle& operator=(const bench_handle&) = delete;
+
+        int load(const std::string& model)
+        {
+            auto ret = utilities::load_model(model, [&](const void* data, size_t size) {
+                return AX_ENGINE_CreateHandle(&this->handle, data, size);
+            });
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine creating handle failed. 0x%x\n", ret);
+                this->handle = nullptr;
+                return ret;
+            }
+            ret = AX_ENGINE_GetIOInfo(this->handle, &this->io_info);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine get io info failed. 0x%x\n", ret);
+            }
+            return ret;
+        }
+
+        AX_ENGINE_HANDLE handle = nullptr;
+        AX_ENGINE_IO_INFO_T* io_info = nullptr;
+    };
+
+    // one context of the handle: its io buffers and what the post process keeps between frames
+    class bench_context
+    {
+    public:
+        bench_context(const bench_handle& model, int post, bool tiled)
+            : model(model), post_kind(post), serial(1), tiled(tiled)
+        {
+        }
+
+        ~bench_context()
+        {
+            if (this->io_ready)
+            {
+                middleware::free_io(&this->io, this->pool);
+            }
+        }
+
+        int create(middleware::cmm_pool* pool)
+        {
+            auto ret = AX_ENGINE_CreateContextV2(this->model.handle, &this->context);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine creating context failed. 0x%x\n", ret);
+                return ret;
+            }
+            ret = middleware::prepare_io(this->model.io_info, &this->io, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED), pool);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine alloc io failed. 0x%x\n", ret);
+                return ret;
+            }
+            this->pool = pool;
+            this->io_ready = true;
+            return 0;
+        }
+
+        // warmup + repeat frames, the last repeat ones are recorded
+        void run(const bench_frame* frame, int warmup, int repeat, const std::function<void()>& ready)
+        {
+            const auto& input = this->model.io_info->pInputs[0];
+            const bool letterbox = frame != nullptr && is_image_input(input);
+            const int input_h = input.pShape[1];
+            const int input_w = input.pShape[2];
+
+            for (int i = 0; i < warmup + repeat; ++i)
+            {
+                if (i == warmup)
+                {
+                    ready();
+                }
+
+                AX_TRACE_SCOPE("frame");
+                timer tick;
+                if (letterbox)
+                {
+                    common::letterbox_bgr(frame->data.data(), frame->rows, frame->cols, (size_t)frame->cols * 3,
+                                          (uint8_t*)this->io.pInputs[0].pVirAddr, input_h, input_w);
+                }
+                float pre_ms = tick.cost();
+
+                tick.start();
+                int ret;
+                {
+                    AX_TRACE_SCOPE("engine_run");
+                    ret = AX_ENGINE_RunSyncV2(this->model.handle, this->context, &this->io);
+                }
+                float infer_ms = tick.cost();
+
+                tick.start();
+                if (ret == 0)
+                {
+                    post_process(input_h, input_w, frame != nullptr ? frame->rows : input_h, frame != nullptr ? frame->cols : input_w);
+                }
+                float post_ms = tick.cost();
+
+                if (i < warmup)
+                {
+                    continue;
+                }
+                if (ret != 0)
+                {
+                    this->failed++;
+                    continue;
+                }
+                this->pre.add(pre_ms);
+                this->infer.add(infer_ms);
+                this->post.add(post_ms);
+                this->total.add(pre_ms + infer_ms + post_ms);
+            }
+        }
+
+        utilities::latency_stats pre;
+        utilities::latency_stats infer;
+        utilities::latency_stats post;
+        utilities::latency_stats total;
+        int failed = 0;
+
+    private:
+        void post_process(int input_h, int input_w, int src_rows, int src_cols)
+        {
+            if (this->post_kind == POST_NONE)
+            {
+                return;
+            }
+            detection::get_out_yolo_heads(this->model.io_info, &this->io, this->post_kind == POST_YOLO26 ? detection::YOLO_HEADS_26 : detection::YOLO_HEADS_V8,
+                                          PROB_THRESHOLD, NMS_THRESHOLD, input_h, input_w, src_rows, src_cols, this->tiles, this->proposals, this->objects,
+                                          this->tiled ? detection::PROPOSAL_TILE_ROWS : 0, this->tiled ? nullptr : &this->serial);
+        }
+
+        const bench_handle& model;
+        AX_ENGINE_CONTEXT_T context = nullptr;
+        AX_ENGINE_IO_T io = {};
+        middleware::cmm_pool* pool = nullptr;
+        bool io_ready = false;
+        int post_kind;
+        common::thread_pool serial;
+        bool tiled;
+        detection::ProposalTiles<detection::Proposals> tiles;
+        detection::Proposals proposals;
+        std::vector<detection::Object> objects;
+    };
+
+    // `contexts` contexts on one handle of the model, as middleware::pipeline runs them, each on a thread
+    // of its own, all start the timed frames together
+    static bool run_contexts(const std::string& model, int cores, int contexts, const bench_frame* frame, int post, int warmup, int repeat, bench_result& result)
+    {
+        // a pool of its own, its high water are the io buffers of this run only. declared first, so the
+        // contexts give their buffers back and the handle goes away before it is trimmed
+        middleware::cmm_pool pool;
+        bench_handle handle;
+        if (handle.load(model) != 0)
+        {
+            return false;
+        }
+        std::vector<std::unique_ptr<bench_context> > runs;
+        for (int i = 0; i < contexts; ++i)
+        {
+            // with one context the post process has the cores to itself, with more they already run side by side
+            runs.emplace_back(new bench_context(handle, post, contexts == 1));
+            if (runs.back()->create(&pool) != 0)
+            {
+                return false;
+            }
+        }
+
+        // what the engine holds for the weights and the contexts, measured once they all exist
+        AX_ENGINE_CMM_INFO cmm_info;
+        memset(&cmm_info, 0, sizeof(cmm_info));
+        if (AX_ENGINE_GetCMMUsage(handle.handle, &cmm_info) != 0)
+        {
+            fprintf(stderr, "Engine get cmm usage of %s failed, it counts as 0.\n", model.c_str());
+            cmm_info.nCMMSize = 0;
+        }
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        int waiting = 0;
+        timer wall;
+        auto ready = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (++waiting == contexts)
+            {
+                wall.start();
+                cond.notify_all();
+                return;
+            }
+            cond.wait(lock, [&] { return waiting == contexts; });
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < contexts; ++i)
+        {
+            threads.emplace_back([&, i]() {
+                AX_TRACE_THREAD("context " + std::to_string(i));
+                runs[i]->run(frame, warmup, repeat, ready);
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        wall.stop();
+
+        result.model = model;
+        result.input = shape_string(handle.io_info->pInputs[0]);
+        result.cores = cores;
+        result.contexts = contexts;
+        result.frames = 0;
+        result.failed = 0;
+        result.wall_ms = wall.cost();
+        result.cmm_model = cmm_info.nCMMSize;
+        result.cmm_io = pool.stats().high_water;
+        for (auto& run : runs)
+        {
+            result.frames += (int)run->infer.size();
+            result.failed += run->failed;
+            result.pre.merge(run->pre);
+            result.infer.merge(run->infer);
+            result.post.merge(run->post);
+            result.total.merge(run->total);
+        }
+        return true;
+    }
+
+    static float fps(const bench_result& result)
+    {
+        return result.wall_ms > 0.f ? result.frames * 1000.f / result.wall_ms : 0.f;
+    }
+
+    static float cmm_mb(const bench_result& result)
+    {
+        return (result.cmm_model + result.cmm_io) / 1048576.f;
+    }
+
+    static void print_results(const std::vector<bench_result>& results)
+    {
+        fprintf(stdout, "--------------------------------------\n");
+        fprintf(stdout, "%-5s %-4s %9s | %8s %8s %8s %8s %8s | %8s %8s | %8s %8s | %8s\n",
+                "cores", "ctx", "fps", "infer", "p50", "p90", "p99", "p99.9", "pre", "post", "total", "p99", "cmm MB");
+        std::string model;
+        for (const auto& r : results)
+        {
+            if (r.model != model)
+            {
+                model = r.model;
+                fprintf(stdout, "%s, input %s\n", r.model.c_str(), r.input.c_str());
+            }
+            fprintf(stdout, "%-5d %-4d %9.2f | %8.3f %8.3f %8.3f %8.3f %8.3f | %8.3f %8.3f | %8.3f %8.3f | %8.2f%s\n",
+                    r.cores, r.contexts, fps(r), r.infer.mean(), r.infer.percentile(50.f), r.infer.percentile(90.f), r.infer.percentile(99.f), r.infer.percentile(99.9f),
+                    r.pre.mean(), r.post.mean(), r.total.percentile(50.f), r.total.percentile(99.f), cmm_mb(r), r.failed > 0 ? "  failed runs" : "");
+        }
+        fprintf(stdout, "--------------------------------------\n");
+    }
+
+    // the first result of `model` on `cores` cores, i.e. at the first context count
+    static const bench_result* first_result(const std::vector<bench_result>& results, const std::string& model, int cores)
+    {
+        for (const auto& r : results)
+        {
+            if (r.model == model && r.cores == cores)
+            {
+                return &r;
+            }
+        }
+        return nullptr;
+    }
+
+    static std::string markdown_cells(const bench_result* r, float (*value)(const bench_result&), const char* format)
+    {
+        if (r == nullptr)
+        {
+            return "-";
+        }
+        char text[32];
+        snprintf(text, sizeof(text), format, value(*r));
+        return text;
+    }
+
+    static float infer_ms(const bench_result& r)
+    {
+        return r.infer.mean();
+    }
+
+    static float infer_fps(const bench_result& r)
+    {
+        return r.infer.mean() > 0.f ? 1000.f / r.infer.mean() : 0.f;
+    }
+
+    // one row per model like benchmark/Benchmark_AX650N.md, the time and fps of the first context count.
+    // a core count that was not run is a -
+    static void print_markdown(const std::vector<bench_result>& results)
+    {
+        fprintf(stdout, "| Models | Input Size | Inference Time(ms)@1 Core | FPS@1 Core | Inference Time(ms)@3 Cores | FPS@3 Cores | CMM(MB)@1 Core | CMM(MB)@3 Cores |\n");
+        fprintf(stdout, "| ------ | ---------- | ------------------------- | ---------- | -------------------------- | ----------- | -------------- | --------------- |\n");
+        std::vector<std::string> models;
+        for (const auto& r : results)
+        {
+            if (std::find(models.begin(), models.end(), r.model) == models.end())
+            {
+                models.push_back(r.model);
+            }
+        }
+        for (const auto& model : models)
+        {
+            const bench_result* one = first_result(results, model, 1);
+            const bench_result* three = first_result(results, model, 3);
+            const bench_result* any = one != nullptr ? one : three;
+            auto parts = utilities::split_string(any->input, "x");
+            const char* size = parts.size() == 4 ? parts[1].c_str() : any->input.c_str();
+            auto slash = model.find_last_of('/');
+            std::string name = model.substr(slash == std::string::npos ? 0 : slash + 1);
+            fprintf(stdout, "| %s | %s | %s | %s | %s | %s | %s | %s |\n", name.c_str(), size,
+                    markdown_cells(one, infer_ms, "%.3f").c_str(), markdown_cells(one, infer_fps, "%.2f").c_str(),
+                    markdown_cells(three, infer_ms, "%.3f").c_str(), markdown_cells(three, infer_fps, "%.2f").c_str(),
+                    markdown_cells(one, cmm_mb, "%.2f").c_str(), markdown_cells(three, cmm_mb, "%.2f").c_str());
+        }
+    }
+
+    static void write_stats_json(FILE* fp, const char* name, const utilities::latency_stats& stats, bool last = false)
+    {
+        fprintf(fp, "      \"%s\": {\"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"p99.9\": %.4f}%s\n",
+                name, stats.mean(), stats.min(), stats.max(), stats.percentile(50.f), stats.percentile(90.f), stats.percentile(99.f), stats.percentile(99.9f),
+                last ? "" : ",");
+    }
+
+    static bool write_json(const std::string& path, const std::vector<bench_result>& results, int warmup, int repeat)
+    {
+        FILE* fp = path == "-" ? stdout : fopen(path.c_str(), "w");
+        if (fp == nullptr)
+        {
+            fprintf(stderr, "Open %s failed.\n", path.c_str());
+            return false;
+        }
+        fprintf(fp, "{\n  \"engine\": \"%s\",\n  \"warmup\": %d,\n  \"repeat\": %d,\n  \"results\": [\n", AX_ENGINE_GetVersion(), warmup, repeat);
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            fprintf(fp, "    {\n");
+            fprintf(fp, "      \"model\": \"%s\",\n      \"input\": \"%s\",\n      \"cores\": %d,\n      \"contexts\": %d,\n      \"frames\": %d,\n      \"failed\": %d,\n",
+                    r.model.c_str(), r.input.c_str(), r.cores, r.contexts, r.frames, r.failed);
+            fprintf(fp, "      \"fps\": %.2f,\n      \"cmm_model_bytes\": %zu,\n      \"cmm_io_bytes\": %zu,\n", fps(r), r.cmm_model, r.cmm_io);
+            write_stats_json(fp, "pre_ms", r.pre);
+            write_stats_json(fp, "infer_ms", r.infer);
+            write_stats_json(fp, "post_ms", r.post);
+            write_stats_json(fp, "total_ms", r.total, true);
+            fprintf(fp, "    }%s\n", i + 1 < results.size() ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+        if (fp != stdout)
+        {
+            fclose(fp);
+        }
+        return true;
+    }
+
+    static bool write_csv(const std::string& path, const std::vector<bench_result>& results)
+    {
+        FILE* fp = path == "-" ? stdout : fopen(path.c_str(), "w");
+        if (fp == nullptr)
+        {
+            fprintf(stderr, "Open %s failed.\n", path.c_str());
+            return false;
+        }
+        fprintf(fp, "model,input,cores,contexts,frames,failed,fps,cmm_mb");
+        for (const char* stage : {"pre", "infer", "post", "total"})
+        {
+            fprintf(fp, ",%s_mean,%s_p50,%s_p90,%s_p99,%s_p99.9", stage, stage, stage, stage, stage);
+        }
+        fprintf(fp, "\n");
+        for (const auto& r : results)
+        {
+            fprintf(fp, "%s,%s,%d,%d,%d,%d,%.2f,%.2f", r.model.c_str(), r.input.c_str(), r.cores, r.contexts, r.frames, r.failed, fps(r), cmm_mb(r));
+            for (const auto* stats : {&r.pre, &r.infer, &r.post, &r.total})
+            {
+                fprintf(fp, ",%.4f,%.4f,%.4f,%.4f,%.4f", stats->mean(), stats->percentile(50.f), stats->percentile(90.f), stats->percentile(99.f),
+                        stats->percentile(99.9f));
+            }
+            fprintf(fp, "\n");
+        }
+        if (fp != stdout)
+        {
+            fclose(fp);
+        }
+        return true;
+    }
+} // namespace ax
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<std::string>("model", 'm', "joint files(a.k.a. joint models), separated by ','", true, "");
+    cmd.add<std::string>("image", 'i', "image letterboxed into an image input, a synthetic 1080p frame when not given", false, "");
+    cmd.add<std::string>("contexts", 'c', "concurrent contexts to sweep, separated by ','", false, "1");
+    cmd.add<std::string>("cores", 0, "npu cores to sweep, separated by ',': 1 (a virtual npu, models built for 1 core) or 3", false, "3");
+    cmd.add<int>("repeat", 'r', "timed frames per context", false, DEFAULT_REPEAT);
+    cmd.add<int>("warmup", 'w', "untimed frames per context before them", false, DEFAULT_WARMUP);
+    cmd.add<std::string>("post", 'p', "post process to time: none, yolov8 or yolo26", false, "none", cmdline::oneof<std::string>("none", "yolov8", "yolo26"));
+    cmd.add("no-pre", 0, "do not letterbox a frame into the input");
+    cmd.add<std::string>("json", 'j', "write the results as json to this file, - for stdout", false, "");
+    cmd.add<std::string>("csv", 0, "write the results as csv to this file, - for stdout", false, "");
+    cmd.add("markdown", 0, "print a benchmark table of the first context count, run --cores 1,3 to fill both columns");
+#ifdef AXERA_TRACE
+    cmd.add<std::string>("trace", 't', "write a chrome trace json of the last runs to this file", false, "");
+#endif
+#ifdef AXERA_MOCK_ENGINE
+    cmd.add<float>("mock-latency", 0, "mock engine: ms every run takes", false, 0.f);
+    cmd.add<float>("mock-jitter", 0, "mock engine: up to this many ms more per run", false, 0.f);
+    cmd.add<int>("mock-cores", 0, "mock engine: runs that may execute at the same time", false, 1);
+#endif
+    cmd.parse_check(argc, argv);
+
+    // 0. get app args, can be removed from user's app
+    auto models = utilities::split_string(cmd.get<std::string>("model"), ",");
+    for (auto& model : models)
+    {
+        if (!utilities::file_exist(model))
+        {
+            fprintf(stderr, "Input file model(%s) is not exist, please check it.\n", model.c_str());
+            return -1;
+        }
+    }
+    std::vector<int> contexts;
+    for (auto& text : utilities::split_string(cmd.get<std::string>("contexts"), ","))
+    {
+        int count = std::atoi(text.c_str());
+        if (count <= 0)
+        {
+            fprintf(stderr, "Bad context count %s.\n", text.c_str());
+            return -1;
+        }
+        contexts.push_back(count);
+    }
+    std::vector<int> cores;
+    for (auto& text : utilities::split_string(cmd.get<std::string>("cores"), ","))
+    {
+        int count = std::atoi(text.c_str());
+        AX_ENGINE_NPU_MODE_T mode;
+        if (!ax::npu_mode(count, mode))
+        {
+            fprintf(stderr, "Bad core count %s, 1 or 3.\n", text.c_str());
+            return -1;
+        }
+        cores.push_back(count);
+    }
+    const int repeat = std::max(cmd.get<int>("repeat"), 1);
+    const int warmup = std::max(cmd.get<int>("warmup"), 0);
+    const auto post_name = cmd.get<std::string>("post");
+    const int post = post_name == "yolov8" ? ax::POST_YOLOV8 : (post_name == "yolo26" ? ax::POST_YOLO26 : ax::POST_NONE);
+
+#ifdef AXERA_MOCK_ENGINE
+    // the mock reads these when a handle is created, a mock model file overrides the latency
+    setenv("AX_MOCK_LATENCY_MS", std::to_string(cmd.get<float>("mock-latency")).c_str(), 1);
+    setenv("AX_MOCK_LATENCY_JITTER_MS", std::to_string(cmd.get<float>("mock-jitter")).c_str(), 1);
+    setenv("AX_MOCK_NPU_CORES", std::to_string(cmd.get<int>("mock-cores")).c_str(), 1);
+#endif
+
+    // the frame every context letterboxes, the same work a sample does per image
+    ax::bench_frame frame;
+    const bool pre = !cmd.exist("no-pre");
+    if (pre)
+    {
+        auto image_file = cmd.get<std::string>("image");
+        cv::Mat mat;
+        if (!image_file.empty())
+        {
+            mat = cv::imread(image_file);
+            if (mat.empty())
+            {
+                fprintf(stderr, "Read image failed.\n");
+                return -1;
+            }
+            frame.rows = mat.rows;
+            frame.cols = mat.cols;
+            frame.data.resize((size_t)mat.rows * mat.cols * 3);
+            for (int y = 0; y < mat.rows; ++y)
+            {
+                memcpy(frame.data.data() + (size_t)y * mat.cols * 3, mat.ptr(y), (size_t)mat.cols * 3);
+            }
+        }
+        else
+        {
+            frame.rows = DEFAULT_FRAME_ROWS;
+            frame.cols = DEFAULT_FRAME_COLS;
+            frame.data.resize((size_t)frame.rows * frame.cols * 3);
+            std::mt19937 rng(42);
+            for (auto& v : frame.data)
+            {
+                v = (uint8_t)(rng() & 0xff);
+            }
+        }
+    }
+
+    // 1. print args
+    fprintf(stdout, "--------------------------------------\n");
+    fprintf(stdout, "models : %zu\n", models.size());
+    fprintf(stdout, "cores : %s\n", cmd.get<std::string>("cores").c_str());
+    fprintf(stdout, "contexts : %s\n", cmd.get<std::string>("contexts").c_str());
+    fprintf(stdout, "frames : %d warmup + %d timed per context\n", warmup, repeat);
+    fprintf(stdout, "preprocess : %s, post process : %s\n", pre ? "letterbox" : "none", post_name.c_str());
+    fprintf(stdout, "--------------------------------------\n");
+
+    // 2. sys_init
+    AX_SYS_Init();
+
+    // 3. every model at every context count, the engine is initialized again for every core count
+    std::vector<ax::bench_result> results;
+    bool ok = true;
+    for (int core_count : cores)
+    {
+        AX_ENGINE_NPU_ATTR_T npu_attr;
+        memset(&npu_attr, 0, sizeof(npu_attr));
+        ax::npu_mode(core_count, npu_attr.eHardMode);
+        auto ret = AX_ENGINE_Init(&npu_attr);
+        if (0 != ret)
+        {
+            fprintf(stderr, "Init ax-engine for %d cores failed{0x%8x}.\n", core_count, ret);
+            ok = false;
+            continue;
+        }
+
+        for (auto& model : models)
+        {
+            for (int count : contexts)
+            {
+                ax::bench_result result;
+                if (!ax::run_contexts(model, core_count, count, pre ? &frame : nullptr, post, warmup, repeat, result))
+                {
+                    fprintf(stderr, "Run %s on %d cores with %d contexts failed.\n", model.c_str(), core_count, count);
+                    ok = false;
+                    continue;
+                }
+                results.push_back(result);
+            }
+        }
+
+        // 4. engine de init
+        AX_ENGINE_Deinit();
+    }
+
+    ax::print_results(results);
+    if (cmd.exist("markdown"))
+    {
+        ax::print_markdown(results);
+    }
+    if (!cmd.get<std::string>("json").empty())
+    {
+        ok = ax::write_json(cmd.get<std::string>("json"), results, warmup, repeat) && ok;
+    }
+    if (!cmd.get<std::string>("csv").empty())
+    {
+        ok = ax::write_csv(cmd.get<std::string>("csv"), results) && ok;
+    }
+#ifdef AXERA_TRACE
+    if (!cmd.get<std::string>("trace").empty())
+    {
+        ok = AX_TRACE_WRITE(cmd.get<std::string>("trace")) && ok;
+    }
+#endif
+
+    // 5. sys de init
+    AX_SYS_Deinit();
+    return ok ? 0 : -1;
+}
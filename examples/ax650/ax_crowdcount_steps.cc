@@ -26,6 +26,7 @@
 #include "base/common.hpp"
 #include "base/detection.hpp"
 #include "middleware/io.hpp"
+#include "middleware/session.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -241,7 +242,7 @@ namespace ax
         cv::imwrite("crowdcount_out.jpg", mat);
     }
 
-    bool run_model(const std::string& model, const std::vector<uint8_t>& data, const int& repeat, cv::Mat& mat, int input_h, int input_w)
+    bool run_model(const std::string& model, const int& repeat, cv::Mat& mat, int input_h, int input_w)
     {
         // 1. init engine
 #ifdef AXERA_TARGET_CHIP_AX620E
@@ -257,65 +258,45 @@ namespace ax
             return ret;
         }
 
-        // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
+        // 2. load model, create handle, context and io
+        middleware::session session;
+        ret = session.load(model);
+        if (0 != ret)
         {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
+            return ret;
         }
 
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating handle is done.\n");
-
-        // 4. create context
-        ret = AX_ENGINE_CreateContext(handle);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating context is done.\n");
-
-        // 5. set io
-        AX_ENGINE_IO_INFO_T* io_info;
-        ret = AX_ENGINE_GetIOInfo(handle, &io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine get io info is done. \n");
-
-        // 6. alloc io
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
-
-        // 7. insert input
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        // 3. letterbox the image straight into the input tensor
+        size_t stride = session.input_stride(input_h, (size_t)input_w * 3);
+        if (0 == stride)
+        {
+            return -1;
+        }
+        common::get_input_data_letterbox(mat, session.get_input(), input_h, input_w, true, stride);
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
-        // 8. warm up
-        for (int i = 0; i < 5; ++i)
-        {
-            AX_ENGINE_RunSync(handle, &io_data);
-        }
+        // 4. warm up
+        session.warm_up(5);
 
-        // 9. run model
+        // 5. run model
         std::vector<float> time_costs(repeat, 0);
         for (int i = 0; i < repeat; ++i)
         {
             timer tick;
-            ret = AX_ENGINE_RunSync(handle, &io_data);
+            ret = session.run();
             time_costs[i] = tick.cost();
-            SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+            if (0 != ret)
+            {
+                return ret;
+            }
         }
 
-        // 10. get result
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        // 6. get result
+        post_process(session.get_io_info(), session.get_io(), mat, input_w, input_h, time_costs);
         fprintf(stdout, "--------------------------------------\n");
 
-        middleware::free_io(&io_data);
-        return AX_ENGINE_DestroyHandle(handle);
+        return 0;
     }
 } // namespace ax
 
@@ -374,15 +355,13 @@ int main(int argc, char* argv[])
     fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
     fprintf(stdout, "--------------------------------------\n");
 
-    // 2. read image & resize & transpose
-    std::vector<uint8_t> image(input_size[0] * input_size[1] * 3, 0);
+    // 2. read image
     cv::Mat mat = cv::imread(image_file);
     if (mat.empty())
     {
         fprintf(stderr, "Read image failed.\n");
         return -1;
     }
-    common::get_input_data_letterbox(mat, image, input_size[0], input_size[1], true);
 
     // 3. sys_init
     AX_SYS_Init();
@@ -390,7 +369,7 @@ int main(int argc, char* argv[])
     // 4. -  engine model  -  can only use AX_ENGINE** inside
     {
         // AX_ENGINE_NPUReset(); // todo ??
-        ax::run_model(model_file, image, repeat, mat, input_size[0], input_size[1]);
+        ax::run_model(model_file, repeat, mat, input_size[0], input_size[1]);
 
         // 4.3 engine de init
         AX_ENGINE_Deinit();
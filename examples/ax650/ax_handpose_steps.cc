@@ -31,6 +31,7 @@
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
 #include "utilities/file.hpp"
+#include "utilities/model.hpp"
 #include "utilities/timer.hpp"
 
 #include <ax_sys_api.h>
@@ -103,17 +104,11 @@ namespace ax
         }
 
         // 2. load model
-        std::vector<char> model_buffer;
-        if (!utl::read_file(model, model_buffer))
-        {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            AX_ENGINE_Deinit();
-            return false;
-        }
-
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
+        AX_ENGINE_HANDLE handle = nullptr;
+        ret = utl::load_model(model, [&](const void* data, size_t size) {
+            // 3. create handle, straight from the mapped file
+            return AX_ENGINE_CreateHandle(&handle, data, size);
+        });
         if (0 != ret)
         {
             fprintf(stderr, "AX_ENGINE_CreateHandle failed, ret = 0x%x\n", ret);
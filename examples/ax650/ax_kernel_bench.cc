@@ -0,0 +1,1947 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+/*
+* Author:
+*/
+
+// micro benchmarks of the cpu post process kernels, no npu or model needed.
+// every case times the current path against the reference one and checks they agree.
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "base/candidate.hpp"
+#include "base/class_scan.hpp"
+#include "base/common.hpp"
+#include "base/detection.hpp"
+#include "base/dfl.hpp"
+#include "base/mask.hpp"
+#include "base/matcher.hpp"
+#include "base/nms.hpp"
+#include "base/nv12.hpp"
+#include "base/pose.hpp"
+#include "base/proposal_tiles.hpp"
+#include "base/score_sort.hpp"
+#include "base/segmentation.hpp"
+#include "base/slicing.hpp"
+#include "base/superpoint.hpp"
+#include "middleware/cmm_pool.hpp"
+
+#include "utilities/cmdline.hpp"
+#include "utilities/model.hpp"
+#include "utilities/timer.hpp"
+#include "utilities/trace.hpp"
+
+// heap allocations of this process, for the cases that look at allocation counts.
+// the malloc / free calls stay out of line, otherwise gcc pairs them with new / delete and warns
+static size_t g_allocations = 0;
+
+__attribute__((noinline)) static void* counted_alloc(size_t size)
+{
+    g_allocations++;
+    return malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) static void counted_free(void* ptr)
+{
+    free(ptr);
+}
+
+void* operator new(size_t size)
+{
+    void* ptr = counted_alloc(size);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    counted_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    counted_free(ptr);
+}
+
+namespace bench
+{
+    // run `func` `repeat` times and return the best time in ms, the first run warms the caches
+    static float best_of(int repeat, const std::function<void()>& func)
+    {
+        float best = 1e30f;
+        for (int i = 0; i < repeat + 1; ++i)
+        {
+            timer tick;
+            func();
+            float cost = tick.cost();
+            if (i > 0)
+            {
+                best = std::min(best, cost);
+            }
+        }
+        return best;
+    }
+
+    static void print_compare(const char* name, const char* unit, int count, float ref_ms, float cur_ms)
+    {
+        fprintf(stdout, "%-28s ref %9.3f ms  cur %9.3f ms  (%8.2f ns/%s)  speedup %.2fx\n",
+                name, ref_ms, cur_ms, cur_ms * 1e6f / (float)count, unit, cur_ms > 0.f ? ref_ms / cur_ms : 0.f);
+    }
+
+    // dfl: 4 ltrb distributions of one anchor-free cell, scalar softmax loop vs simd kernel
+    static int run_dfl(int count, int repeat)
+    {
+        const int reg_maxes[] = {16, 17};
+        std::mt19937 rng(42);
+        std::normal_distribution<float> logits(0.f, 3.f);
+
+        int failed = 0;
+        for (int reg_max : reg_maxes)
+        {
+            std::vector<float> feat((size_t)count * 4 * reg_max);
+            for (auto& v : feat)
+            {
+                v = logits(rng);
+            }
+            std::vector<float> ref((size_t)count * 4), cur((size_t)count * 4);
+
+            float ref_ms = best_of(repeat, [&]() {
+                for (int i = 0; i < count; ++i)
+                {
+                    detection::dfl_decode_ltrb_ref(feat.data() + (size_t)i * 4 * reg_max, reg_max, 1.f, ref.data() + i * 4);
+                }
+            });
+            float cur_ms = best_of(repeat, [&]() {
+                for (int i = 0; i < count; ++i)
+                {
+                    detection::dfl_decode_ltrb(feat.data() + (size_t)i * 4 * reg_max, reg_max, 1.f, cur.data() + i * 4);
+                }
+            });
+
+            float max_diff = 0.f;
+            for (size_t i = 0; i < ref.size(); ++i)
+            {
+                max_diff = std::max(max_diff, std::fabs(ref[i] - cur[i]));
+            }
+
+            char name[64];
+            snprintf(name, sizeof(name), "dfl reg_max=%d", reg_max);
+            print_compare(name, "cell", count, ref_ms, cur_ms);
+            // distances are in bins here, anything close to 1e-3 bin would already move a box by a fraction of a pixel
+            bool ok = max_diff < 1e-4f;
+            fprintf(stdout, "%-28s max abs deviation %.3g bins %s\n", "", max_diff, ok ? "ok" : "FAILED");
+            failed += ok ? 0 : 1;
+        }
+        return failed;
+    }
+
+    // scan: best class of every cell of an 80 class anchor-free head, argmax + sigmoid per cell vs threshold first scan
+    static int run_scan(int count, int repeat)
+    {
+        const int cls_num = 80;
+        const int cell_step = cls_num + 64;
+        const float prob_threshold = 0.45f;
+        std::mt19937 rng(42);
+        // mostly background, as in a real head, a few cells get a confident class
+        std::normal_distribution<float> background(-7.f, 1.5f);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        std::vector<float> feat((size_t)count * cell_step);
+        for (auto& v : feat)
+        {
+            v = background(rng);
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            if (uniform(rng) < 0.02f)
+            {
+                feat[(size_t)i * cell_step + (int)(uniform(rng) * cls_num)] = uniform(rng) * 6.f - 2.f;
+            }
+        }
+
+        std::vector<detection::ClassCandidate> ref, cur;
+        float ref_ms = best_of(repeat, [&]() {
+            ref.clear();
+            for (int i = 0; i < count; ++i)
+            {
+                const float* p = feat.data() + (size_t)i * cell_step;
+                int class_index = 0;
+                float class_score = -FLT_MAX;
+                for (int s = 0; s < cls_num; s++)
+                {
+                    if (p[s] > class_score)
+                    {
+                        class_index = s;
+                        class_score = p[s];
+                    }
+                }
+                if (1.f / (1.f + std::exp(-class_score)) > prob_threshold)
+                {
+                    ref.push_back({i, class_index, class_score});
+                }
+            }
+        });
+        float cur_ms = best_of(repeat, [&]() {
+            cur.clear();
+            detection::scan_class_scores(feat.data(), count, cell_step, cls_num, detection::logit_threshold(prob_threshold), cur);
+        });
+
+        // the scan may let through cells sitting exactly on the threshold, the decoders re-check them after the sigmoid
+        size_t kept = 0;
+        bool ok = true;
+        for (const auto& c : cur)
+        {
+            if (1.f / (1.f + std::exp(-c.score)) > prob_threshold)
+            {
+                ok = ok && kept < ref.size() && ref[kept].cell == c.cell && ref[kept].label == c.label && ref[kept].score == c.score;
+                kept++;
+            }
+        }
+        ok = ok && kept == ref.size();
+
+        print_compare("scan cls=80", "cell", count, ref_ms, cur_ms);
+        fprintf(stdout, "%-28s %zu candidates, %zu after sigmoid, %zu expected %s\n", "", cur.size(), kept, ref.size(), ok ? "ok" : "FAILED");
+        return ok ? 0 : 1;
+    }
+
+    struct nms_box
+    {
+        struct
+        {
+            float x, y, width, height;
+        } rect;
+        int label;
+        float prob;
+    };
+
+    // nms: clustered proposals over 80 classes, greedy reference vs grid + simd iou, class agnostic and aware
+    static int run_nms(int count, int repeat)
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::normal_distribution<float> jitter(0.f, 4.f);
+
+        // a few hundred objects, each seen by a burst of neighbouring cells
+        std::vector<nms_box> boxes(count);
+        const int objects = std::max(1, count / 30);
+        for (int i = 0; i < count; ++i)
+        {
+            std::mt19937 obj_rng(i % objects);
+            float w = 16.f + uniform(obj_rng) * 160.f;
+            float h = 16.f + uniform(obj_rng) * 160.f;
+            float cx = uniform(obj_rng) * 640.f;
+            float cy = uniform(obj_rng) * 640.f;
+            int label = (int)(uniform(obj_rng) * 80);
+
+            nms_box& box = boxes[i];
+            box.rect.width = std::max(1.f, w + jitter(rng));
+            box.rect.height = std::max(1.f, h + jitter(rng));
+            box.rect.x = cx - box.rect.width * 0.5f + jitter(rng);
+            box.rect.y = cy - box.rect.height * 0.5f + jitter(rng);
+            box.label = uniform(rng) < 0.8f ? label : (int)(uniform(rng) * 80);
+            box.prob = uniform(rng);
+        }
+        std::sort(boxes.begin(), boxes.end(), [](const nms_box& a, const nms_box& b) { return a.prob > b.prob; });
+
+        int failed = 0;
+        for (bool class_aware : {false, true})
+        {
+            detection::NmsParam param(0.45f, class_aware);
+            std::vector<int> ref, cur;
+            float ref_ms = best_of(repeat, [&]() {
+                detection::nms_sorted_bboxes(boxes, ref, param.iou_threshold, param.class_aware);
+            });
+            float cur_ms = best_of(repeat, [&]() {
+                detection::nms_grid_sorted_bboxes(boxes, cur, param);
+            });
+
+            const char* name = class_aware ? "nms class aware" : "nms class agnostic";
+            print_compare(name, "box", count, ref_ms, cur_ms);
+            size_t diff = 0;
+            for (size_t i = 0; i < std::max(ref.size(), cur.size()); ++i)
+            {
+                diff += (i >= ref.size() || i >= cur.size() || ref[i] != cur[i]) ? 1 : 0;
+            }
+            bool ok = diff == 0;
+            fprintf(stdout, "%-28s %zu kept, %zu expected, %zu differ %s\n", "", cur.size(), ref.size(), diff, ok ? "ok" : "FAILED");
+            failed += ok ? 0 : 1;
+        }
+
+        // the cap keeps the highest scoring picks
+        std::vector<int> all, capped;
+        detection::nms_grid_sorted_bboxes(boxes, all, detection::NmsParam(0.45f, false));
+        detection::nms_grid_sorted_bboxes(boxes, capped, detection::NmsParam(0.45f, false, 100));
+        bool ok = capped.size() == std::min(all.size(), (size_t)100) && std::equal(capped.begin(), capped.end(), all.begin());
+        fprintf(stdout, "%-28s max_det=100 keeps %zu %s\n", "", capped.size(), ok ? "ok" : "FAILED");
+        failed += ok ? 0 : 1;
+        return failed;
+    }
+
+    // proposal shaped like detection::Object, the heap members make every swap/move cost something
+    struct sort_box
+    {
+        float rect[4];
+        int label;
+        float prob;
+        std::vector<float> mask_feat;
+        std::vector<float> kps_feat;
+    };
+
+    // the recursive quicksort that qsort_descent_inplace used to be (openmp is not enabled in the build)
+    static void legacy_qsort_descent(std::vector<sort_box>& objects, int left, int right)
+    {
+        int i = left;
+        int j = right;
+        float p = objects[(left + right) / 2].prob;
+        while (i <= j)
+        {
+            while (objects[i].prob > p)
+                i++;
+            while (objects[j].prob < p)
+                j--;
+            if (i <= j)
+            {
+                std::swap(objects[i], objects[j]);
+                i++;
+                j--;
+            }
+        }
+        if (left < j) legacy_qsort_descent(objects, left, j);
+        if (i < right) legacy_qsort_descent(objects, i, right);
+    }
+
+    // sort: proposal ordering at several sizes, legacy in place quicksort vs index sorts and a pre-nms top-k
+    static int run_sort(int count, int repeat)
+    {
+        const int sizes[] = {256, 2048, count, count * 4};
+        const int top_k = 300;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        int failed = 0;
+        for (int n : sizes)
+        {
+            std::vector<sort_box> boxes(n);
+            for (auto& box : boxes)
+            {
+                // scores above a 0.25 threshold, quantized like a sigmoid of int8 logits so ties happen
+                box.prob = 0.25f + std::round(uniform(rng) * 192.f) / 256.f;
+                box.mask_feat.resize(32);
+            }
+
+            std::vector<std::vector<sort_box> > copies(repeat + 1, boxes);
+            size_t next = 0;
+            float ref_ms = best_of(repeat, [&]() {
+                auto& objects = copies[next++ % copies.size()];
+                legacy_qsort_descent(objects, 0, (int)objects.size() - 1);
+            });
+
+            std::vector<int> order_std, order_radix, order_top;
+            float std_ms = best_of(repeat, [&]() { detection::sort_descent_indices(boxes, order_std, 0, detection::SORT_STD); });
+            float radix_ms = best_of(repeat, [&]() { detection::sort_descent_indices(boxes, order_radix, 0, detection::SORT_RADIX); });
+            float top_ms = best_of(repeat, [&]() { detection::sort_descent_indices(boxes, order_top, top_k); });
+
+            char name[64];
+            snprintf(name, sizeof(name), "sort n=%d std", n);
+            print_compare(name, "box", n, ref_ms, std_ms);
+            snprintf(name, sizeof(name), "sort n=%d radix", n);
+            print_compare(name, "box", n, ref_ms, radix_ms);
+            snprintf(name, sizeof(name), "sort n=%d top%d", n, top_k);
+            print_compare(name, "box", n, ref_ms, top_ms);
+
+            // all orders are stable, so they have to agree index by index
+            bool ok = order_std == order_radix && (int)order_top.size() == std::min(n, top_k)
+                      && std::equal(order_top.begin(), order_top.end(), order_std.begin());
+            for (int i = 1; i < n && ok; ++i)
+            {
+                ok = boxes[order_std[i - 1]].prob >= boxes[order_std[i]].prob;
+            }
+            fprintf(stdout, "%-28s stable orders agree %s\n", "", ok ? "ok" : "FAILED");
+            failed += ok ? 0 : 1;
+        }
+        return failed;
+    }
+
+    // proposal shaped like detection::Object with a mask, what the decoders used to push per cell
+    struct object_box
+    {
+        detection::CandidateRect rect;
+        int label;
+        float prob;
+        std::vector<float> mask_feat;
+        std::vector<float> kps_feat;
+    };
+
+    // tiles: the three heads of a yolov8 native output decoded serially vs in row tiles on pools of
+    // 1 / 2 / 4 / 8 threads, for a 640 and a 1280 input. the merged candidates must equal the serial ones.
+    static int run_tiles(int count, int repeat)
+    {
+        const int cls_num = 80;
+        int reg_max = 16; // not const, gcc would fold it into the dfl tail loop and warn
+        const int cell_step = cls_num + 4 * reg_max;
+        const float prob_threshold = 0.45f;
+        const int strides[3] = {8, 16, 32};
+        std::mt19937 rng(42);
+        std::normal_distribution<float> background(-8.f, 2.f);
+        std::normal_distribution<float> box(0.f, 2.f);
+        std::uniform_int_distribution<int> pick(0, 199);
+
+        // decode of one head as generate_proposals_yolov8_native does it
+        auto decode = [&](int stride, const float* feat, int size, const detection::GridRows& rows, detection::Proposals& proposals) {
+            const int feat_w = size / stride;
+            const int feat_h = size / stride;
+            std::vector<detection::ClassCandidate> candidates;
+            detection::scan_class_rows(feat + 4 * reg_max, feat_w, feat_h, rows, cell_step, cls_num, detection::logit_threshold(prob_threshold), candidates);
+            for (const auto& candidate : candidates)
+            {
+                const float box_prob = 1.f / (1.f + std::exp(-candidate.score));
+                if (box_prob > prob_threshold)
+                {
+                    float ltrb[4];
+                    detection::dfl_decode_ltrb(feat + (size_t)candidate.cell * cell_step, reg_max, stride, ltrb);
+                    const float cx = (candidate.cell % feat_w + 0.5f) * stride;
+                    const float cy = (candidate.cell / feat_w + 0.5f) * stride;
+                    float x0 = std::max(std::min(cx - ltrb[0], (float)(size - 1)), 0.f);
+                    float y0 = std::max(std::min(cy - ltrb[1], (float)(size - 1)), 0.f);
+                    float x1 = std::max(std::min(cx + ltrb[2], (float)(size - 1)), 0.f);
+                    float y1 = std::max(std::min(cy + ltrb[3], (float)(size - 1)), 0.f);
+                    proposals.push(x0, y0, x1 - x0, y1 - y0, candidate.label, box_prob);
+                }
+            }
+        };
+
+        int failed = 0;
+        for (int size : {640, 1280})
+        {
+            // mostly background logits, about one cell in 200 holds an object
+            std::vector<std::vector<float> > heads(3);
+            int head_rows[3];
+            int cells = 0;
+            for (int i = 0; i < 3; ++i)
+            {
+                const int feat = size / strides[i];
+                head_rows[i] = feat;
+                cells += feat * feat;
+                heads[i].resize((size_t)feat * feat * cell_step);
+                for (int c = 0; c < feat * feat; ++c)
+                {
+                    float* cell = heads[i].data() + (size_t)c * cell_step;
+                    for (int k = 0; k < 4 * reg_max; ++k)
+                    {
+                        cell[k] = box(rng);
+                    }
+                    for (int k = 0; k < cls_num; ++k)
+                    {
+                        cell[4 * reg_max + k] = background(rng);
+                    }
+                    if (pick(rng) == 0)
+                    {
+                        cell[4 * reg_max + pick(rng) % cls_num] = 2.f;
+                    }
+                }
+            }
+
+            detection::Proposals ref, cur;
+            float ref_ms = best_of(repeat, [&]() {
+                ref.clear();
+                for (int i = 0; i < 3; ++i)
+                {
+                    decode(strides[i], heads[i].data(), size, detection::GridRows(), ref);
+                }
+            });
+
+            for (int threads : {1, 2, 4, 8})
+            {
+                common::thread_pool pool(threads);
+                detection::ProposalTiles<detection::Proposals> tiles;
+                float cur_ms = best_of(repeat, [&]() {
+                    cur.clear();
+                    tiles.run(head_rows, 3, [&](int i, const detection::GridRows& rows, detection::Proposals& tile) {
+                        decode(strides[i], heads[i].data(), size, rows, tile);
+                    }, cur, detection::PROPOSAL_TILE_ROWS, &pool);
+                });
+                char name[64];
+                snprintf(name, sizeof(name), "tiles %d %zut %dt", size, tiles.tile_count(), threads);
+                print_compare(name, "cell", cells, ref_ms, cur_ms);
+
+                bool ok = ref.size() == cur.size() && ref.size() > 0;
+                for (size_t i = 0; ok && i < ref.size(); ++i)
+                {
+                    const detection::Candidate& a = ref.candidates[i];
+                    const detection::Candidate& b = cur.candidates[i];
+                    ok = a.label == b.label && a.prob == b.prob && memcmp(&a.rect, &b.rect, sizeof(a.rect)) == 0;
+                }
+                fprintf(stdout, "%-28s %zu candidates %s\n", "", cur.size(), ok ? "ok" : "FAILED");
+                failed += ok ? 0 : 1;
+            }
+        }
+        (void)count;
+        return failed;
+    }
+
+
+    // proposals: seg head decode + nms + survivors, Objects pushed per cell vs a reused Proposals arena
+    static int run_proposals(int count, int repeat)
+    {
+        const int mask_dim = 32;
+        const int frames = 16;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::normal_distribution<float> jitter(0.f, 4.f);
+
+        // one frame of decoded cells, a burst of neighbouring cells per object like run_nms
+        std::vector<object_box> cells(count);
+        const int objects = std::max(1, count / 30);
+        for (int i = 0; i < count; ++i)
+        {
+            std::mt19937 obj_rng(i % objects);
+            float w = 16.f + uniform(obj_rng) * 160.f;
+            float h = 16.f + uniform(obj_rng) * 160.f;
+            float cx = uniform(obj_rng) * 640.f;
+            float cy = uniform(obj_rng) * 640.f;
+
+            object_box& cell = cells[i];
+            cell.rect.width = std::max(1.f, w + jitter(rng));
+            cell.rect.height = std::max(1.f, h + jitter(rng));
+            cell.rect.x = cx - cell.rect.width * 0.5f + jitter(rng);
+            cell.rect.y = cy - cell.rect.height * 0.5f + jitter(rng);
+            cell.label = (int)(uniform(obj_rng) * 80);
+            cell.prob = uniform(rng);
+        }
+        std::vector<float> protos((size_t)count * mask_dim);
+        for (auto& v : protos)
+        {
+            v = uniform(rng);
+        }
+
+        const detection::NmsParam param(0.45f);
+        std::vector<object_box> ref_out, cur_out;
+        std::vector<int> picked;
+
+        auto legacy_frame = [&]() {
+            std::vector<object_box> proposals;
+            for (int i = 0; i < count; ++i)
+            {
+                object_box obj;
+                obj.rect = cells[i].rect;
+                obj.label = cells[i].label;
+                obj.prob = cells[i].prob;
+                obj.mask_feat.assign(protos.begin() + (size_t)i * mask_dim, protos.begin() + (size_t)(i + 1) * mask_dim);
+                proposals.push_back(obj);
+            }
+            detection::nms_bboxes(proposals, picked, param);
+            ref_out.clear();
+            for (int index : picked)
+            {
+                ref_out.push_back(proposals[index]);
+            }
+        };
+
+        detection::Proposals proposals;
+        auto slim_frame = [&]() {
+            proposals.clear();
+            proposals.set_feat(detection::CANDIDATE_FEAT_MASK, mask_dim);
+            for (int i = 0; i < count; ++i)
+            {
+                const auto& rect = cells[i].rect;
+                float* feat = proposals.push(rect.x, rect.y, rect.width, rect.height, cells[i].label, cells[i].prob);
+                memcpy(feat, protos.data() + (size_t)i * mask_dim, mask_dim * sizeof(float));
+            }
+            detection::nms_bboxes(proposals.candidates, picked, param);
+            cur_out.resize(picked.size());
+            for (size_t i = 0; i < picked.size(); ++i)
+            {
+                const auto& candidate = proposals.candidates[picked[i]];
+                object_box& obj = cur_out[i];
+                obj.rect = candidate.rect;
+                obj.label = candidate.label;
+                obj.prob = candidate.prob;
+                const float* feat = proposals.feat(picked[i]);
+                obj.mask_feat.assign(feat, feat + mask_dim);
+            }
+        };
+
+        float ref_ms = best_of(repeat, legacy_frame);
+        float cur_ms = best_of(repeat, slim_frame);
+        print_compare("proposals seg frame", "cell", count, ref_ms, cur_ms);
+
+        // steady state: the arena and the output vector are warm, count what one more frame allocates
+        size_t before = g_allocations;
+        for (int f = 0; f < frames; ++f)
+        {
+            legacy_frame();
+        }
+        size_t ref_allocs = g_allocations - before;
+        before = g_allocations;
+        for (int f = 0; f < frames; ++f)
+        {
+            slim_frame();
+        }
+        size_t cur_allocs = g_allocations - before;
+        fprintf(stdout, "%-28s ref %9.1f allocs  cur %9.1f allocs per frame\n", "proposals allocations",
+                (float)ref_allocs / frames, (float)cur_allocs / frames);
+
+        bool ok = ref_out.size() == cur_out.size();
+        for (size_t i = 0; i < ref_out.size() && ok; ++i)
+        {
+            ok = ref_out[i].prob == cur_out[i].prob && ref_out[i].label == cur_out[i].label
+                 && ref_out[i].rect.x == cur_out[i].rect.x && ref_out[i].mask_feat == cur_out[i].mask_feat;
+        }
+        fprintf(stdout, "%-28s %zu survivors %s\n", "", cur_out.size(), ok ? "ok" : "FAILED");
+
+        // one Object vector over a seg frame and then a det frame, nothing of the seg object may stay
+        std::vector<detection::Object> reused;
+        detection::Proposals frame;
+        frame.set_feat(detection::CANDIDATE_FEAT_MASK, mask_dim);
+        memcpy(frame.push(10.f, 10.f, 50.f, 50.f, 3, 0.9f), protos.data(), mask_dim * sizeof(float));
+        detection::append_objects(frame, reused);
+        reused[0].mask = cv::Mat(50, 50, CV_8UC1);
+        reused[0].kps_feat.assign(51, 1.f);
+        reused[0].landmark[0] = cv::Point2f(1.f, 1.f);
+        frame.clear();
+        frame.set_feat(detection::CANDIDATE_FEAT_NONE, 0);
+        frame.push(20.f, 20.f, 40.f, 40.f, 5, 0.8f);
+        std::vector<int> first(1, 0);
+        detection::materialize_objects(frame, first, reused);
+        const detection::Object& det = reused[0];
+        bool clean = reused.size() == 1 && det.label == 5 && det.mask.rows == 0 && det.mask_feat.empty()
+                     && det.kps_feat.empty() && det.landmark[0].x == 0.f && det.landmark[0].y == 0.f;
+        fprintf(stdout, "%-28s seg then det frame in one vector %s\n", "", clean ? "ok" : "FAILED");
+        return (ok ? 0 : 1) + (clean ? 0 : 1);
+    }
+
+    // letterbox: opencv resize + border (+ swap) into a vector and the memcpy into the input vs the fused pass
+    static int run_letterbox(int count, int repeat)
+    {
+        const int shapes[][4] = {{1080, 1920, 640, 640}, {480, 640, 640, 640}, {375, 500, 640, 640}, {720, 1280, 384, 640}, {1000, 999, 320, 320}};
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> byte(0, 255);
+
+        int failed = 0;
+        for (auto& shape : shapes)
+        {
+            const int rows = shape[0], cols = shape[1], lb_rows = shape[2], lb_cols = shape[3];
+            std::vector<uint8_t> pixels((size_t)rows * cols * 3);
+            for (auto& v : pixels)
+            {
+                v = (uint8_t)byte(rng);
+            }
+            cv::Mat mat(rows, cols, CV_8UC3, pixels.data());
+
+            for (bool bgr2rgb : {false, true})
+            {
+                std::vector<uint8_t> image((size_t)lb_rows * lb_cols * 3), ref(image.size()), cur(image.size());
+                float ref_ms = best_of(repeat, [&]() {
+                    common::get_input_data_letterbox(mat, image, lb_rows, lb_cols, bgr2rgb);
+                    memcpy(ref.data(), image.data(), image.size());
+                });
+                float cur_ms = best_of(repeat, [&]() {
+                    common::get_input_data_letterbox(mat, cur.data(), lb_rows, lb_cols, bgr2rgb);
+                });
+
+                char name[64];
+                snprintf(name, sizeof(name), "letterbox %dx%d->%dx%d%s", cols, rows, lb_cols, lb_rows, bgr2rgb ? " rgb" : "");
+                print_compare(name, "px", lb_rows * lb_cols, ref_ms, cur_ms);
+
+                size_t diff = 0;
+                for (size_t i = 0; i < ref.size(); ++i)
+                {
+                    diff += ref[i] != cur[i] ? 1 : 0;
+                }
+                fprintf(stdout, "%-28s %zu bytes differ %s\n", "", diff, diff == 0 ? "ok" : "FAILED");
+                failed += diff == 0 ? 0 : 1;
+            }
+        }
+        return failed;
+    }
+
+    // nv12 input: the staging vector + memcpy the sample used to do vs letterboxing straight into the
+    // input. a frame at the model resolution is bound and costs nothing, the memcpy is what that saves.
+    static int run_nv12(int count, int repeat)
+    {
+        const int shapes[][4] = {{1080, 1920, 640, 640}, {640, 640, 640, 640}, {720, 1280, 384, 640}};
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> byte(0, 255);
+
+        int failed = 0;
+        for (auto& shape : shapes)
+        {
+            const int rows = shape[0], cols = shape[1], lb_rows = shape[2], lb_cols = shape[3];
+            std::vector<uint8_t> frame((size_t)rows * cols * 3 / 2);
+            for (auto& v : frame)
+            {
+                v = (uint8_t)byte(rng);
+            }
+            const uint8_t* y = frame.data();
+            const uint8_t* uv = y + (size_t)rows * cols;
+
+            const size_t input_size = (size_t)lb_rows * lb_cols * 3 / 2;
+            std::vector<uint8_t> staging(input_size), ref(input_size), cur(input_size);
+            char name[64];
+            if (rows == lb_rows && cols == lb_cols)
+            {
+                float copy_ms = best_of(repeat, [&]() {
+                    memcpy(cur.data(), frame.data(), input_size);
+                });
+                snprintf(name, sizeof(name), "nv12 bind %dx%d", cols, rows);
+                fprintf(stdout, "%-28s copy %8.3f ms  bind    0.000 ms\n", name, copy_ms);
+                continue;
+            }
+
+            float ref_ms = best_of(repeat, [&]() {
+                common::nv12_letterbox(y, uv, rows, cols, cols, staging.data(), lb_rows, lb_cols);
+                memcpy(ref.data(), staging.data(), input_size);
+            });
+            float cur_ms = best_of(repeat, [&]() {
+                common::nv12_letterbox(y, uv, rows, cols, cols, cur.data(), lb_rows, lb_cols);
+            });
+            snprintf(name, sizeof(name), "nv12 letterbox %dx%d->%dx%d", cols, rows, lb_cols, lb_rows);
+            print_compare(name, "px", lb_rows * lb_cols, ref_ms, cur_ms);
+
+            bool ok = ref == cur;
+            fprintf(stdout, "%-28s %s\n", "", ok ? "ok" : "FAILED");
+            failed += ok ? 0 : 1;
+        }
+        return failed;
+    }
+
+    // seg masks of one 1080p frame at 640: per object roi copy, 1 x 32 by 32 x (h * w) product, sigmoid,
+    // resize of the probabilities and > 0.5, the way the opencv code did it, vs InstanceMasks.
+    // pixels where the sigmoid path and the logits path disagree sit on mask borders, a few in 10^4.
+    static int run_mask(int count, int repeat)
+    {
+        const int dim = 32, stride = 4, proto_h = 160, proto_w = 160;
+        const float scale = 3.f; // 1920 x 1080 letterboxed into 640 x 640
+        std::mt19937 rng(42);
+        std::normal_distribution<float> gauss(0.f, 1.f);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        // smooth protos, the masks of random ones would be mostly border
+        std::vector<float> proto((size_t)dim * proto_h * proto_w);
+        for (int k = 0; k < dim; ++k)
+        {
+            const float fx = uniform(rng) * 0.15f, fy = uniform(rng) * 0.15f, phase = uniform(rng) * 6.f;
+            for (int y = 0; y < proto_h; ++y)
+            {
+                for (int x = 0; x < proto_w; ++x)
+                {
+                    proto[((size_t)k * proto_h + y) * proto_w + x] = std::sin(fx * x + fy * y + phase) * 2.f;
+                }
+            }
+        }
+
+        int failed = 0;
+        for (int instances : {10, 50, 100})
+        {
+            std::vector<float> boxes(instances * 4), coefs(instances * dim);
+            std::vector<const float*> coef_ptrs(instances);
+            for (int i = 0; i < instances; ++i)
+            {
+                const float w = 16.f + uniform(rng) * 184.f, h = 16.f + uniform(rng) * 184.f;
+                boxes[i * 4] = uniform(rng) * (640.f - w);
+                boxes[i * 4 + 1] = 140.f + uniform(rng) * (360.f - h);
+                boxes[i * 4 + 2] = w;
+                boxes[i * 4 + 3] = h;
+                for (int k = 0; k < dim; ++k)
+                {
+                    coefs[i * dim + k] = gauss(rng);
+                }
+                coef_ptrs[i] = coefs.data() + i * dim;
+            }
+
+            std::vector<std::vector<uint8_t> > ref(instances), cur(instances);
+            float ref_ms = best_of(repeat, [&]() {
+                std::vector<int> x_offsets, y_offsets;
+                std::vector<float> x_weights, y_weights;
+                for (int i = 0; i < instances; ++i)
+                {
+                    const float* box = boxes.data() + i * 4;
+                    auto roi = detection::mask_roi(box[0], box[1], box[2], box[3], stride, proto_h, proto_w);
+                    const int n = roi.width * roi.height;
+                    std::vector<float> protos((size_t)dim * n);
+                    for (int k = 0; k < dim; ++k)
+                    {
+                        for (int y = 0; y < roi.height; ++y)
+                        {
+                            memcpy(protos.data() + (size_t)k * n + y * roi.width,
+                                   proto.data() + ((size_t)k * proto_h + roi.y + y) * proto_w + roi.x, sizeof(float) * roi.width);
+                        }
+                    }
+                    std::vector<float> mask(n);
+                    for (int j = 0; j < n; ++j)
+                    {
+                        float sum = 0.f;
+                        for (int k = 0; k < dim; ++k)
+                        {
+                            sum += coef_ptrs[i][k] * protos[(size_t)k * n + j];
+                        }
+                        mask[j] = 1.f / (1.f + std::exp(-sum));
+                    }
+
+                    const int width = (int)(box[2] * scale), height = (int)(box[3] * scale);
+                    detection::mask_linear_taps(roi.width, width, x_offsets, x_weights);
+                    detection::mask_linear_taps(roi.height, height, y_offsets, y_weights);
+                    std::vector<float> resized((size_t)width * height);
+                    for (int dy = 0; dy < height; ++dy)
+                    {
+                        const float* r0 = mask.data() + y_offsets[dy] * roi.width;
+                        const float* r1 = mask.data() + std::min(y_offsets[dy] + 1, roi.height - 1) * roi.width;
+                        for (int dx = 0; dx < width; ++dx)
+                        {
+                            const int x0 = x_offsets[dx], x1 = std::min(x0 + 1, roi.width - 1);
+                            const float top = r0[x0] + (r0[x1] - r0[x0]) * x_weights[dx];
+                            const float bottom = r1[x0] + (r1[x1] - r1[x0]) * x_weights[dx];
+                            resized[(size_t)dy * width + dx] = top + (bottom - top) * y_weights[dy];
+                        }
+                    }
+                    ref[i].resize(resized.size());
+                    for (size_t j = 0; j < resized.size(); ++j)
+                    {
+                        ref[i][j] = resized[j] > 0.5f ? 255 : 0;
+                    }
+                }
+            });
+
+            detection::InstanceMasks masks;
+            float assemble_ms = best_of(repeat, [&]() {
+                masks.assemble(proto.data(), dim, proto_h, proto_w, stride, boxes.data(), coef_ptrs.data(), instances);
+            });
+            float cur_ms = best_of(repeat, [&]() {
+                masks.assemble(proto.data(), dim, proto_h, proto_w, stride, boxes.data(), coef_ptrs.data(), instances);
+                for (int i = 0; i < instances; ++i)
+                {
+                    const int width = (int)(boxes[i * 4 + 2] * scale), height = (int)(boxes[i * 4 + 3] * scale);
+                    cur[i].resize((size_t)width * height);
+                    masks.decode(i, width, height, cur[i].data(), width);
+                }
+            });
+
+            char name[64];
+            snprintf(name, sizeof(name), "mask %d instances", instances);
+            print_compare(name, "obj", instances, ref_ms, cur_ms);
+
+            size_t pixels = 0, diff = 0;
+            for (int i = 0; i < instances; ++i)
+            {
+                pixels += ref[i].size();
+                for (size_t j = 0; j < ref[i].size() && j < cur[i].size(); ++j)
+                {
+                    diff += ref[i][j] != cur[i][j] ? 1 : 0;
+                }
+            }
+            const bool ok = diff * 1000 < pixels;
+            fprintf(stdout, "%-28s assemble only %.3f ms, %zu of %zu pixels differ %s\n", "", assemble_ms, diff, pixels, ok ? "ok" : "FAILED");
+            failed += ok ? 0 : 1;
+        }
+        return failed;
+    }
+
+    // semantic segmentation drawn at 1080p: the per pixel loops the samples had (argmax, palette at the
+    // model resolution, nearest resize of the bgr image, addWeighted) vs segmentation:: on 1 thread and
+    // on the whole pool. deeplab is a 21 class nchw score map, segformer a 19 class id map blended.
+    static int run_seg(int count, int repeat)
+    {
+        const int out_rows = 1080, out_cols = 1920;
+        std::mt19937 rng(42);
+        std::normal_distribution<float> gauss(0.f, 1.f);
+        std::uniform_int_distribution<int> byte(0, 255);
+
+        std::vector<uint8_t> image((size_t)out_rows * out_cols * 3);
+        for (auto& v : image)
+        {
+            v = (uint8_t)byte(rng);
+        }
+        auto palette = segmentation::voc_palette();
+        auto blend_palette = segmentation::voc_palette(153);
+
+        // the old loops, a nearest resize of the bgr image the palette made
+        auto reference = [&](const uint8_t* labels, int rows, int cols, bool blend, uint8_t* out) {
+            std::vector<uint8_t> color((size_t)rows * cols * 3);
+            for (int i = 0; i < rows * cols; ++i)
+            {
+                color[i * 3] = palette[labels[i]].b;
+                color[i * 3 + 1] = palette[labels[i]].g;
+                color[i * 3 + 2] = palette[labels[i]].r;
+            }
+            std::vector<int> x_offsets, y_offsets;
+            segmentation::nearest_taps(cols, out_cols, x_offsets);
+            segmentation::nearest_taps(rows, out_rows, y_offsets);
+            for (int y = 0; y < out_rows; ++y)
+            {
+                for (int x = 0; x < out_cols; ++x)
+                {
+                    const uint8_t* c = color.data() + ((size_t)y_offsets[y] * cols + x_offsets[x]) * 3;
+                    uint8_t* o = out + ((size_t)y * out_cols + x) * 3;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        o[k] = blend ? (uint8_t)std::lrint(image[o - out + k] * 0.4f + c[k] * 0.6f) : c[k];
+                    }
+                }
+            }
+        };
+
+        common::thread_pool single(1);
+        common::thread_pool& shared = common::thread_pool::shared();
+
+        int failed = 0;
+        {
+            const int channels = 21, rows = 513, cols = 513;
+            std::vector<float> scores((size_t)channels * rows * cols);
+            for (auto& v : scores)
+            {
+                v = gauss(rng);
+            }
+            std::vector<uint8_t> labels((size_t)rows * cols), ref((size_t)out_rows * out_cols * 3), cur(ref.size());
+            float ref_ms = best_of(repeat, [&]() {
+                for (int i = 0; i < rows * cols; ++i)
+                {
+                    int best = 0;
+                    float best_score = -FLT_MAX;
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        if (scores[(size_t)c * rows * cols + i] > best_score)
+                        {
+                            best_score = scores[(size_t)c * rows * cols + i];
+                            best = c;
+                        }
+                    }
+                    labels[i] = (uint8_t)best;
+                }
+                reference(labels.data(), rows, cols, false, ref.data());
+            });
+            for (auto* pool : {&single, &shared})
+            {
+                float cur_ms = best_of(repeat, [&]() {
+                    segmentation::argmax_nchw(scores.data(), channels, rows, cols, labels.data(), cols, -FLT_MAX, pool);
+                    segmentation::render(labels.data(), rows, cols, cols, palette.data(), nullptr, 0, cur.data(), out_rows, out_cols, out_cols * 3, false, pool);
+                });
+                char name[64];
+                snprintf(name, sizeof(name), "seg deeplab 513->1080p %dt", pool->size());
+                print_compare(name, "px", out_rows * out_cols, ref_ms, cur_ms);
+                const bool ok = ref == cur;
+                fprintf(stdout, "%-28s %s\n", "", ok ? "ok" : "FAILED");
+                failed += ok ? 0 : 1;
+            }
+        }
+        {
+            const int classes = 19, rows = 160, cols = 320;
+            std::vector<int> ids((size_t)rows * cols);
+            for (auto& v : ids)
+            {
+                v = byte(rng) % (classes + 1);
+            }
+            std::vector<uint8_t> labels((size_t)rows * cols), ref((size_t)out_rows * out_cols * 3), cur(ref.size());
+            float ref_ms = best_of(repeat, [&]() {
+                for (int i = 0; i < rows * cols; ++i)
+                {
+                    labels[i] = ids[i] < classes ? (uint8_t)ids[i] : 0;
+                }
+                reference(labels.data(), rows, cols, true, ref.data());
+            });
+            for (auto* pool : {&single, &shared})
+            {
+                float cur_ms = best_of(repeat, [&]() {
+                    segmentation::labels_from_ids(ids.data(), rows, cols, classes, 0, labels.data(), cols, pool);
+                    segmentation::render(labels.data(), rows, cols, cols, blend_palette.data(), image.data(), out_cols * 3, cur.data(), out_rows, out_cols, out_cols * 3, false, pool);
+                });
+                char name[64];
+                snprintf(name, sizeof(name), "seg segformer blend %dt", pool->size());
+                print_compare(name, "px", out_rows * out_cols, ref_ms, cur_ms);
+
+                // the fixed point blend may round the other way
+                int max_diff = 0;
+                for (size_t i = 0; i < ref.size(); ++i)
+                {
+                    max_diff = std::max(max_diff, std::abs((int)ref[i] - (int)cur[i]));
+                }
+                fprintf(stdout, "%-28s max diff %d %s\n", "", max_diff, max_diff <= 1 ? "ok" : "FAILED");
+                failed += max_diff <= 1 ? 0 : 1;
+            }
+        }
+        return failed;
+    }
+
+    // io buffers of model reloads: a backend alloc / free per tensor vs leasing them from a cmm_pool.
+    // runs on the host backend, on the board the cmm ioctls make the direct path far slower still.
+    static int run_cmm(int count, int repeat)
+    {
+        // yolov8s 640 with the tensors of a seg head, bytes
+        const AX_U32 tensors[] = {640 * 640 * 3, 80 * 80 * 144 * 4, 40 * 40 * 144 * 4, 20 * 20 * 144 * 4,
+                                  80 * 80 * 32 * 4, 40 * 40 * 32 * 4, 20 * 20 * 32 * 4, 160 * 160 * 32 * 4};
+        const int loads = std::max(count / 100, 1);
+        const auto backend = middleware::cmm_host_backend();
+        std::vector<AX_U64> phy(sizeof(tensors) / sizeof(tensors[0]));
+        std::vector<void*> vir(phy.size());
+
+        int failed = 0;
+        float ref_ms = best_of(repeat, [&]() {
+            for (int l = 0; l < loads; ++l)
+            {
+                for (size_t i = 0; i < phy.size(); ++i)
+                {
+                    failed += backend.alloc(&phy[i], &vir[i], tensors[i], middleware::cmm_pool::ALIGN, false, "bench") != 0;
+                    memset(vir[i], 0, 64);
+                }
+                for (size_t i = 0; i < phy.size(); ++i)
+                {
+                    backend.free(phy[i], vir[i]);
+                }
+            }
+        });
+
+        middleware::cmm_pool pool(backend, "bench");
+        float cur_ms = best_of(repeat, [&]() {
+            for (int l = 0; l < loads; ++l)
+            {
+                for (size_t i = 0; i < phy.size(); ++i)
+                {
+                    failed += pool.lease(tensors[i], false, &phy[i], &vir[i]) != 0;
+                    memset(vir[i], 0, 64);
+                }
+                for (size_t i = 0; i < phy.size(); ++i)
+                {
+                    failed += pool.give_back(phy[i], vir[i]) != 0;
+                }
+            }
+        });
+        print_compare("cmm io reload", "load", loads, ref_ms, cur_ms);
+
+        // a second context with cached buffers alive next to the first one, then both torn down
+        std::vector<AX_U64> phy2(phy.size());
+        std::vector<void*> vir2(phy.size());
+        for (size_t i = 0; i < phy.size(); ++i)
+        {
+            failed += pool.lease(tensors[i], false, &phy[i], &vir[i]) != 0;
+            failed += pool.lease(tensors[i], true, &phy2[i], &vir2[i]) != 0;
+        }
+        auto stats = pool.stats();
+        for (size_t i = 0; i < phy.size(); ++i)
+        {
+            failed += pool.give_back(phy[i], vir[i]) != 0;
+            failed += pool.give_back(phy2[i], vir2[i]) != 0;
+        }
+        size_t requested = 0;
+        for (auto size : tensors)
+        {
+            requested += size;
+        }
+        fprintf(stdout, "%-28s %zu leases, %zu hits, %zu allocs, in use %.2f MB for %.2f MB requested, high water %.2f MB\n", "cmm pool",
+                stats.leases, stats.hits, stats.allocs, stats.in_use / 1048576.0, requested * 2 / 1048576.0, stats.high_water / 1048576.0);
+        bool ok = failed == 0 && stats.allocs == phy.size() * 2 && stats.in_use >= requested * 2;
+        fprintf(stdout, "%-28s %s\n", "", ok ? "ok" : "FAILED");
+        return ok ? 0 : 1;
+    }
+
+    // resident set right now in KB
+    static long current_rss_kb()
+    {
+        long pages = 0, resident = 0;
+        FILE* fp = fopen("/proc/self/statm", "r");
+        if (fp != nullptr)
+        {
+            if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+            {
+                resident = 0;
+            }
+            fclose(fp);
+        }
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    // model loading: the old byte by byte stream into a vector, the fixed read_file and the mapping.
+    // every variant reads all bytes like AX_ENGINE_CreateHandle does, and runs in its own process so
+    // the peak rss of one does not hide the others. "held" is what stays resident until run_model ends.
+    static int run_model_load(int count, int repeat)
+    {
+        const size_t size = (size_t)128 << 20;
+        const std::string path = "/tmp/ax_kernel_bench.axmodel";
+        {
+            std::vector<char> data(size);
+            std::mt19937 rng(42);
+            for (size_t i = 0; i < size; i += 4096)
+            {
+                data[i] = (char)rng();
+            }
+            FILE* fp = fopen(path.c_str(), "wb");
+            if (fp == nullptr || fwrite(data.data(), 1, size, fp) != size)
+            {
+                fprintf(stderr, "cannot write %s\n", path.c_str());
+                if (fp != nullptr)
+                {
+                    fclose(fp);
+                }
+                return 1;
+            }
+            fclose(fp);
+        }
+
+        // what the engine does with the model: read it once
+        volatile unsigned sink = 0;
+        auto consume = [&](const void* data, size_t length) {
+            const uint8_t* bytes = (const uint8_t*)data;
+            unsigned sum = 0;
+            for (size_t i = 0; i < length; i += 64)
+            {
+                sum += bytes[i];
+            }
+            sink = sink + sum;
+        };
+
+        const char* names[] = {"model load stream", "model load read_file", "model load mmap"};
+        int failed = 0;
+        for (int variant = 0; variant < 3; ++variant)
+        {
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                const long rss_start = current_rss_kb();
+                long held = 0;
+                size_t loaded = 0;
+                float cost = best_of(std::min(repeat, 5), [&]() {
+                    std::vector<char> buffer;
+                    if (variant == 0)
+                    {
+                        std::fstream fs(path, std::ios::in | std::ios::binary);
+                        buffer.insert(buffer.end(), std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+                        consume(buffer.data(), buffer.size());
+                        loaded = buffer.size();
+                    }
+                    else if (variant == 1)
+                    {
+                        utilities::read_file(path, buffer);
+                        consume(buffer.data(), buffer.size());
+                        loaded = buffer.size();
+                    }
+                    else
+                    {
+                        utilities::mapped_file file(path);
+                        consume(file.data(), file.size());
+                        loaded = file.size();
+                        file.drop_pages();
+                    }
+                    held = current_rss_kb() - rss_start;
+                });
+                fprintf(stdout, "%-28s %9.3f ms  %7.1f MB/s  peak rss %+8.1f MB  held %+8.1f MB\n", names[variant], cost,
+                        loaded / 1048576.0 / (cost / 1000.0), (utilities::peak_rss_kb() - rss_start) / 1024.0, held / 1024.0);
+                fflush(stdout);
+                _exit(loaded == size ? 0 : 1);
+            }
+            int status = 1;
+            if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            {
+                fprintf(stdout, "%-28s FAILED\n", names[variant]);
+                failed++;
+            }
+        }
+        unlink(path.c_str());
+        return failed;
+    }
+
+    // heatmap: peaks of a batch of 17 x 64 x 48 hrnet heatmaps, find_max_2d per joint vs the simd decoder,
+    // planar and channels last. the refinements are timed on top, against the same reference
+    static int run_heatmap(int count, int repeat)
+    {
+        const int batch = 8, joints = 17, height = 64, width = 48;
+        const int pixels = height * width;
+        std::mt19937 rng(42);
+        std::normal_distribution<float> noise(0.f, 0.02f);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        // a gaussian blob per joint over low noise, like a trained model gives
+        std::vector<float> chw((size_t)batch * joints * pixels), hwc(chw.size());
+        for (int n = 0; n < batch; ++n)
+        {
+            for (int k = 0; k < joints; ++k)
+            {
+                const float cx = uniform(rng) * width, cy = uniform(rng) * height, peak = 0.3f + 0.7f * uniform(rng);
+                for (int i = 0; i < pixels; ++i)
+                {
+                    const float dx = i % width - cx, dy = i / width - cy;
+                    const float v = peak * std::exp(-(dx * dx + dy * dy) / 8.f) + noise(rng);
+                    chw[((size_t)n * joints + k) * pixels + i] = v;
+                    hwc[((size_t)n * pixels + i) * joints + k] = v;
+                }
+            }
+        }
+
+        std::vector<int> ref_x(batch * joints), ref_y(batch * joints);
+        std::vector<float> ref_score(batch * joints);
+        float ref_ms = best_of(repeat, [&]() {
+            for (int n = 0; n < batch; ++n)
+            {
+                for (int k = 0; k < joints; ++k)
+                {
+                    const int i = n * joints + k;
+                    pose::find_max_2d(chw.data() + (size_t)n * joints * pixels, width, height, &ref_x[i], &ref_y[i], &ref_score[i], k);
+                }
+            }
+        });
+
+        common::thread_pool single(1);
+        std::vector<pose::HeatmapPeak> peaks(batch * joints);
+        int failed = 0;
+        auto check = [&](const char* name) {
+            for (int i = 0; i < batch * joints; ++i)
+            {
+                if (peaks[i].x != (float)ref_x[i] || peaks[i].y != (float)ref_y[i] || peaks[i].score != ref_score[i])
+                {
+                    fprintf(stdout, "%s mismatch at joint %d: %g %g %g, expected %d %d %g\n", name, i, peaks[i].x, peaks[i].y, peaks[i].score,
+                            ref_x[i], ref_y[i], ref_score[i]);
+                    failed++;
+                    return;
+                }
+            }
+        };
+
+        float cur_ms = best_of(repeat, [&]() {
+            pose::decode_heatmaps(chw.data(), batch, joints, height, width, peaks.data(), pose::HEATMAP_REFINE_NONE, false,
+                                  pose::HEATMAP_DARK_KERNEL, &single);
+        });
+        print_compare("heatmap argmax chw", "joint", batch * joints, ref_ms, cur_ms);
+        check("heatmap argmax chw");
+
+        cur_ms = best_of(repeat, [&]() {
+            pose::decode_heatmaps(hwc.data(), batch, joints, height, width, peaks.data(), pose::HEATMAP_REFINE_NONE, true,
+                                  pose::HEATMAP_DARK_KERNEL, &single);
+        });
+        print_compare("heatmap argmax hwc", "joint", batch * joints, ref_ms, cur_ms);
+        check("heatmap argmax hwc");
+
+        cur_ms = best_of(repeat, [&]() {
+            pose::decode_heatmaps(chw.data(), batch, joints, height, width, peaks.data(), pose::HEATMAP_REFINE_NONE, false,
+                                  pose::HEATMAP_DARK_KERNEL);
+        });
+        print_compare("heatmap argmax chw, pool", "joint", batch * joints, ref_ms, cur_ms);
+        check("heatmap argmax chw, pool");
+
+        // the refinements move a peak by less than a pixel
+        const int refines[] = {pose::HEATMAP_REFINE_QUARTER, pose::HEATMAP_REFINE_DARK};
+        const char* refine_names[] = {"heatmap quarter chw", "heatmap dark chw"};
+        for (int r = 0; r < 2; ++r)
+        {
+            cur_ms = best_of(repeat, [&]() {
+                pose::decode_heatmaps(chw.data(), batch, joints, height, width, peaks.data(), refines[r], false, pose::HEATMAP_DARK_KERNEL, &single);
+            });
+            print_compare(refine_names[r], "joint", batch * joints, ref_ms, cur_ms);
+            for (int i = 0; i < batch * joints; ++i)
+            {
+                if (std::fabs(peaks[i].x - ref_x[i]) > 1.f || std::fabs(peaks[i].y - ref_y[i]) > 1.f)
+                {
+                    fprintf(stdout, "%s moved joint %d to %g %g from %d %d\n", refine_names[r], i, peaks[i].x, peaks[i].y, ref_x[i], ref_y[i]);
+                    failed++;
+                    break;
+                }
+            }
+        }
+        (void)count;
+        return failed;
+    }
+
+    // simcc: rtmpose x / y vectors (17 x 384 and 17 x 512 per crop) of 1, 8 and 32 persons, the per joint
+    // std::max_element loop of ax_rtmpose_steps vs the batched simd decoder, on one thread and on the pool
+    static int run_simcc(int count, int repeat)
+    {
+        const int joints = 17, input_w = 192, input_h = 256, x_size = 384, y_size = 512;
+        const float split_ratio = 2.f;
+        std::mt19937 rng(42);
+        std::normal_distribution<float> noise(0.f, 0.05f);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        common::thread_pool single(1);
+        int failed = 0;
+        for (int batch : {1, 8, 32})
+        {
+            std::vector<float> simcc_x((size_t)batch * joints * x_size), simcc_y((size_t)batch * joints * y_size);
+            for (int row = 0; row < batch * joints; ++row)
+            {
+                const float cx = uniform(rng) * x_size, cy = uniform(rng) * y_size;
+                for (int i = 0; i < x_size; ++i)
+                {
+                    simcc_x[(size_t)row * x_size + i] = std::exp(-(i - cx) * (i - cx) / 32.f) + noise(rng);
+                }
+                for (int i = 0; i < y_size; ++i)
+                {
+                    simcc_y[(size_t)row * y_size + i] = std::exp(-(i - cy) * (i - cy) / 32.f) + noise(rng);
+                }
+            }
+            std::vector<pose::CropAffine> affines(batch);
+            for (int n = 0; n < batch; ++n)
+            {
+                affines[n] = pose::crop_affine(uniform(rng) * 1920.f, uniform(rng) * 1080.f, 150.f + uniform(rng) * 300.f, 200.f + uniform(rng) * 400.f,
+                                               input_w, input_h);
+            }
+
+            std::vector<pose::ai_point_t> ref(batch * joints), cur(batch * joints);
+            float ref_ms = best_of(repeat, [&]() {
+                for (int n = 0; n < batch; ++n)
+                {
+                    const float scale_w = affines[n].m[0] * input_w, scale_h = affines[n].m[4] * input_h;
+                    const float center_x = affines[n].m[2] + scale_w * 0.5f, center_y = affines[n].m[5] + scale_h * 0.5f;
+                    for (int k = 0; k < joints; ++k)
+                    {
+                        const float* px = simcc_x.data() + ((size_t)n * joints + k) * x_size;
+                        const float* py = simcc_y.data() + ((size_t)n * joints + k) * y_size;
+                        const int max_x_idx = std::max_element(px, px + x_size) - px;
+                        const int max_y_idx = std::max_element(py, py + y_size) - py;
+                        const float kp_x = (float)max_x_idx / split_ratio;
+                        const float kp_y = (float)max_y_idx / split_ratio;
+                        pose::ai_point_t& kp = ref[n * joints + k];
+                        kp.x = kp_x / input_w * scale_w + center_x - scale_w / 2.0f;
+                        kp.y = kp_y / input_h * scale_h + center_y - scale_h / 2.0f;
+                        kp.score = std::min(px[max_x_idx], py[max_y_idx]);
+                    }
+                }
+            });
+
+            for (auto* pool : {&single, &common::thread_pool::shared()})
+            {
+                float cur_ms = best_of(repeat, [&]() {
+                    pose::decode_simcc(simcc_x.data(), simcc_y.data(), batch, joints, x_size, y_size, split_ratio, affines.data(), cur.data(), false, pool);
+                });
+                char name[64];
+                snprintf(name, sizeof(name), "simcc %2d persons, %s", batch, pool == &single ? "1 thread" : "pool");
+                print_compare(name, "person", batch, ref_ms, cur_ms);
+
+                // the same peaks, the affine is folded into one multiply add so the pixels may round apart
+                for (int i = 0; i < batch * joints; ++i)
+                {
+                    if (cur[i].score != ref[i].score || std::fabs(cur[i].x - ref[i].x) > 1e-2f || std::fabs(cur[i].y - ref[i].y) > 1e-2f)
+                    {
+                        fprintf(stdout, "%s mismatch at joint %d: %g %g %g, expected %g %g %g\n", name, i, cur[i].x, cur[i].y, cur[i].score,
+                                ref[i].x, ref[i].y, ref[i].score);
+                        failed++;
+                        break;
+                    }
+                }
+            }
+        }
+        (void)count;
+        return failed;
+    }
+
+    // obb: probiou nms of dense aerial scenes, 500 and 2000 rotated candidates of small objects, the pairwise
+    // loop of the yolo11 / yolo26 obb samples and obb::nms_rotated_sorted_bboxes vs nms_rotated_probiou
+    static int run_obb(int count, int repeat)
+    {
+        // the probiou the yolo11 / yolo26 obb samples computed per pair
+        auto probiou = [](const detection::Object& p, const detection::Object& o) {
+            const float eps = 1e-7f;
+            float cov[2][3];
+            const detection::Object* boxes[2] = {&p, &o};
+            for (int k = 0; k < 2; ++k)
+            {
+                const float ww = boxes[k]->rect.width * boxes[k]->rect.width / 12.f;
+                const float hh = boxes[k]->rect.height * boxes[k]->rect.height / 12.f;
+                const float cs = std::cos(boxes[k]->angle), sn = std::sin(boxes[k]->angle);
+                cov[k][0] = ww * cs * cs + hh * sn * sn;
+                cov[k][1] = ww * sn * sn + hh * cs * cs;
+                cov[k][2] = (ww - hh) * cs * sn;
+            }
+            const float dx = p.rect.x - o.rect.x, dy = p.rect.y - o.rect.y;
+            const float a = cov[0][0] + cov[1][0], b = cov[0][1] + cov[1][1], c = cov[0][2] + cov[1][2];
+            const float sum_ab = a * b - c * c;
+            const float t1 = (a * dy * dy + b * dx * dx) / (sum_ab + eps) * 0.25f;
+            const float t2 = (c * (-dx) * dy) / (sum_ab + eps) * 0.5f;
+            const float i1 = std::max(cov[0][0] * cov[0][1] - cov[0][2] * cov[0][2], 0.f);
+            const float i2 = std::max(cov[1][0] * cov[1][1] - cov[1][2] * cov[1][2], 0.f);
+            const float t3 = std::log(sum_ab / (4.f * std::sqrt(i1 * i2) + eps) + eps) * 0.5f;
+            const float bd = std::min(std::max(t1 + t2 + t3, eps), 100.f);
+            return 1.f - std::sqrt(1.f - std::exp(-bd) + eps);
+        };
+
+        const float iou_threshold = 0.45f;
+        int failed = 0;
+        for (int n : {500, 2000})
+        {
+            // ships and vehicles a few tens of pixels long, each object seen by a burst of cells
+            std::mt19937 rng(42);
+            std::uniform_real_distribution<float> uniform(0.f, 1.f);
+            std::normal_distribution<float> jitter(0.f, 2.f);
+            std::vector<detection::Object> boxes(n);
+            const int objects = std::max(1, n / 8);
+            for (int i = 0; i < n; ++i)
+            {
+                std::mt19937 obj_rng(i % objects);
+                const float w = 8.f + uniform(obj_rng) * 56.f, h = 4.f + uniform(obj_rng) * 20.f;
+                const float cx = uniform(obj_rng) * 1024.f, cy = uniform(obj_rng) * 1024.f, angle = uniform(obj_rng) * 3.1415926f;
+                const int label = (int)(uniform(obj_rng) * 15);
+
+                detection::Object& box = boxes[i];
+                box.rect.x = cx + jitter(rng);
+                box.rect.y = cy + jitter(rng);
+                box.rect.width = std::max(1.f, w + jitter(rng));
+                box.rect.height = std::max(1.f, h + jitter(rng));
+                box.angle = angle + jitter(rng) * 0.05f;
+                box.label = uniform(rng) < 0.9f ? label : (int)(uniform(rng) * 15);
+                box.prob = uniform(rng);
+            }
+            std::sort(boxes.begin(), boxes.end(), [](const detection::Object& a, const detection::Object& b) { return a.prob > b.prob; });
+
+            const int runs = std::min(repeat, 5);
+            char name[64];
+            auto report = [&](const std::vector<int>& ref, const std::vector<int>& cur, size_t allowed) {
+                size_t diff = 0;
+                for (size_t i = 0; i < std::max(ref.size(), cur.size()); ++i)
+                {
+                    diff += (i >= ref.size() || i >= cur.size() || ref[i] != cur[i]) ? 1 : 0;
+                }
+                const bool ok = diff <= allowed;
+                fprintf(stdout, "%-28s %zu kept, %zu expected, %zu differ %s\n", "", cur.size(), ref.size(), diff, ok ? "ok" : "FAILED");
+                failed += ok ? 0 : 1;
+            };
+
+            // the samples: class aware, exact log / exp, so the picks have to agree
+            std::vector<int> ref, cur;
+            float ref_ms = best_of(runs, [&]() {
+                ref.clear();
+                for (int j = 0; j < n; ++j)
+                {
+                    bool suppress = false;
+                    for (int i = 0; i < j && !suppress; ++i)
+                    {
+                        suppress = boxes[i].label == boxes[j].label && probiou(boxes[i], boxes[j]) >= iou_threshold;
+                    }
+                    if (!suppress)
+                        ref.push_back(j);
+                }
+            });
+            float cur_ms = best_of(runs, [&]() {
+                detection::nms_rotated_probiou(boxes, cur, detection::probiou_threshold(iou_threshold), true);
+            });
+            snprintf(name, sizeof(name), "obb nms %d, samples", n);
+            print_compare(name, "box", n, ref_ms, cur_ms);
+            report(ref, cur, 0);
+
+            // get_out_obb_bbox: class agnostic, fast_log / fast_exp in the reference, a pick may flip
+            const float bc_threshold = (1.f - iou_threshold) * (1.f - iou_threshold);
+            ref_ms = best_of(runs, [&]() {
+                ref.clear();
+                detection::obb::nms_rotated_sorted_bboxes(boxes, ref, iou_threshold);
+            });
+            cur_ms = best_of(runs, [&]() {
+                detection::nms_rotated_probiou(boxes, cur, bc_threshold);
+            });
+            snprintf(name, sizeof(name), "obb nms %d, yolov8", n);
+            print_compare(name, "box", n, ref_ms, cur_ms);
+            report(ref, cur, ref.size() / 50);
+        }
+        (void)count;
+        return failed;
+    }
+
+    // superpoint: keypoints of a 480 x 640 score map and descriptors from 256 x 60 x 80. the threshold, full sort and
+    // per keypoint sampling of ax_superpoint_steps vs radius nms + heap top-k and sampling from the transposed map
+    static int run_superpoint(int count, int repeat)
+    {
+        const int h = 480, w = 640, cell = 8, desc_c = 256, desc_h = h / cell, desc_w = w / cell;
+        const float threshold = 0.005f;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        std::normal_distribution<float> gauss(0.f, 1.f);
+
+        // low clutter with a few thousand corner like peaks
+        std::vector<float> score((size_t)h * w), desc((size_t)desc_c * desc_h * desc_w);
+        for (auto& v : score)
+        {
+            v = uniform(rng) * 0.006f;
+        }
+        for (int i = 0; i < 3000; ++i)
+        {
+            const int x = (int)(uniform(rng) * w), y = (int)(uniform(rng) * h);
+            score[(size_t)y * w + x] = 0.01f + uniform(rng) * 0.5f;
+        }
+        for (auto& v : desc)
+        {
+            v = gauss(rng);
+        }
+
+        // the sample's loops
+        auto reference_keypoints = [&](int max_points, std::vector<feature::KeyPoint>& keypoints) {
+            keypoints.clear();
+            for (int y = 0; y < h; ++y)
+            {
+                for (int x = 0; x < w; ++x)
+                {
+                    if (score[(size_t)y * w + x] > threshold)
+                    {
+                        keypoints.push_back({(float)x, (float)y, score[(size_t)y * w + x]});
+                    }
+                }
+            }
+            if ((int)keypoints.size() > max_points)
+            {
+                std::sort(keypoints.begin(), keypoints.end(), feature::keypoint_before);
+                keypoints.resize(max_points);
+            }
+        };
+        auto reference_descriptors = [&](const std::vector<feature::KeyPoint>& keypoints, std::vector<std::vector<float> >& descriptors) {
+            descriptors.clear();
+            for (const auto& kp : keypoints)
+            {
+                float x = kp.x / 8.0f, y = kp.y / 8.0f;
+                int x0 = std::floor(x), x1 = x0 + 1, y0 = std::floor(y), y1 = y0 + 1;
+                x0 = std::max(0, std::min(x0, desc_w - 1));
+                x1 = std::max(0, std::min(x1, desc_w - 1));
+                y0 = std::max(0, std::min(y0, desc_h - 1));
+                y1 = std::max(0, std::min(y1, desc_h - 1));
+                float wa = (x1 - x) * (y1 - y), wb = (x1 - x) * (y - y0), wc = (x - x0) * (y1 - y), wd = (x - x0) * (y - y0);
+                std::vector<float> d(desc_c, 0.0f);
+                for (int c = 0; c < desc_c; ++c)
+                {
+                    const float* plane = desc.data() + (size_t)c * desc_h * desc_w;
+                    d[c] = plane[y0 * desc_w + x0] * wa + plane[y1 * desc_w + x0] * wb + plane[y0 * desc_w + x1] * wc + plane[y1 * desc_w + x1] * wd;
+                }
+                float norm = 0.0f;
+                for (int c = 0; c < desc_c; ++c)
+                {
+                    norm += d[c] * d[c];
+                }
+                norm = std::sqrt(norm + 1e-6f);
+                for (int c = 0; c < desc_c; ++c)
+                {
+                    d[c] /= norm;
+                }
+                descriptors.push_back(d);
+            }
+        };
+
+        int failed = 0;
+        feature::SuperPointFeatures features;
+        for (int max_points : {100, 1000})
+        {
+            std::vector<feature::KeyPoint> ref;
+            std::vector<std::vector<float> > ref_desc;
+            float ref_ms = best_of(repeat, [&]() {
+                reference_keypoints(max_points, ref);
+                reference_descriptors(ref, ref_desc);
+            });
+            // radius 0 is the plain threshold, the same keypoints in the same order
+            float cur_ms = best_of(repeat, [&]() {
+                features.extract(score.data(), h, w, desc.data(), desc_c, desc_h, desc_w, threshold, max_points, 0, cell);
+            });
+            char name[64];
+            snprintf(name, sizeof(name), "superpoint top %d, radius 0", max_points);
+            print_compare(name, "point", max_points, ref_ms, cur_ms);
+
+            bool same = features.size() == (int)ref.size();
+            float max_diff = 0.f;
+            for (int i = 0; same && i < features.size(); ++i)
+            {
+                same = features.keypoints[i].x == ref[i].x && features.keypoints[i].y == ref[i].y && features.keypoints[i].score == ref[i].score;
+                for (int c = 0; c < desc_c; ++c)
+                {
+                    max_diff = std::max(max_diff, std::fabs(features.descriptor(i)[c] - ref_desc[i][c]));
+                }
+            }
+            const bool ok = same && max_diff < 1e-5f;
+            fprintf(stdout, "%-28s %d keypoints, descriptor max difference %g %s\n", "", features.size(), max_diff, ok ? "ok" : "FAILED");
+            failed += ok ? 0 : 1;
+
+            cur_ms = best_of(repeat, [&]() {
+                features.extract(score.data(), h, w, desc.data(), desc_c, desc_h, desc_w, threshold, max_points, 4, cell);
+            });
+            snprintf(name, sizeof(name), "superpoint top %d, radius 4", max_points);
+            print_compare(name, "point", max_points, ref_ms, cur_ms);
+            fprintf(stdout, "%-28s %d keypoints after nms\n", "", features.size());
+        }
+
+        // the parts, at the larger count
+        std::vector<feature::KeyPoint> candidates;
+        float nms_ms = best_of(repeat, [&]() { features.detect(score.data(), h, w, threshold, 4); });
+        candidates = features.keypoints;
+        float topk_ms = best_of(repeat, [&]() {
+            features.keypoints = candidates;
+            feature::select_top_keypoints(features.keypoints, 1000);
+        });
+        float describe_ms = best_of(repeat, [&]() { features.describe(desc.data(), desc_c, desc_h, desc_w, cell); });
+        fprintf(stdout, "%-28s nms %.3f ms (%zu candidates), top-k %.3f ms, descriptors %.3f ms\n", "superpoint parts", nms_ms, candidates.size(),
+                topk_ms, describe_ms);
+        (void)count;
+        return failed;
+    }
+
+    // match: superpoint like descriptors, 256 floats l2 normalised, half of the queries a noisy copy of a train row.
+    // the l2 cross-check loop of ax_superpoint_steps vs the blocked matcher, float, int8 and binary
+    static int run_match(int count, int repeat)
+    {
+        const int dim = 256;
+        std::mt19937 rng(42);
+        std::normal_distribution<float> gauss(0.f, 1.f);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+        auto normalize = [&](float* row) {
+            float sum = 0.f;
+            for (int k = 0; k < dim; ++k)
+            {
+                sum += row[k] * row[k];
+            }
+            const float scale = 1.f / std::sqrt(sum + 1e-6f);
+            for (int k = 0; k < dim; ++k)
+            {
+                row[k] *= scale;
+            }
+        };
+
+        int failed = 0;
+        for (int n : {1000, 2000})
+        {
+            std::vector<float> query((size_t)n * dim), train((size_t)n * dim);
+            for (int i = 0; i < n; ++i)
+            {
+                float* t = train.data() + (size_t)i * dim;
+                for (int k = 0; k < dim; ++k)
+                {
+                    t[k] = gauss(rng);
+                }
+                normalize(t);
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                float* q = query.data() + (size_t)i * dim;
+                const bool copy = uniform(rng) < 0.5f;
+                const float* t = train.data() + (size_t)(rng() % n) * dim;
+                for (int k = 0; k < dim; ++k)
+                {
+                    q[k] = copy ? t[k] * 16.f + gauss(rng) : gauss(rng);
+                }
+                normalize(q);
+            }
+
+            // the sample: the nearest train row of every query, kept when that row's nearest query is the same
+            std::vector<feature::DescriptorMatch> ref, cur;
+            auto distance = [&](const float* a, const float* b) {
+                float dist = 0.f;
+                for (int k = 0; k < dim; ++k)
+                {
+                    const float diff = a[k] - b[k];
+                    dist += diff * diff;
+                }
+                return std::sqrt(dist);
+            };
+            float ref_ms = best_of(1, [&]() {
+                ref.clear();
+                for (int i = 0; i < n; ++i)
+                {
+                    float best_dist = FLT_MAX;
+                    int best_idx = -1;
+                    for (int j = 0; j < n; ++j)
+                    {
+                        const float dist = distance(query.data() + (size_t)i * dim, train.data() + (size_t)j * dim);
+                        if (dist < best_dist)
+                        {
+                            best_dist = dist;
+                            best_idx = j;
+                        }
+                    }
+                    float reverse_best = FLT_MAX;
+                    int reverse_idx = -1;
+                    for (int k = 0; k < n; ++k)
+                    {
+                        const float dist = distance(query.data() + (size_t)k * dim, train.data() + (size_t)best_idx * dim);
+                        if (dist < reverse_best)
+                        {
+                            reverse_best = dist;
+                            reverse_idx = k;
+                        }
+                    }
+                    if (reverse_idx == i)
+                        ref.push_back({i, best_idx, best_dist});
+                }
+            });
+
+            // matches of the reference found again, and distances of those
+            auto report = [&](const char* mode, float allowed_recall, float allowed_diff) {
+                size_t found = 0;
+                float max_diff = 0.f;
+                size_t c = 0;
+                for (const auto& r : ref)
+                {
+                    while (c < cur.size() && cur[c].query < r.query)
+                        ++c;
+                    if (c < cur.size() && cur[c].query == r.query && cur[c].train == r.train)
+                    {
+                        ++found;
+                        max_diff = std::max(max_diff, std::fabs(cur[c].distance - r.distance));
+                    }
+                }
+                const float recall = ref.empty() ? 1.f : (float)found / ref.size();
+                const bool ok = recall >= allowed_recall && max_diff <= allowed_diff;
+                fprintf(stdout, "%-28s %zu matches, %zu expected, %.1f%% found, distance max difference %g %s\n", mode, cur.size(), ref.size(),
+                        recall * 100.f, max_diff, ok ? "ok" : "FAILED");
+                failed += ok ? 0 : 1;
+            };
+
+            feature::MatchDescriptors q, t;
+            feature::DescriptorMatcher matcher;
+            char name[64];
+            const int runs = std::min(repeat, 10);
+            for (int mode : {feature::MATCH_FLOAT, feature::MATCH_INT8, feature::MATCH_BINARY})
+            {
+                const char* mode_name = mode == feature::MATCH_FLOAT ? "float" : (mode == feature::MATCH_INT8 ? "int8" : "binary");
+                // the train side is a keyframe, prepared once
+                t.assign(train.data(), n, dim, mode);
+                float cur_ms = best_of(runs, [&]() {
+                    q.assign(query.data(), n, dim, mode);
+                    matcher.match(q, t, cur);
+                });
+                snprintf(name, sizeof(name), "match %dx%d, %s", n, n, mode_name);
+                print_compare(name, "query", n, ref_ms, cur_ms);
+                if (mode == feature::MATCH_FLOAT)
+                    report("", 0.995f, 1e-4f);
+                else if (mode == feature::MATCH_INT8)
+                    report("", 0.98f, 2e-2f);
+                else
+                    report("", 0.5f, 1.f); // a prefilter at best, sign bits lose most of a noisy match
+            }
+
+            // the ratio test on top, float
+            t.assign(train.data(), n, dim);
+            q.assign(query.data(), n, dim);
+            float ratio_ms = best_of(runs, [&]() { matcher.match(q, t, cur, feature::MatchParam(true, 0.8f)); });
+            fprintf(stdout, "%-28s %9.3f ms, %zu matches pass mutual + ratio 0.8\n", "", ratio_ms, cur.size());
+        }
+        (void)count;
+        return failed;
+    }
+
+    // slices: a 3840 x 2160 frame with small objects cut into 640 input slices, each object seen whole by the
+    // slices that hold it and cut off, with a lower score, by the slices whose edge crosses it, in letterbox
+    // pixels of that slice. the shift back and the merged nms have to leave one whole box per object, the
+    // time is the cpu side of sliced inference per frame and per megapixel
+    static int run_slices(int count, int repeat)
+    {
+        const int src_rows = 2160, src_cols = 3840, input = 640, classes = 3;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+        // 500 disjoint objects up to 48 px, smaller than the overlap, so every one of them lies whole in some slice
+        std::vector<detection::Object> truth;
+        while (truth.size() < 500)
+        {
+            detection::Object obj = detection::Object();
+            obj.rect.width = 12.f + uniform(rng) * 36.f;
+            obj.rect.height = 12.f + uniform(rng) * 36.f;
+            obj.rect.x = uniform(rng) * (src_cols - 1 - obj.rect.width);
+            obj.rect.y = uniform(rng) * (src_rows - 1 - obj.rect.height);
+            obj.label = (int)(uniform(rng) * classes);
+            obj.prob = 0.5f + uniform(rng) * 0.5f;
+            bool overlaps = false;
+            for (const auto& other : truth)
+            {
+                overlaps = overlaps || (obj.rect & other.rect).area() > 0.f;
+            }
+            if (!overlaps)
+                truth.push_back(obj);
+        }
+
+        int failed = 0;
+        for (int slice_size : {640, 960})
+        {
+            std::vector<cv::Rect> slices;
+            detection::slice_image(src_rows, src_cols, slice_size, slice_size, slices);
+            const common::LetterboxLayout layout = common::letterbox_layout(slice_size, slice_size, input, input);
+
+            // what a detector would give per slice, a little jitter so the duplicates are not identical. the part
+            // of an object a slice edge cuts off is not seen, what is left scores lower the less of it there is
+            std::vector<detection::Proposals> decoded(slices.size());
+            size_t partial = 0;
+            for (size_t i = 0; i < slices.size(); ++i)
+            {
+                const cv::Rect& slice = slices[i];
+                const cv::Rect_<float> inner((float)slice.x, (float)slice.y, slice.width - 1.f, slice.height - 1.f);
+                for (const auto& obj : truth)
+                {
+                    const cv::Rect_<float> seen = obj.rect & inner;
+                    const float visible = seen.area() / obj.rect.area();
+                    if (visible < 0.2f)
+                        continue;
+                    const float jitter = (uniform(rng) - 0.5f) * 0.5f;
+                    float prob = obj.prob - uniform(rng) * 0.01f;
+                    if (obj.rect.x < slice.x || obj.rect.y < slice.y || obj.rect.x + obj.rect.width > slice.x + slice.width - 1 ||
+                        obj.rect.y + obj.rect.height > slice.y + slice.height - 1)
+                    {
+                        prob = obj.prob * visible * 0.9f;
+                        ++partial;
+                    }
+                    decoded[i].push((seen.x - slice.x + jitter) * layout.scale + layout.left, (seen.y - slice.y + jitter) * layout.scale + layout.top,
+                                    seen.width * layout.scale, seen.height * layout.scale, obj.label, prob);
+                }
+            }
+
+            std::vector<detection::Proposals> tiles;
+            detection::Proposals proposals;
+            std::vector<detection::Object> objects;
+            float shift_ms = best_of(repeat, [&]() {
+                tiles = decoded;
+                proposals.clear();
+                for (size_t i = 0; i < slices.size(); ++i)
+                {
+                    detection::shift_slice_proposals(tiles[i], slices[i], input, input);
+                    proposals.append(tiles[i]);
+                }
+            });
+            float merge_ms = best_of(repeat, [&]() { detection::merge_slice_proposals(proposals, objects, detection::NmsParam(0.45f, true)); });
+
+            // the same merge by iou keeps most cut off parts next to their whole box
+            std::vector<int> iou_picked;
+            detection::nms_bboxes(proposals.candidates, iou_picked, detection::NmsParam(0.45f, true));
+
+            // one merged box per object, close to it
+            size_t matched = 0;
+            std::vector<bool> used(truth.size(), false);
+            for (const auto& obj : objects)
+            {
+                for (size_t t = 0; t < truth.size(); ++t)
+                {
+                    const cv::Rect_<float> inter = obj.rect & truth[t].rect;
+                    const float iou = inter.area() / (obj.rect.area() + truth[t].rect.area() - inter.area());
+                    if (!used[t] && truth[t].label == obj.label && iou > 0.9f)
+                    {
+                        used[t] = true;
+                        ++matched;
+                        break;
+                    }
+                }
+            }
+            const float megapixels = (float)src_rows * src_cols / 1e6f;
+            const bool ok = objects.size() == truth.size() && matched == truth.size();
+            char name[64];
+            snprintf(name, sizeof(name), "slices %d of %d", (int)slices.size(), slice_size);
+            fprintf(stdout, "%-28s shift %.3f ms, merge %.3f ms (%zu candidates, %zu cut off), %.3f ms/MP\n", name, shift_ms, merge_ms, proposals.size(),
+                    partial, (shift_ms + merge_ms) / megapixels);
+            fprintf(stdout, "%-28s %zu objects, %zu expected, %zu matched %s, iou nms would leave %zu\n", "", objects.size(), truth.size(), matched,
+                    ok ? "ok" : "FAILED", iou_picked.size());
+            failed += ok ? 0 : 1;
+        }
+        (void)count;
+        return failed;
+    }
+
+    // trace: cost of one recorded scope against the same loop without it, and of a flush to json.
+    // the scopes are used directly, so this runs the same whether AXERA_TRACE is set or not
+    static int run_trace(int count, int repeat)
+    {
+        utilities::trace::clear();
+        float ref_ms = best_of(repeat, [&]() {
+            for (int i = 0; i < count; ++i)
+            {
+                __asm__ __volatile__("" ::: "memory");
+            }
+        });
+        float cur_ms = best_of(repeat, [&]() {
+            for (int i = 0; i < count; ++i)
+            {
+                utilities::trace::scope scope("bench");
+                __asm__ __volatile__("" ::: "memory");
+            }
+        });
+        print_compare("trace scope", "event", count, ref_ms, cur_ms);
+        fprintf(stdout, "%-28s %.2f ns per event\n", "trace overhead", (cur_ms - ref_ms) * 1e6f / (float)count);
+
+        // the ring of this thread keeps the last AX_TRACE_RING_EVENTS of (repeat + 1) * count
+        const size_t recorded = utilities::trace::local_ring().snapshot().size();
+        const size_t expected = std::min((size_t)(repeat + 1) * count, (size_t)AX_TRACE_RING_EVENTS);
+
+        const std::string path = "/tmp/ax_kernel_bench_trace.json";
+        timer tick;
+        bool written = utilities::trace::write_chrome_json(path);
+        fprintf(stdout, "%-28s %9.3f ms for %zu events\n", "trace flush", tick.cost(), recorded);
+        unlink(path.c_str());
+        utilities::trace::clear();
+
+        if (!written || recorded != expected)
+        {
+            fprintf(stdout, "trace recorded %zu events, expected %zu\n", recorded, expected);
+            return 1;
+        }
+        return 0;
+    }
+} // namespace bench
+
+int main(int argc, char* argv[])
+{
+    std::map<std::string, std::function<int(int, int)> > cases = {
+        {"dfl", bench::run_dfl},
+        {"scan", bench::run_scan},
+        {"nms", bench::run_nms},
+        {"sort", bench::run_sort},
+        {"letterbox", bench::run_letterbox},
+        {"nv12", bench::run_nv12},
+        {"mask", bench::run_mask},
+        {"seg", bench::run_seg},
+        {"cmm", bench::run_cmm},
+        {"model", bench::run_model_load},
+        {"proposals", bench::run_proposals},
+        {"tiles", bench::run_tiles},
+        {"heatmap", bench::run_heatmap},
+        {"simcc", bench::run_simcc},
+        {"obb", bench::run_obb},
+        {"superpoint", bench::run_superpoint},
+        {"match", bench::run_match},
+        {"slices", bench::run_slices},
+        {"trace", bench::run_trace},
+    };
+
+    std::string case_list;
+    for (auto& c : cases)
+    {
+        case_list += (case_list.empty() ? "" : ", ") + c.first;
+    }
+
+    cmdline::parser cmd;
+    cmd.add<std::string>("case", 'c', "case to run: all, " + case_list, false, "all");
+    cmd.add<int>("count", 'n', "work items per run", false, 8400);
+    cmd.add<int>("repeat", 'r', "timed runs, the best one is reported", false, 20);
+    cmd.parse_check(argc, argv);
+
+    auto name = cmd.get<std::string>("case");
+    auto count = cmd.get<int>("count");
+    auto repeat = cmd.get<int>("repeat");
+
+    if (name != "all" && cases.find(name) == cases.end())
+    {
+        fprintf(stderr, "Unknown case %s, supported: all, %s\n", name.c_str(), case_list.c_str());
+        return -1;
+    }
+
+    int failed = 0;
+    fprintf(stdout, "--------------------------------------\n");
+    for (auto& c : cases)
+    {
+        if (name == "all" || name == c.first)
+        {
+            failed += c.second(count, repeat);
+            fprintf(stdout, "--------------------------------------\n");
+        }
+    }
+
+    return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,133 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+/*
+* Author:
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "middleware/registry.hpp"
+
+#include "utilities/cmdline.hpp"
+#include "utilities/file.hpp"
+#include "utilities/split.hpp"
+#include "utilities/timer.hpp"
+
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+const int DEFAULT_REQUESTS = 100;
+
+namespace ax
+{
+    // serve `requests` inferences spread over `models` from a registry with a cmm budget.
+    // "round" walks the models in turn, "random" draws them with a skew to the first ones,
+    // like a detector that runs every frame and heads that only run now and then.
+    bool run_models(const std::vector<std::string>& models, float budget_mb, int requests, const std::string& order)
+    {
+        // 1. init engine
+        AX_ENGINE_NPU_ATTR_T npu_attr;
+        memset(&npu_attr, 0, sizeof(npu_attr));
+        npu_attr.eHardMode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+        auto ret = AX_ENGINE_Init(&npu_attr);
+        if (0 != ret)
+        {
+            return false;
+        }
+
+        // 2. serve the requests, models are loaded on first use and evicted by the registry
+        {
+            middleware::model_registry registry((size_t)(budget_mb * 1048576.f));
+
+            std::mt19937 rng(42);
+            std::vector<double> weights;
+            for (size_t i = 0; i < models.size(); ++i)
+            {
+                weights.push_back(1.0 / (double)(i + 1));
+            }
+            std::discrete_distribution<int> pick(weights.begin(), weights.end());
+
+            timer total;
+            int failed = 0;
+            for (int i = 0; i < requests; ++i)
+            {
+                const std::string& model = models[order == "random" ? pick(rng) : i % (int)models.size()];
+                auto session = registry.acquire(model);
+                if (session == nullptr || session->run() != 0)
+                {
+                    failed++;
+                }
+            }
+            fprintf(stdout, "%d requests over %zu models in %.2f ms, %d failed\n", requests, models.size(), total.cost(), failed);
+
+            for (auto& model : models)
+            {
+                fprintf(stdout, "  %-40s %8.2f MB%s\n", model.c_str(), registry.get_footprint(model) / 1048576.0,
+                        registry.is_resident(model) ? "  resident" : "");
+            }
+            registry.print_stats();
+        }
+
+        // 3. engine de init
+        AX_ENGINE_Deinit();
+        return true;
+    }
+} // namespace ax
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<std::string>("model", 'm', "joint files(a.k.a. joint models), separated by ','", true, "");
+    cmd.add<float>("budget", 'b', "cmm budget of the resident models in MB, 0 for no limit", false, 0.f);
+    cmd.add<int>("requests", 'n', "inferences to serve", false, DEFAULT_REQUESTS);
+    cmd.add<std::string>("order", 'o', "model of each request: round or random", false, "round", cmdline::oneof<std::string>("round", "random"));
+    cmd.parse_check(argc, argv);
+
+    // 0. get app args, can be removed from user's app
+    auto models = utilities::split_string(cmd.get<std::string>("model"), ",");
+    for (auto& model : models)
+    {
+        if (!utilities::file_exist(model))
+        {
+            fprintf(stderr, "Input file model(%s) is not exist, please check it.\n", model.c_str());
+            return -1;
+        }
+    }
+    if (models.empty())
+    {
+        fprintf(stderr, "No model given.\n");
+        return -1;
+    }
+
+    // 1. print args
+    fprintf(stdout, "--------------------------------------\n");
+    fprintf(stdout, "models : %zu\n", models.size());
+    fprintf(stdout, "budget : %.2f MB\n", cmd.get<float>("budget"));
+    fprintf(stdout, "requests : %d, %s\n", cmd.get<int>("requests"), cmd.get<std::string>("order").c_str());
+    fprintf(stdout, "--------------------------------------\n");
+
+    // 2. sys_init
+    AX_SYS_Init();
+
+    // 3. -  engine model  -  can only use AX_ENGINE** inside
+    ax::run_models(models, cmd.get<float>("budget"), cmd.get<int>("requests"), cmd.get<std::string>("order"));
+
+    AX_SYS_Deinit();
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+/*
+* Author:
+*/
+
+// the detection post process on captured output tensors (ax_yolov8_steps --capture), no npu needed.
+// times the decode + nms over many runs, and saves the objects or checks them against a saved list,
+// exactly or within an epsilon, so post process changes can be verified on a host.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include "base/detection.hpp"
+#include "base/proposal_tiles.hpp"
+#include "middleware/capture.hpp"
+
+#include "utilities/cmdline.hpp"
+#include "utilities/latency.hpp"
+#include "utilities/timer.hpp"
+#include "utilities/trace.hpp"
+
+const int DEFAULT_REPEAT = 100;
+
+const float PROB_THRESHOLD = 0.45f;
+const float NMS_THRESHOLD = 0.45f;
+
+namespace ax
+{
+    // one object per line: label prob x y width height, printed so the floats read back bit exact
+    static bool save_objects(const std::string& path, const std::vector<detection::Object>& objects)
+    {
+        FILE* fp = fopen(path.c_str(), "w");
+        if (fp == nullptr)
+        {
+            fprintf(stderr, "Open %s failed.\n", path.c_str());
+            return false;
+        }
+        for (const auto& obj : objects)
+        {
+            fprintf(fp, "%d %.9g %.9g %.9g %.9g %.9g\n", obj.label, obj.prob, obj.rect.x, obj.rect.y, obj.rect.width, obj.rect.height);
+        }
+        fclose(fp);
+        return true;
+    }
+
+    static bool load_objects(const std::string& path, std::vector<detection::Object>& objects)
+    {
+        FILE* fp = fopen(path.c_str(), "r");
+        if (fp == nullptr)
+        {
+            fprintf(stderr, "Open %s failed.\n", path.c_str());
+            return false;
+        }
+        objects.clear();
+        detection::Object obj;
+        float x, y, width, height;
+        while (fscanf(fp, "%d %f %f %f %f %f", &obj.label, &obj.prob, &x, &y, &width, &height) == 6)
+        {
+            obj.rect = cv::Rect_<float>(x, y, width, height);
+            objects.push_back(obj);
+        }
+        fclose(fp);
+        return true;
+    }
+
+    // same objects in the same order, every value within `eps`. 0 asks for the same bits
+    static bool compare_objects(const std::vector<detection::Object>& expect, const std::vector<detection::Object>& objects, float eps)
+    {
+        if (expect.size() != objects.size())
+        {
+            fprintf(stdout, "mismatch: %zu objects, %zu expected\n", objects.size(), expect.size());
+            return false;
+        }
+        float max_diff = 0.f;
+        bool ok = true;
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            const auto& a = expect[i];
+            const auto& b = objects[i];
+            const float diff = std::max({std::fabs(a.prob - b.prob), std::fabs(a.rect.x - b.rect.x), std::fabs(a.rect.y - b.rect.y),
+                                         std::fabs(a.rect.width - b.rect.width), std::fabs(a.rect.height - b.rect.height)});
+            max_diff = std::max(max_diff, diff);
+            if (a.label != b.label || diff > eps)
+            {
+                fprintf(stdout, "mismatch at object %zu: label %d prob %.6f box %.3f %.3f %.3f %.3f, expected label %d prob %.6f box %.3f %.3f %.3f %.3f\n",
+                        i, b.label, b.prob, b.rect.x, b.rect.y, b.rect.width, b.rect.height, a.label, a.prob, a.rect.x, a.rect.y, a.rect.width, a.rect.height);
+                ok = false;
+            }
+        }
+        fprintf(stdout, "%zu objects, max difference %g (eps %g): %s\n", objects.size(), max_diff, eps, ok ? "match" : "MISMATCH");
+        return ok;
+    }
+} // namespace ax
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<std::string>("capture", 'c', "captured output tensors, see ax_yolov8_steps --capture", true, "");
+    cmd.add<std::string>("post", 'p', "post process: yolov8 or yolo26, the capture's own by default", false, "", cmdline::oneof<std::string>("", "yolov8", "yolo26"));
+    cmd.add<int>("repeat", 'r', "timed runs of the post process", false, DEFAULT_REPEAT);
+    cmd.add<std::string>("save", 's', "write the objects to this file", false, "");
+    cmd.add<std::string>("expect", 'e', "compare the objects with a file written by --save", false, "");
+    cmd.add<float>("eps", 0, "largest difference --expect accepts, 0 for bit exact", false, 0.f);
+    cmd.add<std::string>("trace", 't', "chrome trace json of the runs, needs a build with AXERA_TRACE", false, "");
+    cmd.parse_check(argc, argv);
+
+    middleware::replay_io replay;
+    if (!replay.load(cmd.get<std::string>("capture")))
+    {
+        return -1;
+    }
+    const auto& capture = replay.get_capture();
+    auto io_info = replay.get_io_info();
+    if (io_info->nInputSize < 1 || io_info->pInputs[0].nShapeSize != 4)
+    {
+        fprintf(stderr, "The capture has no nhwc input.\n");
+        return -1;
+    }
+    const int input_h = io_info->pInputs[0].pShape[1];
+    const int input_w = io_info->pInputs[0].pShape[2];
+    const int src_rows = capture.get_int("src_rows", input_h);
+    const int src_cols = capture.get_int("src_cols", input_w);
+
+    auto post = cmd.get<std::string>("post");
+    if (post.empty())
+    {
+        auto it = capture.attributes.find("post");
+        post = it != capture.attributes.end() ? it->second : "yolov8";
+    }
+    const bool yolo26 = post == "yolo26";
+    const int repeat = std::max(cmd.get<int>("repeat"), 1);
+
+    fprintf(stdout, "--------------------------------------\n");
+    fprintf(stdout, "capture : %s, %u outputs\n", cmd.get<std::string>("capture").c_str(), io_info->nOutputSize);
+    fprintf(stdout, "post process : %s, input %dx%d, source %dx%d\n", post.c_str(), input_h, input_w, src_rows, src_cols);
+    fprintf(stdout, "--------------------------------------\n");
+
+    detection::ProposalTiles<detection::Proposals> tiles;
+    detection::Proposals proposals;
+    std::vector<detection::Object> objects;
+    utilities::latency_stats stats;
+    for (int i = 0; i < repeat + 1; ++i)
+    {
+        timer tick;
+        detection::get_out_yolo_heads(io_info, replay.get_io(), yolo26 ? detection::YOLO_HEADS_26 : detection::YOLO_HEADS_V8, PROB_THRESHOLD, NMS_THRESHOLD,
+                                      input_h, input_w, src_rows, src_cols, tiles, proposals, objects);
+        float cost = tick.cost();
+        // the first run sizes the buffers
+        if (i > 0)
+        {
+            stats.add(cost);
+        }
+    }
+    fprintf(stdout, "post process x%d: mean %.3f ms, min %.3f ms, p50 %.3f ms, p99 %.3f ms\n", repeat, stats.mean(), stats.min(),
+            stats.percentile(50.f), stats.percentile(99.f));
+    fprintf(stdout, "detection num: %zu\n", objects.size());
+
+    bool ok = true;
+    if (!cmd.get<std::string>("save").empty())
+    {
+        ok = ax::save_objects(cmd.get<std::string>("save"), objects) && ok;
+    }
+    if (!cmd.get<std::string>("expect").empty())
+    {
+        std::vector<detection::Object> expect;
+        ok = ax::load_objects(cmd.get<std::string>("expect"), expect) && ax::compare_objects(expect, objects, cmd.get<float>("eps")) && ok;
+    }
+    if (!cmd.get<std::string>("trace").empty())
+    {
+#ifdef AXERA_TRACE
+        AX_TRACE_WRITE(cmd.get<std::string>("trace"));
+#else
+        fprintf(stderr, "Tracing is not built in, configure with -DAXERA_TRACE=ON.\n");
+#endif
+    }
+    fprintf(stdout, "--------------------------------------\n");
+    return ok ? 0 : -1;
+}
@@ -28,10 +28,13 @@
 #include <algorithm>
 
 #include <opencv2/opencv.hpp>
+#include "base/detection.hpp"
+#include "base/pose.hpp"
 #include "middleware/io.hpp"
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
 #include "utilities/file.hpp"
+#include "utilities/model.hpp"
 #include "utilities/timer.hpp"
 
 #include <ax_sys_api.h>
@@ -124,36 +127,27 @@ static AffineInfo preprocess(const cv::Mat& img_bgr, std::vector<uint8_t>& out_d
 
 namespace ax
 {
-    static float g_keypoints[NUM_JOINTS][2];
-    static float g_scores[NUM_JOINTS];
-
+    // keypoints of every crop in the output, batch x NUM_JOINTS in image pixels.
+    // the sample cuts one crop, a top-down pipeline passes the affine of each person
     void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data,
-                      const AffineInfo& affine, const std::vector<float>& time_costs)
+                      const std::vector<AffineInfo>& affines, std::vector<pose::ai_point_t>& keypoints,
+                      const std::vector<float>& time_costs)
     {
         timer timer_postprocess;
 
-        float* output_x = (float*)io_data->pOutputs[0].pVirAddr;
-        float* output_y = (float*)io_data->pOutputs[1].pVirAddr;
+        const float* output_x = (const float*)io_data->pOutputs[0].pVirAddr;
+        const float* output_y = (const float*)io_data->pOutputs[1].pVirAddr;
 
+        int batch = std::min((int)io_info->pOutputs[0].pShape[0], (int)affines.size());
         int simcc_w = io_info->pOutputs[0].pShape[2]; // 384
         int simcc_h = io_info->pOutputs[1].pShape[2]; // 512
 
-        for (int k = 0; k < NUM_JOINTS; k++) {
-            float* px = output_x + k * simcc_w;
-            float* py = output_y + k * simcc_h;
-
-            int max_x_idx = std::max_element(px, px + simcc_w) - px;
-            int max_y_idx = std::max_element(py, py + simcc_h) - py;
-            float max_x_val = px[max_x_idx];
-            float max_y_val = py[max_y_idx];
-
-            float kp_x = (float)max_x_idx / SIMCC_SPLIT_RATIO;
-            float kp_y = (float)max_y_idx / SIMCC_SPLIT_RATIO;
-
-            g_keypoints[k][0] = kp_x / INPUT_W * affine.scale[0] + affine.center[0] - affine.scale[0] / 2.0f;
-            g_keypoints[k][1] = kp_y / INPUT_H * affine.scale[1] + affine.center[1] - affine.scale[1] / 2.0f;
-            g_scores[k] = std::min(max_x_val, max_y_val);
+        std::vector<pose::CropAffine> crops(batch);
+        for (int n = 0; n < batch; n++) {
+            crops[n] = pose::crop_affine(affines[n].center[0], affines[n].center[1], affines[n].scale[0], affines[n].scale[1], INPUT_W, INPUT_H);
         }
+        keypoints.resize((size_t)batch * NUM_JOINTS);
+        pose::decode_simcc(output_x, output_y, batch, NUM_JOINTS, simcc_w, simcc_h, SIMCC_SPLIT_RATIO, crops.data(), keypoints.data());
 
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
         fprintf(stdout, "--------------------------------------\n");
@@ -169,29 +163,32 @@ namespace ax
         fprintf(stdout, "--------------------------------------\n");
 
         int above = 0;
-        for (int k = 0; k < NUM_JOINTS; k++) {
-            if (g_scores[k] >= 0.3f) above++;
+        for (size_t k = 0; k < keypoints.size(); k++) {
+            if (keypoints[k].score >= 0.3f) above++;
             fprintf(stdout, "  kp%02d: (%6.1f, %6.1f)  score=%.4f\n",
-                    k, g_keypoints[k][0], g_keypoints[k][1], g_scores[k]);
+                    (int)k, keypoints[k].x, keypoints[k].y, keypoints[k].score);
         }
-        fprintf(stdout, "kpts above 0.3: %d/%d\n", above, NUM_JOINTS);
+        fprintf(stdout, "kpts above 0.3: %d/%d\n", above, (int)keypoints.size());
     }
 
-    void draw_and_save(cv::Mat& mat)
+    void draw_and_save(cv::Mat& mat, const std::vector<pose::ai_point_t>& keypoints)
     {
         const float thr = 0.3f;
-        for (int k = 0; k < NUM_JOINTS; k++) {
-            if (g_scores[k] < thr) continue;
-            cv::circle(mat, cv::Point((int)g_keypoints[k][0], (int)g_keypoints[k][1]),
-                       4, cv::Scalar(0, 255, 0), -1);
-        }
-        for (auto& sk : COCO_SKELETON) {
-            int i = sk[0], j = sk[1];
-            if (g_scores[i] >= thr && g_scores[j] >= thr) {
-                cv::line(mat,
-                         cv::Point((int)g_keypoints[i][0], (int)g_keypoints[i][1]),
-                         cv::Point((int)g_keypoints[j][0], (int)g_keypoints[j][1]),
-                         cv::Scalar(255, 128, 0), 2);
+        for (size_t p = 0; p + NUM_JOINTS <= keypoints.size(); p += NUM_JOINTS) {
+            const pose::ai_point_t* kp = keypoints.data() + p;
+            for (int k = 0; k < NUM_JOINTS; k++) {
+                if (kp[k].score < thr) continue;
+                cv::circle(mat, cv::Point((int)kp[k].x, (int)kp[k].y),
+                           4, cv::Scalar(0, 255, 0), -1);
+            }
+            for (auto& sk : COCO_SKELETON) {
+                int i = sk[0], j = sk[1];
+                if (kp[i].score >= thr && kp[j].score >= thr) {
+                    cv::line(mat,
+                             cv::Point((int)kp[i].x, (int)kp[i].y),
+                             cv::Point((int)kp[j].x, (int)kp[j].y),
+                             cv::Scalar(255, 128, 0), 2);
+                }
             }
         }
         cv::imwrite("rtmpose_out.jpg", mat);
@@ -210,14 +207,10 @@ namespace ax
             return false;
         }
 
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer)) {
-            fprintf(stderr, "Read model file failed.\n");
-            return false;
-        }
-
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
+        AX_ENGINE_HANDLE handle = nullptr;
+        ret = utilities::load_model(model, [&](const void* data, size_t size) {
+            return AX_ENGINE_CreateHandle(&handle, data, size);
+        });
         if (ret != 0) {
             fprintf(stderr, "AX_ENGINE_CreateHandle failed: 0x%x\n", ret);
             return false;
@@ -259,8 +252,9 @@ namespace ax
             }
         }
 
-        post_process(io_info, &io_data, affine, time_costs);
-        draw_and_save(mat);
+        std::vector<pose::ai_point_t> keypoints;
+        post_process(io_info, &io_data, std::vector<AffineInfo>(1, affine), keypoints, time_costs);
+        draw_and_save(mat, keypoints);
 
         middleware::free_io(&io_data);
         AX_ENGINE_DestroyHandle(handle);
@@ -25,7 +25,9 @@
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
 #include "base/detection.hpp"
+#include "base/segmentation.hpp"
 #include "middleware/io.hpp"
+#include "middleware/session.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -50,31 +52,25 @@ namespace ax
             colors[i] = {uchar(rand() % 255), uchar(rand() % 255), uchar(rand() % 255)};
         }
 
+        // 0.6 of the color over 0.4 of the image, labels past the classes are black
+        std::vector<segmentation::LabelColor> palette(256, segmentation::LabelColor{0, 0, 0, 153});
+        for (size_t i = 0; i < 19; i++)
+        {
+            palette[i] = {colors[i][0], colors[i][1], colors[i][2], 153};
+        }
+
         int width = input_w / 4;
         int height = input_h / 4;
-        cv::Mat seg(height, width, CV_8UC3);
+        cv::Mat seg(height, width, CV_8UC1);
 
         timer timer_postprocess;
         auto& output = io_data->pOutputs[1];
-        auto& info = io_info->pOutputs[1];
         auto seg_data = (int*)output.pVirAddr;
 
-        for (size_t y = 0; y < height; y++)
-        {
-            for (size_t x = 0; x < width; x++)
-            {
-                int idx = seg_data[y * width + x];
-                if (idx < 19)
-                {
-                    seg.at<cv::Vec3b>(y, x) = colors[idx];
-                }
-                else
-                {
-                    seg.at<cv::Vec3b>(y, x) = {0, 0, 0};
-                }
-            }
-        }
-        cv::resize(seg, seg, cv::Size(mat.cols, mat.rows));
+        segmentation::labels_from_ids(seg_data, height, width, 19, 19, seg.data, seg.step);
+
+        cv::Mat dst(mat.rows, mat.cols, CV_8UC3);
+        segmentation::render(seg.data, height, width, seg.step, palette.data(), mat.data, mat.step, dst.data, dst.rows, dst.cols, dst.step);
 
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
         fprintf(stdout, "--------------------------------------\n");
@@ -88,8 +84,6 @@ namespace ax
                 *min_max_time.first);
         fprintf(stdout, "--------------------------------------\n");
 
-        cv::Mat dst;
-        cv::addWeighted(mat, 0.4, seg, 0.6, 0, dst);
         cv::imwrite("segformer_out.png", dst);
     }
 
@@ -109,65 +103,44 @@ namespace ax
             return ret;
         }
 
-        // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
+        // 2. load model, create handle, context and io
+        middleware::session session;
+        ret = session.load(model);
+        if (0 != ret)
         {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
+            return ret;
         }
 
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating handle is done.\n");
-
-        // 4. create context
-        ret = AX_ENGINE_CreateContext(handle);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating context is done.\n");
-
-        // 5. set io
-        AX_ENGINE_IO_INFO_T* io_info;
-        ret = AX_ENGINE_GetIOInfo(handle, &io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine get io info is done. \n");
-
-        // 6. alloc io
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
-
-        // 7. insert input
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        // 3. insert input
+        ret = session.push_input(data);
+        if (0 != ret)
+        {
+            return ret;
+        }
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
-        // 8. warm up
-        for (int i = 0; i < 5; ++i)
-        {
-            AX_ENGINE_RunSync(handle, &io_data);
-        }
+        // 4. warm up
+        session.warm_up(5);
 
-        // 9. run model
+        // 5. run model
         std::vector<float> time_costs(repeat, 0);
         for (int i = 0; i < repeat; ++i)
         {
             timer tick;
-            ret = AX_ENGINE_RunSync(handle, &io_data);
+            ret = session.run();
             time_costs[i] = tick.cost();
-            SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+            if (0 != ret)
+            {
+                return ret;
+            }
         }
 
-        // 10. get result
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        // 6. get result
+        post_process(session.get_io_info(), session.get_io(), mat, input_w, input_h, time_costs);
         fprintf(stdout, "--------------------------------------\n");
 
-        middleware::free_io(&io_data);
-        return AX_ENGINE_DestroyHandle(handle);
+        return 0;
     }
 } // namespace ax
 
@@ -24,6 +24,7 @@
 #include "base/common.hpp"
 #include "base/detection.hpp"
 #include "middleware/io.hpp"
+#include "middleware/session.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -89,39 +90,6 @@ namespace ax
         cv::cvtColor(img_new, img_new, cv::COLOR_BGR2RGB);
     }
 
-    static inline void cov_xywhr(float w, float h, float t, float& a, float& b, float& c)
-    {
-        const float ww = w * w / 12.f;
-        const float hh = h * h / 12.f;
-        const float cs = std::cos(t);
-        const float sn = std::sin(t);
-        const float c2 = cs * cs;
-        const float s2 = sn * sn;
-        a = ww * c2 + hh * s2;
-        b = ww * s2 + hh * c2;
-        c = (ww - hh) * cs * sn;
-    }
-
-    static inline float probiou(const detection::Object& A, const detection::Object& B)
-    {
-        constexpr float eps = 1e-7f;
-        float a1, b1, c1; cov_xywhr(A.rect.width, A.rect.height, A.angle, a1, b1, c1);
-        float a2, b2, c2; cov_xywhr(B.rect.width, B.rect.height, B.angle, a2, b2, c2);
-        const float dx = A.rect.x - B.rect.x;
-        const float dy = A.rect.y - B.rect.y;
-        const float sum_ab = (a1 + a2) * (b1 + b2) - (c1 + c2) * (c1 + c2);
-        const float t1 = ((a1 + a2) * dy * dy + (b1 + b2) * dx * dx) / (sum_ab + eps) * 0.25f;
-        const float t2 = ((c1 + c2) * (-dx) * dy) / (sum_ab + eps) * 0.5f;
-        const float i1 = std::max(a1 * b1 - c1 * c1, 0.f);
-        const float i2 = std::max(a2 * b2 - c2 * c2, 0.f);
-        const float t3 = std::log(sum_ab / (4.f * std::sqrt(i1 * i2) + eps) + eps) * 0.5f;
-        float bd = t1 + t2 + t3;
-        if (bd < eps) bd = eps;
-        if (bd > 100.f) bd = 100.f;
-        const float hd = std::sqrt(1.f - std::exp(-bd) + eps);
-        return 1.f - hd;
-    }
-
     static void postprocess_yolo11_obb(std::vector<detection::Object>& proposals,
                                        std::vector<detection::Object>& objects,
                                        float nms_threshold,
@@ -135,29 +103,9 @@ namespace ax
                       return a.prob > b.prob;
                   });
 
-        const int n = static_cast<int>(proposals.size());
+        // ultralytics' probiou nms, every better box suppresses, picked or not
         std::vector<int> picked;
-        picked.reserve(static_cast<size_t>(n));
-        for (int j = 0; j < n; ++j)
-        {
-            bool suppress = false;
-            for (int i = 0; i < j; ++i)
-            {
-                if (!agnostic && proposals[i].label != proposals[j].label)
-                    continue;
-                if (probiou(proposals[i], proposals[j]) >= nms_threshold)
-                {
-                    suppress = true;
-                    break;
-                }
-            }
-            if (!suppress)
-            {
-                picked.push_back(j);
-                if (static_cast<int>(picked.size()) >= max_det)
-                    break;
-            }
-        }
+        detection::nms_rotated_probiou(proposals, picked, detection::probiou_threshold(nms_threshold), !agnostic, max_det);
 
         const float gain = std::min(letterbox_rows * 1.f / src_rows,
                                     letterbox_cols * 1.f / src_cols);
@@ -343,56 +291,39 @@ namespace ax
             return ret;
         }
 
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
+        middleware::session session;
+        ret = session.load(model);
+        if (0 != ret)
         {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
+            return ret;
         }
 
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating handle is done.\n");
-
-        ret = AX_ENGINE_CreateContext(handle);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating context is done.\n");
-
-        AX_ENGINE_IO_INFO_T* io_info;
-        ret = AX_ENGINE_GetIOInfo(handle, &io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine get io info is done. \n");
-
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
-
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        ret = session.push_input(data);
+        if (0 != ret)
+        {
+            return ret;
+        }
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
-        for (int i = 0; i < 5; ++i)
-        {
-            AX_ENGINE_RunSync(handle, &io_data);
-        }
+        session.warm_up(5);
 
         std::vector<float> time_costs(repeat, 0);
         for (int i = 0; i < repeat; ++i)
         {
             timer tick;
-            ret = AX_ENGINE_RunSync(handle, &io_data);
+            ret = session.run();
             time_costs[i] = tick.cost();
-            SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+            if (0 != ret)
+            {
+                return ret;
+            }
         }
 
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        post_process(session.get_io_info(), session.get_io(), mat, input_w, input_h, time_costs);
         fprintf(stdout, "--------------------------------------\n");
 
-        middleware::free_io(&io_data);
-        return AX_ENGINE_DestroyHandle(handle);
+        return 0;
     }
 } // namespace ax
 
@@ -0,0 +1,260 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+/*
+* Author:
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <numeric>
+#include <thread>
+
+#include <opencv2/opencv.hpp>
+#include "base/common.hpp"
+#include "base/detection.hpp"
+#include "middleware/io.hpp"
+#include "middleware/batcher.hpp"
+
+#include "utilities/args.hpp"
+#include "utilities/cmdline.hpp"
+#include "utilities/file.hpp"
+#include "utilities/timer.hpp"
+
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+const int DEFAULT_IMG_H = 640;
+const int DEFAULT_IMG_W = 640;
+
+const char* CLASS_NAMES[] = {
+    "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
+    "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
+    "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee",
+    "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard",
+    "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple",
+    "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch",
+    "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone",
+    "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
+    "hair drier", "toothbrush"};
+
+int NUM_CLASS = 80;
+
+const int DEFAULT_STREAMS = 8;
+const int DEFAULT_FRAMES = 100;
+const float DEFAULT_FPS = 30.f;
+const float DEFAULT_MAX_WAIT_MS = 5.f;
+const int DEFAULT_WORKERS = 4;
+
+const float PROB_THRESHOLD = 0.45f;
+const float NMS_THRESHOLD = 0.45f;
+namespace ax
+{
+    struct batch_options
+    {
+        int streams;
+        int frames;     // per stream
+        float fps;      // per stream, <= 0 submits as fast as the batcher takes frames
+        int max_batch;  // <= 0 takes the max batch of the model
+        float max_wait_ms;
+        int workers;
+    };
+
+    bool run_model(const std::string& model, const cv::Mat& mat, const batch_options& options, int input_h, int input_w)
+    {
+        // 1. init engine
+        AX_ENGINE_NPU_ATTR_T npu_attr;
+        memset(&npu_attr, 0, sizeof(npu_attr));
+        npu_attr.eHardMode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+        auto ret = AX_ENGINE_Init(&npu_attr);
+        if (0 != ret)
+        {
+            return ret;
+        }
+
+        // 2. load model, the batcher owns two io sets of max batch frames each
+        middleware::batcher batcher;
+        ret = batcher.load(model, options.max_batch, options.max_wait_ms, options.workers);
+        if (0 != ret)
+        {
+            return ret;
+        }
+        fprintf(stdout, "--------------------------------------\n");
+
+        // 3. every stream submits its frames at its own pace, each frame gets its own result slot
+        std::vector<std::vector<detection::Object> > results((size_t)options.streams * options.frames);
+        std::atomic<int> failed(0);
+        std::vector<std::thread> streams;
+        for (int s = 0; s < options.streams; ++s)
+        {
+            streams.emplace_back([&, s]() {
+                std::vector<std::future<int> > pending;
+                auto next = std::chrono::steady_clock::now();
+                for (int i = 0; i < options.frames; ++i)
+                {
+                    auto objects = &results[(size_t)s * options.frames + i];
+                    auto fill = [&mat, input_h, input_w](uint8_t* input, size_t size) {
+                        // the slice of one frame, rows may be padded
+                        size_t stride = size / input_h;
+                        if (stride < (size_t)input_w * 3)
+                        {
+                            fprintf(stderr, "The input slice of %zu bytes can not hold a %dx%d image.\n", size, input_w, input_h);
+                            return -1;
+                        }
+                        common::get_input_data_letterbox(mat, input, input_h, input_w, false, stride);
+                        return 0;
+                    };
+                    auto post = [&mat, objects, input_h, input_w](AX_ENGINE_IO_INFO_T* info, const std::vector<void*>& outputs) {
+                        detection::Proposals proposals;
+                        for (int j = 0; j < 3; ++j)
+                        {
+                            int32_t feat_stride = (1 << j) * 8;
+                            detection::generate_proposals_yolov8_native(feat_stride, (float*)outputs[j], PROB_THRESHOLD, proposals, input_w, input_h, NUM_CLASS);
+                        }
+                        detection::get_out_bbox(proposals, *objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
+                        return 0;
+                    };
+                    pending.push_back(batcher.submit(fill, post));
+
+                    if (options.fps > 0.f)
+                    {
+                        next += std::chrono::microseconds((int64_t)(1000000.f / options.fps));
+                        std::this_thread::sleep_until(next);
+                    }
+                }
+                for (auto& result : pending)
+                {
+                    if (0 != result.get())
+                    {
+                        failed++;
+                    }
+                }
+            });
+        }
+        for (auto& stream : streams)
+        {
+            stream.join();
+        }
+
+        // 4. flush and report, the batch size adapts to how fast the streams push
+        batcher.stop();
+        batcher.print_report();
+        if (failed > 0)
+        {
+            fprintf(stderr, "%d frames failed.\n", failed.load());
+            return -1;
+        }
+
+        // 5. get result of the last frame of the first stream
+        auto& objects = results[options.frames - 1];
+        fprintf(stdout, "detection num: %zu\n", objects.size());
+        cv::Mat out = mat.clone();
+        detection::draw_objects(out, objects, CLASS_NAMES, "yolov8_batcher_out");
+
+        return 0;
+    }
+} // namespace ax
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<std::string>("model", 'm', "joint file(a.k.a. joint model), compiled with a dynamic batch size", true, "");
+    cmd.add<std::string>("image", 'i', "image file", true, "");
+    cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
+
+    cmd.add<int>("streams", 's', "producer streams", false, DEFAULT_STREAMS);
+    cmd.add<int>("frames", 'n', "frames per stream", false, DEFAULT_FRAMES);
+    cmd.add<float>("fps", 'f', "frame rate of each stream, 0 for as fast as possible", false, DEFAULT_FPS);
+    cmd.add<int>("batch", 'b', "max batch, 0 for the max batch of the model", false, 0);
+    cmd.add<float>("wait", 'w', "max wait of the first frame of a batch in ms", false, DEFAULT_MAX_WAIT_MS);
+    cmd.add<int>("workers", 't', "post process threads", false, DEFAULT_WORKERS);
+    cmd.parse_check(argc, argv);
+    // 0. get app args, can be removed from user's app
+    auto model_file = cmd.get<std::string>("model");
+    auto image_file = cmd.get<std::string>("image");
+
+    auto model_file_flag = utilities::file_exist(model_file);
+    auto image_file_flag = utilities::file_exist(image_file);
+
+    if (!model_file_flag | !image_file_flag)
+    {
+        auto show_error = [](const std::string& kind, const std::string& value) {
+            fprintf(stderr, "Input file %s(%s) is not exist, please check it.\n", kind.c_str(), value.c_str());
+        };
+
+        if (!model_file_flag) { show_error("model", model_file); }
+        if (!image_file_flag) { show_error("image", image_file); }
+
+        return -1;
+    }
+
+    auto input_size_string = cmd.get<std::string>("size");
+
+    std::array<int, 2> input_size = {DEFAULT_IMG_H, DEFAULT_IMG_W};
+
+    auto input_size_flag = utilities::parse_string(input_size_string, input_size);
+
+    if (!input_size_flag)
+    {
+        auto show_error = [](const std::string& kind, const std::string& value) {
+            fprintf(stderr, "Input %s(%s) is not allowed, please check it.\n", kind.c_str(), value.c_str());
+        };
+
+        show_error("size", input_size_string);
+
+        return -1;
+    }
+
+    ax::batch_options options;
+    options.streams = std::max(cmd.get<int>("streams"), 1);
+    options.frames = std::max(cmd.get<int>("frames"), 1);
+    options.fps = cmd.get<float>("fps");
+    options.max_batch = cmd.get<int>("batch");
+    options.max_wait_ms = cmd.get<float>("wait");
+    options.workers = cmd.get<int>("workers");
+
+    // 1. print args
+    fprintf(stdout, "--------------------------------------\n");
+    fprintf(stdout, "model file : %s\n", model_file.c_str());
+    fprintf(stdout, "image file : %s\n", image_file.c_str());
+    fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
+    fprintf(stdout, "streams : %d x %d frames at %.1f fps\n", options.streams, options.frames, options.fps);
+    fprintf(stdout, "--------------------------------------\n");
+
+    // 2. read image, the letterbox runs per frame inside the batcher
+    cv::Mat mat = cv::imread(image_file);
+    if (mat.empty())
+    {
+        fprintf(stderr, "Read image failed.\n");
+        return -1;
+    }
+
+    // 3. sys_init
+    AX_SYS_Init();
+
+    // 4. -  engine model  -  can only use AX_ENGINE** inside
+    {
+        ax::run_model(model_file, mat, options, input_size[0], input_size[1]);
+
+        // 4.3 engine de init
+        AX_ENGINE_Deinit();
+    }
+    // 4. -  engine model  -
+
+    AX_SYS_Deinit();
+    return 0;
+}
@@ -26,6 +26,8 @@
 #include "base/common.hpp"
 #include "base/detection.hpp"
 #include "middleware/io.hpp"
+#include "middleware/nv12.hpp"
+#include "middleware/session.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
@@ -33,7 +35,9 @@
 #include "utilities/timer.hpp"
 
 #include <ax_sys_api.h>
+#ifndef AXERA_MOCK_ENGINE
 #include <ax_ivps_api.h>
+#endif
 #include <ax_engine_api.h>
 
 #ifndef ALIGN_UP
@@ -62,27 +66,48 @@ const float PROB_THRESHOLD = 0.45f;
 const float NMS_THRESHOLD = 0.45f;
 namespace ax
 {
-    bool rgb2nv12(cv::Mat mat, int cropresize_width, int cropresize_height, std::vector<uint8_t>& image_nv12)
+    // stands in for a vin / vdec channel: the image as an nv12 frame in cmm, sizes aligned to 16.
+    // `mat` is resized to the frame size so the boxes can be drawn on it.
+    bool make_frame(cv::Mat& mat, AX_VIDEO_FRAME_T& frame)
     {
-        // resolution align 16
         printf("image size: %d %d\n", mat.cols, mat.rows);
         cv::resize(mat, mat, cv::Size(ALIGN_UP(mat.cols, 16), ALIGN_UP(mat.rows, 16)));
         printf("align image size: %d %d\n", mat.cols, mat.rows);
-        int ret = AX_SYS_Init();
+
+        const int y_size = mat.cols * mat.rows;
+        memset(&frame, 0, sizeof(frame));
+        unsigned char* tmp = 0;
+        int ret = AX_SYS_MemAlloc(&frame.u64PhyAddr[0], (void**)&tmp, y_size * 3 / 2, 16, (const AX_S8*)"NULL");
         if (ret != 0)
         {
-            printf("AX_SYS_Init failed, s32Ret=0x%x!\n", ret);
+            fprintf(stderr, "AX_SYS_MemAlloc failed.\n");
             return false;
         }
-        ret = AX_IVPS_Init();
-        if (ret != 0)
+        frame.u64VirAddr[0] = (AX_U64)tmp;
+        frame.u64VirAddr[1] = (AX_U64)(tmp + y_size);
+        frame.u64PhyAddr[1] = frame.u64PhyAddr[0] + y_size;
+        frame.enImgFormat = AX_FORMAT_YUV420_SEMIPLANAR;
+        frame.u32PicStride[0] = frame.u32PicStride[1] = mat.cols;
+        frame.u32Width = mat.cols;
+        frame.u32Height = mat.rows;
+        frame.u32FrameSize = y_size * 3 / 2;
+
+#ifdef AXERA_MOCK_ENGINE
+        // no ivps on the host, convert with opencv and interleave u / v
+        cv::Mat i420;
+        cv::cvtColor(mat, i420, cv::COLOR_BGR2YUV_I420);
+        memcpy(tmp, i420.data, y_size);
+        const uint8_t* u = i420.data + y_size;
+        const uint8_t* v = u + y_size / 4;
+        uint8_t* uv = tmp + y_size;
+        for (int i = 0; i < y_size / 4; ++i)
         {
-            printf("AX_IVPS_Init failed, s32Ret=0x%x!\n", ret);
-            return false;
+            uv[i * 2] = u[i];
+            uv[i * 2 + 1] = v[i];
         }
-        AX_VIDEO_FRAME_T ive_bgr = {0}, ive_nv12 = {0}, ive_nv12_crop_resize = {0};
-        unsigned char* tmp = 0;
-        ret = AX_SYS_MemAlloc(&ive_bgr.u64PhyAddr[0], (void**)&tmp, mat.cols * mat.rows * 3, 16, (const AX_S8*)"NULL");
+#else
+        AX_VIDEO_FRAME_T ive_bgr = {0};
+        ret = AX_SYS_MemAlloc(&ive_bgr.u64PhyAddr[0], (void**)&tmp, y_size * 3, 16, (const AX_S8*)"NULL");
         if (ret != 0)
         {
             fprintf(stderr, "AX_SYS_MemAlloc failed.\n");
@@ -93,77 +118,81 @@ namespace ax
         ive_bgr.u32PicStride[0] = mat.cols;
         ive_bgr.u32Width = mat.cols;
         ive_bgr.u32Height = mat.rows;
-        memcpy(tmp, mat.data, mat.cols * mat.rows * 3);
+        memcpy(tmp, mat.data, y_size * 3);
 
-        ret = AX_SYS_MemAlloc(&ive_nv12.u64PhyAddr[0], (void**)&tmp, mat.cols * mat.rows * 3 / 2, 16, (const AX_S8*)"NULL");
+        ret = AX_IVPS_CscTdp(&ive_bgr, &frame);
+        AX_SYS_MemFree(ive_bgr.u64PhyAddr[0], (void*)ive_bgr.u64VirAddr[0]);
         if (ret != 0)
         {
-            fprintf(stderr, "AX_SYS_MemAlloc failed.\n");
+            fprintf(stderr, "AX_IVPS_CSC failed. 0x%x\n", ret);
             return false;
         }
-        ive_nv12.u64VirAddr[0] = (AX_U64)tmp;
-        ive_nv12.u64VirAddr[1] = (AX_U64)(tmp + mat.cols * mat.rows);
-        ive_nv12.u64PhyAddr[1] = ive_nv12.u64PhyAddr[0] + mat.cols * mat.rows;
-        ive_nv12.enImgFormat = AX_FORMAT_YUV420_SEMIPLANAR;
-        ive_nv12.u32PicStride[0] = ive_nv12.u32PicStride[1] = mat.cols;
-        ive_nv12.u32Width = mat.cols;
-        ive_nv12.u32Height = mat.rows;
-
-        ret = AX_SYS_MemAlloc(&ive_nv12_crop_resize.u64PhyAddr[0], (void**)&tmp, cropresize_width * cropresize_height * 3 / 2, 16, (const AX_S8*)"NULL");
-        if (ret != 0)
+#endif
+        return true;
+    }
+
+    void free_frame(AX_VIDEO_FRAME_T& frame)
+    {
+        if (frame.u64VirAddr[0] != 0)
         {
-            fprintf(stderr, "AX_SYS_MemAlloc failed.\n");
-            return false;
+            AX_SYS_MemFree(frame.u64PhyAddr[0], (void*)frame.u64VirAddr[0]);
+            frame.u64VirAddr[0] = 0;
         }
-        ive_nv12_crop_resize.u64VirAddr[0] = (AX_U64)tmp;
-        ive_nv12_crop_resize.u64VirAddr[1] = (AX_U64)(tmp + cropresize_width * cropresize_height);
-        ive_nv12_crop_resize.u64PhyAddr[1] = ive_nv12_crop_resize.u64PhyAddr[0] + cropresize_width * cropresize_height;
-        ive_nv12_crop_resize.enImgFormat = AX_FORMAT_YUV420_SEMIPLANAR;
-        ive_nv12_crop_resize.u32PicStride[0] = ive_nv12_crop_resize.u32PicStride[1] = cropresize_width;
-        ive_nv12_crop_resize.u32Width = cropresize_width;
-        ive_nv12_crop_resize.u32Height = cropresize_height;
-
-        ret = AX_IVPS_CscTdp(&ive_bgr, &ive_nv12);
-        if (ret != 0)
+    }
+
+    // get the frame into the npu input without a cpu copy of the frame:
+    // a frame at the model resolution is bound in place, anything else is letterboxed by the vpp
+    // straight into the input buffer. `cpu` runs the cpu reference of that letterbox instead.
+    int feed_frame(middleware::session& session, const AX_VIDEO_FRAME_T& frame, int input_h, int input_w, bool cpu)
+    {
+        middleware::nv12_image image;
+        if (!middleware::nv12_from_frame(frame, image))
         {
-            fprintf(stderr, "AX_IVPS_CSC failed. 0x%x\n", ret);
-            return false;
+            fprintf(stderr, "frame is not nv12.\n");
+            return -1;
         }
 
-        memset((void*)ive_nv12_crop_resize.u64VirAddr[0], 0, cropresize_width * cropresize_height * 3 / 2);
-        timer timer_crop_resize;
-
-        AX_IVPS_ASPECT_RATIO_T resize_ctrl;
-        resize_ctrl.nBgColor = 0xFFFFFF;
-        resize_ctrl.eMode = AX_IVPS_ASPECT_RATIO_AUTO;
-        resize_ctrl.eAligns[0] = AX_IVPS_ASPECT_RATIO_HORIZONTAL_CENTER;
-        resize_ctrl.eAligns[1] = AX_IVPS_ASPECT_RATIO_VERTICAL_CENTER;
-
-#ifdef AXERA_TARGET_CHIP_AX620E
-        AX_IVPS_CROP_RESIZE_ATTR_T crop_resize_attr;
-        memset(&crop_resize_attr, 0, sizeof(crop_resize_attr));
-        memcpy(&crop_resize_attr.tAspectRatio, &resize_ctrl, sizeof(resize_ctrl));
-        ret = AX_IVPS_CropResizeVpp(&ive_nv12, &ive_nv12_crop_resize, &crop_resize_attr);
-#else
-        ret = AX_IVPS_CropResizeVpp(&ive_nv12, &ive_nv12_crop_resize, &resize_ctrl);
-#endif
-        if (ret != 0)
+        auto& meta = session.get_io_info()->pInputs[0];
+        if (middleware::nv12_bindable(image, meta, input_h, input_w))
         {
-            fprintf(stderr, "AX_IVPS_CropResize failed. 0x%x\n", ret);
+            fprintf(stdout, "frame bound as the npu input.\n");
+            return session.bind_input(image.phy[0], image.vir[0], meta.nSize);
         }
 
-        image_nv12.resize(cropresize_width * cropresize_height * 3 / 2);
-        memcpy(image_nv12.data(), (void*)ive_nv12_crop_resize.u64VirAddr[0], cropresize_width * cropresize_height * 3 / 2);
-
-        AX_SYS_MemFree(ive_bgr.u64PhyAddr[0], (void*)ive_bgr.u64VirAddr[0]);
-        AX_SYS_MemFree(ive_nv12.u64PhyAddr[0], (void*)ive_nv12.u64VirAddr[0]);
-        AX_SYS_MemFree(ive_nv12_crop_resize.u64PhyAddr[0], (void*)ive_nv12_crop_resize.u64VirAddr[0]);
-        return true;
+        auto& input = session.get_io()->pInputs[0];
+        timer timer_crop_resize;
+#ifndef AXERA_MOCK_ENGINE
+        if (!cpu)
+        {
+            AX_VIDEO_FRAME_T dst = middleware::nv12_to_frame(middleware::nv12_from_input(input, input_h, input_w));
+
+            AX_IVPS_ASPECT_RATIO_T resize_ctrl;
+            memset(&resize_ctrl, 0, sizeof(resize_ctrl));
+            resize_ctrl.nBgColor = 0x000000;
+            resize_ctrl.eMode = AX_IVPS_ASPECT_RATIO_AUTO;
+            resize_ctrl.eAligns[0] = AX_IVPS_ASPECT_RATIO_HORIZONTAL_CENTER;
+            resize_ctrl.eAligns[1] = AX_IVPS_ASPECT_RATIO_VERTICAL_CENTER;
+
+            auto ret = AX_IVPS_CropResizeVpp(const_cast<AX_VIDEO_FRAME_T*>(&frame), &dst, &resize_ctrl);
+            if (ret != 0)
+            {
+                fprintf(stderr, "AX_IVPS_CropResize failed. 0x%x\n", ret);
+                return ret;
+            }
+            fprintf(stdout, "vpp letterbox into the npu input cost time:%.2f ms \n", timer_crop_resize.cost());
+            return 0;
+        }
+#else
+        (void)cpu;
+#endif
+        middleware::nv12_letterbox_cpu(image, input, input_h, input_w);
+        fprintf(stdout, "cpu letterbox into the npu input cost time:%.2f ms \n", timer_crop_resize.cost());
+        return 0;
     }
 
     void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
-        std::vector<detection::Object> proposals;
+        detection::Proposals proposals;
         std::vector<detection::Object> objects;
         timer timer_postprocess;
         for (int i = 0; i < 3; ++i)
@@ -190,7 +219,7 @@ namespace ax
         detection::draw_objects(mat, objects, CLASS_NAMES, "yolov8s_out", 1, 3);
     }
 
-    bool run_model(const std::string& model, const std::vector<uint8_t>& data, const int& repeat, cv::Mat& mat, int input_h, int input_w)
+    int run_model(const std::string& model, const AX_VIDEO_FRAME_T& frame, const int& repeat, cv::Mat& mat, int input_h, int input_w, bool cpu)
     {
         // 1. init engine
 #ifdef AXERA_TARGET_CHIP_AX620E
@@ -206,65 +235,46 @@ namespace ax
             return ret;
         }
 
-        // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
+        // 2. load model, create handle, context and io
+        middleware::session session;
+        ret = session.load(model);
+        if (0 != ret)
         {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
+            return ret;
         }
 
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating handle is done.\n");
-
-        // 4. create context
-        ret = AX_ENGINE_CreateContext(handle);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating context is done.\n");
-
-        // 5. set io
-        AX_ENGINE_IO_INFO_T* io_info;
-        ret = AX_ENGINE_GetIOInfo(handle, &io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine get io info is done. \n");
-
-        // 6. alloc io
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
-
-        // 7. insert input
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        // 3. feed the frame, bound or letterboxed in place
+        ret = feed_frame(session, frame, input_h, input_w, cpu);
+        if (0 != ret)
+        {
+            return ret;
+        }
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
-        // 8. warm up
-        for (int i = 0; i < 5; ++i)
-        {
-            AX_ENGINE_RunSync(handle, &io_data);
-        }
+        // 4. warm up
+        session.warm_up(5);
 
-        // 9. run model
+        // 5. run model
         std::vector<float> time_costs(repeat, 0);
         for (int i = 0; i < repeat; ++i)
         {
             timer tick;
-            ret = AX_ENGINE_RunSync(handle, &io_data);
+            ret = session.run();
             time_costs[i] = tick.cost();
-            SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+            if (0 != ret)
+            {
+                return ret;
+            }
         }
 
-        // 10. get result
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        // 6. get result
+        post_process(session.get_io_info(), session.get_io(), mat, input_w, input_h, time_costs);
         fprintf(stdout, "--------------------------------------\n");
 
-        middleware::free_io(&io_data);
-        return AX_ENGINE_DestroyHandle(handle);
+        // the frame goes back to its owner, the input buffer of the session is freed on release
+        session.unbind_input();
+        return 0;
     }
 } // namespace ax
 
@@ -276,6 +286,7 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
 
     cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
+    cmd.add("cpu", 'c', "letterbox the frame on the cpu instead of the vpp");
     cmd.parse_check(argc, argv);
 
     // 0. get app args, can be removed from user's app
@@ -315,6 +326,7 @@ int main(int argc, char* argv[])
     }
 
     auto repeat = cmd.get<int>("repeat");
+    auto cpu = cmd.exist("cpu");
 
     // 1. print args
     fprintf(stdout, "--------------------------------------\n");
@@ -323,8 +335,7 @@ int main(int argc, char* argv[])
     fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
     fprintf(stdout, "--------------------------------------\n");
 
-    // 2. read image & resize & transpose
-    std::vector<uint8_t> image_nv12;
+    // 2. read image
     cv::Mat mat = cv::imread(image_file);
     if (mat.empty())
     {
@@ -332,26 +343,42 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    if (!ax::rgb2nv12(mat, input_size[0], input_size[1], image_nv12))
+    // 3. sys init, the frame source
+    int ret = AX_SYS_Init();
+    if (ret != 0)
+    {
+        printf("AX_SYS_Init failed, s32Ret=0x%x!\n", ret);
+        return -1;
+    }
+#ifndef AXERA_MOCK_ENGINE
+    ret = AX_IVPS_Init();
+    if (ret != 0)
     {
-        fprintf(stderr, "rgb2nv12 failed.\n");
+        printf("AX_IVPS_Init failed, s32Ret=0x%x!\n", ret);
         return -1;
     }
+#endif
 
-    // 3. sys_init
-    // AX_SYS_Init();
+    AX_VIDEO_FRAME_T frame;
+    if (!ax::make_frame(mat, frame))
+    {
+        fprintf(stderr, "make nv12 frame failed.\n");
+        return -1;
+    }
 
     // 4. -  engine model  -  can only use AX_ENGINE** inside
     {
-        // AX_ENGINE_NPUReset(); // todo ??
-        ax::run_model(model_file, image_nv12, repeat, mat, input_size[0], input_size[1]);
+        ax::run_model(model_file, frame, repeat, mat, input_size[0], input_size[1], cpu);
 
         // 4.3 engine de init
         AX_ENGINE_Deinit();
-        // AX_ENGINE_NPUReset();
     }
     // 4. -  engine model  -
 
+    ax::free_frame(frame);
+#ifndef AXERA_MOCK_ENGINE
+    AX_IVPS_Deinit();
+#endif
     AX_SYS_Deinit();
     return 0;
 }
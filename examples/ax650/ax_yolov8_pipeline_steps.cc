@@ -0,0 +1,212 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+/*
+* Author:
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+#include <opencv2/opencv.hpp>
+#include "base/common.hpp"
+#include "base/detection.hpp"
+#include "middleware/io.hpp"
+#include "middleware/pipeline.hpp"
+
+#include "utilities/args.hpp"
+#include "utilities/cmdline.hpp"
+#include "utilities/file.hpp"
+#include "utilities/timer.hpp"
+
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+const int DEFAULT_IMG_H = 640;
+const int DEFAULT_IMG_W = 640;
+
+const char* CLASS_NAMES[] = {
+    "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
+    "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
+    "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee",
+    "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard",
+    "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple",
+    "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch",
+    "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone",
+    "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
+    "hair drier", "toothbrush"};
+
+int NUM_CLASS = 80;
+
+const int DEFAULT_LOOP_COUNT = 100;
+const int DEFAULT_CONTEXTS = 3;
+
+const float PROB_THRESHOLD = 0.45f;
+const float NMS_THRESHOLD = 0.45f;
+namespace ax
+{
+    bool run_model(const std::string& model, const cv::Mat& mat, const int& repeat, const int& contexts, int input_h, int input_w)
+    {
+        // 1. init engine
+        AX_ENGINE_NPU_ATTR_T npu_attr;
+        memset(&npu_attr, 0, sizeof(npu_attr));
+        npu_attr.eHardMode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+        auto ret = AX_ENGINE_Init(&npu_attr);
+        if (0 != ret)
+        {
+            return ret;
+        }
+
+        // 2. load model, every context gets its own io
+        middleware::pipeline pipeline;
+        ret = pipeline.load(model, contexts);
+        if (0 != ret)
+        {
+            return ret;
+        }
+        fprintf(stdout, "--------------------------------------\n");
+
+        // 3. pre process, letterbox the frame straight into the input buffer of the context
+        auto pre = [&](int index, AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io) {
+            size_t stride = middleware::input_row_stride(io_info->pInputs[0]);
+            if (stride < (size_t)input_w * 3 || stride * input_h > io_info->pInputs[0].nSize)
+            {
+                fprintf(stderr, "The input size is not matched with tensor {name: %s, size: %d}.\n", io_info->pInputs[0].pName, io_info->pInputs[0].nSize);
+                return -1;
+            }
+            common::get_input_data_letterbox(mat, io->pInputs[0].pVirAddr, input_h, input_w, false, stride);
+            return 0;
+        };
+
+        // 4. post process, keep the objects of the last frame for drawing
+        std::vector<detection::Object> objects;
+        auto post = [&](int index, AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io) {
+            detection::Proposals proposals;
+            for (int i = 0; i < 3; ++i)
+            {
+                auto feat_ptr = (float*)io->pOutputs[i].pVirAddr;
+                int32_t stride = (1 << i) * 8;
+                detection::generate_proposals_yolov8_native(stride, feat_ptr, PROB_THRESHOLD, proposals, input_w, input_h, NUM_CLASS);
+            }
+            objects.clear();
+            detection::get_out_bbox(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
+            return 0;
+        };
+
+        // 5. warm up, then run the pipeline
+        ret = pipeline.run(contexts * 2, pre, post);
+        if (0 != ret)
+        {
+            return ret;
+        }
+        ret = pipeline.run(repeat, pre, post);
+        pipeline.print_report();
+        if (0 != ret)
+        {
+            return ret;
+        }
+
+        // 6. get result
+        fprintf(stdout, "detection num: %zu\n", objects.size());
+        cv::Mat out = mat.clone();
+        detection::draw_objects(out, objects, CLASS_NAMES, "yolov8_pipeline_out");
+
+        return 0;
+    }
+} // namespace ax
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<std::string>("model", 'm', "joint file(a.k.a. joint model)", true, "");
+    cmd.add<std::string>("image", 'i', "image file", true, "");
+    cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
+
+    cmd.add<int>("repeat", 'r', "frames pushed through the pipeline", false, DEFAULT_LOOP_COUNT);
+    cmd.add<int>("contexts", 'c', "contexts (frames in flight)", false, DEFAULT_CONTEXTS);
+    cmd.parse_check(argc, argv);
+
+    // 0. get app args, can be removed from user's app
+    auto model_file = cmd.get<std::string>("model");
+    auto image_file = cmd.get<std::string>("image");
+
+    auto model_file_flag = utilities::file_exist(model_file);
+    auto image_file_flag = utilities::file_exist(image_file);
+
+    if (!model_file_flag | !image_file_flag)
+    {
+        auto show_error = [](const std::string& kind, const std::string& value) {
+            fprintf(stderr, "Input file %s(%s) is not exist, please check it.\n", kind.c_str(), value.c_str());
+        };
+
+        if (!model_file_flag) { show_error("model", model_file); }
+        if (!image_file_flag) { show_error("image", image_file); }
+
+        return -1;
+    }
+
+    auto input_size_string = cmd.get<std::string>("size");
+
+    std::array<int, 2> input_size = {DEFAULT_IMG_H, DEFAULT_IMG_W};
+
+    auto input_size_flag = utilities::parse_string(input_size_string, input_size);
+
+    if (!input_size_flag)
+    {
+        auto show_error = [](const std::string& kind, const std::string& value) {
+            fprintf(stderr, "Input %s(%s) is not allowed, please check it.\n", kind.c_str(), value.c_str());
+        };
+
+        show_error("size", input_size_string);
+
+        return -1;
+    }
+
+    auto repeat = cmd.get<int>("repeat");
+    auto contexts = cmd.get<int>("contexts");
+
+    // 1. print args
+    fprintf(stdout, "--------------------------------------\n");
+    fprintf(stdout, "model file : %s\n", model_file.c_str());
+    fprintf(stdout, "image file : %s\n", image_file.c_str());
+    fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
+    fprintf(stdout, "contexts : %d\n", contexts);
+    fprintf(stdout, "--------------------------------------\n");
+
+    // 2. read image, the letterbox runs per frame inside the pipeline
+    cv::Mat mat = cv::imread(image_file);
+    if (mat.empty())
+    {
+        fprintf(stderr, "Read image failed.\n");
+        return -1;
+    }
+
+    // 3. sys_init
+    AX_SYS_Init();
+
+    // 4. -  engine model  -  can only use AX_ENGINE** inside
+    {
+        ax::run_model(model_file, mat, repeat, contexts, input_size[0], input_size[1]);
+
+        // 4.3 engine de init
+        AX_ENGINE_Deinit();
+    }
+    // 4. -  engine model  -
+
+    AX_SYS_Deinit();
+    return 0;
+}
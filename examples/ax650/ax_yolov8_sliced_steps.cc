@@ -0,0 +1,302 @@
+/*
+* AXERA is pleased to support the open source community by making ax-samples available.
+*
+* Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+*
+* Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+* in compliance with the License. You may obtain a copy of the License at
+*
+* https://opensource.org/licenses/BSD-3-Clause
+*
+* Unless required by applicable law or agreed to in writing, software distributed
+* under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+* CONDITIONS OF ANY KIND, either express or implied. See the License for the
+* specific language governing permissions and limitations under the License.
+*/
+
+/*
+* Author:
+*/
+
+// sliced inference of high resolution images: the image is cut into overlapping model sized slices,
+// the slices go through the batcher (as many per RunSync as the model takes), every slice is decoded
+// with the usual yolov8 decoder and moved back into the image, one class aware nms merges them all.
+// the cost is reported per megapixel next to the plain letterbox of the whole frame.
+
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include "base/common.hpp"
+#include "base/detection.hpp"
+#include "base/slicing.hpp"
+#include "middleware/io.hpp"
+#include "middleware/batcher.hpp"
+
+#include "utilities/args.hpp"
+#include "utilities/cmdline.hpp"
+#include "utilities/file.hpp"
+#include "utilities/latency.hpp"
+#include "utilities/timer.hpp"
+
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+const int DEFAULT_IMG_H = 640;
+const int DEFAULT_IMG_W = 640;
+
+const char* CLASS_NAMES[] = {
+    "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
+    "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog", "horse", "sheep", "cow",
+    "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella", "handbag", "tie", "suitcase", "frisbee",
+    "skis", "snowboard", "sports ball", "kite", "baseball bat", "baseball glove", "skateboard", "surfboard",
+    "tennis racket", "bottle", "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple",
+    "sandwich", "orange", "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch",
+    "potted plant", "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone",
+    "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors", "teddy bear",
+    "hair drier", "toothbrush"};
+
+const int DEFAULT_LOOP_COUNT = 10;
+const int DEFAULT_WORKERS = 4;
+// the slices of a frame are submitted back to back, the wait only matters for the last batch
+const float DEFAULT_MAX_WAIT_MS = 2.f;
+
+const float PROB_THRESHOLD = 0.45f;
+const float NMS_THRESHOLD = 0.45f;
+
+namespace ax
+{
+    struct slice_options
+    {
+        int slice_h; // <= 0 takes the model input size
+        int slice_w;
+        float overlap;
+        bool full_frame; // the whole frame as one more slice, for objects larger than a slice
+        int max_batch;   // <= 0 takes the max batch of the model
+        int repeat;
+        int workers;
+    };
+
+    // one frame through the batcher, a slice per submit(). the candidates of every slice are decoded into
+    // a buffer of its own and appended in slice order, so the merge does not depend on the batch timing
+    static int detect_sliced(middleware::batcher& batcher, const cv::Mat& mat, const std::vector<cv::Rect>& slices, int input_h, int input_w,
+                             std::vector<detection::Proposals>& slice_proposals, detection::Proposals& proposals, std::vector<detection::Object>& objects)
+    {
+        slice_proposals.resize(slices.size());
+        std::vector<std::future<int> > pending;
+        for (size_t i = 0; i < slices.size(); ++i)
+        {
+            const cv::Mat crop = mat(slices[i]);
+            auto tile = &slice_proposals[i];
+            const cv::Rect slice = slices[i];
+            auto fill = [crop, input_h, input_w](uint8_t* input, size_t size) {
+                size_t stride = size / input_h;
+                if (stride < (size_t)input_w * 3)
+                {
+                    fprintf(stderr, "The input slice of %zu bytes can not hold a %dx%d image.\n", size, input_w, input_h);
+                    return -1;
+                }
+                common::get_input_data_letterbox(crop, input, input_h, input_w, false, stride);
+                return 0;
+            };
+            auto post = [tile, slice, input_h, input_w](AX_ENGINE_IO_INFO_T* info, const std::vector<void*>& outputs) {
+                tile->clear();
+                for (int j = 0; j < 3; ++j)
+                {
+                    int32_t feat_stride = (1 << j) * 8;
+                    detection::generate_proposals_yolov8_native(feat_stride, (float*)outputs[j], PROB_THRESHOLD, *tile, input_w, input_h,
+                                                                info->pOutputs[j].pShape[3] - 64);
+                }
+                detection::shift_slice_proposals(*tile, slice, input_h, input_w);
+                return 0;
+            };
+            pending.push_back(batcher.submit(fill, post));
+        }
+
+        int failed = 0;
+        for (auto& result : pending)
+        {
+            failed += 0 != result.get() ? 1 : 0;
+        }
+        if (failed > 0)
+        {
+            fprintf(stderr, "%d slices failed.\n", failed);
+            return -1;
+        }
+
+        proposals.clear();
+        for (const auto& tile : slice_proposals)
+        {
+            proposals.append(tile);
+        }
+        detection::merge_slice_proposals(proposals, objects, detection::NmsParam(NMS_THRESHOLD, true));
+        return 0;
+    }
+
+    bool run_model(const std::string& model, const cv::Mat& mat, const slice_options& options, int input_h, int input_w)
+    {
+        // 1. init engine
+        AX_ENGINE_NPU_ATTR_T npu_attr;
+        memset(&npu_attr, 0, sizeof(npu_attr));
+        npu_attr.eHardMode = AX_ENGINE_VIRTUAL_NPU_DISABLE;
+        auto ret = AX_ENGINE_Init(&npu_attr);
+        if (0 != ret)
+        {
+            return ret;
+        }
+
+        // 2. load model, a batch holds up to nMaxBatchSize slices
+        middleware::batcher batcher;
+        ret = batcher.load(model, options.max_batch, DEFAULT_MAX_WAIT_MS, options.workers);
+        if (0 != ret)
+        {
+            return ret;
+        }
+
+        // 3. cut the frame, model sized slices keep the pixels of small objects
+        const int slice_h = options.slice_h > 0 ? options.slice_h : input_h;
+        const int slice_w = options.slice_w > 0 ? options.slice_w : input_w;
+        std::vector<cv::Rect> slices, whole;
+        detection::slice_image(mat.rows, mat.cols, slice_h, slice_w, slices, options.overlap, options.full_frame);
+        whole.push_back(cv::Rect(0, 0, mat.cols, mat.rows));
+        fprintf(stdout, "--------------------------------------\n");
+        fprintf(stdout, "%zu slices of %dx%d (overlap %.2f%s), batches of up to %d\n", slices.size(), slice_h, slice_w, options.overlap,
+                options.full_frame ? ", with the full frame" : "", batcher.get_max_batch());
+
+        // 4. the sliced frames, then the whole frame letterboxed once for comparison
+        std::vector<detection::Proposals> slice_proposals;
+        detection::Proposals proposals;
+        std::vector<detection::Object> objects, whole_objects;
+        utilities::latency_stats sliced_stats, whole_stats;
+        for (int i = 0; i < options.repeat; ++i)
+        {
+            timer tick;
+            if (0 != detect_sliced(batcher, mat, slices, input_h, input_w, slice_proposals, proposals, objects))
+            {
+                return -1;
+            }
+            sliced_stats.add(tick.cost());
+        }
+        const size_t candidates = proposals.size();
+        for (int i = 0; i < options.repeat; ++i)
+        {
+            timer tick;
+            if (0 != detect_sliced(batcher, mat, whole, input_h, input_w, slice_proposals, proposals, whole_objects))
+            {
+                return -1;
+            }
+            whole_stats.add(tick.cost());
+        }
+        batcher.stop();
+
+        const float megapixels = (float)mat.rows * mat.cols / 1e6f;
+        fprintf(stdout, "--------------------------------------\n");
+        fprintf(stdout, "image %dx%d, %.2f MP\n", mat.cols, mat.rows, megapixels);
+        fprintf(stdout, "sliced      x%d: mean %.2f ms, min %.2f ms, %.2f ms/MP, %zu candidates, %zu objects\n", options.repeat, sliced_stats.mean(),
+                sliced_stats.min(), sliced_stats.mean() / megapixels, candidates, objects.size());
+        fprintf(stdout, "full frame  x%d: mean %.2f ms, min %.2f ms, %.2f ms/MP, %zu objects\n", options.repeat, whole_stats.mean(), whole_stats.min(),
+                whole_stats.mean() / megapixels, whole_objects.size());
+        fprintf(stdout, "slicing costs %.2fx the full frame\n", sliced_stats.mean() / std::max(whole_stats.mean(), 1e-3f));
+        fprintf(stdout, "--------------------------------------\n");
+
+        // 5. draw the sliced result
+        detection::draw_objects(mat, objects, CLASS_NAMES, "yolov8_sliced_out");
+        return 0;
+    }
+} // namespace ax
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<std::string>("model", 'm', "joint file(a.k.a. joint model), a dynamic batch size packs several slices per run", true, "");
+    cmd.add<std::string>("image", 'i', "image file", true, "");
+    cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
+
+    cmd.add<std::string>("slice", 's', "slice_h, slice_w in source pixels, the input size by default", false, "0,0");
+    cmd.add<float>("overlap", 'o', "overlap ratio of neighbouring slices", false, detection::SLICE_OVERLAP);
+    cmd.add("full", 'f', "add the whole frame as one more slice");
+    cmd.add<int>("batch", 'b', "max slices per run, 0 for the max batch of the model", false, 0);
+    cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
+    cmd.add<int>("workers", 't', "letterbox / post process threads", false, DEFAULT_WORKERS);
+    cmd.parse_check(argc, argv);
+    // 0. get app args, can be removed from user's app
+    auto model_file = cmd.get<std::string>("model");
+    auto image_file = cmd.get<std::string>("image");
+
+    auto model_file_flag = utilities::file_exist(model_file);
+    auto image_file_flag = utilities::file_exist(image_file);
+
+    if (!model_file_flag | !image_file_flag)
+    {
+        auto show_error = [](const std::string& kind, const std::string& value) {
+            fprintf(stderr, "Input file %s(%s) is not exist, please check it.\n", kind.c_str(), value.c_str());
+        };
+
+        if (!model_file_flag) { show_error("model", model_file); }
+        if (!image_file_flag) { show_error("image", image_file); }
+
+        return -1;
+    }
+
+    auto input_size_string = cmd.get<std::string>("size");
+    auto slice_size_string = cmd.get<std::string>("slice");
+
+    std::array<int, 2> input_size = {DEFAULT_IMG_H, DEFAULT_IMG_W};
+    std::array<int, 2> slice_size = {0, 0};
+
+    auto input_size_flag = utilities::parse_string(input_size_string, input_size);
+    auto slice_size_flag = utilities::parse_string(slice_size_string, slice_size);
+
+    if (!input_size_flag | !slice_size_flag)
+    {
+        auto show_error = [](const std::string& kind, const std::string& value) {
+            fprintf(stderr, "Input %s(%s) is not allowed, please check it.\n", kind.c_str(), value.c_str());
+        };
+
+        if (!input_size_flag) { show_error("size", input_size_string); }
+        if (!slice_size_flag) { show_error("slice", slice_size_string); }
+
+        return -1;
+    }
+
+    ax::slice_options options;
+    options.slice_h = slice_size[0];
+    options.slice_w = slice_size[1];
+    options.overlap = std::min(std::max(cmd.get<float>("overlap"), 0.f), 0.9f);
+    options.full_frame = cmd.exist("full");
+    options.max_batch = cmd.get<int>("batch");
+    options.repeat = std::max(cmd.get<int>("repeat"), 1);
+    options.workers = cmd.get<int>("workers");
+
+    // 1. print args
+    fprintf(stdout, "--------------------------------------\n");
+    fprintf(stdout, "model file : %s\n", model_file.c_str());
+    fprintf(stdout, "image file : %s\n", image_file.c_str());
+    fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
+    fprintf(stdout, "--------------------------------------\n");
+
+    // 2. read image, the slices are letterboxed straight into the batch inputs
+    cv::Mat mat = cv::imread(image_file);
+    if (mat.empty())
+    {
+        fprintf(stderr, "Read image failed.\n");
+        return -1;
+    }
+
+    // 3. sys_init
+    AX_SYS_Init();
+
+    // 4. -  engine model  -  can only use AX_ENGINE** inside
+    {
+        ax::run_model(model_file, mat, options, input_size[0], input_size[1]);
+
+        // 4.3 engine de init
+        AX_ENGINE_Deinit();
+    }
+    // 4. -  engine model  -
+
+    AX_SYS_Deinit();
+    return 0;
+}
@@ -25,12 +25,16 @@
 #include <opencv2/opencv.hpp>
 #include "base/common.hpp"
 #include "base/detection.hpp"
+#include "base/proposal_tiles.hpp"
 #include "middleware/io.hpp"
+#include "middleware/capture.hpp"
+#include "middleware/session.hpp"
 
 #include "utilities/args.hpp"
 #include "utilities/cmdline.hpp"
 #include "utilities/file.hpp"
 #include "utilities/timer.hpp"
+#include "utilities/trace.hpp"
 
 #include <ax_sys_api.h>
 #include <ax_engine_api.h>
@@ -59,15 +63,18 @@ namespace ax
 {
     void post_process(AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io_data, const cv::Mat& mat, int input_w, int input_h, const std::vector<float>& time_costs)
     {
-        std::vector<detection::Object> proposals;
+        detection::Proposals proposals;
         std::vector<detection::Object> objects;
         timer timer_postprocess;
-        for (int i = 0; i < 3; ++i)
-        {
+        AX_TRACE_SCOPE("post_process");
+        // the three heads in row tiles on all cores
+        const int head_rows[3] = {input_h / 8, input_h / 16, input_h / 32};
+        detection::ProposalTiles<detection::Proposals> tiles;
+        tiles.run(head_rows, 3, [&](int i, const detection::GridRows& rows, detection::Proposals& tile) {
             auto feat_ptr = (float*)io_data->pOutputs[i].pVirAddr;
             int32_t stride = (1 << i) * 8;
-            detection::generate_proposals_yolov8_native(stride, feat_ptr, PROB_THRESHOLD, proposals, input_w, input_h, NUM_CLASS);
-        }
+            detection::generate_proposals_yolov8_native(stride, feat_ptr, PROB_THRESHOLD, tile, input_w, input_h, NUM_CLASS, rows);
+        }, proposals);
 
         detection::get_out_bbox(proposals, objects, NMS_THRESHOLD, input_h, input_w, mat.rows, mat.cols);
         fprintf(stdout, "post process cost time:%.2f ms \n", timer_postprocess.cost());
@@ -86,7 +93,8 @@ namespace ax
         detection::draw_objects(mat, objects, CLASS_NAMES, "yolov8_out");
     }
 
-    bool run_model(const std::string& model, const std::vector<uint8_t>& data, const int& repeat, cv::Mat& mat, int input_h, int input_w)
+    bool run_model(const std::string& model, const int& repeat, cv::Mat& mat, int input_h, int input_w,
+                   const std::string& capture_file)
     {
         // 1. init engine
         AX_ENGINE_NPU_ATTR_T npu_attr;
@@ -98,65 +106,54 @@ namespace ax
             return ret;
         }
 
-        // 2. load model
-        std::vector<char> model_buffer;
-        if (!utilities::read_file(model, model_buffer))
+        // 2. load model, create handle, context and io
+        middleware::session session;
+        ret = session.load(model);
+        if (0 != ret)
         {
-            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", model.c_str());
-            return false;
+            return ret;
         }
 
-        // 3. create handle
-        AX_ENGINE_HANDLE handle;
-        ret = AX_ENGINE_CreateHandle(&handle, model_buffer.data(), model_buffer.size());
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating handle is done.\n");
-
-        // 4. create context
-        ret = AX_ENGINE_CreateContext(handle);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine creating context is done.\n");
-
-        // 5. set io
-        AX_ENGINE_IO_INFO_T* io_info;
-        ret = AX_ENGINE_GetIOInfo(handle, &io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine get io info is done. \n");
-
-        // 6. alloc io
-        AX_ENGINE_IO_T io_data;
-        ret = middleware::prepare_io(io_info, &io_data, std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED));
-        SAMPLE_AX_ENGINE_DEAL_HANDLE
-        fprintf(stdout, "Engine alloc io is done. \n");
-
-        // 7. insert input
-        ret = middleware::push_input(data, &io_data, io_info);
-        SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+        // 3. letterbox the image straight into the input tensor
+        size_t stride = session.input_stride(input_h, (size_t)input_w * 3);
+        if (0 == stride)
+        {
+            return -1;
+        }
+        common::get_input_data_letterbox(mat, session.get_input(), input_h, input_w, false, stride);
         fprintf(stdout, "Engine push input is done. \n");
         fprintf(stdout, "--------------------------------------\n");
 
-        // 8. warm up
-        for (int i = 0; i < 5; ++i)
-        {
-            AX_ENGINE_RunSync(handle, &io_data);
-        }
+        // 4. warm up
+        session.warm_up(5);
 
-        // 9. run model
+        // 5. run model
         std::vector<float> time_costs(repeat, 0);
         for (int i = 0; i < repeat; ++i)
         {
             timer tick;
-            ret = AX_ENGINE_RunSync(handle, &io_data);
+            ret = session.run();
             time_costs[i] = tick.cost();
-            SAMPLE_AX_ENGINE_DEAL_HANDLE_IO
+            if (0 != ret)
+            {
+                return ret;
+            }
         }
 
-        // 10. get result
-        post_process(io_info, &io_data, mat, input_w, input_h, time_costs);
+        // 6. get result, the outputs can be kept for replaying the post process on a host
+        if (!capture_file.empty())
+        {
+            std::map<std::string, std::string> attributes = {
+                {"src_rows", std::to_string(mat.rows)}, {"src_cols", std::to_string(mat.cols)}, {"post", "yolov8"}};
+            if (middleware::save_capture(capture_file, session.get_io_info(), session.get_io(), attributes))
+            {
+                fprintf(stdout, "outputs captured to %s\n", capture_file.c_str());
+            }
+        }
+        post_process(session.get_io_info(), session.get_io(), mat, input_w, input_h, time_costs);
         fprintf(stdout, "--------------------------------------\n");
 
-        middleware::free_io(&io_data);
-        return AX_ENGINE_DestroyHandle(handle);
+        return 0;
     }
 } // namespace ax
 
@@ -168,6 +165,8 @@ int main(int argc, char* argv[])
     cmd.add<std::string>("size", 'g', "input_h, input_w", false, std::to_string(DEFAULT_IMG_H) + "," + std::to_string(DEFAULT_IMG_W));
 
     cmd.add<int>("repeat", 'r', "repeat count", false, DEFAULT_LOOP_COUNT);
+    cmd.add<std::string>("trace", 't', "chrome trace json of the run, needs a build with AXERA_TRACE", false, "");
+    cmd.add<std::string>("capture", 0, "save the output tensors of the last run to this file, for ax_replay", false, "");
     cmd.parse_check(argc, argv);
 
     // 0. get app args, can be removed from user's app
@@ -207,6 +206,8 @@ int main(int argc, char* argv[])
     }
 
     auto repeat = cmd.get<int>("repeat");
+    auto trace_file = cmd.get<std::string>("trace");
+    auto capture_file = cmd.get<std::string>("capture");
 
     // 1. print args
     fprintf(stdout, "--------------------------------------\n");
@@ -215,15 +216,18 @@ int main(int argc, char* argv[])
     fprintf(stdout, "img_h, img_w : %d %d\n", input_size[0], input_size[1]);
     fprintf(stdout, "--------------------------------------\n");
 
-    // 2. read image & resize & transpose
-    std::vector<uint8_t> image(input_size[0] * input_size[1] * 3, 0);
-    cv::Mat mat = cv::imread(image_file);
+    // 2. read image
+    AX_TRACE_THREAD("main");
+    cv::Mat mat;
+    {
+        AX_TRACE_SCOPE("imread");
+        mat = cv::imread(image_file);
+    }
     if (mat.empty())
     {
         fprintf(stderr, "Read image failed.\n");
         return -1;
     }
-    common::get_input_data_letterbox(mat, image, input_size[0], input_size[1]);
 
     // 3. sys_init
     AX_SYS_Init();
@@ -231,7 +235,7 @@ int main(int argc, char* argv[])
     // 4. -  engine model  -  can only use AX_ENGINE** inside
     {
         // AX_ENGINE_NPUReset(); // todo ??
-        ax::run_model(model_file, image, repeat, mat, input_size[0], input_size[1]);
+        ax::run_model(model_file, repeat, mat, input_size[0], input_size[1], capture_file);
 
         // 4.3 engine de init
         AX_ENGINE_Deinit();
@@ -240,5 +244,15 @@ int main(int argc, char* argv[])
     // 4. -  engine model  -
 
     AX_SYS_Deinit();
+
+    if (!trace_file.empty())
+    {
+#ifdef AXERA_TRACE
+        AX_TRACE_WRITE(trace_file);
+        fprintf(stdout, "trace written to %s\n", trace_file.c_str());
+#else
+        fprintf(stderr, "Tracing is not built in, configure with -DAXERA_TRACE=ON.\n");
+#endif
+    }
     return 0;
 }
@@ -0,0 +1,577 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+#include "middleware/io.hpp"
+#include "utilities/model.hpp"
+#include "utilities/queue.hpp"
+
+namespace middleware
+{
+    struct batcher_report
+    {
+        int frames = 0;
+        int batches = 0;
+        int max_batch = 0;
+        float max_wait_ms = 0.f;
+        float total_ms = 0.f;
+        float fps = 0.f;
+        float batch_avg = 0.f;
+        std::vector<int> batch_sizes; // batch_sizes[n] is how many batches held n frames
+
+        // end to end, from submit() to the end of the post process of the frame
+        float latency_avg = 0.f;
+        float latency_p50 = 0.f;
+        float latency_p90 = 0.f;
+        float latency_p99 = 0.f;
+        float latency_max = 0.f;
+
+        float wait_avg = 0.f;  // submit() until the batch of the frame was flushed
+        float fill_avg = 0.f;  // filling all input slices of a batch
+        float infer_avg = 0.f; // one batched RunSync
+        float post_avg = 0.f;  // post process of one frame
+    };
+
+    // dynamic batcher for models compiled with a dynamic batch size (nMaxBatchSize > 1).
+    // any number of producers submit() frames. a scheduler thread flushes a batch as soon as
+    // max_batch frames are waiting or the oldest waiting frame is max_wait_ms old, the input
+    // slices of the batch are filled in parallel and the whole batch goes through one RunSync
+    // with io.nBatchSize set. the frames of a batch are post processed in parallel on the worker
+    // threads, each caller gets the return value of its own post through the future of submit().
+    //
+    //   producers --submit--> pending --flush--> fill slices (workers) --> npu --> post per frame (workers) --> futures
+    //
+    // every io set has its own context, the npu runs batch n + 1 while the frames of batch n are decoded.
+    class batcher
+    {
+    public:
+        // write one frame into `input`, its slice of the batched input tensor, return 0 on success
+        typedef std::function<int(uint8_t* input, size_t size)> fill_t;
+        // decode one frame, outputs[i] is its slice of output i, return 0 on success
+        typedef std::function<int(AX_ENGINE_IO_INFO_T* io_info, const std::vector<void*>& outputs)> post_t;
+
+        batcher() = default;
+
+        ~batcher()
+        {
+            release();
+        }
+
+        batcher(const batcher&) = delete;
+        batcher& operator=(const batcher&) = delete;
+
+        // max_batch <= 0 takes nMaxBatchSize of the model
+        int load(const std::string& model, int max_batch = 0, float max_wait_ms = 5.f, int workers = 4, int io_sets = 2,
+                 INPUT_OUTPUT_ALLOC_STRATEGY strategy = std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED))
+        {
+            release();
+
+            auto ret = utilities::load_model(model, [&](const void* data, size_t size) {
+                return AX_ENGINE_CreateHandle(&this->handle, data, size);
+            });
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine creating handle failed. 0x%x\n", ret);
+                this->handle = nullptr;
+                return ret;
+            }
+            fprintf(stdout, "Engine creating handle is done.\n");
+
+            ret = AX_ENGINE_GetIOInfo(this->handle, &this->io_info);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine get io info failed. 0x%x\n", ret);
+                release();
+                return ret;
+            }
+            if (this->io_info->nInputSize != 1)
+            {
+                fprintf(stderr, "Only support Input size == 1 current now\n");
+                release();
+                return -1;
+            }
+
+            int model_batch = std::max((int)this->io_info->nMaxBatchSize, 1);
+            this->max_batch = max_batch > 0 ? std::min(max_batch, model_batch) : model_batch;
+            this->max_wait = std::chrono::microseconds((int64_t)(std::max(max_wait_ms, 0.f) * 1000.f));
+            this->max_wait_ms = max_wait_ms;
+            if (this->io_info->bDynamicBatchSize != AX_TRUE && this->max_batch > 1)
+            {
+                fprintf(stdout, "The model has no dynamic batch size, batches are always padded to %d.\n", model_batch);
+            }
+
+            // tensors hold nMaxBatchSize frames back to back
+            this->input_slice = this->io_info->pInputs[0].nSize / model_batch;
+            this->output_slices.resize(this->io_info->nOutputSize);
+            for (size_t i = 0; i < this->output_slices.size(); ++i)
+            {
+                this->output_slices[i] = this->io_info->pOutputs[i].nSize / model_batch;
+            }
+
+            io_sets = std::max(io_sets, 1);
+            this->slots.resize(io_sets);
+            for (int i = 0; i < io_sets; ++i)
+            {
+                auto& slot = this->slots[i];
+                ret = AX_ENGINE_CreateContextV2(this->handle, &slot.context);
+                if (0 != ret)
+                {
+                    fprintf(stderr, "Engine creating context{%d} failed. 0x%x\n", i, ret);
+                    this->slots.resize(i);
+                    release();
+                    return ret;
+                }
+
+                ret = prepare_io(this->io_info, &slot.io, strategy, this->pool);
+                if (0 != ret)
+                {
+                    fprintf(stderr, "Engine alloc io of context{%d} failed. 0x%x\n", i, ret);
+                    this->slots.resize(i);
+                    release();
+                    return ret;
+                }
+            }
+            fprintf(stdout, "Engine batcher with max batch %d, %d io sets, %.2f ms max wait is ready.\n", this->max_batch, io_sets, max_wait_ms);
+
+            start(std::max(workers, 1));
+            return 0;
+        }
+
+        // queue one frame, blocks while too many frames are already waiting.
+        // the future carries the return value of fill, of the npu run or of post, the first that failed.
+        std::future<int> submit(fill_t fill, post_t post)
+        {
+            std::shared_ptr<request_t> request = std::make_shared<request_t>();
+            request->fill = std::move(fill);
+            request->post = std::move(post);
+            auto result = request->promise.get_future();
+
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->not_full.wait(lock, [this] { return !this->running || this->stopping || this->pending.size() < this->max_pending(); });
+            if (!this->running || this->stopping)
+            {
+                lock.unlock();
+                request->promise.set_value(-1);
+                return result;
+            }
+            request->submit = clock_type::now();
+            if (!this->stats.begin_set)
+            {
+                this->stats.begin = request->submit;
+                this->stats.begin_set = true;
+            }
+            this->pending.push_back(request);
+            lock.unlock();
+            this->not_empty.notify_one();
+            return result;
+        }
+
+        // flush what is still waiting, wait until every frame is post processed and stop the threads.
+        // submit() fails afterwards, the report covers every frame since load().
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (!this->running)
+                {
+                    return;
+                }
+                this->stopping = true;
+            }
+            this->not_empty.notify_all();
+            this->not_full.notify_all();
+
+            if (this->scheduler.joinable())
+            {
+                this->scheduler.join();
+            }
+            // every slot back in the free queue means every post has finished
+            std::vector<slot_t*> drained;
+            slot_t* slot = nullptr;
+            while (drained.size() < this->slots.size() && this->free_slots->pop(slot))
+            {
+                drained.push_back(slot);
+            }
+            this->jobs->close();
+            for (auto& worker : this->workers)
+            {
+                worker.join();
+            }
+            this->workers.clear();
+            make_report();
+            this->running = false;
+        }
+
+        const batcher_report& get_report() const
+        {
+            return this->report;
+        }
+
+        void print_report() const
+        {
+            auto& r = this->report;
+            fprintf(stdout, "--------------------------------------\n");
+            fprintf(stdout, "Batcher %d frames in %d batches (max batch %d, max wait %.2f ms), total %.2f ms, %.2f fps\n",
+                    r.frames, r.batches, r.max_batch, r.max_wait_ms, r.total_ms, r.fps);
+            fprintf(stdout, "batch size avg %.2f:", r.batch_avg);
+            for (size_t n = 1; n < r.batch_sizes.size(); ++n)
+            {
+                if (r.batch_sizes[n] > 0)
+                {
+                    fprintf(stdout, " %zux%d", n, r.batch_sizes[n]);
+                }
+            }
+            fprintf(stdout, "\n");
+            fprintf(stdout, "latency avg %.2f ms, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n", r.latency_avg, r.latency_p50, r.latency_p90, r.latency_p99, r.latency_max);
+            fprintf(stdout, "stage avg: wait %.2f ms, fill %.2f ms/batch, infer %.2f ms/batch, post %.2f ms/frame\n", r.wait_avg, r.fill_avg, r.infer_avg, r.post_avg);
+            fprintf(stdout, "--------------------------------------\n");
+        }
+
+        void release()
+        {
+            stop();
+
+            for (auto& slot : this->slots)
+            {
+                free_io(&slot.io, this->pool);
+            }
+            this->slots.clear();
+
+            // contexts created by CreateContextV2 belong to the handle
+            if (this->handle != nullptr)
+            {
+                AX_ENGINE_DestroyHandle(this->handle);
+                this->handle = nullptr;
+            }
+            this->io_info = nullptr;
+        }
+
+        // where load() takes the io buffers from, call it before load(). nullptr, the default, allocates
+        // them from the cmm heap directly. the pool must outlive this object.
+        void set_pool(cmm_pool* pool)
+        {
+            this->pool = pool;
+        }
+
+        AX_ENGINE_IO_INFO_T* get_io_info() const
+        {
+            return this->io_info;
+        }
+
+        int get_max_batch() const
+        {
+            return this->max_batch;
+        }
+
+    private:
+        typedef std::chrono::steady_clock clock_type;
+
+        struct request_t
+        {
+            fill_t fill;
+            post_t post;
+            std::promise<int> promise;
+            clock_type::time_point submit;
+            int ret = 0;
+        };
+
+        struct slot_t
+        {
+            AX_ENGINE_CONTEXT_T context = nullptr;
+            AX_ENGINE_IO_T io = {};
+            std::vector<std::shared_ptr<request_t> > batch;
+            std::atomic<int> unfinished{0};
+        };
+
+        // frame costs, guarded by stats_mutex
+        struct stats_t
+        {
+            clock_type::time_point begin;
+            bool begin_set = false;
+            std::vector<float> latency, wait, post;
+            std::vector<float> fill, infer;
+            std::vector<int> batch_sizes;
+        };
+
+        // counts down finished jobs of one batch, wait() returns once all of them are done
+        class job_latch
+        {
+        public:
+            explicit job_latch(int count)
+                : count(count)
+            {
+            }
+
+            void count_down()
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (--this->count == 0)
+                {
+                    this->cond.notify_all();
+                }
+            }
+
+            void wait()
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->cond.wait(lock, [this] { return this->count <= 0; });
+            }
+
+        private:
+            int count;
+            std::mutex mutex;
+            std::condition_variable cond;
+        };
+
+        static float elapsed_ms(const clock_type::time_point& since, const clock_type::time_point& until = clock_type::now())
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(until - since).count() / 1000.f;
+        }
+
+        static float average(const std::vector<float>& costs)
+        {
+            return costs.empty() ? 0.f : std::accumulate(costs.begin(), costs.end(), 0.f) / (float)costs.size();
+        }
+
+        static float percentile(const std::vector<float>& sorted, float p)
+        {
+            if (sorted.empty())
+            {
+                return 0.f;
+            }
+            auto index = (size_t)(p * (float)(sorted.size() - 1) + 0.5f);
+            return sorted[std::min(index, sorted.size() - 1)];
+        }
+
+        // enough waiting frames for every io set plus the one being collected
+        size_t max_pending() const
+        {
+            return (size_t)this->max_batch * (this->slots.size() + 1);
+        }
+
+        void start(int worker_count)
+        {
+            this->stopping = false;
+            this->running = true;
+            this->stats = stats_t();
+            this->stats.batch_sizes.resize(this->max_batch + 1, 0);
+
+            this->free_slots.reset(new utilities::bounded_queue<slot_t*>(this->slots.size()));
+            for (auto& slot : this->slots)
+            {
+                this->free_slots->push(&slot);
+            }
+            // fill and post jobs of every io set fit in at once, so the scheduler never blocks on a push
+            this->jobs.reset(new utilities::bounded_queue<std::function<void()> >((size_t)this->max_batch * (this->slots.size() + 1)));
+            for (int i = 0; i < worker_count; ++i)
+            {
+                this->workers.emplace_back([this]() {
+                    std::function<void()> job;
+                    while (this->jobs->pop(job))
+                    {
+                        job();
+                    }
+                });
+            }
+            this->scheduler = std::thread([this]() { schedule(); });
+        }
+
+        // take up to max_batch frames, waits for the first one and then until the batch is full or
+        // the first frame has waited max_wait. returns false once stopped and drained.
+        bool collect(std::vector<std::shared_ptr<request_t> >& batch)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->not_empty.wait(lock, [this] { return this->stopping || !this->pending.empty(); });
+            if (this->pending.empty())
+            {
+                return false;
+            }
+
+            auto deadline = this->pending.front()->submit + this->max_wait;
+            this->not_empty.wait_until(lock, deadline, [this] { return this->stopping || (int)this->pending.size() >= this->max_batch; });
+
+            int count = std::min((int)this->pending.size(), this->max_batch);
+            batch.assign(this->pending.begin(), this->pending.begin() + count);
+            this->pending.erase(this->pending.begin(), this->pending.begin() + count);
+            lock.unlock();
+            this->not_full.notify_all();
+            return true;
+        }
+
+        void schedule()
+        {
+            std::vector<std::shared_ptr<request_t> > batch;
+            while (collect(batch))
+            {
+                auto flush = clock_type::now();
+
+                slot_t* slot = nullptr;
+                this->free_slots->pop(slot);
+                slot->batch.swap(batch);
+                batch.clear();
+                const int count = (int)slot->batch.size();
+
+                // 1. every frame writes its own input slice
+                auto fill_start = clock_type::now();
+                auto input = (uint8_t*)slot->io.pInputs[0].pVirAddr;
+                job_latch filled(count);
+                for (int b = 0; b < count; ++b)
+                {
+                    request_t* request = slot->batch[b].get();
+                    uint8_t* dst = input + (size_t)b * this->input_slice;
+                    this->jobs->push([this, request, dst, &filled]() {
+                        request->ret = request->fill(dst, this->input_slice);
+                        filled.count_down();
+                    });
+                }
+                filled.wait();
+                float fill_ms = elapsed_ms(fill_start);
+
+                // 2. one npu run for the whole batch
+                auto infer_start = clock_type::now();
+                slot->io.nBatchSize = this->io_info->bDynamicBatchSize == AX_TRUE ? count : this->io_info->nMaxBatchSize;
+                auto ret = AX_ENGINE_RunSyncV2(this->handle, slot->context, &slot->io);
+                float infer_ms = elapsed_ms(infer_start);
+
+                {
+                    std::lock_guard<std::mutex> lock(this->stats_mutex);
+                    for (auto& request : slot->batch)
+                    {
+                        this->stats.wait.push_back(elapsed_ms(request->submit, flush));
+                    }
+                    this->stats.fill.push_back(fill_ms);
+                    this->stats.infer.push_back(infer_ms);
+                    this->stats.batch_sizes[count]++;
+                }
+
+                // 3. scatter, every frame decodes its own output slices
+                slot->unfinished = count;
+                for (int b = 0; b < count; ++b)
+                {
+                    this->jobs->push([this, slot, b, ret]() { finish(slot, b, ret); });
+                }
+            }
+        }
+
+        void finish(slot_t* slot, int b, int infer_ret)
+        {
+            request_t* request = slot->batch[b].get();
+            auto start = clock_type::now();
+            int ret = request->ret != 0 ? request->ret : infer_ret;
+            if (0 == ret)
+            {
+                std::vector<void*> outputs(this->output_slices.size());
+                for (size_t i = 0; i < outputs.size(); ++i)
+                {
+                    outputs[i] = (uint8_t*)slot->io.pOutputs[i].pVirAddr + (size_t)b * this->output_slices[i];
+                }
+                ret = request->post(this->io_info, outputs);
+            }
+            auto end = clock_type::now();
+
+            {
+                std::lock_guard<std::mutex> lock(this->stats_mutex);
+                this->stats.post.push_back(elapsed_ms(start, end));
+                this->stats.latency.push_back(elapsed_ms(request->submit, end));
+            }
+            request->promise.set_value(ret);
+
+            // the last frame of the batch hands the io set back
+            if (--slot->unfinished == 0)
+            {
+                slot->batch.clear();
+                this->free_slots->push(slot);
+            }
+        }
+
+        void make_report()
+        {
+            std::lock_guard<std::mutex> lock(this->stats_mutex);
+            auto& s = this->stats;
+            auto& r = this->report;
+            r = batcher_report();
+            r.frames = (int)s.latency.size();
+            r.batches = (int)s.infer.size();
+            r.max_batch = this->max_batch;
+            r.max_wait_ms = this->max_wait_ms;
+            r.total_ms = s.begin_set ? elapsed_ms(s.begin) : 0.f;
+            r.fps = r.total_ms > 0.f ? (float)r.frames * 1000.f / r.total_ms : 0.f;
+            r.batch_avg = r.batches > 0 ? (float)r.frames / (float)r.batches : 0.f;
+            r.batch_sizes = s.batch_sizes;
+
+            std::sort(s.latency.begin(), s.latency.end());
+            r.latency_avg = average(s.latency);
+            r.latency_p50 = percentile(s.latency, 0.50f);
+            r.latency_p90 = percentile(s.latency, 0.90f);
+            r.latency_p99 = percentile(s.latency, 0.99f);
+            r.latency_max = s.latency.empty() ? 0.f : s.latency.back();
+
+            r.wait_avg = average(s.wait);
+            r.fill_avg = average(s.fill);
+            r.infer_avg = average(s.infer);
+            r.post_avg = average(s.post);
+        }
+
+        AX_ENGINE_HANDLE handle = nullptr;
+        AX_ENGINE_IO_INFO_T* io_info = nullptr;
+        cmm_pool* pool = nullptr;
+        std::deque<slot_t> slots;
+        size_t input_slice = 0;
+        std::vector<size_t> output_slices;
+
+        int max_batch = 1;
+        float max_wait_ms = 0.f;
+        clock_type::duration max_wait{0};
+
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::deque<std::shared_ptr<request_t> > pending;
+        bool stopping = false;
+        bool running = false;
+
+        std::unique_ptr<utilities::bounded_queue<slot_t*> > free_slots;
+        std::unique_ptr<utilities::bounded_queue<std::function<void()> > > jobs;
+        std::vector<std::thread> workers;
+        std::thread scheduler;
+
+        std::mutex stats_mutex;
+        stats_t stats;
+        batcher_report report;
+    };
+} // namespace middleware
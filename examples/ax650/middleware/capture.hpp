@@ -0,0 +1,202 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ax_engine_api.h>
+
+#include "utilities/capture.hpp"
+
+namespace middleware
+{
+    static inline utilities::CapturedTensor capture_tensor(const AX_ENGINE_IOMETA_T& meta, const AX_ENGINE_IO_BUFFER_T* buffer)
+    {
+        utilities::CapturedTensor tensor;
+        tensor.name = meta.pName != nullptr ? meta.pName : "";
+        tensor.shape.assign(meta.pShape, meta.pShape + meta.nShapeSize);
+        tensor.data_type = (uint32_t)meta.eDataType;
+        tensor.quantization = meta.nQuantizationValue;
+        tensor.size = meta.nSize;
+        if (buffer != nullptr && buffer->pVirAddr != nullptr)
+        {
+            const uint8_t* data = (const uint8_t*)buffer->pVirAddr;
+            tensor.data.assign(data, data + meta.nSize);
+        }
+        return tensor;
+    }
+
+    // the io of a run: the metadata of every tensor, the data of the outputs and, with `with_inputs`,
+    // of the inputs too. call it right after run(), before the buffers are written again.
+    static inline void capture_io(const AX_ENGINE_IO_INFO_T* io_info, const AX_ENGINE_IO_T* io_data, utilities::tensor_capture& capture,
+                                  bool with_inputs = false)
+    {
+        capture.inputs.clear();
+        capture.outputs.clear();
+        for (AX_U32 i = 0; i < io_info->nInputSize; ++i)
+        {
+            capture.inputs.push_back(capture_tensor(io_info->pInputs[i], with_inputs ? &io_data->pInputs[i] : nullptr));
+        }
+        for (AX_U32 i = 0; i < io_info->nOutputSize; ++i)
+        {
+            capture.outputs.push_back(capture_tensor(io_info->pOutputs[i], &io_data->pOutputs[i]));
+        }
+    }
+
+    // capture_io() into a file, `attributes` go along, e.g. src_rows / src_cols of the frame
+    static inline bool save_capture(const std::string& path, const AX_ENGINE_IO_INFO_T* io_info, const AX_ENGINE_IO_T* io_data,
+                                    const std::map<std::string, std::string>& attributes = std::map<std::string, std::string>(),
+                                    bool with_inputs = false)
+    {
+        utilities::tensor_capture capture;
+        capture.attributes = attributes;
+        capture_io(io_info, io_data, capture, with_inputs);
+        return capture.save(path);
+    }
+
+    // a capture seen like a session that has just run: get_io_info() / get_io() point at the captured
+    // tensors, so a post process written against the engine io runs on it unchanged, without an npu.
+    // tensors captured without data are zero filled.
+    class replay_io
+    {
+    public:
+        replay_io() = default;
+        replay_io(const replay_io&) = delete;
+        replay_io& operator=(const replay_io&) = delete;
+
+        bool load(const std::string& path)
+        {
+            utilities::tensor_capture loaded;
+            if (!loaded.load(path))
+            {
+                return false;
+            }
+            return load(std::move(loaded));
+        }
+
+        bool load(utilities::tensor_capture capture)
+        {
+            this->capture = std::move(capture);
+            this->shapes.clear();
+            this->input_meta.clear();
+            this->output_meta.clear();
+            this->input_buffers.clear();
+            this->output_buffers.clear();
+
+            for (auto& tensor : this->capture.inputs)
+            {
+                if (!add(tensor, this->input_meta, this->input_buffers))
+                {
+                    return false;
+                }
+            }
+            for (auto& tensor : this->capture.outputs)
+            {
+                if (!add(tensor, this->output_meta, this->output_buffers))
+                {
+                    return false;
+                }
+            }
+
+            this->io_info = AX_ENGINE_IO_INFO_T();
+            this->io_info.pInputs = this->input_meta.data();
+            this->io_info.nInputSize = (AX_U32)this->input_meta.size();
+            this->io_info.pOutputs = this->output_meta.data();
+            this->io_info.nOutputSize = (AX_U32)this->output_meta.size();
+            this->io_info.nMaxBatchSize = 1;
+
+            this->io_data = AX_ENGINE_IO_T();
+            this->io_data.pInputs = this->input_buffers.data();
+            this->io_data.nInputSize = (AX_U32)this->input_buffers.size();
+            this->io_data.pOutputs = this->output_buffers.data();
+            this->io_data.nOutputSize = (AX_U32)this->output_buffers.size();
+            this->io_data.nBatchSize = 1;
+            return true;
+        }
+
+        AX_ENGINE_IO_INFO_T* get_io_info()
+        {
+            return &this->io_info;
+        }
+
+        AX_ENGINE_IO_T* get_io()
+        {
+            return &this->io_data;
+        }
+
+        void* get_output(int index = 0)
+        {
+            return this->io_data.pOutputs[index].pVirAddr;
+        }
+
+        const utilities::tensor_capture& get_capture() const
+        {
+            return this->capture;
+        }
+
+    private:
+        // the post process reads floats straight from pVirAddr, the tensor data is padded to their size
+        bool add(utilities::CapturedTensor& tensor, std::vector<AX_ENGINE_IOMETA_T>& metas, std::vector<AX_ENGINE_IO_BUFFER_T>& buffers)
+        {
+            if (!tensor.data.empty() && tensor.data.size() != tensor.size)
+            {
+                fprintf(stderr, "Captured tensor %s has %zu bytes, %u expected.\n", tensor.name.c_str(), tensor.data.size(), tensor.size);
+                return false;
+            }
+            tensor.data.resize(tensor.size, 0);
+            this->shapes.push_back(std::vector<AX_S32>(tensor.shape.begin(), tensor.shape.end()));
+
+            AX_ENGINE_IOMETA_T meta;
+            memset(&meta, 0, sizeof(meta));
+            meta.pName = (AX_CHAR*)tensor.name.c_str();
+            meta.pShape = this->shapes.back().data();
+            meta.nShapeSize = (AX_U8)tensor.shape.size();
+            meta.eMemoryType = AX_ENGINE_MT_PHYSICAL;
+            meta.eDataType = (AX_ENGINE_DATA_TYPE_T)tensor.data_type;
+            meta.nSize = tensor.size;
+            meta.nQuantizationValue = tensor.quantization;
+            metas.push_back(meta);
+
+            AX_ENGINE_IO_BUFFER_T buffer;
+            memset(&buffer, 0, sizeof(buffer));
+            buffer.phyAddr = (AX_U64)(uintptr_t)tensor.data.data();
+            buffer.pVirAddr = tensor.data.data();
+            buffer.nSize = tensor.size;
+            buffers.push_back(buffer);
+            return true;
+        }
+
+        utilities::tensor_capture capture;
+        std::deque<std::vector<AX_S32> > shapes; // pShape of the metas, a deque keeps them in place
+        std::vector<AX_ENGINE_IOMETA_T> input_meta;
+        std::vector<AX_ENGINE_IOMETA_T> output_meta;
+        std::vector<AX_ENGINE_IO_BUFFER_T> input_buffers;
+        std::vector<AX_ENGINE_IO_BUFFER_T> output_buffers;
+        AX_ENGINE_IO_INFO_T io_info = {};
+        AX_ENGINE_IO_T io_data = {};
+    };
+} // namespace middleware
@@ -0,0 +1,294 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <ax_sys_api.h>
+
+namespace middleware
+{
+    // where the pool gets its memory from, the cmm of AX_SYS by default
+    typedef struct
+    {
+        int (*alloc)(AX_U64* phy, void** vir, AX_U32 size, AX_U32 align, bool cached, const char* token);
+        int (*free)(AX_U64 phy, void* vir);
+    } cmm_backend;
+
+    static inline int cmm_sys_alloc(AX_U64* phy, void** vir, AX_U32 size, AX_U32 align, bool cached, const char* token)
+    {
+        if (cached)
+        {
+            return AX_SYS_MemAllocCached(phy, vir, size, align, (const AX_S8*)token);
+        }
+        return AX_SYS_MemAlloc(phy, vir, size, align, (const AX_S8*)token);
+    }
+
+    static inline int cmm_sys_free(AX_U64 phy, void* vir)
+    {
+        return AX_SYS_MemFree(phy, vir);
+    }
+
+    // plain host memory, the physical address is the virtual one. for testing and benchmarking the
+    // pool without a board.
+    static inline int cmm_host_alloc(AX_U64* phy, void** vir, AX_U32 size, AX_U32 align, bool cached, const char* token)
+    {
+        (void)cached;
+        (void)token;
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, std::max<size_t>(align, sizeof(void*)), size) != 0)
+        {
+            return -1;
+        }
+        *vir = ptr;
+        *phy = (AX_U64)(uintptr_t)ptr;
+        return 0;
+    }
+
+    static inline int cmm_host_free(AX_U64 phy, void* vir)
+    {
+        (void)phy;
+        free(vir);
+        return 0;
+    }
+
+    static inline cmm_backend cmm_sys_backend()
+    {
+        return cmm_backend{cmm_sys_alloc, cmm_sys_free};
+    }
+
+    static inline cmm_backend cmm_host_backend()
+    {
+        return cmm_backend{cmm_host_alloc, cmm_host_free};
+    }
+
+    typedef struct
+    {
+        size_t leases;      // lease() calls
+        size_t hits;        // leases served by an idle block
+        size_t allocs;      // blocks allocated from the backend
+        size_t frees;       // blocks given back to the backend
+        size_t in_use;      // bytes leased right now, rounded to the size classes
+        size_t idle;        // bytes kept for reuse
+        size_t high_water;  // max of in_use + idle, the cmm the pool ever held at once
+        size_t peak_in_use; // max of in_use
+    } cmm_pool_stats;
+
+    // keeps the cmm blocks of torn down io buffers and hands them out again, so reloading a model or
+    // adding contexts does not go back to the cmm heap for every tensor. requests are rounded up to
+    // size classes, 128 byte steps up to 4 KB and then 4 classes per power of two (at most 25% slack),
+    // cached and non cached blocks are pooled apart. thread safe. the destructor gives the idle blocks
+    // back, so a pool must go away before AX_SYS_Deinit, never as a static.
+    class cmm_pool
+    {
+    public:
+        static const AX_U32 ALIGN = 128;
+
+        explicit cmm_pool(cmm_backend backend = cmm_sys_backend(), const char* token = "ax-samples-cmm")
+            : backend(backend), token(token)
+        {
+        }
+
+        ~cmm_pool()
+        {
+            trim();
+        }
+
+        cmm_pool(const cmm_pool&) = delete;
+        cmm_pool& operator=(const cmm_pool&) = delete;
+
+        static size_t size_class(size_t size)
+        {
+            size = (size + ALIGN - 1) / ALIGN * ALIGN;
+            if (size <= 4096)
+            {
+                return std::max(size, (size_t)ALIGN);
+            }
+            size_t top = 4096;
+            while (top * 2 < size)
+            {
+                top *= 2;
+            }
+            // size is in (top, 2 * top], split that range in 4
+            const size_t step = top / 4;
+            return (size + step - 1) / step * step;
+        }
+
+        int lease(AX_U32 size, bool cached, AX_U64* phy, void** vir)
+        {
+            const size_t bytes = size_class(size);
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->counters.leases++;
+
+            auto& idle_blocks = this->idle_lists[cached ? 1 : 0][bytes];
+            block_t block;
+            if (!idle_blocks.empty())
+            {
+                block = idle_blocks.back();
+                idle_blocks.pop_back();
+                this->counters.hits++;
+                this->counters.idle -= bytes;
+            }
+            else
+            {
+                block.size = bytes;
+                block.cached = cached;
+                auto ret = this->backend.alloc(&block.phy, &block.vir, (AX_U32)bytes, ALIGN, cached, this->token);
+                if (ret != 0)
+                {
+                    // the idle blocks of other classes may be what is missing
+                    trim_locked();
+                    ret = this->backend.alloc(&block.phy, &block.vir, (AX_U32)bytes, ALIGN, cached, this->token);
+                }
+                if (ret != 0)
+                {
+                    fprintf(stderr, "cmm pool alloc %zu bytes failed. 0x%x\n", bytes, ret);
+                    return ret;
+                }
+                this->counters.allocs++;
+            }
+
+            this->leased[block.vir] = block;
+            this->counters.in_use += bytes;
+            this->counters.peak_in_use = std::max(this->counters.peak_in_use, this->counters.in_use);
+            this->counters.high_water = std::max(this->counters.high_water, this->counters.in_use + this->counters.idle);
+            *phy = block.phy;
+            *vir = block.vir;
+            return 0;
+        }
+
+        // back to the idle list, or to the backend when that would exceed max_idle_bytes
+        int give_back(AX_U64 phy, void* vir)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->leased.find(vir);
+            if (it == this->leased.end() || it->second.phy != phy)
+            {
+                fprintf(stderr, "cmm pool does not own buffer %p.\n", vir);
+                return -1;
+            }
+            block_t block = it->second;
+            this->leased.erase(it);
+            this->counters.in_use -= block.size;
+
+            if (this->counters.idle + block.size > this->max_idle)
+            {
+                this->counters.frees++;
+                return this->backend.free(block.phy, block.vir);
+            }
+            this->idle_lists[block.cached ? 1 : 0][block.size].push_back(block);
+            this->counters.idle += block.size;
+            return 0;
+        }
+
+        // cap on the idle bytes the pool keeps, 0 turns the reuse off
+        void set_max_idle_bytes(size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->max_idle = bytes;
+            while (this->counters.idle > this->max_idle && release_one_idle())
+            {
+            }
+        }
+
+        // give every idle block back to the backend
+        void trim()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            trim_locked();
+        }
+
+        cmm_pool_stats stats() const
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->counters;
+        }
+
+        void print_stats() const
+        {
+            auto s = stats();
+            fprintf(stdout, "cmm pool: %zu leases, %zu hits, %zu allocs, %zu frees, in use %.2f MB, idle %.2f MB, high water %.2f MB\n",
+                    s.leases, s.hits, s.allocs, s.frees, s.in_use / 1048576.0, s.idle / 1048576.0, s.high_water / 1048576.0);
+        }
+
+    private:
+        typedef struct
+        {
+            AX_U64 phy;
+            void* vir;
+            size_t size;
+            bool cached;
+        } block_t;
+
+        // frees one block of the largest class
+        bool release_one_idle()
+        {
+            for (int kind = 0; kind < 2; ++kind)
+            {
+                for (auto it = this->idle_lists[kind].rbegin(); it != this->idle_lists[kind].rend(); ++it)
+                {
+                    if (!it->second.empty())
+                    {
+                        block_t block = it->second.back();
+                        it->second.pop_back();
+                        this->backend.free(block.phy, block.vir);
+                        this->counters.idle -= block.size;
+                        this->counters.frees++;
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void trim_locked()
+        {
+            for (auto& lists : this->idle_lists)
+            {
+                for (auto& list : lists)
+                {
+                    for (auto& block : list.second)
+                    {
+                        this->backend.free(block.phy, block.vir);
+                        this->counters.frees++;
+                    }
+                }
+                lists.clear();
+            }
+            this->counters.idle = 0;
+        }
+
+        cmm_backend backend;
+        const char* token;
+        mutable std::mutex mutex;
+        std::map<size_t, std::vector<block_t> > idle_lists[2]; // [non cached, cached] by size class
+        std::unordered_map<void*, block_t> leased;
+        cmm_pool_stats counters = {};
+        size_t max_idle = SIZE_MAX;
+    };
+} // namespace middleware
@@ -28,6 +28,8 @@
 #include <ax_sys_api.h>
 #include <ax_engine_api.h>
 
+#include "middleware/cmm_pool.hpp"
+
 #define AX_CMM_ALIGN_SIZE 128
 
 const char* AX_CMM_SESSION_NAME = "ax-samples-cmm";
@@ -56,32 +58,56 @@ typedef std::pair<AX_ENGINE_ALLOC_BUFFER_STRATEGY_T, AX_ENGINE_ALLOC_BUFFER_STRA
 namespace middleware
 {
 
-    void free_io_index(AX_ENGINE_IO_BUFFER_T* io_buf, size_t index)
+    // buffers of prepare_io go back to `pool` when one was used, to the cmm heap otherwise
+    static inline void free_io_buffer(AX_ENGINE_IO_BUFFER_T* buffer, cmm_pool* pool)
+    {
+        if (pool != nullptr)
+        {
+            pool->give_back(buffer->phyAddr, buffer->pVirAddr);
+        }
+        else
+        {
+            AX_SYS_MemFree(buffer->phyAddr, buffer->pVirAddr);
+        }
+    }
+
+    void free_io_index(AX_ENGINE_IO_BUFFER_T* io_buf, size_t index, cmm_pool* pool = nullptr)
     {
         for (int i = 0; i < (int)index; ++i)
         {
-            AX_ENGINE_IO_BUFFER_T* pBuf = io_buf + i;
-            AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+            free_io_buffer(io_buf + i, pool);
         }
     }
 
-    void free_io(AX_ENGINE_IO_T* io)
+    void free_io(AX_ENGINE_IO_T* io, cmm_pool* pool = nullptr)
     {
         for (size_t j = 0; j < io->nInputSize; ++j)
         {
-            AX_ENGINE_IO_BUFFER_T* pBuf = io->pInputs + j;
-            AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+            free_io_buffer(io->pInputs + j, pool);
         }
         for (size_t j = 0; j < io->nOutputSize; ++j)
         {
-            AX_ENGINE_IO_BUFFER_T* pBuf = io->pOutputs + j;
-            AX_SYS_MemFree(pBuf->phyAddr, pBuf->pVirAddr);
+            free_io_buffer(io->pOutputs + j, pool);
         }
         delete[] io->pInputs;
         delete[] io->pOutputs;
     }
 
-    static inline int prepare_io(AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io_data, INPUT_OUTPUT_ALLOC_STRATEGY strategy)
+    static inline int alloc_io_buffer(AX_ENGINE_IO_BUFFER_T* buffer, AX_U32 size, AX_ENGINE_ALLOC_BUFFER_STRATEGY_T strategy, cmm_pool* pool)
+    {
+        if (pool != nullptr)
+        {
+            return pool->lease(size, strategy == AX_ENGINE_ABST_CACHED, (AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr);
+        }
+        if (strategy == AX_ENGINE_ABST_CACHED)
+        {
+            return AX_SYS_MemAllocCached((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, size, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
+        }
+        return AX_SYS_MemAlloc((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, size, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
+    }
+
+    // `pool`: lease the buffers from a cmm_pool instead of allocating them, free_io needs the same pool
+    static inline int prepare_io(AX_ENGINE_IO_INFO_T* info, AX_ENGINE_IO_T* io_data, INPUT_OUTPUT_ALLOC_STRATEGY strategy, cmm_pool* pool = nullptr)
     {
         memset(io_data, 0, sizeof(*io_data));
         io_data->pInputs = new AX_ENGINE_IO_BUFFER_T[info->nInputSize];
@@ -93,18 +119,10 @@ namespace middleware
         {
             auto meta = info->pInputs[i];
             auto buffer = &io_data->pInputs[i];
-            if (strategy.first == AX_ENGINE_ABST_CACHED)
-            {
-                ret = AX_SYS_MemAllocCached((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
-            }
-            else
-            {
-                ret = AX_SYS_MemAlloc((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
-            }
-
+            ret = alloc_io_buffer(buffer, meta.nSize, strategy.first, pool);
             if (ret != 0)
             {
-                free_io_index(io_data->pInputs, i);
+                free_io_index(io_data->pInputs, i, pool);
                 fprintf(stderr, "Allocate input{%d} { phy: %p, vir: %p, size: %lu Bytes }. fail \n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
                 return ret;
             }
@@ -119,19 +137,12 @@ namespace middleware
             auto meta = info->pOutputs[i];
             auto buffer = &io_data->pOutputs[i];
             buffer->nSize = meta.nSize;
-            if (strategy.second == AX_ENGINE_ABST_CACHED)
-            {
-                ret = AX_SYS_MemAllocCached((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
-            }
-            else
-            {
-                ret = AX_SYS_MemAlloc((AX_U64*)(&buffer->phyAddr), &buffer->pVirAddr, meta.nSize, AX_CMM_ALIGN_SIZE, (const AX_S8*)(AX_CMM_SESSION_NAME));
-            }
+            ret = alloc_io_buffer(buffer, meta.nSize, strategy.second, pool);
             if (ret != 0)
             {
                 fprintf(stderr, "Allocate output{%d} { phy: %p, vir: %p, size: %lu Bytes }. fail \n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
-                free_io_index(io_data->pInputs, io_data->nInputSize);
-                free_io_index(io_data->pOutputs, i);
+                free_io_index(io_data->pInputs, io_data->nInputSize, pool);
+                free_io_index(io_data->pOutputs, i, pool);
                 return ret;
             }
             // fprintf(stderr, "Allocate output{%d} { phy: %p, vir: %p, size: %lu Bytes }.\n", i, (void*)buffer->phyAddr, buffer->pVirAddr, (long)meta.nSize);
@@ -159,6 +170,16 @@ namespace middleware
         return 0;
     }
 
+    // row pitch in bytes of an nhwc image input, 0 if the tensor does not look like one
+    static inline size_t input_row_stride(const AX_ENGINE_IOMETA_T& meta)
+    {
+        if (meta.nShapeSize != 4 || meta.pShape[0] <= 0 || meta.pShape[1] <= 0)
+        {
+            return 0;
+        }
+        return meta.nSize / ((size_t)meta.pShape[0] * meta.pShape[1]);
+    }
+
     static void print_io_info(AX_ENGINE_IO_INFO_T* io_info)
     {
         static std::map<AX_ENGINE_DATA_TYPE_T, const char*> data_type = {
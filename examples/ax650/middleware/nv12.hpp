@@ -0,0 +1,132 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+#include "base/nv12.hpp"
+
+namespace middleware
+{
+    // an nv12 image in cmm, the y plane and the interleaved uv plane share one stride.
+    // only a view, the memory belongs to whoever produced the frame.
+    typedef struct
+    {
+        AX_U64 phy[2];
+        uint8_t* vir[2];
+        int width;
+        int height;
+        int stride;
+    } nv12_image;
+
+    // view of a vin / vdec / ivps output frame, false when it is not nv12
+    static inline bool nv12_from_frame(const AX_VIDEO_FRAME_T& frame, nv12_image& image)
+    {
+        if (frame.enImgFormat != AX_FORMAT_YUV420_SEMIPLANAR || frame.u64VirAddr[0] == 0)
+        {
+            return false;
+        }
+        image.width = (int)frame.u32Width;
+        image.height = (int)frame.u32Height;
+        image.stride = frame.u32PicStride[0] != 0 ? (int)frame.u32PicStride[0] : image.width;
+        if (frame.u32PicStride[1] != 0 && (int)frame.u32PicStride[1] != image.stride)
+        {
+            return false;
+        }
+        const AX_U64 y_size = (AX_U64)image.stride * image.height;
+        image.phy[0] = frame.u64PhyAddr[0];
+        image.vir[0] = (uint8_t*)frame.u64VirAddr[0];
+        image.phy[1] = frame.u64PhyAddr[1] != 0 ? frame.u64PhyAddr[1] : frame.u64PhyAddr[0] + y_size;
+        image.vir[1] = frame.u64VirAddr[1] != 0 ? (uint8_t*)frame.u64VirAddr[1] : image.vir[0] + y_size;
+        return true;
+    }
+
+    // the frame an ivps call needs to read or write `image`
+    static inline AX_VIDEO_FRAME_T nv12_to_frame(const nv12_image& image)
+    {
+        AX_VIDEO_FRAME_T frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.enImgFormat = AX_FORMAT_YUV420_SEMIPLANAR;
+        frame.u32Width = image.width;
+        frame.u32Height = image.height;
+        frame.u32PicStride[0] = frame.u32PicStride[1] = image.stride;
+        for (int i = 0; i < 2; ++i)
+        {
+            frame.u64PhyAddr[i] = image.phy[i];
+            frame.u64VirAddr[i] = (AX_U64)image.vir[i];
+        }
+        frame.u32FrameSize = image.stride * image.height * 3 / 2;
+        return frame;
+    }
+
+    // the nv12 image the npu reads from an input buffer of input_h x input_w
+    static inline nv12_image nv12_from_input(const AX_ENGINE_IO_BUFFER_T& buffer, int input_h, int input_w)
+    {
+        nv12_image image;
+        image.width = input_w;
+        image.height = input_h;
+        image.stride = input_w;
+        image.phy[0] = buffer.phyAddr;
+        image.vir[0] = (uint8_t*)buffer.pVirAddr;
+        image.phy[1] = image.phy[0] + (AX_U64)input_w * input_h;
+        image.vir[1] = image.vir[0] + (size_t)input_w * input_h;
+        return image;
+    }
+
+    // crop view, no copy. the rectangle is clipped to the image, an empty crop has a 0 width or height.
+    // x, y, width and height are rounded down to even values for the chroma.
+    static inline nv12_image nv12_crop(const nv12_image& image, int x, int y, int width, int height)
+    {
+        x = std::min(std::max(x, 0), image.width) & ~1;
+        y = std::min(std::max(y, 0), image.height) & ~1;
+        nv12_image crop = image;
+        crop.width = std::max(std::min(width, image.width - x), 0) & ~1;
+        crop.height = std::max(std::min(height, image.height - y), 0) & ~1;
+        const size_t y_offset = (size_t)y * image.stride + x;
+        const size_t uv_offset = (size_t)(y / 2) * image.stride + x;
+        crop.phy[0] += y_offset;
+        crop.vir[0] += y_offset;
+        crop.phy[1] += uv_offset;
+        crop.vir[1] += uv_offset;
+        return crop;
+    }
+
+    // the npu can read the image in place: model resolution, no row padding and the uv plane right
+    // behind the y plane, which is what a vin / ivps channel configured for the model produces
+    static inline bool nv12_bindable(const nv12_image& image, const AX_ENGINE_IOMETA_T& meta, int input_h, int input_w)
+    {
+        const AX_U64 y_size = (AX_U64)input_w * input_h;
+        return image.width == input_w && image.height == input_h && image.stride == input_w
+               && image.phy[1] == image.phy[0] + y_size && image.vir[1] == image.vir[0] + y_size
+               && meta.nSize == y_size * 3 / 2;
+    }
+
+    // cpu reference of the vpp letterbox, writes into the npu input of the session
+    static inline void nv12_letterbox_cpu(const nv12_image& image, const AX_ENGINE_IO_BUFFER_T& input, int input_h, int input_w)
+    {
+        common::nv12_letterbox(image.vir[0], image.vir[1], image.height, image.width, image.stride,
+                               (uint8_t*)input.pVirAddr, input_h, input_w, input_w);
+    }
+} // namespace middleware
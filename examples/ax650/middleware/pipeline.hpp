@@ -0,0 +1,351 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+#include "middleware/io.hpp"
+#include "utilities/model.hpp"
+#include "utilities/queue.hpp"
+
+namespace middleware
+{
+    struct pipeline_report
+    {
+        int frames = 0;
+        int contexts = 0;
+        float total_ms = 0.f;
+        float fps = 0.f;
+
+        // end to end, from the start of pre process to the end of post process
+        float latency_avg = 0.f;
+        float latency_p50 = 0.f;
+        float latency_p90 = 0.f;
+        float latency_p99 = 0.f;
+        float latency_max = 0.f;
+
+        // average busy time of each stage
+        float pre_avg = 0.f;
+        float infer_avg = 0.f;
+        float post_avg = 0.f;
+    };
+
+    // runs pre process, npu inference and post process of consecutive frames as
+    // overlapping stages. every context owns its own io buffers, so up to
+    // `contexts` frames are in flight: one being filled, some on the npu, one
+    // being decoded.
+    //
+    //   pre thread  --infer queue-->  one infer thread per context  --done queue-->  post thread
+    //        ^                                                                            |
+    //        +----------------------------------- free queue ----------------------------+
+    //
+    // post process sees frames in completion order, which is not always submit order
+    // when more than one context is running.
+    class pipeline
+    {
+    public:
+        // fill the inputs of `io` for frame `index` (pre) or decode its outputs (post), return 0 on success
+        typedef std::function<int(int index, AX_ENGINE_IO_INFO_T* io_info, AX_ENGINE_IO_T* io)> stage_t;
+
+        pipeline() = default;
+
+        ~pipeline()
+        {
+            release();
+        }
+
+        pipeline(const pipeline&) = delete;
+        pipeline& operator=(const pipeline&) = delete;
+
+        int load(const std::string& model, int contexts = 3, INPUT_OUTPUT_ALLOC_STRATEGY strategy = std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED))
+        {
+            release();
+
+            auto ret = utilities::load_model(model, [&](const void* data, size_t size) {
+                return AX_ENGINE_CreateHandle(&this->handle, data, size);
+            });
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine creating handle failed. 0x%x\n", ret);
+                this->handle = nullptr;
+                return ret;
+            }
+            fprintf(stdout, "Engine creating handle is done.\n");
+
+            ret = AX_ENGINE_GetIOInfo(this->handle, &this->io_info);
+            if (0 != ret)
+            {
+                fprintf(stderr, "Engine get io info failed. 0x%x\n", ret);
+                release();
+                return ret;
+            }
+
+            contexts = std::max(contexts, 1);
+            this->slots.resize(contexts);
+            for (int i = 0; i < contexts; ++i)
+            {
+                auto& slot = this->slots[i];
+                ret = AX_ENGINE_CreateContextV2(this->handle, &slot.context);
+                if (0 != ret)
+                {
+                    fprintf(stderr, "Engine creating context{%d} failed. 0x%x\n", i, ret);
+                    this->slots.resize(i);
+                    release();
+                    return ret;
+                }
+
+                ret = prepare_io(this->io_info, &slot.io, strategy, this->pool);
+                if (0 != ret)
+                {
+                    fprintf(stderr, "Engine alloc io of context{%d} failed. 0x%x\n", i, ret);
+                    this->slots.resize(i);
+                    release();
+                    return ret;
+                }
+            }
+            fprintf(stdout, "Engine creating %d contexts is done.\n", contexts);
+
+            return 0;
+        }
+
+        // push `frames` frames through the stages, blocks until all of them are post processed.
+        // the first failing stage stops new frames from being submitted, frames in flight still drain.
+        int run(int frames, const stage_t& pre, const stage_t& post)
+        {
+            if (this->slots.empty())
+            {
+                return -1;
+            }
+
+            auto contexts = (int)this->slots.size();
+            utilities::bounded_queue<slot_t*> free_queue(contexts);
+            utilities::bounded_queue<slot_t*> infer_queue(contexts);
+            utilities::bounded_queue<slot_t*> done_queue(contexts);
+            for (auto& slot : this->slots)
+            {
+                free_queue.push(&slot);
+            }
+
+            std::atomic<int> error(0);
+            std::atomic<int> infer_running(contexts);
+            std::vector<float> latency;
+            std::vector<float> pre_costs, infer_costs, post_costs;
+            latency.reserve(frames);
+            pre_costs.reserve(frames);
+            post_costs.reserve(frames);
+            infer_costs.resize(frames, 0.f);
+
+            auto set_error = [&error](int ret) {
+                int expected = 0;
+                error.compare_exchange_strong(expected, ret);
+            };
+
+            auto begin = clock_type::now();
+
+            std::thread pre_thread([&]() {
+                slot_t* slot = nullptr;
+                for (int i = 0; i < frames && error.load() == 0; ++i)
+                {
+                    if (!free_queue.pop(slot))
+                    {
+                        break;
+                    }
+                    slot->index = i;
+                    slot->submit = clock_type::now();
+                    auto ret = pre(i, this->io_info, &slot->io);
+                    pre_costs.push_back(elapsed_ms(slot->submit));
+                    if (0 != ret)
+                    {
+                        set_error(ret);
+                        break;
+                    }
+                    infer_queue.push(slot);
+                }
+                infer_queue.close();
+            });
+
+            std::vector<std::thread> infer_threads;
+            for (int c = 0; c < contexts; ++c)
+            {
+                infer_threads.emplace_back([&]() {
+                    slot_t* slot = nullptr;
+                    while (infer_queue.pop(slot))
+                    {
+                        auto start = clock_type::now();
+                        slot->ret = AX_ENGINE_RunSyncV2(this->handle, slot->context, &slot->io);
+                        infer_costs[slot->index] = elapsed_ms(start);
+                        done_queue.push(slot);
+                    }
+                    if (--infer_running == 0)
+                    {
+                        done_queue.close();
+                    }
+                });
+            }
+
+            std::thread post_thread([&]() {
+                slot_t* slot = nullptr;
+                while (done_queue.pop(slot))
+                {
+                    auto start = clock_type::now();
+                    auto ret = slot->ret;
+                    if (0 == ret)
+                    {
+                        ret = post(slot->index, this->io_info, &slot->io);
+                    }
+                    post_costs.push_back(elapsed_ms(start));
+                    latency.push_back(elapsed_ms(slot->submit));
+                    if (0 != ret)
+                    {
+                        set_error(ret);
+                    }
+                    free_queue.push(slot);
+                }
+            });
+
+            pre_thread.join();
+            for (auto& t : infer_threads)
+            {
+                t.join();
+            }
+            post_thread.join();
+
+            auto total_ms = elapsed_ms(begin);
+            infer_costs.resize(latency.size());
+            make_report(contexts, total_ms, latency, pre_costs, infer_costs, post_costs);
+
+            return error.load();
+        }
+
+        const pipeline_report& get_report() const
+        {
+            return this->report;
+        }
+
+        void print_report() const
+        {
+            auto& r = this->report;
+            fprintf(stdout, "--------------------------------------\n");
+            fprintf(stdout, "Pipeline %d frames with %d contexts, total %.2f ms, %.2f fps\n", r.frames, r.contexts, r.total_ms, r.fps);
+            fprintf(stdout, "latency avg %.2f ms, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n", r.latency_avg, r.latency_p50, r.latency_p90, r.latency_p99, r.latency_max);
+            fprintf(stdout, "stage avg: pre %.2f ms, infer %.2f ms, post %.2f ms\n", r.pre_avg, r.infer_avg, r.post_avg);
+            fprintf(stdout, "--------------------------------------\n");
+        }
+
+        void release()
+        {
+            for (auto& slot : this->slots)
+            {
+                free_io(&slot.io, this->pool);
+            }
+            this->slots.clear();
+
+            // contexts created by CreateContextV2 belong to the handle
+            if (this->handle != nullptr)
+            {
+                AX_ENGINE_DestroyHandle(this->handle);
+                this->handle = nullptr;
+            }
+            this->io_info = nullptr;
+        }
+
+        // where load() takes the io buffers from, call it before load(). nullptr, the default, allocates
+        // them from the cmm heap directly. the pool must outlive this object.
+        void set_pool(cmm_pool* pool)
+        {
+            this->pool = pool;
+        }
+
+        AX_ENGINE_IO_INFO_T* get_io_info() const
+        {
+            return this->io_info;
+        }
+
+    private:
+        typedef std::chrono::steady_clock clock_type;
+
+        struct slot_t
+        {
+            AX_ENGINE_CONTEXT_T context = nullptr;
+            AX_ENGINE_IO_T io = {};
+            int index = 0;
+            int ret = 0;
+            clock_type::time_point submit;
+        };
+
+        static float elapsed_ms(const clock_type::time_point& since)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - since).count() / 1000.f;
+        }
+
+        static float average(const std::vector<float>& costs)
+        {
+            return costs.empty() ? 0.f : std::accumulate(costs.begin(), costs.end(), 0.f) / (float)costs.size();
+        }
+
+        static float percentile(const std::vector<float>& sorted, float p)
+        {
+            if (sorted.empty())
+            {
+                return 0.f;
+            }
+            auto index = (size_t)(p * (float)(sorted.size() - 1) + 0.5f);
+            return sorted[std::min(index, sorted.size() - 1)];
+        }
+
+        void make_report(int contexts, float total_ms, std::vector<float>& latency, const std::vector<float>& pre_costs, const std::vector<float>& infer_costs, const std::vector<float>& post_costs)
+        {
+            auto& r = this->report;
+            r = pipeline_report();
+            r.frames = (int)latency.size();
+            r.contexts = contexts;
+            r.total_ms = total_ms;
+            r.fps = total_ms > 0.f ? (float)r.frames * 1000.f / total_ms : 0.f;
+
+            std::sort(latency.begin(), latency.end());
+            r.latency_avg = average(latency);
+            r.latency_p50 = percentile(latency, 0.50f);
+            r.latency_p90 = percentile(latency, 0.90f);
+            r.latency_p99 = percentile(latency, 0.99f);
+            r.latency_max = latency.empty() ? 0.f : latency.back();
+
+            r.pre_avg = average(pre_costs);
+            r.infer_avg = average(infer_costs);
+            r.post_avg = average(post_costs);
+        }
+
+        AX_ENGINE_HANDLE handle = nullptr;
+        AX_ENGINE_IO_INFO_T* io_info = nullptr;
+        cmm_pool* pool = nullptr;
+        std::vector<slot_t> slots;
+        pipeline_report report;
+    };
+} // namespace middleware
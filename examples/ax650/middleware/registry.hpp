@@ -0,0 +1,368 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+
+#include "middleware/cmm_pool.hpp"
+#include "middleware/session.hpp"
+#include "utilities/timer.hpp"
+
+namespace middleware
+{
+    typedef struct
+    {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t failed;          // loads that did not give a session
+        size_t models;          // resident right now
+        size_t resident_bytes;  // cmm footprint of the resident models
+        size_t peak_bytes;      // max of resident_bytes
+        size_t over_budget;     // loads that left it over the budget, the rest in use or one model too large
+        std::vector<size_t> load_histogram; // load latencies, counts per REGISTRY_LOAD_BUCKETS_MS bucket
+    } registry_stats;
+
+    // upper bounds of the load latency buckets in ms, one more bucket counts what is slower
+    const float REGISTRY_LOAD_BUCKETS_MS[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+    const int REGISTRY_LOAD_BUCKETS = sizeof(REGISTRY_LOAD_BUCKETS_MS) / sizeof(REGISTRY_LOAD_BUCKETS_MS[0]) + 1;
+
+    // lazily loaded sessions of many models under one cmm budget. a model is loaded on its first
+    // acquire() and stays resident, the least recently used ones are evicted when loading another
+    // would go over the budget. a session handed out is pinned until the caller drops it. loads run
+    // outside the lock, so other models are served meanwhile, callers of a model being loaded wait for it.
+    //
+    // the footprint of a model is its file size, which the engine's copy of the weights is close
+    // to, plus its io buffers from AX_ENGINE_IO_INFO_T rounded to the pool size classes. the io
+    // buffers come from a pool of the registry, so the next model reuses what an evicted one held.
+    // sessions handed out must not outlive the registry.
+    class model_registry
+    {
+    public:
+        // budget in bytes, 0 for no limit
+        explicit model_registry(size_t budget = 0, INPUT_OUTPUT_ALLOC_STRATEGY strategy = std::make_pair(AX_ENGINE_ABST_DEFAULT, AX_ENGINE_ABST_CACHED))
+            : budget(budget), strategy(strategy)
+        {
+            this->counters = registry_stats();
+            this->counters.load_histogram.assign(REGISTRY_LOAD_BUCKETS, 0);
+        }
+
+        ~model_registry()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->entries.clear();
+            this->retired.clear();
+            this->lru.clear();
+        }
+
+        model_registry(const model_registry&) = delete;
+        model_registry& operator=(const model_registry&) = delete;
+
+        // the session of `path`, loaded when it is not resident. nullptr when loading failed.
+        // a file that changed on disk (size or mtime) since it was loaded is loaded again.
+        std::shared_ptr<session> acquire(const std::string& path)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            // one load per model, later callers take the session it gives
+            this->loaded.wait(lock, [&] { return this->loading.find(path) == this->loading.end(); });
+
+            struct stat st;
+            if (stat(path.c_str(), &st) != 0)
+            {
+                fprintf(stderr, "Model(%s) does not exist.\n", path.c_str());
+                this->counters.failed++;
+                return nullptr;
+            }
+
+            auto it = this->entries.find(path);
+            if (it != this->entries.end())
+            {
+                if (it->second.file_size == (size_t)st.st_size && it->second.mtime == (int64_t)st.st_mtime)
+                {
+                    this->counters.hits++;
+                    this->lru.splice(this->lru.begin(), this->lru, it->second.lru);
+                    return it->second.model;
+                }
+                // stale, the sessions already handed out keep working on the old handle
+                retire(it);
+            }
+            this->counters.misses++;
+
+            // a model seen before has a known footprint, make room before loading it and hold it
+            // back from the other loads until the real footprint is known
+            auto known = this->footprints.find(path);
+            const size_t need = known != this->footprints.end() ? known->second : (size_t)st.st_size;
+            make_room(need, path, false);
+            this->loading[path] = need;
+            this->loading_bytes += need;
+
+            lock.unlock();
+            timer load_timer;
+            auto model = std::make_shared<session>();
+            model->set_pool(&this->pool);
+            auto ret = model->load(path, this->strategy);
+            float cost = load_timer.cost();
+            lock.lock();
+
+            this->loading_bytes -= need;
+            this->loading.erase(path);
+            this->loaded.notify_all();
+            if (ret != 0)
+            {
+                this->counters.failed++;
+                return nullptr;
+            }
+            int bucket = 0;
+            while (bucket < REGISTRY_LOAD_BUCKETS - 1 && cost > REGISTRY_LOAD_BUCKETS_MS[bucket])
+            {
+                bucket++;
+            }
+            this->counters.load_histogram[bucket]++;
+
+            entry_t entry;
+            entry.model = model;
+            entry.footprint = footprint((size_t)st.st_size, model->get_io_info());
+            entry.file_size = (size_t)st.st_size;
+            entry.mtime = (int64_t)st.st_mtime;
+            this->lru.push_front(path);
+            entry.lru = this->lru.begin();
+            this->footprints[path] = entry.footprint;
+            this->counters.resident_bytes += entry.footprint;
+            this->entries[path] = entry;
+
+            // the real footprint may be larger than what room was made for
+            make_room(0, path);
+            this->pool.trim();
+
+            this->counters.models = this->entries.size();
+            this->counters.peak_bytes = std::max(this->counters.peak_bytes, this->counters.resident_bytes);
+            return model;
+        }
+
+        // drop a model if nobody uses it, true when it is not resident afterwards
+        bool evict(const std::string& path)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->entries.find(path);
+            if (it == this->entries.end())
+            {
+                return true;
+            }
+            if (it->second.model.use_count() > 1)
+            {
+                return false;
+            }
+            erase(it);
+            this->counters.evictions++;
+            this->pool.trim();
+            return true;
+        }
+
+        // budget in bytes, 0 for no limit. evicts right away when the resident models exceed it.
+        void set_budget(size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->budget = bytes;
+            make_room(0, std::string());
+            this->pool.trim();
+        }
+
+        size_t get_budget() const
+        {
+            return this->budget;
+        }
+
+        bool is_resident(const std::string& path) const
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->entries.find(path) != this->entries.end();
+        }
+
+        // cmm footprint of a model that was loaded at least once, 0 otherwise
+        size_t get_footprint(const std::string& path) const
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->footprints.find(path);
+            return it == this->footprints.end() ? 0 : it->second;
+        }
+
+        // resident models, most recently used first
+        std::vector<std::string> resident() const
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return std::vector<std::string>(this->lru.begin(), this->lru.end());
+        }
+
+        registry_stats stats() const
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->counters;
+        }
+
+        void print_stats() const
+        {
+            auto s = stats();
+            fprintf(stdout, "--------------------------------------\n");
+            fprintf(stdout, "model registry: %zu hits, %zu misses, %zu evictions, %zu failed, %zu over budget\n",
+                    s.hits, s.misses, s.evictions, s.failed, s.over_budget);
+            fprintf(stdout, "resident %zu models, %.2f MB, peak %.2f MB, budget %.2f MB\n",
+                    s.models, s.resident_bytes / 1048576.0, s.peak_bytes / 1048576.0, this->budget / 1048576.0);
+            fprintf(stdout, "load latency:");
+            for (int i = 0; i < REGISTRY_LOAD_BUCKETS; ++i)
+            {
+                if (s.load_histogram[i] == 0)
+                {
+                    continue;
+                }
+                if (i < REGISTRY_LOAD_BUCKETS - 1)
+                {
+                    fprintf(stdout, " <=%gms:%zu", REGISTRY_LOAD_BUCKETS_MS[i], s.load_histogram[i]);
+                }
+                else
+                {
+                    fprintf(stdout, " >%gms:%zu", REGISTRY_LOAD_BUCKETS_MS[i - 1], s.load_histogram[i]);
+                }
+            }
+            fprintf(stdout, "\n");
+            fprintf(stdout, "--------------------------------------\n");
+        }
+
+    private:
+        typedef struct
+        {
+            std::shared_ptr<session> model;
+            size_t footprint;
+            size_t file_size;
+            int64_t mtime;
+            std::list<std::string>::iterator lru;
+        } entry_t;
+
+        static size_t footprint(size_t file_size, const AX_ENGINE_IO_INFO_T* io_info)
+        {
+            size_t bytes = file_size;
+            for (AX_U32 i = 0; i < io_info->nInputSize; ++i)
+            {
+                bytes += cmm_pool::size_class(io_info->pInputs[i].nSize);
+            }
+            for (AX_U32 i = 0; i < io_info->nOutputSize; ++i)
+            {
+                bytes += cmm_pool::size_class(io_info->pOutputs[i].nSize);
+            }
+            return bytes;
+        }
+
+        void erase(std::unordered_map<std::string, entry_t>::iterator it)
+        {
+            this->counters.resident_bytes -= it->second.footprint;
+            this->lru.erase(it->second.lru);
+            this->entries.erase(it);
+            this->counters.models = this->entries.size();
+        }
+
+        // a stale model out of the lookup. while its sessions are still in use they hold their cmm,
+        // so its footprint stays in resident_bytes until release_retired() sees the last one dropped
+        void retire(std::unordered_map<std::string, entry_t>::iterator it)
+        {
+            if (it->second.model.use_count() == 1)
+            {
+                erase(it);
+                return;
+            }
+            this->retired.push_back(it->second);
+            this->lru.erase(it->second.lru);
+            this->entries.erase(it);
+            this->counters.models = this->entries.size();
+        }
+
+        void release_retired()
+        {
+            for (auto it = this->retired.begin(); it != this->retired.end();)
+            {
+                if (it->model.use_count() > 1)
+                {
+                    ++it;
+                    continue;
+                }
+                this->counters.resident_bytes -= it->footprint;
+                it = this->retired.erase(it);
+            }
+        }
+
+        // evict the least recently used models that are not in use until `need` more bytes fit,
+        // `keep` is never evicted. `report` counts and logs it when that is not enough.
+        void make_room(size_t need, const std::string& keep, bool report = true)
+        {
+            release_retired();
+            if (this->budget == 0)
+            {
+                return;
+            }
+            need += this->loading_bytes;
+            auto it = this->lru.end();
+            while (this->counters.resident_bytes + need > this->budget && it != this->lru.begin())
+            {
+                --it;
+                auto entry = this->entries.find(*it);
+                if (*it == keep || entry->second.model.use_count() > 1)
+                {
+                    continue;
+                }
+                // erase() invalidates `it`. keep its neighbour on the least recently used side, already
+                // checked or end(), the --it above then moves on to the next more recent entry
+                auto next = it;
+                ++next;
+                erase(entry);
+                this->counters.evictions++;
+                it = next;
+            }
+            if (report && this->counters.resident_bytes + need > this->budget)
+            {
+                this->counters.over_budget++;
+                fprintf(stderr, "model registry is over its budget, %.2f MB resident + %.2f MB needed > %.2f MB.\n",
+                        this->counters.resident_bytes / 1048576.0, need / 1048576.0, this->budget / 1048576.0);
+            }
+        }
+
+        size_t budget;
+        INPUT_OUTPUT_ALLOC_STRATEGY strategy;
+        cmm_pool pool;
+        mutable std::mutex mutex;
+        std::condition_variable loaded;
+        std::unordered_map<std::string, entry_t> entries;
+        std::vector<entry_t> retired;                    // stale models whose sessions are still in use
+        std::unordered_map<std::string, size_t> loading; // models being loaded, the room made for each
+        size_t loading_bytes = 0;
+        std::unordered_map<std::string, size_t> footprints;
+        std::list<std::string> lru; // most recently used first
+        registry_stats counters;
+    };
+} // namespace middleware
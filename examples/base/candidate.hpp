@@ -0,0 +1,135 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+namespace detection
+{
+    typedef struct
+    {
+        float x;
+        float y;
+        float width;
+        float height;
+    } CandidateRect;
+
+    // plain proposal record used from decode through sort and nms. it has the same rect / label / prob
+    // members as Object, so the sort and nms templates take both. extra features live in Proposals::feats.
+    typedef struct
+    {
+        CandidateRect rect;
+        int label;
+        float prob;
+        float angle;
+        int feat; // offset of the features in Proposals::feats, -1 when there are none
+    } Candidate;
+
+    enum CandidateFeat
+    {
+        CANDIDATE_FEAT_NONE = 0,
+        CANDIDATE_FEAT_MASK = 1,     // Object::mask_feat
+        CANDIDATE_FEAT_KPS = 2,      // Object::kps_feat
+        CANDIDATE_FEAT_LANDMARK = 3, // Object::landmark, x y of 5 points
+    };
+
+    // all proposals of one frame. keep one around and clear() it per frame, the buffers then stop
+    // allocating after the first frames. full Objects are only built for the nms survivors.
+    struct Proposals
+    {
+        std::vector<Candidate> candidates;
+        std::vector<float> feats;
+        int feat_kind = CANDIDATE_FEAT_NONE;
+        int feat_dim = 0; // floats per candidate
+
+        void clear()
+        {
+            candidates.clear();
+            feats.clear();
+        }
+
+        size_t size() const
+        {
+            return candidates.size();
+        }
+
+        bool empty() const
+        {
+            return candidates.empty();
+        }
+
+        // every candidate of a frame carries the same kind of features
+        void set_feat(int kind, int dim)
+        {
+            feat_kind = kind;
+            feat_dim = kind == CANDIDATE_FEAT_NONE ? 0 : dim;
+        }
+
+        // add a candidate and return where its feat_dim features go (nullptr without features).
+        // the pointer is only valid until the next push.
+        float* push(float x, float y, float width, float height, int label, float prob, float angle = 0.f)
+        {
+            Candidate candidate;
+            candidate.rect.x = x;
+            candidate.rect.y = y;
+            candidate.rect.width = width;
+            candidate.rect.height = height;
+            candidate.label = label;
+            candidate.prob = prob;
+            candidate.angle = angle;
+            candidate.feat = -1;
+            if (feat_dim > 0)
+            {
+                candidate.feat = (int)feats.size();
+                feats.resize(feats.size() + feat_dim);
+            }
+            candidates.push_back(candidate);
+            return candidate.feat < 0 ? nullptr : feats.data() + candidate.feat;
+        }
+
+        // append the candidates of `other`, e.g. those of one row tile decoded into a buffer of its own
+        void append(const Proposals& other)
+        {
+            if (other.feat_kind != CANDIDATE_FEAT_NONE)
+            {
+                set_feat(other.feat_kind, other.feat_dim);
+            }
+            const int base = (int)feats.size();
+            const size_t first = candidates.size();
+            candidates.insert(candidates.end(), other.candidates.begin(), other.candidates.end());
+            feats.insert(feats.end(), other.feats.begin(), other.feats.end());
+            for (size_t i = first; i < candidates.size(); ++i)
+            {
+                if (candidates[i].feat >= 0)
+                {
+                    candidates[i].feat += base;
+                }
+            }
+        }
+
+        const float* feat(int index) const
+        {
+            int offset = candidates[index].feat;
+            return offset < 0 ? nullptr : feats.data() + offset;
+        }
+    };
+} // namespace detection
@@ -0,0 +1,208 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#include "base/simd.hpp"
+
+namespace detection
+{
+    typedef struct
+    {
+        int cell;
+        int label;
+        float score;
+    } ClassCandidate;
+
+    // rows [begin, end) of the grid of one head, so a head can be decoded in row tiles. the default
+    // is the whole grid, a decoder given a range only emits the cells of those rows.
+    struct GridRows
+    {
+        int begin;
+        int end;
+
+        GridRows(int begin = 0, int end = INT_MAX)
+            : begin(begin), end(end)
+        {
+        }
+
+        // the range clamped to a grid of `feat_h` rows
+        int row_begin(int feat_h) const
+        {
+            return std::min(std::max(begin, 0), feat_h);
+        }
+
+        int row_end(int feat_h) const
+        {
+            return std::min(std::max(end, row_begin(feat_h)), feat_h);
+        }
+    };
+
+    // sigmoid(x) > prob  <=>  x > logit(prob), so thresholds can be checked before any sigmoid
+    static inline float logit_threshold(float prob)
+    {
+        const float p = std::min(std::max(prob, 1e-6f), 1.f - 1e-6f);
+        return std::log(p / (1.f - p));
+    }
+
+    // max over n contiguous scores, vector body + scalar tail
+    static inline float max_score(const float* src, int n)
+    {
+        int i = 0;
+        float m = -FLT_MAX;
+        if (n >= 4)
+        {
+            simd::v4f vm = simd::load(src);
+            for (i = 4; i + 3 < n; i += 4)
+            {
+                vm = simd::max(vm, simd::load(src + i));
+            }
+            m = simd::hmax(vm);
+        }
+        for (; i < n; ++i)
+        {
+            m = std::max(m, src[i]);
+        }
+        return m;
+    }
+
+    // first index holding `value`, the same label a strict `>` argmax loop picks
+    static inline int find_score(const float* src, int n, float value)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            if (src[i] == value)
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    // best class of one cell if its score reaches `threshold`, for heads gated per cell (objectness first)
+    static inline bool max_class_above(const float* cls, int cls_num, float threshold, int& label, float& score)
+    {
+        score = max_score(cls, cls_num);
+        if (!(score >= threshold))
+        {
+            return false;
+        }
+        label = find_score(cls, cls_num, score);
+        return true;
+    }
+
+    // threshold first class scan over `cells` cells. the scores of cell i start at cls + i * cell_step.
+    // four cells are reduced side by side and compared at once, the argmax only runs for the few cells
+    // whose best score reaches `threshold`. candidates come out in cell order.
+    static inline void scan_class_scores(const float* cls, int cells, int cell_step, int cls_num, float threshold, std::vector<ClassCandidate>& candidates)
+    {
+        const int vec_num = cls_num & ~3;
+        const simd::v4f vthr = simd::set1(threshold);
+
+        int c = 0;
+        if (vec_num > 0)
+        {
+            for (; c + 3 < cells; c += 4)
+            {
+                const float* p0 = cls + (size_t)c * cell_step;
+                const float* p1 = p0 + cell_step;
+                const float* p2 = p1 + cell_step;
+                const float* p3 = p2 + cell_step;
+
+                simd::v4f m0 = simd::load(p0);
+                simd::v4f m1 = simd::load(p1);
+                simd::v4f m2 = simd::load(p2);
+                simd::v4f m3 = simd::load(p3);
+                for (int i = 4; i < vec_num; i += 4)
+                {
+                    m0 = simd::max(m0, simd::load(p0 + i));
+                    m1 = simd::max(m1, simd::load(p1 + i));
+                    m2 = simd::max(m2, simd::load(p2 + i));
+                    m3 = simd::max(m3, simd::load(p3 + i));
+                }
+                // lane k of the reduced vector is the max of cell c + k
+                simd::transpose4x4(m0, m1, m2, m3);
+                simd::v4f best = simd::max(simd::max(m0, m1), simd::max(m2, m3));
+                if (vec_num < cls_num)
+                {
+                    float tail[4];
+                    simd::store(tail, best);
+                    for (int i = vec_num; i < cls_num; ++i)
+                    {
+                        tail[0] = std::max(tail[0], p0[i]);
+                        tail[1] = std::max(tail[1], p1[i]);
+                        tail[2] = std::max(tail[2], p2[i]);
+                        tail[3] = std::max(tail[3], p3[i]);
+                    }
+                    best = simd::load(tail);
+                }
+
+                // ordered compare, a NaN best score fails it as in max_class_above()
+                int mask = simd::cmpge_mask(best, vthr);
+                if (mask == 0)
+                {
+                    continue;
+                }
+
+                float scores[4];
+                simd::store(scores, best);
+                for (int k = 0; k < 4; ++k)
+                {
+                    if (mask & (1 << k))
+                    {
+                        const float* p = cls + (size_t)(c + k) * cell_step;
+                        candidates.push_back({c + k, find_score(p, cls_num, scores[k]), scores[k]});
+                    }
+                }
+            }
+        }
+
+        for (; c < cells; ++c)
+        {
+            const float* p = cls + (size_t)c * cell_step;
+            int label;
+            float score;
+            if (max_class_above(p, cls_num, threshold, label, score))
+            {
+                candidates.push_back({c, label, score});
+            }
+        }
+    }
+
+    // scan_class_scores() over grid rows `rows` of a feat_w x feat_h head, the cells that come back
+    // are numbered over the whole grid
+    static inline void scan_class_rows(const float* cls, int feat_w, int feat_h, const GridRows& rows, int cell_step, int cls_num, float threshold,
+                                       std::vector<ClassCandidate>& candidates)
+    {
+        const int first = rows.row_begin(feat_h) * feat_w;
+        const size_t start = candidates.size();
+        scan_class_scores(cls + (size_t)first * cell_step, rows.row_end(feat_h) * feat_w - first, cell_step, cls_num, threshold, candidates);
+        for (size_t i = start; i < candidates.size(); ++i)
+        {
+            candidates[i].cell += first;
+        }
+    }
+} // namespace detection
@@ -27,6 +27,9 @@
 #include <cmath>
 #include <string>
 
+#include "base/letterbox.hpp"
+#include "utilities/trace.hpp"
+
 namespace common
 {
     // opencv mat(h, w)
@@ -43,6 +46,7 @@ namespace common
 
     void get_input_data_letterbox(cv::Mat mat, std::vector<uint8_t>& image, int letterbox_rows, int letterbox_cols, bool bgr2rgb = false)
     {
+        AX_TRACE_SCOPE("letterbox");
         /* letterbox process to support different letterbox size */
         float scale_letterbox;
         int resize_rows;
@@ -75,6 +79,23 @@ namespace common
         }
     }
 
+    // the same letterbox written straight into `dst` (e.g. session.get_input()) in one fused pass,
+    // dst_stride is the row pitch of dst in bytes, 0 for letterbox_cols * 3
+    void get_input_data_letterbox(const cv::Mat& mat, void* dst, int letterbox_rows, int letterbox_cols, bool bgr2rgb = false, size_t dst_stride = 0)
+    {
+        cv::Mat bgr = mat;
+        if (mat.channels() == 4)
+        {
+            cv::cvtColor(mat, bgr, cv::COLOR_BGRA2BGR);
+        }
+        else if (mat.channels() == 1)
+        {
+            cv::cvtColor(mat, bgr, cv::COLOR_GRAY2BGR);
+        }
+
+        letterbox_bgr(bgr.data, bgr.rows, bgr.cols, bgr.step, (uint8_t*)dst, letterbox_rows, letterbox_cols, dst_stride, bgr2rgb);
+    }
+
     void get_input_data_centercrop(cv::Mat mat, std::vector<uint8_t>& image, int model_h, int model_w, bool bgr2rgb = false)
     {
         /* letterbox process to support different letterbox size */
@@ -26,6 +26,16 @@
 #include <algorithm>
 #include <cmath>
 #include <string>
+
+#include "base/candidate.hpp"
+#include "base/class_scan.hpp"
+#include "base/dfl.hpp"
+#include "base/mask.hpp"
+#include "base/nms.hpp"
+#include "base/nms_rotated.hpp"
+#include "base/proposal_tiles.hpp"
+#include "utilities/trace.hpp"
+
 namespace detection
 {
     typedef struct
@@ -60,6 +70,75 @@ namespace detection
         cv::Mat affine_trans_mat_inv;
     } PalmObject;
 
+    /* palm detection has a single class */
+    static inline int nms_label(const PalmObject&)
+    {
+        return 0;
+    }
+
+    // full Object of candidate `index`, features go where the decoder of their kind used to put them
+    static inline void candidate_to_object(const Proposals& proposals, int index, Object& obj)
+    {
+        const Candidate& candidate = proposals.candidates[index];
+        obj.rect.x = candidate.rect.x;
+        obj.rect.y = candidate.rect.y;
+        obj.rect.width = candidate.rect.width;
+        obj.rect.height = candidate.rect.height;
+        obj.label = candidate.label;
+        obj.prob = candidate.prob;
+        obj.angle = candidate.angle;
+        // `obj` may hold an Object of an earlier frame, none of its features may survive
+        obj.mask.release();
+        obj.mask_feat.clear();
+        obj.kps_feat.clear();
+        for (int l = 0; l < 5; l++)
+        {
+            obj.landmark[l] = cv::Point2f();
+        }
+
+        const float* feat = proposals.feat(index);
+        if (feat == nullptr)
+            return;
+
+        switch (proposals.feat_kind)
+        {
+        case CANDIDATE_FEAT_MASK:
+            obj.mask_feat.assign(feat, feat + proposals.feat_dim);
+            break;
+        case CANDIDATE_FEAT_KPS:
+            obj.kps_feat.assign(feat, feat + proposals.feat_dim);
+            break;
+        case CANDIDATE_FEAT_LANDMARK:
+            for (int l = 0; l < 5 && l * 2 + 1 < proposals.feat_dim; l++)
+            {
+                obj.landmark[l] = cv::Point2f(feat[l * 2], feat[l * 2 + 1]);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Objects of the picked candidates only, in picked order
+    static void materialize_objects(const Proposals& proposals, const std::vector<int>& picked, std::vector<Object>& objects)
+    {
+        objects.resize(picked.size());
+        for (size_t i = 0; i < picked.size(); i++)
+        {
+            candidate_to_object(proposals, picked[i], objects[i]);
+        }
+    }
+
+    static void append_objects(const Proposals& proposals, std::vector<Object>& objects)
+    {
+        size_t offset = objects.size();
+        objects.resize(offset + proposals.size());
+        for (size_t i = 0; i < proposals.size(); i++)
+        {
+            candidate_to_object(proposals, (int)i, objects[offset + i]);
+        }
+    }
+
     static inline float sigmoid(float x)
     {
         return static_cast<float>(1.f / (1.f + exp(-x)));
@@ -90,87 +169,6 @@ namespace detection
         return inter.area();
     }
 
-    template<typename T>
-    static void qsort_descent_inplace(std::vector<T>& faceobjects, int left, int right)
-    {
-        int i = left;
-        int j = right;
-        float p = faceobjects[(left + right) / 2].prob;
-
-        while (i <= j)
-        {
-            while (faceobjects[i].prob > p)
-                i++;
-
-            while (faceobjects[j].prob < p)
-                j--;
-
-            if (i <= j)
-            {
-                // swap
-                std::swap(faceobjects[i], faceobjects[j]);
-
-                i++;
-                j--;
-            }
-        }
-#pragma omp parallel sections
-        {
-#pragma omp section
-            {
-                if (left < j) qsort_descent_inplace(faceobjects, left, j);
-            }
-#pragma omp section
-            {
-                if (i < right) qsort_descent_inplace(faceobjects, i, right);
-            }
-        }
-    }
-
-    template<typename T>
-    static void qsort_descent_inplace(std::vector<T>& faceobjects)
-    {
-        if (faceobjects.empty())
-            return;
-
-        qsort_descent_inplace(faceobjects, 0, faceobjects.size() - 1);
-    }
-
-    template<typename T>
-    static void nms_sorted_bboxes(const std::vector<T>& faceobjects, std::vector<int>& picked, float nms_threshold)
-    {
-        picked.clear();
-
-        const int n = faceobjects.size();
-
-        std::vector<float> areas(n);
-        for (int i = 0; i < n; i++)
-        {
-            areas[i] = faceobjects[i].rect.area();
-        }
-
-        for (int i = 0; i < n; i++)
-        {
-            const T& a = faceobjects[i];
-
-            int keep = 1;
-            for (int j = 0; j < (int)picked.size(); j++)
-            {
-                const T& b = faceobjects[picked[j]];
-
-                // intersection over union
-                float inter_area = intersection_area(a, b);
-                float union_area = areas[i] + areas[picked[j]] - inter_area;
-                // float IoU = inter_area / union_area
-                if (inter_area / union_area > nms_threshold)
-                    keep = 0;
-            }
-
-            if (keep)
-                picked.push_back(i);
-        }
-    }
-
     static void generate_grids_and_stride(const int target_w, const int target_h, std::vector<int>& strides, std::vector<GridAndStride>& grid_strides)
     {
         for (auto stride : strides)
@@ -346,14 +344,16 @@ namespace detection
     }
 
     static void generate_proposals_yolox(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                         int letterbox_cols, int letterbox_rows, int cls_num = 80)
+                                         int letterbox_cols, int letterbox_rows, int cls_num = 80, const GridRows& rows = GridRows())
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
+        int row_begin = rows.row_begin(feat_h);
+        int row_end = rows.row_end(feat_h);
 
-        auto feat_ptr = feat;
+        auto feat_ptr = feat + (size_t)row_begin * feat_w * (cls_num + 5);
 
-        for (int h = 0; h <= feat_h - 1; h++)
+        for (int h = row_begin; h <= row_end - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
             {
@@ -365,17 +365,8 @@ namespace detection
                 }
 
                 //process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s <= cls_num - 1; s++)
-                {
-                    float score = feat_ptr[s + 5];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+                float class_score = max_score(feat_ptr + 5, cls_num);
+                int class_index = find_score(feat_ptr + 5, cls_num, class_score);
 
                 float box_prob = box_objectness * class_score;
 
@@ -405,14 +396,16 @@ namespace detection
     }
 
     static void generate_proposals_yolov7(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                          int letterbox_cols, int letterbox_rows, const float* anchors, int cls_num = 80)
+                                          int letterbox_cols, int letterbox_rows, const float* anchors, int cls_num = 80, const GridRows& rows = GridRows())
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
+        int row_begin = rows.row_begin(feat_h);
+        int row_end = rows.row_end(feat_h);
 
-        auto feat_ptr = feat;
+        auto feat_ptr = feat + (size_t)row_begin * feat_w * 3 * (cls_num + 5);
 
-        for (int h = 0; h <= feat_h - 1; h++)
+        for (int h = row_begin; h <= row_end - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
             {
@@ -426,17 +419,8 @@ namespace detection
                     }
 
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feat_ptr[s + 5];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feat_ptr + 5, cls_num);
+                    int class_index = find_score(feat_ptr + 5, cls_num, class_score);
 
                     float box_prob = box_objectness * class_score;
 
@@ -495,17 +479,8 @@ namespace detection
                     }
 
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feature_ptr[s + 5 + 10];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feature_ptr + 5 + 10, cls_num);
+                    int class_index = find_score(feature_ptr + 5 + 10, cls_num, class_score);
                     //process box score
                     float box_score = feature_ptr[4];
                     float final_score = sigmoid(box_score) * sigmoid(class_score);
@@ -584,17 +559,8 @@ namespace detection
                     }
 
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feature_ptr[s + 5 + 8];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feature_ptr + 5 + 8, cls_num);
+                    int class_index = find_score(feature_ptr + 5 + 8, cls_num, class_score);
                     //process box score
                     float box_score = feature_ptr[4];
                     float final_score = sigmoid(box_score) * sigmoid(class_score);
@@ -644,7 +610,7 @@ namespace detection
     }
 
     static void generate_proposals_yolov5(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                          int letterbox_cols, int letterbox_rows, const float* anchors, float prob_threshold_unsigmoid, int cls_num = 80)
+                                          int letterbox_cols, int letterbox_rows, const float* anchors, float prob_threshold_unsigmoid, int cls_num = 80, const GridRows& rows = GridRows())
     {
         int anchor_num = 3;
         int feat_w = letterbox_cols / stride;
@@ -656,10 +622,12 @@ namespace detection
             anchor_group = 2;
         if (stride == 32)
             anchor_group = 3;
+        int row_begin = rows.row_begin(feat_h);
+        int row_end = rows.row_end(feat_h);
 
-        auto feature_ptr = feat;
+        auto feature_ptr = feat + (size_t)row_begin * feat_w * anchor_num * (cls_num + 5);
 
-        for (int h = 0; h <= feat_h - 1; h++)
+        for (int h = row_begin; h <= row_end - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
             {
@@ -672,17 +640,8 @@ namespace detection
                     }
 
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feature_ptr[s + 5];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feature_ptr + 5, cls_num);
+                    int class_index = find_score(feature_ptr + 5, cls_num, class_score);
                     //process box score
                     float box_score = feature_ptr[4];
                     float final_score = sigmoid(box_score) * sigmoid(class_score);
@@ -721,7 +680,7 @@ namespace detection
     }
 
     static void generate_proposals_yolov5_seg(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                              int letterbox_cols, int letterbox_rows, const float* anchors, float prob_threshold_unsigmoid, int cls_num = 80, int mask_proto_dim = 32)
+                                              int letterbox_cols, int letterbox_rows, const float* anchors, float prob_threshold_unsigmoid, int cls_num = 80, int mask_proto_dim = 32, const GridRows& rows = GridRows())
     {
         int anchor_num = 3;
         int feat_w = letterbox_cols / stride;
@@ -733,10 +692,12 @@ namespace detection
             anchor_group = 2;
         if (stride == 32)
             anchor_group = 3;
+        int row_begin = rows.row_begin(feat_h);
+        int row_end = rows.row_end(feat_h);
 
-        auto feature_ptr = feat;
+        auto feature_ptr = feat + (size_t)row_begin * feat_w * anchor_num * (cls_num + 5 + mask_proto_dim);
 
-        for (int h = 0; h <= feat_h - 1; h++)
+        for (int h = row_begin; h <= row_end - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
             {
@@ -749,17 +710,8 @@ namespace detection
                     }
 
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feature_ptr[s + 5];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feature_ptr + 5, cls_num);
+                    int class_index = find_score(feature_ptr + 5, cls_num, class_score);
                     //process box score
                     float box_score = feature_ptr[4];
                     float final_score = sigmoid(box_score) * sigmoid(class_score);
@@ -831,17 +783,8 @@ namespace detection
                     }
 
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feature_ptr[s + 5];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feature_ptr + 5, cls_num);
+                    int class_index = find_score(feature_ptr + 5, cls_num, class_score);
                     //process box score
                     float box_score = feature_ptr[4];
                     float final_score = sigmoid(box_score) * sigmoid(class_score);
@@ -880,31 +823,28 @@ namespace detection
     }
 
     static void generate_proposals_yolov6(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                          int letterbox_cols, int letterbox_rows, int cls_num = 80)
+                                          int letterbox_cols, int letterbox_rows, int cls_num = 80, const GridRows& rows = GridRows())
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
 
-        auto feat_ptr = feat;
+        int cell_step = cls_num + 4;
 
+        //process cls score, only cells whose best score passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat + 4, feat_w, feat_h, rows, cell_step, cls_num, prob_threshold, candidates);
+
+        size_t next = 0;
         for (int h = 0; h <= feat_h - 1; h++)
         {
-            for (int w = 0; w <= feat_w - 1; w++)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
             {
-                //process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s <= cls_num - 1; s++)
-                {
-                    float score = feat_ptr[s + 4];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+                const ClassCandidate& candidate = candidates[next];
+                int w = candidate.cell - h * feat_w;
+                auto feat_ptr = feat + candidate.cell * cell_step;
 
-                float box_prob = class_score;
+                int class_index = candidate.label;
+                float box_prob = candidate.score;
 
                 if (box_prob > prob_threshold)
                 {
@@ -913,21 +853,16 @@ namespace detection
                     float x1 = (w + 0.5f + feat_ptr[2]) * stride;
                     float y1 = (h + 0.5f + feat_ptr[3]) * stride;
 
-                    float w = x1 - x0;
-                    float h = y1 - y0;
-
                     Object obj;
                     obj.rect.x = x0;
                     obj.rect.y = y0;
-                    obj.rect.width = w;
-                    obj.rect.height = h;
+                    obj.rect.width = x1 - x0;
+                    obj.rect.height = y1 - y0;
                     obj.label = class_index;
                     obj.prob = box_prob;
 
                     objects.push_back(obj);
                 }
-
-                feat_ptr += 84;
             }
         }
     }
@@ -962,17 +897,8 @@ namespace detection
                     }
 
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feature_ptr[s + 5 + 15];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feature_ptr + 5 + 15, cls_num);
+                    int class_index = find_score(feature_ptr + 5 + 15, cls_num, class_score);
                     //process box score
                     float box_score = feature_ptr[4];
                     float final_score = sigmoid(box_score) * sigmoid(class_score);
@@ -1051,17 +977,7 @@ namespace detection
                     }
 
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feature_ptr[s + 5 + 21];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feature_ptr + 5 + 21, cls_num);
                     //process box score
                     float box_score = feature_ptr[4];
                     float final_score = sigmoid(box_score) * sigmoid(class_score);
@@ -1139,7 +1055,6 @@ namespace detection
         auto cls_ptr = cls_feat;
         auto cls_idx_ptr = cls_idx;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
         for (int h = 0; h <= feat_h - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
@@ -1153,11 +1068,7 @@ namespace detection
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(dfl_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+                    dfl_decode_ltrb(dfl_ptr, reg_max, stride, pred_ltrb);
 
                     float pb_cx = (w + 0.5f) * stride;
                     float pb_cy = (h + 0.5f) * stride;
@@ -1198,7 +1109,6 @@ namespace detection
         auto cls_ptr = cls_feat;
         auto cls_idx_ptr = cls_idx;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
         for (int h = 0; h <= feat_h - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
@@ -1211,11 +1121,7 @@ namespace detection
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(dfl_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+                    dfl_decode_ltrb(dfl_ptr, reg_max, stride, pred_ltrb);
 
                     float pb_cx = (w + 0.5f) * stride;
                     float pb_cy = (h + 0.5f) * stride;
@@ -1257,7 +1163,6 @@ namespace detection
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
         for (int h = 0; h <= feat_h - 1; h++)
         {
             for (int w = 0; w <= feat_w - 1; w++)
@@ -1271,11 +1176,7 @@ namespace detection
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(bboxes + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+                    dfl_decode_ltrb(bboxes, reg_max, stride, pred_ltrb);
 
                     float pb_cx = (w + 0.5f) * stride;
                     float pb_cy = (h + 0.5f) * stride;
@@ -1315,41 +1216,35 @@ namespace detection
     }
 
     static void generate_proposals_yolov9(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                          int letterbox_cols, int letterbox_rows, int cls_num = 80)
+                                          int letterbox_cols, int letterbox_rows, int cls_num = 80, const GridRows& rows = GridRows())
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_ptr = feat;
+        int cell_step = cls_num + 4 * reg_max;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
+        // process cls score, only cells whose best logit passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat + 4 * reg_max, feat_w, feat_h, rows, cell_step, cls_num, logit_threshold(prob_threshold), candidates);
+
+        size_t next = 0;
         for (int h = 0; h <= feat_h - 1; h++)
         {
-            for (int w = 0; w <= feat_w - 1; w++)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
             {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+                const ClassCandidate& candidate = candidates[next];
+                int w = candidate.cell - h * feat_w;
+                auto feat_ptr = feat + candidate.cell * cell_step;
+
+                int class_index = candidate.label;
+                float class_score = candidate.score;
 
                 float box_prob = sigmoid(class_score);
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+                    dfl_decode_ltrb(feat_ptr, reg_max, stride, pred_ltrb);
 
                     float pb_cx = (w + 0.5f) * stride;
                     float pb_cy = (h + 0.5f) * stride;
@@ -1374,48 +1269,40 @@ namespace detection
 
                     objects.push_back(obj);
                 }
-
-                feat_ptr += (cls_num + 4 * reg_max);
             }
         }
     }
 
-    static void generate_proposals_yolov8_native(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                                 int letterbox_cols, int letterbox_rows, int cls_num = 80)
+    static void generate_proposals_yolov8_native(int stride, const float* feat, float prob_threshold, Proposals& proposals,
+                                                 int letterbox_cols, int letterbox_rows, int cls_num = 80, const GridRows& rows = GridRows())
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_ptr = feat;
+        int cell_step = cls_num + 4 * reg_max;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
+        // process cls score, only cells whose best logit passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat + 4 * reg_max, feat_w, feat_h, rows, cell_step, cls_num, logit_threshold(prob_threshold), candidates);
+
+        size_t next = 0;
         for (int h = 0; h <= feat_h - 1; h++)
         {
-            for (int w = 0; w <= feat_w - 1; w++)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
             {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+                const ClassCandidate& candidate = candidates[next];
+                int w = candidate.cell - h * feat_w;
+                auto feat_ptr = feat + candidate.cell * cell_step;
+
+                int class_index = candidate.label;
+                float class_score = candidate.score;
 
                 float box_prob = sigmoid(class_score);
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+                    dfl_decode_ltrb(feat_ptr, reg_max, stride, pred_ltrb);
 
                     float pb_cx = (w + 0.5f) * stride;
                     float pb_cy = (h + 0.5f) * stride;
@@ -1430,59 +1317,53 @@ namespace detection
                     x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
                     y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
 
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
-
-                    objects.push_back(obj);
+                    proposals.push(x0, y0, x1 - x0, y1 - y0, class_index, box_prob);
                 }
-
-                feat_ptr += (cls_num + 4 * reg_max);
             }
         }
     }
 
-    static void generate_proposals_yolov8_seg_native(int stride, const float* feat, const float* feat_seg, float prob_threshold, std::vector<Object>& objects,
-                                                     int letterbox_cols, int letterbox_rows, int cls_num = 80, int mask_proto_dim = 32)
+    static void generate_proposals_yolov8_native(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
+                                                 int letterbox_cols, int letterbox_rows, int cls_num = 80)
+    {
+        Proposals proposals;
+        generate_proposals_yolov8_native(stride, feat, prob_threshold, proposals, letterbox_cols, letterbox_rows, cls_num);
+        append_objects(proposals, objects);
+    }
+
+    static void generate_proposals_yolov8_seg_native(int stride, const float* feat, const float* feat_seg, float prob_threshold, Proposals& proposals,
+                                                     int letterbox_cols, int letterbox_rows, int cls_num = 80, int mask_proto_dim = 32, const GridRows& rows = GridRows())
     {
+        proposals.set_feat(CANDIDATE_FEAT_MASK, mask_proto_dim);
+
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_ptr = feat;
-        auto feat_seg_ptr = feat_seg;
+        int cell_step = cls_num + 4 * reg_max;
+
+        // process cls score, only cells whose best logit passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat + 4 * reg_max, feat_w, feat_h, rows, cell_step, cls_num, logit_threshold(prob_threshold), candidates);
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
+        size_t next = 0;
         for (int h = 0; h <= feat_h - 1; h++)
         {
-            for (int w = 0; w <= feat_w - 1; w++)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
             {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+                const ClassCandidate& candidate = candidates[next];
+                int w = candidate.cell - h * feat_w;
+                auto feat_ptr = feat + candidate.cell * cell_step;
+                auto feat_seg_ptr = feat_seg + candidate.cell * mask_proto_dim;
+
+                int class_index = candidate.label;
+                float class_score = candidate.score;
 
                 float box_prob = sigmoid(class_score);
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+                    dfl_decode_ltrb(feat_ptr, reg_max, stride, pred_ltrb);
 
                     float pb_cx = (w + 0.5f) * stride;
                     float pb_cy = (h + 0.5f) * stride;
@@ -1497,64 +1378,54 @@ namespace detection
                     x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
                     y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
 
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
-                    obj.mask_feat.resize(mask_proto_dim);
-                    memcpy(obj.mask_feat.data(), feat_seg_ptr, sizeof(float) * mask_proto_dim);
-                    // for (int k = 0; k < mask_proto_dim; k++)
-                    // {
-                    //     obj.mask_feat[k] = feat_seg_ptr[k];
-                    // }
-                    objects.push_back(obj);
+                    float* mask_feat = proposals.push(x0, y0, x1 - x0, y1 - y0, class_index, box_prob);
+                    memcpy(mask_feat, feat_seg_ptr, sizeof(float) * mask_proto_dim);
                 }
-
-                feat_ptr += cls_num + 4 * reg_max;
-                feat_seg_ptr += mask_proto_dim;
             }
         }
     }
 
-    static void generate_proposals_yolov8_pose_native(int stride, const float* feat, const float* feat_kps, float prob_threshold, std::vector<Object>& objects,
-                                                      int letterbox_cols, int letterbox_rows, const int num_point = 17, int cls_num = 1)
+    static void generate_proposals_yolov8_seg_native(int stride, const float* feat, const float* feat_seg, float prob_threshold, std::vector<Object>& objects,
+                                                     int letterbox_cols, int letterbox_rows, int cls_num = 80, int mask_proto_dim = 32)
     {
+        Proposals proposals;
+        generate_proposals_yolov8_seg_native(stride, feat, feat_seg, prob_threshold, proposals, letterbox_cols, letterbox_rows, cls_num, mask_proto_dim);
+        append_objects(proposals, objects);
+    }
+
+    static void generate_proposals_yolov8_pose_native(int stride, const float* feat, const float* feat_kps, float prob_threshold, Proposals& proposals,
+                                                      int letterbox_cols, int letterbox_rows, const int num_point = 17, int cls_num = 1, const GridRows& rows = GridRows())
+    {
+        proposals.set_feat(CANDIDATE_FEAT_KPS, 3 * num_point);
+
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_ptr = feat;
+        int cell_step = cls_num + 4 * reg_max;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
+        // process cls score, only cells whose best logit passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat + 4 * reg_max, feat_w, feat_h, rows, cell_step, cls_num, logit_threshold(prob_threshold), candidates);
+
+        size_t next = 0;
         for (int h = 0; h <= feat_h - 1; h++)
         {
-            for (int w = 0; w <= feat_w - 1; w++)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
             {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+                const ClassCandidate& candidate = candidates[next];
+                int w = candidate.cell - h * feat_w;
+                auto feat_ptr = feat + candidate.cell * cell_step;
+                auto feat_kps_ptr = feat_kps + candidate.cell * 3 * num_point;
+
+                int class_index = candidate.label;
+                float class_score = candidate.score;
 
                 float box_prob = sigmoid(class_score);
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+                    dfl_decode_ltrb(feat_ptr, reg_max, stride, pred_ltrb);
 
                     float pb_cx = (w + 0.5f) * stride;
                     float pb_cy = (h + 0.5f) * stride;
@@ -1569,70 +1440,57 @@ namespace detection
                     x1 = std::max(std::min(x1, (float)(letterbox_cols - 1)), 0.f);
                     y1 = std::max(std::min(y1, (float)(letterbox_rows - 1)), 0.f);
 
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = class_index;
-                    obj.prob = box_prob;
-                    obj.kps_feat.clear();
+                    float* kps_feat = proposals.push(x0, y0, x1 - x0, y1 - y0, class_index, box_prob);
                     for (int k = 0; k < num_point; k++)
                     {
-                        float kps_x = (feat_kps[k * 3] * 2.f + w) * stride;
-                        float kps_y = (feat_kps[k * 3 + 1] * 2.f + h) * stride;
-                        float kps_s = sigmoid(feat_kps[k * 3 + 2]);
-                        obj.kps_feat.push_back(kps_x);
-                        obj.kps_feat.push_back(kps_y);
-                        obj.kps_feat.push_back(kps_s);
+                        kps_feat[k * 3] = (feat_kps_ptr[k * 3] * 2.f + w) * stride;
+                        kps_feat[k * 3 + 1] = (feat_kps_ptr[k * 3 + 1] * 2.f + h) * stride;
+                        kps_feat[k * 3 + 2] = sigmoid(feat_kps_ptr[k * 3 + 2]);
                     }
-                    objects.push_back(obj);
                 }
-                feat_ptr += (cls_num + 4 * reg_max);
-                feat_kps += 3 * num_point;
             }
         }
     }
 
+    static void generate_proposals_yolov8_pose_native(int stride, const float* feat, const float* feat_kps, float prob_threshold, std::vector<Object>& objects,
+                                                      int letterbox_cols, int letterbox_rows, const int num_point = 17, int cls_num = 1)
+    {
+        Proposals proposals;
+        generate_proposals_yolov8_pose_native(stride, feat, feat_kps, prob_threshold, proposals, letterbox_cols, letterbox_rows, num_point, cls_num);
+        append_objects(proposals, objects);
+    }
+
     static void generate_proposals_yolo_world(int stride, const float* feat_cls, const float* feat_reg, float exp, float bias, float prob_threshold, std::vector<Object>& objects,
-                                              int letterbox_cols, int letterbox_rows, int cls_num = 80)
+                                              int letterbox_cols, int letterbox_rows, int cls_num = 80, const GridRows& rows = GridRows())
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
         int reg_max = 16;
 
-        auto feat_cls_ptr = feat_cls;
-        auto feat_reg_ptr = feat_reg;
+        // the scores are scaled as score * exp + bias before the sigmoid, move the threshold back to raw scores
+        float raw_threshold = exp > 0.f ? (logit_threshold(prob_threshold) - bias) / exp : -FLT_MAX;
 
-        std::vector<float> dis_after_sm(reg_max, 0.f);
+        // process cls score, only cells whose best logit passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat_cls, feat_w, feat_h, rows, cls_num, cls_num, raw_threshold, candidates);
+
+        size_t next = 0;
         for (int h = 0; h <= feat_h - 1; h++)
         {
-            for (int w = 0; w <= feat_w - 1; w++)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
             {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_cls_ptr[s];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+                const ClassCandidate& candidate = candidates[next];
+                int w = candidate.cell - h * feat_w;
+                auto feat_reg_ptr = feat_reg + candidate.cell * 4 * reg_max;
 
-                class_score = class_score * exp + bias;
+                int class_index = candidate.label;
+                float class_score = candidate.score * exp + bias;
 
                 float box_prob = sigmoid(class_score);
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_reg_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * stride;
-                    }
+                    dfl_decode_ltrb(feat_reg_ptr, reg_max, stride, pred_ltrb);
 
                     float pb_cx = (w + 0.5f) * stride;
                     float pb_cy = (h + 0.5f) * stride;
@@ -1657,9 +1515,6 @@ namespace detection
 
                     objects.push_back(obj);
                 }
-
-                feat_cls_ptr += cls_num;
-                feat_reg_ptr += 4 * reg_max;
             }
         }
     }
@@ -1689,18 +1544,9 @@ namespace detection
                 for (int a = 0; a <= anchor_num - 1; a++)
                 {
                     //process cls score
-                    int class_index = 0;
-                    float class_score = -FLT_MAX;
                     int offset = a * a_stride + h * h_stride + w * w_stride;
-                    for (int s = 0; s <= cls_num - 1; s++)
-                    {
-                        float score = feat[offset + s + 5];
-                        if (score > class_score)
-                        {
-                            class_index = s;
-                            class_score = score;
-                        }
-                    }
+                    float class_score = max_score(feat + offset + 5, cls_num);
+                    int class_index = find_score(feat + offset + 5, cls_num, class_score);
                     //process box score
                     float box_score = feat[offset + 4];
                     float final_score = sigmoid(box_score) * sigmoid(class_score);
@@ -1802,6 +1648,7 @@ namespace detection
 
     static void draw_objects(const cv::Mat& bgr, const std::vector<Object>& objects, const char** class_names, const char* output_name, double fontScale = 0.5, int thickness = 1)
     {
+        AX_TRACE_SCOPE("draw");
         static const std::vector<cv::Scalar> COCO_COLORS = {
             {128, 56, 0, 255}, {128, 226, 255, 0}, {128, 0, 94, 255}, {128, 0, 37, 255}, {128, 0, 255, 94}, {128, 255, 226, 0}, {128, 0, 18, 255}, {128, 255, 151, 0}, {128, 170, 0, 255}, {128, 0, 255, 56}, {128, 255, 0, 75}, {128, 0, 75, 255}, {128, 0, 255, 169}, {128, 255, 0, 207}, {128, 75, 255, 0}, {128, 207, 0, 255}, {128, 37, 0, 255}, {128, 0, 207, 255}, {128, 94, 0, 255}, {128, 0, 255, 113}, {128, 255, 18, 0}, {128, 255, 0, 56}, {128, 18, 0, 255}, {128, 0, 255, 226}, {128, 170, 255, 0}, {128, 255, 0, 245}, {128, 151, 255, 0}, {128, 132, 255, 0}, {128, 75, 0, 255}, {128, 151, 0, 255}, {128, 0, 151, 255}, {128, 132, 0, 255}, {128, 0, 255, 245}, {128, 255, 132, 0}, {128, 226, 0, 255}, {128, 255, 37, 0}, {128, 207, 255, 0}, {128, 0, 255, 207}, {128, 94, 255, 0}, {128, 0, 226, 255}, {128, 56, 255, 0}, {128, 255, 94, 0}, {128, 255, 113, 0}, {128, 0, 132, 255}, {128, 255, 0, 132}, {128, 255, 170, 0}, {128, 255, 0, 188}, {128, 113, 255, 0}, {128, 245, 0, 255}, {128, 113, 0, 255}, {128, 255, 188, 0}, {128, 0, 113, 255}, {128, 255, 0, 0}, {128, 0, 56, 255}, {128, 255, 0, 113}, {128, 0, 255, 188}, {128, 255, 0, 94}, {128, 255, 0, 18}, {128, 18, 255, 0}, {128, 0, 255, 132}, {128, 0, 188, 255}, {128, 0, 245, 255}, {128, 0, 169, 255}, {128, 37, 255, 0}, {128, 255, 0, 151}, {128, 188, 0, 255}, {128, 0, 255, 37}, {128, 0, 255, 0}, {128, 255, 0, 170}, {128, 255, 0, 37}, {128, 255, 75, 0}, {128, 0, 0, 255}, {128, 255, 207, 0}, {128, 255, 0, 226}, {128, 255, 245, 0}, {128, 188, 255, 0}, {128, 0, 255, 18}, {128, 0, 255, 75}, {128, 0, 255, 151}, {128, 255, 56, 0}, {128, 245, 255, 0}};
         cv::Mat image = bgr.clone();
@@ -1912,6 +1759,7 @@ namespace detection
 
     static void draw_objects_mask(const cv::Mat& bgr, const std::vector<Object>& objects, const char** class_names, const std::vector<std::vector<uint8_t> >& colors, const char* output_name)
     {
+        AX_TRACE_SCOPE("draw");
         cv::Mat image = bgr.clone();
         cv::Mat mask = bgr.clone();
         int color_index = 0;
@@ -2047,11 +1895,10 @@ namespace detection
         }
     }
 
-    void get_out_bbox_no_letterbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int model_h, int model_w, int src_rows, int src_cols)
+    void get_out_bbox_no_letterbox(std::vector<Object>& proposals, std::vector<Object>& objects, const NmsParam& nms, int model_h, int model_w, int src_rows, int src_cols)
     {
-        qsort_descent_inplace(proposals);
         std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        nms_bboxes(proposals, picked, nms);
 
         /* yolov5 draw the result */
         float ratio_x = (float)src_cols / (float)model_w;
@@ -2109,8 +1956,6 @@ namespace detection
         float ratio_y = (float)src_cols / resize_cols;
 
         int count = objects.size();
-
-        objects.resize(count);
         for (int i = 0; i < count; i++)
         {
             float x0 = (objects[i].rect.x);
@@ -2142,12 +1987,32 @@ namespace detection
         }
     }
 
-    void get_out_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    void get_out_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    {
+        std::vector<int> picked;
+        nms_bboxes(proposals, picked, nms);
+
+        int count = picked.size();
+        objects.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            objects[i] = proposals[picked[i]];
+        }
+        get_out_bbox(objects, letterbox_rows, letterbox_cols, src_rows, src_cols);
+    }
+
+    void get_out_bbox(Proposals& proposals, std::vector<Object>& objects, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
     {
-        qsort_descent_inplace(proposals);
         std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        nms_bboxes(proposals.candidates, picked, nms);
+        materialize_objects(proposals, picked, objects);
+        get_out_bbox(objects, letterbox_rows, letterbox_cols, src_rows, src_cols);
+    }
 
+    // letterbox back to the source image for objects that already went through nms. the masks are
+    // left in `masks` at proto resolution, masks.decode(i, ...) makes the one of objects[i] on demand
+    void get_out_bbox_mask(std::vector<Object>& objects, InstanceMasks& masks, const float* mask_proto, int mask_proto_dim, int mask_stride, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    {
         /* yolov5 draw the result */
         float scale_letterbox;
         int resize_rows;
@@ -2169,15 +2034,29 @@ namespace detection
         float ratio_x = (float)src_rows / resize_rows;
         float ratio_y = (float)src_cols / resize_cols;
 
-        int count = picked.size();
+        int mask_proto_h = int(letterbox_rows / mask_stride);
+        int mask_proto_w = int(letterbox_cols / mask_stride);
 
-        objects.resize(count);
+        int count = objects.size();
+
+        /* the mask coefficients of all objects against the protos under their boxes */
+        std::vector<float> boxes(count * 4);
+        std::vector<const float*> coefs(count);
         for (int i = 0; i < count; i++)
         {
-            objects[i] = proposals[picked[i]];
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
+            boxes[i * 4] = objects[i].rect.x;
+            boxes[i * 4 + 1] = objects[i].rect.y;
+            boxes[i * 4 + 2] = objects[i].rect.width;
+            boxes[i * 4 + 3] = objects[i].rect.height;
+            coefs[i] = objects[i].mask_feat.data();
+        }
+        masks.assemble(mask_proto, mask_proto_dim, mask_proto_h, mask_proto_w, mask_stride, boxes.data(), coefs.data(), count);
+
+        for (int i = 0; i < count; i++)
+        {
+            float x0 = (objects[i].rect.x);
+            float y0 = (objects[i].rect.y);
+            float x1 = (objects[i].rect.x + objects[i].rect.width);
             float y1 = (objects[i].rect.y + objects[i].rect.height);
 
             x0 = (x0 - tmp_w) * ratio_x;
@@ -2185,13 +2064,6 @@ namespace detection
             x1 = (x1 - tmp_w) * ratio_x;
             y1 = (y1 - tmp_h) * ratio_y;
 
-            for (int l = 0; l < 5; l++)
-            {
-                auto lx = objects[i].landmark[l].x;
-                auto ly = objects[i].landmark[l].y;
-                objects[i].landmark[l] = cv::Point2f((lx - tmp_w) * ratio_x, (ly - tmp_h) * ratio_y);
-            }
-
             x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
             y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
             x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
@@ -2204,105 +2076,46 @@ namespace detection
         }
     }
 
-    void get_out_bbox_mask(std::vector<Object>& proposals, std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    // letterbox back to the source image for objects that already went through nms, with the mask
+    // of every object at the size of its box
+    void get_out_bbox_mask(std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
     {
-        qsort_descent_inplace(proposals);
-        std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        InstanceMasks masks;
+        get_out_bbox_mask(objects, masks, mask_proto, mask_proto_dim, mask_stride, letterbox_rows, letterbox_cols, src_rows, src_cols);
 
-        /* yolov5 draw the result */
-        float scale_letterbox;
-        int resize_rows;
-        int resize_cols;
-        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
-        {
-            scale_letterbox = letterbox_rows * 1.0 / src_rows;
-        }
-        else
+        int count = objects.size();
+        for (int i = 0; i < count; i++)
         {
-            scale_letterbox = letterbox_cols * 1.0 / src_cols;
+            objects[i].mask = cv::Mat((int)objects[i].rect.height, (int)objects[i].rect.width, CV_8UC1);
+            masks.decode(i, objects[i].mask.cols, objects[i].mask.rows, objects[i].mask.data, objects[i].mask.step);
         }
-        resize_cols = int(scale_letterbox * src_cols);
-        resize_rows = int(scale_letterbox * src_rows);
-
-        int tmp_h = (letterbox_rows - resize_rows) / 2;
-        int tmp_w = (letterbox_cols - resize_cols) / 2;
-
-        float ratio_x = (float)src_rows / resize_rows;
-        float ratio_y = (float)src_cols / resize_cols;
+    }
 
-        int mask_proto_h = int(letterbox_rows / mask_stride);
-        int mask_proto_w = int(letterbox_cols / mask_stride);
+    void get_out_bbox_mask(std::vector<Object>& proposals, std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    {
+        std::vector<int> picked;
+        nms_bboxes(proposals, picked, nms);
 
         int count = picked.size();
         objects.resize(count);
-
         for (int i = 0; i < count; i++)
         {
             objects[i] = proposals[picked[i]];
-            float x0 = (objects[i].rect.x);
-            float y0 = (objects[i].rect.y);
-            float x1 = (objects[i].rect.x + objects[i].rect.width);
-            float y1 = (objects[i].rect.y + objects[i].rect.height);
-            /* naive RoiAlign by opencv */
-            int hstart = std::floor(objects[i].rect.y / mask_stride);
-            int hend = std::ceil(objects[i].rect.y / mask_stride + objects[i].rect.height / mask_stride);
-            int wstart = std::floor(objects[i].rect.x / mask_stride);
-            int wend = std::ceil(objects[i].rect.x / mask_stride + objects[i].rect.width / mask_stride);
-
-            hstart = std::min(std::max(hstart, 0), mask_proto_h);
-            wstart = std::min(std::max(wstart, 0), mask_proto_w);
-            hend = std::min(std::max(hend, 0), mask_proto_h);
-            wend = std::min(std::max(wend, 0), mask_proto_w);
-
-            int mask_w = wend - wstart;
-            int mask_h = hend - hstart;
-
-            cv::Mat mask = cv::Mat(mask_h, mask_w, CV_32FC1);
-            if (mask_w > 0 && mask_h > 0)
-            {
-                std::vector<cv::Range> roi_ranges;
-                roi_ranges.push_back(cv::Range(0, 1));
-                roi_ranges.push_back(cv::Range::all());
-                roi_ranges.push_back(cv::Range(hstart, hend));
-                roi_ranges.push_back(cv::Range(wstart, wend));
-
-                cv::Mat mask_protos = cv::Mat(mask_proto_dim, mask_proto_h * mask_proto_w, CV_32FC1, (float*)mask_proto);
-                int sz[] = {1, mask_proto_dim, mask_proto_h, mask_proto_w};
-                cv::Mat mask_protos_reshape = mask_protos.reshape(1, 4, sz);
-                cv::Mat protos = mask_protos_reshape(roi_ranges).clone().reshape(0, {mask_proto_dim, mask_w * mask_h});
-                cv::Mat mask_proposals = cv::Mat(1, mask_proto_dim, CV_32FC1, (float*)objects[i].mask_feat.data());
-                cv::Mat masks_feature = (mask_proposals * protos);
-                /* sigmoid */
-                cv::exp(-masks_feature.reshape(1, {mask_h, mask_w}), mask);
-                mask = 1.0 / (1.0 + mask);
-            }
-
-            x0 = (x0 - tmp_w) * ratio_x;
-            y0 = (y0 - tmp_h) * ratio_y;
-            x1 = (x1 - tmp_w) * ratio_x;
-            y1 = (y1 - tmp_h) * ratio_y;
-
-            x0 = std::max(std::min(x0, (float)(src_cols - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(src_rows - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(src_cols - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(src_rows - 1)), 0.f);
-
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
-            cv::resize(mask, mask, cv::Size((int)objects[i].rect.width, (int)objects[i].rect.height));
-            objects[i].mask = mask > 0.5;
         }
+        get_out_bbox_mask(objects, mask_proto, mask_proto_dim, mask_stride, letterbox_rows, letterbox_cols, src_rows, src_cols);
     }
 
-    void get_out_bbox_kps(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    void get_out_bbox_mask(Proposals& proposals, std::vector<Object>& objects, const float* mask_proto, int mask_proto_dim, int mask_stride, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
     {
-        qsort_descent_inplace(proposals);
         std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        nms_bboxes(proposals.candidates, picked, nms);
+        materialize_objects(proposals, picked, objects);
+        get_out_bbox_mask(objects, mask_proto, mask_proto_dim, mask_stride, letterbox_rows, letterbox_cols, src_rows, src_cols);
+    }
 
+    // letterbox back to the source image for objects that already went through nms
+    void get_out_bbox_kps(std::vector<Object>& objects, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    {
         /* yolov8 draw the result */
         float scale_letterbox;
         int resize_rows;
@@ -2324,12 +2137,9 @@ namespace detection
         float ratio_x = (float)src_rows / resize_rows;
         float ratio_y = (float)src_cols / resize_cols;
 
-        int count = picked.size();
-
-        objects.resize(count);
+        int count = objects.size();
         for (int i = 0; i < count; i++)
         {
-            objects[i] = proposals[picked[i]];
             float x0 = (objects[i].rect.x);
             float y0 = (objects[i].rect.y);
             float x1 = (objects[i].rect.x + objects[i].rect.width);
@@ -2360,6 +2170,28 @@ namespace detection
         }
     }
 
+    void get_out_bbox_kps(std::vector<Object>& proposals, std::vector<Object>& objects, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    {
+        std::vector<int> picked;
+        nms_bboxes(proposals, picked, nms);
+
+        int count = picked.size();
+        objects.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            objects[i] = proposals[picked[i]];
+        }
+        get_out_bbox_kps(objects, letterbox_rows, letterbox_cols, src_rows, src_cols);
+    }
+
+    void get_out_bbox_kps(Proposals& proposals, std::vector<Object>& objects, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    {
+        std::vector<int> picked;
+        nms_bboxes(proposals.candidates, picked, nms);
+        materialize_objects(proposals, picked, objects);
+        get_out_bbox_kps(objects, letterbox_rows, letterbox_cols, src_rows, src_cols);
+    }
+
     static void transform_rects_palm(PalmObject& object)
     {
         float x0 = object.landmarks[0].x;
@@ -2409,11 +2241,10 @@ namespace detection
         }
     }
 
-    static void get_out_bbox_palm(std::vector<PalmObject>& proposals, std::vector<PalmObject>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    static void get_out_bbox_palm(std::vector<PalmObject>& proposals, std::vector<PalmObject>& objects, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
     {
-        qsort_descent_inplace(proposals);
         std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        nms_bboxes(proposals, picked, nms);
 
         int count = picked.size();
         objects.resize(count);
@@ -2474,11 +2305,10 @@ namespace detection
         }
     }
 
-    void get_out_bbox_yolopv2(std::vector<Object>& proposals, std::vector<Object>& objects, const float* da_ptr, const float* ll_ptr, cv::Mat& ll_seg_mask, cv::Mat& da_seg_mask, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+    void get_out_bbox_yolopv2(std::vector<Object>& proposals, std::vector<Object>& objects, const float* da_ptr, const float* ll_ptr, cv::Mat& ll_seg_mask, cv::Mat& da_seg_mask, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
     {
-        qsort_descent_inplace(proposals);
         std::vector<int> picked;
-        nms_sorted_bboxes(proposals, picked, nms_threshold);
+        nms_bboxes(proposals, picked, nms);
 
         /* yolov5 draw the result */
         float scale_letterbox;
@@ -2563,26 +2393,8 @@ namespace detection
             return 1.0f / (1.0f + fast_exp(-x));
         }
 
-        inline static float fast_softmax(
-            const float* src,
-            float* dst,
-            int length)
-        {
-            const float alpha = *std::max_element(src, src + length);
-            float denominator = 0;
-            float dis_sum = 0;
-            for (int i = 0; i < length; ++i)
-            {
-                dst[i] = fast_exp(src[i] - alpha);
-                denominator += dst[i];
-            }
-            for (int i = 0; i < length; ++i)
-            {
-                dst[i] /= denominator;
-                dis_sum += i * dst[i];
-            }
-            return dis_sum;
-        }
+        // fast_exp is a few percent off, so the logit gate keeps some slack and fast_sigmoid still decides
+        const float FAST_LOGIT_SLACK = 0.1f;
 
         static void generate_proposals_ppyoloeplus(
             int stride,
@@ -2596,24 +2408,31 @@ namespace detection
         {
             int feat_w = letterbox_cols / stride;
             int feat_h = letterbox_rows / stride;
-            auto cls_ptr = cls_feat;
-            auto boxes_ptr = box_feat;
             int reg_max = 17;
-            float dis_after_sm[reg_max];
 
-            for (int h = 0; h < feat_h; h++)
+            // process cls score, only cells whose best logit passes come back
+            std::vector<ClassCandidate> candidates;
+            scan_class_scores(cls_feat, feat_w * feat_h, cls_num, cls_num, logit_threshold(prob_threshold) - FAST_LOGIT_SLACK, candidates);
+
+            size_t next = 0;
+            for (int h = 0; h <= feat_h - 1; h++)
             {
-                for (int w = 0; w < feat_w; w++)
+                for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
                 {
-                    auto max = std::max_element(cls_ptr, cls_ptr + cls_num);
-                    float box_prob = fast_sigmoid(*max);
+                    const ClassCandidate& candidate = candidates[next];
+                    int w = candidate.cell - h * feat_w;
+                    auto boxes_ptr = box_feat + candidate.cell * 4 * reg_max;
+
+                    float box_prob = fast_sigmoid(candidate.score);
 
                     if (box_prob > prob_threshold)
                     {
-                        float x0 = w + 0.5f - fast_softmax(boxes_ptr, dis_after_sm, reg_max);
-                        float y0 = h + 0.5f - fast_softmax(boxes_ptr + reg_max, dis_after_sm, reg_max);
-                        float x1 = w + 0.5f + fast_softmax(boxes_ptr + 2 * reg_max, dis_after_sm, reg_max);
-                        float y1 = h + 0.5f + fast_softmax(boxes_ptr + 3 * reg_max, dis_after_sm, reg_max);
+                        float pred_ltrb[4];
+                        dfl_decode_ltrb(boxes_ptr, reg_max, 1.f, pred_ltrb);
+                        float x0 = w + 0.5f - pred_ltrb[0];
+                        float y0 = h + 0.5f - pred_ltrb[1];
+                        float x1 = w + 0.5f + pred_ltrb[2];
+                        float y1 = h + 0.5f + pred_ltrb[3];
 
                         x0 *= stride;
                         y0 *= stride;
@@ -2630,13 +2449,11 @@ namespace detection
                         obj.rect.y = y0;
                         obj.rect.width = x1 - x0;
                         obj.rect.height = y1 - y0;
-                        obj.label = max - cls_ptr;
+                        obj.label = candidate.label;
                         obj.prob = box_prob;
 
                         objects.push_back(obj);
                     }
-                    cls_ptr += cls_num;
-                    boxes_ptr += 4 * reg_max;
                 }
             }
         }
@@ -2663,8 +2480,8 @@ namespace detection
                 for (int w = 0; w < feat_w; w++)
                 {
                     //process cls score
-                    auto max = std::max_element(cls_ptr, cls_ptr + cls_num);
-                    float box_prob = fast_sigmoid(*max) * fast_sigmoid(*conf_ptr);
+                    float class_score = max_score(cls_ptr, cls_num);
+                    float box_prob = fast_sigmoid(class_score) * fast_sigmoid(*conf_ptr);
 
                     if (box_prob > prob_threshold)
                     {
@@ -2685,7 +2502,7 @@ namespace detection
                         obj.rect.y = y0;
                         obj.rect.width = width;
                         obj.rect.height = height;
-                        obj.label = max - cls_ptr;
+                        obj.label = find_score(cls_ptr, cls_num, class_score);
                         obj.prob = box_prob;
 
                         objects.push_back(obj);
@@ -2709,16 +2526,21 @@ namespace detection
         {
             int feat_w = letterbox_cols / stride;
             int feat_h = letterbox_rows / stride;
-            auto cls_ptr = cls_feat;
-            auto boxes_ptr = box_feat;
 
-            for (int h = 0; h < feat_h; h++)
+            // process cls score, only cells whose best logit passes come back
+            std::vector<ClassCandidate> candidates;
+            scan_class_scores(cls_feat, feat_w * feat_h, cls_num, cls_num, logit_threshold(prob_threshold) - FAST_LOGIT_SLACK, candidates);
+
+            size_t next = 0;
+            for (int h = 0; h <= feat_h - 1; h++)
             {
-                for (int w = 0; w < feat_w; w++)
+                for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
                 {
-                    //process cls score
-                    auto max = std::max_element(cls_ptr, cls_ptr + cls_num);
-                    float box_prob = fast_sigmoid(*max);
+                    const ClassCandidate& candidate = candidates[next];
+                    int w = candidate.cell - h * feat_w;
+                    auto boxes_ptr = box_feat + candidate.cell * 4;
+
+                    float box_prob = fast_sigmoid(candidate.score);
 
                     if (box_prob > prob_threshold)
                     {
@@ -2737,13 +2559,11 @@ namespace detection
                         obj.rect.y = y0;
                         obj.rect.width = x1 - x0;
                         obj.rect.height = y1 - y0;
-                        obj.label = max - cls_ptr;
+                        obj.label = candidate.label;
                         obj.prob = box_prob;
 
                         objects.push_back(obj);
                     }
-                    cls_ptr += cls_num;
-                    boxes_ptr += 4;
                 }
             }
         }
@@ -2760,24 +2580,31 @@ namespace detection
         {
             int feat_w = letterbox_cols / stride;
             int feat_h = letterbox_rows / stride;
-            auto cls_ptr = cls_feat;
-            auto boxes_ptr = box_feat;
             int reg_max = 16;
-            float dis_after_sm[reg_max];
 
-            for (int h = 0; h < feat_h; h++)
+            // process cls score, only cells whose best logit passes come back
+            std::vector<ClassCandidate> candidates;
+            scan_class_scores(cls_feat, feat_w * feat_h, cls_num, cls_num, logit_threshold(prob_threshold) - FAST_LOGIT_SLACK, candidates);
+
+            size_t next = 0;
+            for (int h = 0; h <= feat_h - 1; h++)
             {
-                for (int w = 0; w < feat_w; w++)
+                for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
                 {
-                    auto max = std::max_element(cls_ptr, cls_ptr + cls_num);
-                    float box_prob = fast_sigmoid(*max);
+                    const ClassCandidate& candidate = candidates[next];
+                    int w = candidate.cell - h * feat_w;
+                    auto boxes_ptr = box_feat + candidate.cell * 4 * reg_max;
+
+                    float box_prob = fast_sigmoid(candidate.score);
 
                     if (box_prob > prob_threshold)
                     {
-                        float x0 = w + 0.5f - fast_softmax(boxes_ptr, dis_after_sm, reg_max);
-                        float y0 = h + 0.5f - fast_softmax(boxes_ptr + reg_max, dis_after_sm, reg_max);
-                        float x1 = w + 0.5f + fast_softmax(boxes_ptr + 2 * reg_max, dis_after_sm, reg_max);
-                        float y1 = h + 0.5f + fast_softmax(boxes_ptr + 3 * reg_max, dis_after_sm, reg_max);
+                        float pred_ltrb[4];
+                        dfl_decode_ltrb(boxes_ptr, reg_max, 1.f, pred_ltrb);
+                        float x0 = w + 0.5f - pred_ltrb[0];
+                        float y0 = h + 0.5f - pred_ltrb[1];
+                        float x1 = w + 0.5f + pred_ltrb[2];
+                        float y1 = h + 0.5f + pred_ltrb[3];
 
                         x0 *= stride;
                         y0 *= stride;
@@ -2794,13 +2621,11 @@ namespace detection
                         obj.rect.y = y0;
                         obj.rect.width = x1 - x0;
                         obj.rect.height = y1 - y0;
-                        obj.label = max - cls_ptr;
+                        obj.label = candidate.label;
                         obj.prob = box_prob;
 
                         objects.push_back(obj);
                     }
-                    cls_ptr += cls_num;
-                    boxes_ptr += 4 * reg_max;
                 }
             }
         }
@@ -2889,6 +2714,8 @@ namespace detection
             return iou;
         }
 
+        // the pairwise loop nms_rotated_probiou replaced, kept as its reference. fast_log / fast_exp
+        // make it a few % off near the threshold
         static inline void nms_rotated_sorted_bboxes(
             const std::vector<Object>& objects,
             std::vector<int>& picked,
@@ -2919,11 +2746,12 @@ namespace detection
                     picked.push_back(i);
             }
         }
-        static void get_out_obb_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const float nms_threshold, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
+        static void get_out_obb_bbox(std::vector<Object>& proposals, std::vector<Object>& objects, const NmsParam& nms, int letterbox_rows, int letterbox_cols, int src_rows, int src_cols)
         {
             qsort_descent_inplace(proposals);
             std::vector<int> picked;
-            obb::nms_rotated_sorted_bboxes(proposals, picked, nms_threshold);
+            // this path has always kept a box while bc < (1 - iou_threshold)^2
+            nms_rotated_probiou(proposals, picked, (1.f - nms.iou_threshold) * (1.f - nms.iou_threshold), nms.class_aware, nms.max_det);
 
             /* yolov5 draw the result */
             float scale_letterbox;
@@ -2981,32 +2809,24 @@ namespace detection
         {
             const int num_points = grid_strides.size();
             int reg_max = 16;
-            auto feat_ptr = feat;
-            std::vector<float> dis_after_sm(reg_max, 0.f);
-            for (int i = 0; i < num_points; i++)
+            int cell_step = cls_num + 4 * reg_max + 1;
+
+            // process cls score, only points whose best logit passes come back
+            std::vector<ClassCandidate> candidates;
+            scan_class_scores(feat + 4 * reg_max, num_points, cell_step, cls_num, logit_threshold(prob_threshold), candidates);
+
+            for (const auto& candidate : candidates)
             {
-                // process cls score
-                int class_index = 0;
-                float class_score = -FLT_MAX;
-                for (int s = 0; s < cls_num; s++)
-                {
-                    float score = feat_ptr[s + 4 * reg_max];
-                    if (score > class_score)
-                    {
-                        class_index = s;
-                        class_score = score;
-                    }
-                }
+                int i = candidate.cell;
+                auto feat_ptr = feat + i * cell_step;
+                int class_index = candidate.label;
+                float class_score = candidate.score;
 
                 float box_prob = sigmoid(class_score);
                 if (box_prob > prob_threshold)
                 {
                     float pred_ltrb[4];
-                    for (int k = 0; k < 4; k++)
-                    {
-                        float dis = softmax(feat_ptr + k * reg_max, dis_after_sm.data(), reg_max);
-                        pred_ltrb[k] = dis * grid_strides[i].stride;
-                    }
+                    dfl_decode_ltrb(feat_ptr, reg_max, grid_strides[i].stride, pred_ltrb);
 
                     float angle = feat_ptr[4 * reg_max + cls_num];
 
@@ -3034,7 +2854,6 @@ namespace detection
 
                     objects.push_back(obj);
                 }
-                feat_ptr += (cls_num + 4 * reg_max + 1);
             }
         }
         static void generate_proposals_yolo26_obb(int stride, const float* feat_box, const float* feat_cls, const float* feat_angle,
@@ -3051,58 +2870,32 @@ namespace detection
                 reg_max = box_channels / 4;
             }
 
-            const float p = std::min(std::max(prob_threshold, 1e-6f), 1.f - 1e-6f);
-            const float conf_raw = std::log(p / (1.f - p));
-
             const int cls_stride_elems = std::max(1, cls_num);
             const int ang_stride_elems = std::max(1, angle_ch);
 
-            std::vector<float> dfl_sm_buf;
-            if (reg_max > 1)
-            {
-                dfl_sm_buf.resize(reg_max);
-            }
+            // process cls score, only cells whose best logit passes come back
+            std::vector<ClassCandidate> candidates;
+            scan_class_scores(feat_cls, feat_w * feat_h, cls_stride_elems, cls_stride_elems, logit_threshold(prob_threshold), candidates);
 
+            size_t next = 0;
             for (int h = 0; h < feat_h; ++h)
             {
-                for (int w = 0; w < feat_w; ++w)
+                for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; ++next)
                 {
-                    const float* cls_ptr = feat_cls + (h * feat_w + w) * cls_stride_elems;
-                    int best_c = 0;
-                    float best_logit = -FLT_MAX;
-                    if (cls_num <= 1)
-                    {
-                        best_logit = cls_ptr[0];
-                        best_c = 0;
-                    }
-                    else
-                    {
-                        for (int c = 0; c < cls_num; ++c)
-                        {
-                            float v = cls_ptr[c];
-                            if (v > best_logit)
-                            {
-                                best_logit = v;
-                                best_c = c;
-                            }
-                        }
-                    }
-                    if (best_logit < conf_raw)
-                    {
-                        continue;
-                    }
+                    const ClassCandidate& candidate = candidates[next];
+                    const int idx = candidate.cell;
+                    const int w = idx - h * feat_w;
+                    const int best_c = candidate.label;
+                    const float best_logit = candidate.score;
+
                     const float score = sigmoid(best_logit);
 
-                    const float* box_ptr = feat_box + (h * feat_w + w) * box_channels;
+                    const float* box_ptr = feat_box + idx * box_channels;
                     float l, t, r, b;
                     if (reg_max > 1)
                     {
                         float pred_ltrb[4];
-                        for (int k = 0; k < 4; ++k)
-                        {
-                            float dis = softmax(box_ptr + k * reg_max, dfl_sm_buf.data(), reg_max);
-                            pred_ltrb[k] = dis * stride;
-                        }
+                        dfl_decode_ltrb(box_ptr, reg_max, stride, pred_ltrb);
                         l = pred_ltrb[0];
                         t = pred_ltrb[1];
                         r = pred_ltrb[2];
@@ -3116,7 +2909,7 @@ namespace detection
                         b = box_ptr[3] * stride;
                     }
 
-                    const float angle = feat_angle[(h * feat_w + w) * ang_stride_elems];
+                    const float angle = feat_angle[idx * ang_stride_elems];
 
                     const float pb_cx = (w + 0.5f) * stride;
                     const float pb_cy = (h + 0.5f) * stride;
@@ -3157,60 +2950,34 @@ namespace detection
                 reg_max = box_channels / 4;
             }
 
-            const float p = std::min(std::max(prob_threshold, 1e-6f), 1.f - 1e-6f);
-            const float conf_raw = std::log(p / (1.f - p));
-
             const int cls_stride_elems = std::max(1, cls_num);
             const int ang_stride_elems = std::max(1, angle_ch);
 
-            std::vector<float> dfl_sm_buf;
-            if (reg_max > 1)
-            {
-                dfl_sm_buf.resize(reg_max);
-            }
-
             const float pi = static_cast<float>(M_PI);
 
+            // process cls score, only cells whose best logit passes come back
+            std::vector<ClassCandidate> candidates;
+            scan_class_scores(feat_cls, feat_w * feat_h, cls_stride_elems, cls_stride_elems, logit_threshold(prob_threshold), candidates);
+
+            size_t next = 0;
             for (int h = 0; h < feat_h; ++h)
             {
-                for (int w = 0; w < feat_w; ++w)
+                for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; ++next)
                 {
-                    const float* cls_ptr = feat_cls + (h * feat_w + w) * cls_stride_elems;
-                    int best_c = 0;
-                    float best_logit = -FLT_MAX;
-                    if (cls_num <= 1)
-                    {
-                        best_logit = cls_ptr[0];
-                        best_c = 0;
-                    }
-                    else
-                    {
-                        for (int c = 0; c < cls_num; ++c)
-                        {
-                            float v = cls_ptr[c];
-                            if (v > best_logit)
-                            {
-                                best_logit = v;
-                                best_c = c;
-                            }
-                        }
-                    }
-                    if (best_logit < conf_raw)
-                    {
-                        continue;
-                    }
+                    const ClassCandidate& candidate = candidates[next];
+                    const int idx = candidate.cell;
+                    const int w = idx - h * feat_w;
+                    const int best_c = candidate.label;
+                    const float best_logit = candidate.score;
+
                     const float score = sigmoid(best_logit);
 
-                    const float* box_ptr = feat_box + (h * feat_w + w) * box_channels;
+                    const float* box_ptr = feat_box + idx * box_channels;
                     float l, t, r, b;
                     if (reg_max > 1)
                     {
                         float pred_ltrb[4];
-                        for (int k = 0; k < 4; ++k)
-                        {
-                            float dis = softmax(box_ptr + k * reg_max, dfl_sm_buf.data(), reg_max);
-                            pred_ltrb[k] = dis * stride;
-                        }
+                        dfl_decode_ltrb(box_ptr, reg_max, stride, pred_ltrb);
                         l = pred_ltrb[0];
                         t = pred_ltrb[1];
                         r = pred_ltrb[2];
@@ -3224,7 +2991,7 @@ namespace detection
                         b = box_ptr[3] * stride;
                     }
 
-                    const float ang_raw = feat_angle[(h * feat_w + w) * ang_stride_elems];
+                    const float ang_raw = feat_angle[idx * ang_stride_elems];
                     const float angle = (sigmoid(ang_raw) - 0.25f) * pi;
 
                     const float pb_cx = (w + 0.5f) * stride;
@@ -3251,6 +3018,7 @@ namespace detection
                     objects.push_back(obj);
                 }
             }
+
         }
         static void draw_objects_obb(const cv::Mat& bgr, const std::vector<Object>& objects, const char** class_names, const char* output_name, int thickness = 1)
         {
@@ -3289,89 +3057,75 @@ namespace detection
     } // namespace obb
 
     static void generate_proposals_yolov10(int stride, const float* feat, float prob_threshold, std::vector<Object>& objects,
-                                           int letterbox_cols, int letterbox_rows, int cls_num = 80)
+                                           int letterbox_cols, int letterbox_rows, int cls_num = 80, const GridRows& rows = GridRows())
     {
         int feat_w = letterbox_cols / stride;
         int feat_h = letterbox_rows / stride;
-        auto feat_ptr = feat;
-        float dis[16];
+        int cell_step = cls_num + 4 * 16;
+
+        // scores are already probabilities here, the scan compares them to prob_threshold as is
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat, feat_w, feat_h, rows, cell_step, cls_num, prob_threshold, candidates);
+
+        size_t next = 0;
         for (int h = 0; h <= feat_h - 1; h++)
         {
-            for (int w = 0; w <= feat_w - 1; w++)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; next++)
             {
-                int c_index = 0;
-                float c_score = 0;
-
-                for (int c = 0; c < cls_num; c++)
-                {
-                    float score = feat_ptr[c];
-                    if (score > c_score)
-                    {
-                        c_index = c;
-                        c_score = score;
-                    }
-                }
-
-                if (c_score >= prob_threshold)
-                {
-                    float x0 = w + 0.5f - mmyolo::fast_softmax(feat_ptr + cls_num + 0 * 16, dis, 16);
-                    float y0 = h + 0.5f - mmyolo::fast_softmax(feat_ptr + cls_num + 1 * 16, dis, 16);
-                    float x1 = w + 0.5f + mmyolo::fast_softmax(feat_ptr + cls_num + 2 * 16, dis, 16);
-                    float y1 = h + 0.5f + mmyolo::fast_softmax(feat_ptr + cls_num + 3 * 16, dis, 16);
-
-                    x0 *= stride;
-                    y0 *= stride;
-                    x1 *= stride;
-                    y1 *= stride;
+                const ClassCandidate& candidate = candidates[next];
+                int w = candidate.cell - h * feat_w;
+                auto feat_ptr = feat + candidate.cell * cell_step;
+                int c_index = candidate.label;
+                float c_score = candidate.score;
+
+                float pred_ltrb[4];
+                dfl_decode_ltrb(feat_ptr + cls_num, 16, 1.f, pred_ltrb);
+                float x0 = w + 0.5f - pred_ltrb[0];
+                float y0 = h + 0.5f - pred_ltrb[1];
+                float x1 = w + 0.5f + pred_ltrb[2];
+                float y1 = h + 0.5f + pred_ltrb[3];
+
+                x0 *= stride;
+                y0 *= stride;
+                x1 *= stride;
+                y1 *= stride;
 
-                    Object obj;
-                    obj.rect.x = x0;
-                    obj.rect.y = y0;
-                    obj.rect.width = x1 - x0;
-                    obj.rect.height = y1 - y0;
-                    obj.label = c_index;
-                    obj.prob = c_score;
-                    objects.push_back(obj);
-                }
-                feat_ptr += (cls_num + 4 * 16);
+                Object obj;
+                obj.rect.x = x0;
+                obj.rect.y = y0;
+                obj.rect.width = x1 - x0;
+                obj.rect.height = y1 - y0;
+                obj.label = c_index;
+                obj.prob = c_score;
+                objects.push_back(obj);
             }
         }
     }
 
-    static void generate_proposals_yolo26(int stride, const float* feat, const float* feat_cls, float prob_threshold, std::vector<Object>& objects,
-                                          int letterbox_cols, int letterbox_rows, int cls_num = 80)
+    static void generate_proposals_yolo26(int stride, const float* feat, const float* feat_cls, float prob_threshold, Proposals& proposals,
+                                          int letterbox_cols, int letterbox_rows, int cls_num = 80, const GridRows& rows = GridRows())
     {
         const int feat_w = letterbox_cols / stride;
         const int feat_h = letterbox_rows / stride;
 
-        const float p = std::min(std::max(prob_threshold, 1e-6f), 1.f - 1e-6f);
-        const float conf_raw = std::log(p / (1.f - p));
+        // process cls score, only cells whose best logit passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat_cls, feat_w, feat_h, rows, cls_num, cls_num, logit_threshold(prob_threshold), candidates);
 
+        size_t next = 0;
         for (int h = 0; h < feat_h; ++h)
         {
-            for (int w = 0; w < feat_w; ++w)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; ++next)
             {
-                int best_c = 0;
-                float best_logit = -FLT_MAX;
-                const float* cls_ptr = feat_cls + (h * feat_w + w) * cls_num;
-                for (int c = 0; c < cls_num; ++c)
-                {
-                    float v = cls_ptr[c];
-                    if (v > best_logit)
-                    {
-                        best_logit = v;
-                        best_c = c;
-                    }
-                }
-
-                if (best_logit < conf_raw)
-                {
-                    continue;
-                }
+                const ClassCandidate& candidate = candidates[next];
+                const int idx = candidate.cell;
+                const int w = idx - h * feat_w;
+                const int best_c = candidate.label;
+                const float best_logit = candidate.score;
 
                 const float score = sigmoid(best_logit);
 
-                const float* box_ptr = feat + (h * feat_w + w) * 4;
+                const float* box_ptr = feat + idx * 4;
                 const float l = box_ptr[0];
                 const float t = box_ptr[1];
                 const float r = box_ptr[2];
@@ -3390,52 +3144,42 @@ namespace detection
                 x1 = std::max(0.f, std::min(x1, (float)(letterbox_cols - 1)));
                 y1 = std::max(0.f, std::min(y1, (float)(letterbox_rows - 1)));
 
-                Object obj;
-                obj.rect.x = x0;
-                obj.rect.y = y0;
-                obj.rect.width = x1 - x0;
-                obj.rect.height = y1 - y0;
-                obj.label = best_c;
-                obj.prob = score;
-                objects.push_back(obj);
+                proposals.push(x0, y0, x1 - x0, y1 - y0, best_c, score);
             }
         }
     }
 
+    static void generate_proposals_yolo26(int stride, const float* feat, const float* feat_cls, float prob_threshold, std::vector<Object>& objects,
+                                          int letterbox_cols, int letterbox_rows, int cls_num = 80)
+    {
+        Proposals proposals;
+        generate_proposals_yolo26(stride, feat, feat_cls, prob_threshold, proposals, letterbox_cols, letterbox_rows, cls_num);
+        append_objects(proposals, objects);
+    }
+
     static void generate_proposals_yolo26_pose(int stride, const float* feat_box, const float* feat_cls, const float* feat_kps,
-                                               float prob_threshold, std::vector<Object>& objects,
-                                               int letterbox_cols, int letterbox_rows, const int num_point = 17, int cls_num = 1)
+                                               float prob_threshold, Proposals& proposals,
+                                               int letterbox_cols, int letterbox_rows, const int num_point = 17, int cls_num = 1, const GridRows& rows = GridRows())
     {
+        proposals.set_feat(CANDIDATE_FEAT_KPS, 3 * num_point);
+
         const int feat_w = letterbox_cols / stride;
         const int feat_h = letterbox_rows / stride;
 
-        const float p = std::min(std::max(prob_threshold, 1e-6f), 1.f - 1e-6f);
-        const float conf_raw = std::log(p / (1.f - p));
+        // process cls score, only cells whose best logit passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat_cls, feat_w, feat_h, rows, cls_num, cls_num, logit_threshold(prob_threshold), candidates);
 
+        size_t next = 0;
         for (int h = 0; h < feat_h; ++h)
         {
-            for (int w = 0; w < feat_w; ++w)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; ++next)
             {
-                const int idx = h * feat_w + w;
-
-                // Find best class score
-                int best_c = 0;
-                float best_logit = -FLT_MAX;
-                const float* cls_ptr = feat_cls + idx * cls_num;
-                for (int c = 0; c < cls_num; ++c)
-                {
-                    float v = cls_ptr[c];
-                    if (v > best_logit)
-                    {
-                        best_logit = v;
-                        best_c = c;
-                    }
-                }
-
-                if (best_logit < conf_raw)
-                {
-                    continue;
-                }
+                const ClassCandidate& candidate = candidates[next];
+                const int idx = candidate.cell;
+                const int w = idx - h * feat_w;
+                const int best_c = candidate.label;
+                const float best_logit = candidate.score;
 
                 const float score = sigmoid(best_logit);
 
@@ -3459,13 +3203,7 @@ namespace detection
                 x1 = std::max(0.f, std::min(x1, (float)(letterbox_cols - 1)));
                 y1 = std::max(0.f, std::min(y1, (float)(letterbox_rows - 1)));
 
-                Object obj;
-                obj.rect.x = x0;
-                obj.rect.y = y0;
-                obj.rect.width = x1 - x0;
-                obj.rect.height = y1 - y0;
-                obj.label = best_c;
-                obj.prob = score;
+                float* kps_feat = proposals.push(x0, y0, x1 - x0, y1 - y0, best_c, score);
 
                 // Decode keypoints using YOLO26-Pose formula:
                 // kpts_decoded[:, :, 0] = (kpts[:, :, 0] + anchor_x) * stride
@@ -3475,57 +3213,48 @@ namespace detection
                 const float anchor_x = w + 0.5f;
                 const float anchor_y = h + 0.5f;
 
-                obj.kps_feat.clear();
                 for (int k = 0; k < num_point; ++k)
                 {
-                    float kps_x = (kps_ptr[k * 3 + 0] + anchor_x) * stride;
-                    float kps_y = (kps_ptr[k * 3 + 1] + anchor_y) * stride;
-                    float kps_s = sigmoid(kps_ptr[k * 3 + 2]);
-
-                    obj.kps_feat.push_back(kps_x);
-                    obj.kps_feat.push_back(kps_y);
-                    obj.kps_feat.push_back(kps_s);
+                    kps_feat[k * 3 + 0] = (kps_ptr[k * 3 + 0] + anchor_x) * stride;
+                    kps_feat[k * 3 + 1] = (kps_ptr[k * 3 + 1] + anchor_y) * stride;
+                    kps_feat[k * 3 + 2] = sigmoid(kps_ptr[k * 3 + 2]);
                 }
-
-                objects.push_back(obj);
             }
         }
     }
 
+    static void generate_proposals_yolo26_pose(int stride, const float* feat_box, const float* feat_cls, const float* feat_kps,
+                                               float prob_threshold, std::vector<Object>& objects,
+                                               int letterbox_cols, int letterbox_rows, const int num_point = 17, int cls_num = 1)
+    {
+        Proposals proposals;
+        generate_proposals_yolo26_pose(stride, feat_box, feat_cls, feat_kps, prob_threshold, proposals, letterbox_cols, letterbox_rows, num_point, cls_num);
+        append_objects(proposals, objects);
+    }
+
     static void generate_proposals_yolo26_seg(int stride, const float* feat_box, const float* feat_cls, const float* feat_mask,
-                                              float prob_threshold, std::vector<Object>& objects,
-                                              int letterbox_cols, int letterbox_rows, int cls_num = 80, int mask_proto_dim = 32)
+                                              float prob_threshold, Proposals& proposals,
+                                              int letterbox_cols, int letterbox_rows, int cls_num = 80, int mask_proto_dim = 32, const GridRows& rows = GridRows())
     {
+        proposals.set_feat(CANDIDATE_FEAT_MASK, mask_proto_dim);
+
         const int feat_w = letterbox_cols / stride;
         const int feat_h = letterbox_rows / stride;
 
-        const float p = std::min(std::max(prob_threshold, 1e-6f), 1.f - 1e-6f);
-        const float conf_raw = std::log(p / (1.f - p));
+        // process cls score, only cells whose best logit passes come back
+        std::vector<ClassCandidate> candidates;
+        scan_class_rows(feat_cls, feat_w, feat_h, rows, cls_num, cls_num, logit_threshold(prob_threshold), candidates);
 
+        size_t next = 0;
         for (int h = 0; h < feat_h; ++h)
         {
-            for (int w = 0; w < feat_w; ++w)
+            for (; next < candidates.size() && candidates[next].cell < (h + 1) * feat_w; ++next)
             {
-                const int idx = h * feat_w + w;
-
-                // Find best class score
-                int best_c = 0;
-                float best_logit = -FLT_MAX;
-                const float* cls_ptr = feat_cls + idx * cls_num;
-                for (int c = 0; c < cls_num; ++c)
-                {
-                    float v = cls_ptr[c];
-                    if (v > best_logit)
-                    {
-                        best_logit = v;
-                        best_c = c;
-                    }
-                }
-
-                if (best_logit < conf_raw)
-                {
-                    continue;
-                }
+                const ClassCandidate& candidate = candidates[next];
+                const int idx = candidate.cell;
+                const int w = idx - h * feat_w;
+                const int best_c = candidate.label;
+                const float best_logit = candidate.score;
 
                 const float score = sigmoid(best_logit);
 
@@ -3549,21 +3278,69 @@ namespace detection
                 x1 = std::max(0.f, std::min(x1, (float)(letterbox_cols - 1)));
                 y1 = std::max(0.f, std::min(y1, (float)(letterbox_rows - 1)));
 
-                Object obj;
-                obj.rect.x = x0;
-                obj.rect.y = y0;
-                obj.rect.width = x1 - x0;
-                obj.rect.height = y1 - y0;
-                obj.label = best_c;
-                obj.prob = score;
+                float* mask_feat = proposals.push(x0, y0, x1 - x0, y1 - y0, best_c, score);
 
                 // Copy mask coefficients
                 const float* mask_ptr = feat_mask + idx * mask_proto_dim;
-                obj.mask_feat.resize(mask_proto_dim);
-                memcpy(obj.mask_feat.data(), mask_ptr, sizeof(float) * mask_proto_dim);
-
-                objects.push_back(obj);
+                memcpy(mask_feat, mask_ptr, sizeof(float) * mask_proto_dim);
             }
         }
     }
+
+    static void generate_proposals_yolo26_seg(int stride, const float* feat_box, const float* feat_cls, const float* feat_mask,
+                                              float prob_threshold, std::vector<Object>& objects,
+                                              int letterbox_cols, int letterbox_rows, int cls_num = 80, int mask_proto_dim = 32)
+    {
+        Proposals proposals;
+        generate_proposals_yolo26_seg(stride, feat_box, feat_cls, feat_mask, prob_threshold, proposals, letterbox_cols, letterbox_rows, cls_num, mask_proto_dim);
+        append_objects(proposals, objects);
+    }
+
+    enum YoloHeads
+    {
+        YOLO_HEADS_V8 = 0, // one 1 x h x w x (64 + classes) output per head, the native yolov8 / yolo11 export
+        YOLO_HEADS_26 = 1, // a 1 x h x w x 4 box and a 1 x h x w x classes score output per head
+    };
+
+    // decode + nms of the detection heads of one run, for tools that take any yolov8 / yolo26 model.
+    // IoInfo / Io are AX_ENGINE_IO_INFO_T / AX_ENGINE_IO_T, the strides and class counts come from the
+    // output shapes. the heads are decoded in row tiles on `pool`, see ProposalTiles::run()
+    template<typename IoInfo, typename Io>
+    static void get_out_yolo_heads(const IoInfo* io_info, const Io* io_data, int kind, float prob_threshold, const NmsParam& nms,
+                                   int letterbox_rows, int letterbox_cols, int src_rows, int src_cols, ProposalTiles<Proposals>& tiles,
+                                   Proposals& proposals, std::vector<Object>& objects, int tile_rows = PROPOSAL_TILE_ROWS,
+                                   common::thread_pool* pool = nullptr)
+    {
+        const int outputs = (int)io_info->nOutputSize;
+        const int heads = kind == YOLO_HEADS_26 ? outputs / 2 : outputs;
+        std::vector<int> head_rows(heads);
+        for (int i = 0; i < heads; ++i)
+        {
+            const auto& meta = io_info->pOutputs[kind == YOLO_HEADS_26 ? i * 2 : i];
+            head_rows[i] = meta.nShapeSize == 4 ? meta.pShape[1] : 0;
+        }
+
+        proposals.clear();
+        tiles.run(head_rows.data(), heads, [&](int i, const GridRows& rows, Proposals& tile) {
+            const int stride = head_rows[i] > 0 ? letterbox_rows / head_rows[i] : 0;
+            if (stride <= 0)
+            {
+                return;
+            }
+            if (kind == YOLO_HEADS_26)
+            {
+                const auto& meta = io_info->pOutputs[i * 2 + 1];
+                generate_proposals_yolo26(stride, (const float*)io_data->pOutputs[i * 2].pVirAddr, (const float*)io_data->pOutputs[i * 2 + 1].pVirAddr,
+                                          prob_threshold, tile, letterbox_cols, letterbox_rows, meta.pShape[3], rows);
+            }
+            else
+            {
+                const auto& meta = io_info->pOutputs[i];
+                generate_proposals_yolov8_native(stride, (const float*)io_data->pOutputs[i].pVirAddr, prob_threshold, tile,
+                                                 letterbox_cols, letterbox_rows, meta.pShape[3] - 64, rows);
+            }
+        }, proposals, tile_rows, pool);
+
+        get_out_bbox(proposals, objects, nms, letterbox_rows, letterbox_cols, src_rows, src_cols);
+    }
 } // namespace detection
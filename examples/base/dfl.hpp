@@ -0,0 +1,112 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/simd.hpp"
+
+namespace detection
+{
+    // largest reg_max the vector path keeps on the stack, bigger heads take the scalar path
+    const int DFL_MAX_REG = 64;
+
+    // scalar reference: softmax over each of the 4 distributions, then the expectation of the bin index
+    static inline void dfl_decode_ltrb_ref(const float* src, int reg_max, float scale, float* ltrb)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            const float* dis = src + k * reg_max;
+            const float alpha = *std::max_element(dis, dis + reg_max);
+            float denominator = 0.f;
+            float dis_sum = 0.f;
+            for (int i = 0; i < reg_max; ++i)
+            {
+                float e = std::exp(dis[i] - alpha);
+                denominator += e;
+                dis_sum += i * e;
+            }
+            ltrb[k] = dis_sum / denominator * scale;
+        }
+    }
+
+    // decode the 4 ltrb distributions of one cell, `src` holds them back to back (4 * reg_max floats).
+    // each vector lane carries one side, so after the 4x4 transposes the softmax is purely vertical
+    // and no horizontal reduction is needed. ltrb[k] = scale * sum(i * softmax(src_k)[i]).
+    static inline void dfl_decode_ltrb(const float* src, int reg_max, float scale, float* ltrb)
+    {
+#if AX_SIMD_NONE
+        dfl_decode_ltrb_ref(src, reg_max, scale, ltrb);
+#else
+        if (reg_max <= 0 || reg_max > DFL_MAX_REG)
+        {
+            dfl_decode_ltrb_ref(src, reg_max, scale, ltrb);
+            return;
+        }
+
+        simd::v4f bins[DFL_MAX_REG];
+        const float* s0 = src;
+        const float* s1 = src + reg_max;
+        const float* s2 = src + 2 * reg_max;
+        const float* s3 = src + 3 * reg_max;
+
+        const int vec_end = reg_max & ~3;
+        int i = 0;
+        for (; i < vec_end; i += 4)
+        {
+            simd::v4f r0 = simd::load(s0 + i);
+            simd::v4f r1 = simd::load(s1 + i);
+            simd::v4f r2 = simd::load(s2 + i);
+            simd::v4f r3 = simd::load(s3 + i);
+            simd::transpose4x4(r0, r1, r2, r3);
+            bins[i] = r0;
+            bins[i + 1] = r1;
+            bins[i + 2] = r2;
+            bins[i + 3] = r3;
+        }
+        for (i = vec_end; i < reg_max; ++i)
+        {
+            bins[i] = simd::set4(s0[i], s1[i], s2[i], s3[i]);
+        }
+
+        simd::v4f alpha = bins[0];
+        for (i = 1; i < reg_max; ++i)
+        {
+            alpha = simd::max(alpha, bins[i]);
+        }
+
+        simd::v4f denominator = simd::set1(0.f);
+        simd::v4f dis_sum = simd::set1(0.f);
+        simd::v4f index = simd::set1(0.f);
+        const simd::v4f one = simd::set1(1.f);
+        for (i = 0; i < reg_max; ++i)
+        {
+            simd::v4f e = simd::exp(simd::sub(bins[i], alpha));
+            denominator = simd::add(denominator, e);
+            dis_sum = simd::add(dis_sum, simd::mul(index, e));
+            index = simd::add(index, one);
+        }
+
+        simd::store(ltrb, simd::mul(simd::div(dis_sum, denominator), simd::set1(scale)));
+#endif
+    }
+} // namespace detection
@@ -0,0 +1,304 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "base/parallel.hpp"
+#include "base/simd.hpp"
+#include "utilities/trace.hpp"
+
+namespace pose
+{
+    enum
+    {
+        HEATMAP_REFINE_NONE = 0,
+        HEATMAP_REFINE_QUARTER = 1, // a quarter pixel towards the higher neighbour, as in the hrnet paper
+        HEATMAP_REFINE_DARK = 2,    // taylor expansion of the log of the blurred heatmap, DARK (cvpr 2020)
+    };
+
+    // gaussian kernel of the DARK blur, the one mmpose uses for 64 x 48 heatmaps
+    const int HEATMAP_DARK_KERNEL = 11;
+
+    typedef struct
+    {
+        float x; // heatmap pixels
+        float y;
+        float score;
+    } HeatmapPeak;
+
+    // first maximum of `count` contiguous floats, like a strict `>` loop.
+    // 16 at a time into 4 running maxima, then the first element equal to the max is looked up
+    static inline int heatmap_argmax(const float* data, int count, float& score)
+    {
+        int i = 0;
+        float best = count > 0 ? data[0] : 0.f;
+        if (count >= 16)
+        {
+            simd::v4f m0 = simd::load(data), m1 = simd::load(data + 4), m2 = simd::load(data + 8), m3 = simd::load(data + 12);
+            for (i = 16; i + 15 < count; i += 16)
+            {
+                m0 = simd::max(m0, simd::load(data + i));
+                m1 = simd::max(m1, simd::load(data + i + 4));
+                m2 = simd::max(m2, simd::load(data + i + 8));
+                m3 = simd::max(m3, simd::load(data + i + 12));
+            }
+            best = simd::hmax(simd::max(simd::max(m0, m1), simd::max(m2, m3)));
+        }
+        for (; i < count; ++i)
+        {
+            best = std::max(best, data[i]);
+        }
+
+        // the plane is still in cache, find where the max is
+        const simd::v4f vbest = simd::set1(best);
+        i = 0;
+        for (; i + 3 < count; i += 4)
+        {
+            if (simd::cmpgt_mask(vbest, simd::load(data + i)) != 0xF)
+            {
+                break;
+            }
+        }
+        for (; i < count && data[i] != best; ++i)
+        {
+        }
+        score = best;
+        return std::min(i, count - 1);
+    }
+
+    // the same for every joint of a pixels x joints (channels last) heatmap in one pass over it,
+    // 4 joints per vector and up to 16 per pass
+    static inline void heatmap_argmax_hwc(const float* data, int joints, int pixels, int* index, float* score)
+    {
+        int j = 0;
+        while (j + 3 < joints)
+        {
+            const int blocks = std::min((joints - j) / 4, 4);
+            simd::v4f vmax[4], vidx[4];
+            for (int b = 0; b < blocks; ++b)
+            {
+                vmax[b] = simd::load(data + j + b * 4);
+                vidx[b] = simd::set1(0.f);
+            }
+            const float* p = data + joints + j;
+            for (int i = 1; i < pixels; ++i, p += joints)
+            {
+                const simd::v4f vi = simd::set1((float)i);
+                for (int b = 0; b < blocks; ++b)
+                {
+                    const simd::v4f v = simd::load(p + b * 4);
+                    vidx[b] = simd::select_gt(v, vmax[b], vi, vidx[b]);
+                    vmax[b] = simd::max(v, vmax[b]);
+                }
+            }
+            for (int b = 0; b < blocks; ++b)
+            {
+                float idx[4];
+                simd::store(idx, vidx[b]);
+                simd::store(score + j + b * 4, vmax[b]);
+                for (int k = 0; k < 4; ++k)
+                {
+                    index[j + b * 4 + k] = (int)idx[k];
+                }
+            }
+            j += blocks * 4;
+        }
+        for (; j < joints; ++j)
+        {
+            index[j] = 0;
+            score[j] = data[j];
+            for (int i = 1; i < pixels; ++i)
+            {
+                if (data[(size_t)i * joints + j] > score[j])
+                {
+                    score[j] = data[(size_t)i * joints + j];
+                    index[j] = i;
+                }
+            }
+        }
+    }
+
+    // one heatmap seen through its pixel stride, 1 for planar and the joint count for channels last
+    typedef struct
+    {
+        const float* data;
+        size_t pixel_stride;
+        int height;
+        int width;
+
+        float at(int y, int x) const
+        {
+            return data[((size_t)y * width + x) * pixel_stride];
+        }
+    } HeatmapView;
+
+    // hrnet's get_final_preds, only for peaks off the border
+    static inline void refine_quarter(const HeatmapView& hm, int px, int py, HeatmapPeak& peak)
+    {
+        if (px <= 1 || px >= hm.width - 1 || py <= 1 || py >= hm.height - 1)
+        {
+            return;
+        }
+        const float dx = hm.at(py, px + 1) - hm.at(py, px - 1);
+        const float dy = hm.at(py + 1, px) - hm.at(py - 1, px);
+        peak.x += dx > 0.f ? 0.25f : (dx < 0.f ? -0.25f : 0.f);
+        peak.y += dy > 0.f ? 0.25f : (dy < 0.f ? -0.25f : 0.f);
+    }
+
+    // the gradient and hessian of log(blur(heatmap)) at the peak give the offset -H^-1 g. only the
+    // 5 x 5 cells around the peak are blurred, zero padded as mmpose does. its rescale of the blurred
+    // map to the original max only shifts the log by a constant and is left out.
+    static inline void refine_dark(const HeatmapView& hm, int px, int py, int kernel, HeatmapPeak& peak)
+    {
+        if (px < 2 || px > hm.width - 3 || py < 2 || py > hm.height - 3)
+        {
+            return;
+        }
+        const int radius = std::min(std::max(kernel / 2, 0), 31);
+        const int taps = radius * 2 + 1;
+        // cv::getGaussianKernel with sigma 0
+        const float sigma = 0.3f * ((taps - 1) * 0.5f - 1.f) + 0.8f;
+        float weights[63];
+        float sum = 0.f;
+        for (int i = 0; i < taps; ++i)
+        {
+            const float d = (float)(i - radius);
+            weights[i] = std::exp(-d * d / (2.f * sigma * sigma));
+            sum += weights[i];
+        }
+        for (int i = 0; i < taps; ++i)
+        {
+            weights[i] /= sum;
+        }
+
+        // horizontal pass over the rows the vertical one needs, then the vertical one
+        float rows[5 + 62][5];
+        const int row_count = 5 + 2 * radius;
+        for (int r = 0; r < row_count; ++r)
+        {
+            const int y = py - 2 - radius + r;
+            for (int c = 0; c < 5; ++c)
+            {
+                float acc = 0.f;
+                if (y >= 0 && y < hm.height)
+                {
+                    for (int t = 0; t < taps; ++t)
+                    {
+                        const int x = px - 2 + c - radius + t;
+                        if (x >= 0 && x < hm.width)
+                        {
+                            acc += weights[t] * hm.at(y, x);
+                        }
+                    }
+                }
+                rows[r][c] = acc;
+            }
+        }
+        float l[5][5]; // log of the blurred cells, l[2][2] is the peak
+        for (int r = 0; r < 5; ++r)
+        {
+            for (int c = 0; c < 5; ++c)
+            {
+                float acc = 0.f;
+                for (int t = 0; t < taps; ++t)
+                {
+                    acc += weights[t] * rows[r + t][c];
+                }
+                l[r][c] = std::log(std::max(acc, 1e-10f));
+            }
+        }
+
+        const float dx = 0.5f * (l[2][3] - l[2][1]);
+        const float dy = 0.5f * (l[3][2] - l[1][2]);
+        const float dxx = 0.25f * (l[2][4] - 2.f * l[2][2] + l[2][0]);
+        const float dyy = 0.25f * (l[4][2] - 2.f * l[2][2] + l[0][2]);
+        const float dxy = 0.25f * (l[3][3] - l[1][3] - l[3][1] + l[1][1]);
+        const float det = dxx * dyy - dxy * dxy;
+        if (det != 0.f)
+        {
+            peak.x -= (dyy * dx - dxy * dy) / det;
+            peak.y -= (dxx * dy - dxy * dx) / det;
+        }
+    }
+
+    // peaks of `batch` crops of `joints` heatmaps each, joints x height x width per crop or, with
+    // channels_last, height x width x joints. peaks has batch * joints entries in heatmap pixels.
+    // the crops are decoded side by side on the pool, the joints of one crop in one pass.
+    static inline void decode_heatmaps(const float* data, int batch, int joints, int height, int width, HeatmapPeak* peaks,
+                                       int refine = HEATMAP_REFINE_NONE, bool channels_last = false, int dark_kernel = HEATMAP_DARK_KERNEL,
+                                       common::thread_pool* pool = nullptr)
+    {
+        AX_TRACE_SCOPE("heatmap_decode");
+        const int pixels = height * width;
+        const size_t crop_size = (size_t)joints * pixels;
+        common::thread_pool& workers = pool != nullptr ? *pool : common::thread_pool::shared();
+        workers.parallel_for(batch, 1, [&](int begin, int end) {
+            std::vector<int> index(joints);
+            std::vector<float> score(joints);
+            for (int n = begin; n < end; ++n)
+            {
+                const float* crop = data + n * crop_size;
+                if (channels_last)
+                {
+                    heatmap_argmax_hwc(crop, joints, pixels, index.data(), score.data());
+                }
+                else
+                {
+                    for (int k = 0; k < joints; ++k)
+                    {
+                        index[k] = heatmap_argmax(crop + (size_t)k * pixels, pixels, score[k]);
+                    }
+                }
+
+                for (int k = 0; k < joints; ++k)
+                {
+                    HeatmapPeak& peak = peaks[(size_t)n * joints + k];
+                    const int px = index[k] % width;
+                    const int py = index[k] / width;
+                    peak.x = (float)px;
+                    peak.y = (float)py;
+                    peak.score = score[k];
+                    if (refine == HEATMAP_REFINE_NONE)
+                    {
+                        continue;
+                    }
+                    HeatmapView hm;
+                    hm.data = channels_last ? crop + k : crop + (size_t)k * pixels;
+                    hm.pixel_stride = channels_last ? joints : 1;
+                    hm.height = height;
+                    hm.width = width;
+                    if (refine == HEATMAP_REFINE_QUARTER)
+                    {
+                        refine_quarter(hm, px, py, peak);
+                    }
+                    else
+                    {
+                        refine_dark(hm, px, py, dark_kernel, peak);
+                    }
+                }
+            }
+        });
+    }
+} // namespace pose
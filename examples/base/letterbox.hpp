@@ -0,0 +1,240 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "base/simd.hpp"
+#include "utilities/trace.hpp"
+
+namespace common
+{
+    typedef struct
+    {
+        float scale;
+        int resize_rows;
+        int resize_cols;
+        int top;
+        int left;
+    } LetterboxLayout;
+
+    // where the resized image sits inside the letterbox, the same numbers get_input_data_letterbox uses
+    static inline LetterboxLayout letterbox_layout(int src_rows, int src_cols, int letterbox_rows, int letterbox_cols)
+    {
+        LetterboxLayout layout;
+        if ((letterbox_rows * 1.0 / src_rows) < (letterbox_cols * 1.0 / src_cols))
+        {
+            layout.scale = (float)letterbox_rows * 1.0f / (float)src_rows;
+        }
+        else
+        {
+            layout.scale = (float)letterbox_cols * 1.0f / (float)src_cols;
+        }
+        layout.resize_cols = int(layout.scale * (float)src_cols);
+        layout.resize_rows = int(layout.scale * (float)src_rows);
+        layout.top = (letterbox_rows - layout.resize_rows) / 2;
+        layout.left = (letterbox_cols - layout.resize_cols) / 2;
+        return layout;
+    }
+
+    // cv::resize INTER_LINEAR on 8 bit images works in fixed point, weights carry 11 fraction bits
+    const int LINEAR_COEF_SCALE = 1 << 11;
+
+    // source index and the two weights of every destination pixel along one axis, computed like cv::resize.
+    // opencv clamps the columns at the borders but not the rows, the row indices are clipped when read.
+    static inline void linear_coefs(int src_size, int dst_size, bool clamp, std::vector<int>& offsets, std::vector<short>& coefs)
+    {
+        const double scale = 1.0 / ((double)dst_size / src_size);
+        offsets.resize(dst_size);
+        coefs.resize(dst_size * 2);
+        for (int d = 0; d < dst_size; ++d)
+        {
+            float f = (float)((d + 0.5) * scale - 0.5);
+            int s = (int)std::floor(f);
+            f -= s;
+            if (clamp && s < 0)
+            {
+                f = 0.f;
+                s = 0;
+            }
+            if (clamp && s >= src_size - 1)
+            {
+                f = 0.f;
+                s = src_size - 1;
+            }
+            offsets[d] = s;
+            coefs[d * 2] = (short)std::lrint((1.f - f) * LINEAR_COEF_SCALE);
+            coefs[d * 2 + 1] = (short)std::lrint(f * LINEAR_COEF_SCALE);
+        }
+    }
+
+    // horizontal pass of one bgr row into 32 bit sums, the channel swap is folded into the gather
+    static inline void linear_hresize_row(const uint8_t* src, const int* x0, const int* x1, const short* alpha, int cols, int c0, int c2, int* dst)
+    {
+        for (int dx = 0; dx < cols; ++dx)
+        {
+            const uint8_t* p0 = src + x0[dx];
+            const uint8_t* p1 = src + x1[dx];
+            const int a0 = alpha[dx * 2];
+            const int a1 = alpha[dx * 2 + 1];
+            dst[0] = p0[c0] * a0 + p1[c0] * a1;
+            dst[1] = p0[1] * a0 + p1[1] * a1;
+            dst[2] = p0[c2] * a0 + p1[c2] * a1;
+            dst += 3;
+        }
+    }
+
+    // vertical pass, ((b0 * (s0 >> 4)) >> 16) + ((b1 * (s1 >> 4)) >> 16) rounded by 2 bits.
+    // this is the arithmetic of the vectorized opencv kernel, which its scalar tail does not share.
+    static inline void linear_vresize_row(const int* s0, const int* s1, short b0, short b1, int n, uint8_t* dst)
+    {
+        int x = 0;
+#if AX_SIMD_NEON
+        const int32x4_t vb0 = vdupq_n_s32(b0);
+        const int32x4_t vb1 = vdupq_n_s32(b1);
+        const int32x4_t delta = vdupq_n_s32(2);
+        for (; x + 7 < n; x += 8)
+        {
+            int32x4_t lo = vaddq_s32(vshrq_n_s32(vmulq_s32(vshrq_n_s32(vld1q_s32(s0 + x), 4), vb0), 16),
+                                     vshrq_n_s32(vmulq_s32(vshrq_n_s32(vld1q_s32(s1 + x), 4), vb1), 16));
+            int32x4_t hi = vaddq_s32(vshrq_n_s32(vmulq_s32(vshrq_n_s32(vld1q_s32(s0 + x + 4), 4), vb0), 16),
+                                     vshrq_n_s32(vmulq_s32(vshrq_n_s32(vld1q_s32(s1 + x + 4), 4), vb1), 16));
+            lo = vshrq_n_s32(vaddq_s32(lo, delta), 2);
+            hi = vshrq_n_s32(vaddq_s32(hi, delta), 2);
+            vst1_u8(dst + x, vqmovn_u16(vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi))));
+        }
+#elif AX_SIMD_SSE
+        const __m128i vb0 = _mm_set1_epi16(b0);
+        const __m128i vb1 = _mm_set1_epi16(b1);
+        const __m128i delta = _mm_set1_epi16(2);
+        for (; x + 7 < n; x += 8)
+        {
+            // s >> 4 fits 16 bits, so mulhi gives the high half of the 32 bit product
+            __m128i v0 = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i*)(s0 + x)), 4),
+                                         _mm_srai_epi32(_mm_loadu_si128((const __m128i*)(s0 + x + 4)), 4));
+            __m128i v1 = _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i*)(s1 + x)), 4),
+                                         _mm_srai_epi32(_mm_loadu_si128((const __m128i*)(s1 + x + 4)), 4));
+            __m128i sum = _mm_adds_epi16(_mm_mulhi_epi16(v0, vb0), _mm_mulhi_epi16(v1, vb1));
+            sum = _mm_srai_epi16(_mm_adds_epi16(sum, delta), 2);
+            _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(sum, sum));
+        }
+#endif
+        for (; x < n; ++x)
+        {
+            int v = (((b0 * (s0[x] >> 4)) >> 16) + ((b1 * (s1[x] >> 4)) >> 16) + 2) >> 2;
+            dst[x] = (uint8_t)std::min(std::max(v, 0), 255);
+        }
+    }
+
+    // letterbox a packed bgr image straight into `dst` (e.g. the npu input buffer): bilinear resize,
+    // zero padding and the optional bgr -> rgb swap in one pass, without any full frame temporary.
+    // gives the same bytes as cv::resize (INTER_LINEAR) + cv::copyMakeBorder (+ cv::cvtColor).
+    // strides are in bytes, a dst_stride of 0 means letterbox_cols * 3.
+    static void letterbox_bgr(const uint8_t* src, int src_rows, int src_cols, size_t src_stride,
+                              uint8_t* dst, int letterbox_rows, int letterbox_cols, size_t dst_stride = 0, bool bgr2rgb = false)
+    {
+        AX_TRACE_SCOPE("letterbox");
+        if (dst_stride == 0)
+        {
+            dst_stride = (size_t)letterbox_cols * 3;
+        }
+
+        const LetterboxLayout layout = letterbox_layout(src_rows, src_cols, letterbox_rows, letterbox_cols);
+        const int rows = layout.resize_rows;
+        const int cols = layout.resize_cols;
+        const size_t row_bytes = (size_t)letterbox_cols * 3;
+
+        for (int y = 0; y < layout.top; ++y)
+        {
+            memset(dst + y * dst_stride, 0, row_bytes);
+        }
+        for (int y = layout.top + rows; y < letterbox_rows; ++y)
+        {
+            memset(dst + y * dst_stride, 0, row_bytes);
+        }
+        if (rows <= 0 || cols <= 0)
+        {
+            return;
+        }
+
+        std::vector<int> x_offsets, y_offsets;
+        std::vector<short> alpha, beta;
+        linear_coefs(src_cols, cols, true, x_offsets, alpha);
+        linear_coefs(src_rows, rows, false, y_offsets, beta);
+
+        // byte offsets of both taps, the right tap of the last column stays inside the row
+        std::vector<int> x0(cols), x1(cols);
+        for (int dx = 0; dx < cols; ++dx)
+        {
+            x0[dx] = x_offsets[dx] * 3;
+            x1[dx] = std::min(x_offsets[dx] + 1, src_cols - 1) * 3;
+        }
+
+        const int c0 = bgr2rgb ? 2 : 0;
+        const int c2 = bgr2rgb ? 0 : 2;
+        const int n = cols * 3;
+
+        // the two source rows of the current output row, reused while the output walks down
+        std::vector<int> buffer((size_t)n * 2);
+        int* rows_buf[2] = {buffer.data(), buffer.data() + n};
+        int cached[2] = {-1, -1};
+
+        const size_t left_bytes = (size_t)layout.left * 3;
+        const size_t right_bytes = row_bytes - left_bytes - (size_t)n;
+        for (int dy = 0; dy < rows; ++dy)
+        {
+            const int sy0 = std::min(std::max(y_offsets[dy], 0), src_rows - 1);
+            const int sy1 = std::min(std::max(y_offsets[dy] + 1, 0), src_rows - 1);
+
+            if (cached[0] != sy0 && cached[1] == sy0)
+            {
+                std::swap(rows_buf[0], rows_buf[1]);
+                std::swap(cached[0], cached[1]);
+            }
+            if (cached[0] != sy0)
+            {
+                linear_hresize_row(src + sy0 * src_stride, x0.data(), x1.data(), alpha.data(), cols, c0, c2, rows_buf[0]);
+                cached[0] = sy0;
+            }
+            if (cached[1] != sy1)
+            {
+                if (sy1 == sy0)
+                {
+                    memcpy(rows_buf[1], rows_buf[0], (size_t)n * sizeof(int));
+                }
+                else
+                {
+                    linear_hresize_row(src + sy1 * src_stride, x0.data(), x1.data(), alpha.data(), cols, c0, c2, rows_buf[1]);
+                }
+                cached[1] = sy1;
+            }
+
+            uint8_t* out = dst + (layout.top + dy) * dst_stride;
+            memset(out, 0, left_bytes);
+            linear_vresize_row(rows_buf[0], rows_buf[1], beta[dy * 2], beta[dy * 2 + 1], n, out + left_bytes);
+            memset(out + left_bytes + n, 0, right_bytes);
+        }
+    }
+} // namespace common
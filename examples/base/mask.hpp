@@ -0,0 +1,265 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "base/simd.hpp"
+#include "utilities/trace.hpp"
+
+namespace detection
+{
+    // box of one instance on the proto grid, its logits start at `offset` in InstanceMasks::logits
+    typedef struct
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+        size_t offset;
+    } MaskRoi;
+
+    // proto cells under a box given in letterbox pixels, rounded outwards like the opencv roi crop did
+    static inline MaskRoi mask_roi(float x, float y, float width, float height, int stride, int proto_h, int proto_w)
+    {
+        int hstart = (int)std::floor(y / stride);
+        int hend = (int)std::ceil(y / stride + height / stride);
+        int wstart = (int)std::floor(x / stride);
+        int wend = (int)std::ceil(x / stride + width / stride);
+
+        hstart = std::min(std::max(hstart, 0), proto_h);
+        wstart = std::min(std::max(wstart, 0), proto_w);
+        hend = std::min(std::max(hend, 0), proto_h);
+        wend = std::min(std::max(wend, 0), proto_w);
+
+        MaskRoi roi;
+        roi.x = wstart;
+        roi.y = hstart;
+        roi.width = std::max(wend - wstart, 0);
+        roi.height = std::max(hend - hstart, 0);
+        roi.offset = 0;
+        return roi;
+    }
+
+    // n logits of one proto row: dst[x] = sum_k coefs[k] * proto[k * plane + x].
+    // 16 columns at a time in 4 accumulators, each coefficient is broadcast once per block
+    static inline void mask_gemm_row(const float* coefs, int dim, const float* proto, size_t plane, int n, float* dst)
+    {
+        int x = 0;
+        for (; x + 15 < n; x += 16)
+        {
+            simd::v4f a0 = simd::set1(0.f), a1 = a0, a2 = a0, a3 = a0;
+            const float* p = proto + x;
+            for (int k = 0; k < dim; ++k, p += plane)
+            {
+                const simd::v4f c = simd::set1(coefs[k]);
+                a0 = simd::add(a0, simd::mul(c, simd::load(p)));
+                a1 = simd::add(a1, simd::mul(c, simd::load(p + 4)));
+                a2 = simd::add(a2, simd::mul(c, simd::load(p + 8)));
+                a3 = simd::add(a3, simd::mul(c, simd::load(p + 12)));
+            }
+            simd::store(dst + x, a0);
+            simd::store(dst + x + 4, a1);
+            simd::store(dst + x + 8, a2);
+            simd::store(dst + x + 12, a3);
+        }
+        for (; x + 3 < n; x += 4)
+        {
+            simd::v4f a0 = simd::set1(0.f);
+            const float* p = proto + x;
+            for (int k = 0; k < dim; ++k, p += plane)
+            {
+                a0 = simd::add(a0, simd::mul(simd::set1(coefs[k]), simd::load(p)));
+            }
+            simd::store(dst + x, a0);
+        }
+        for (; x < n; ++x)
+        {
+            float sum = 0.f;
+            const float* p = proto + x;
+            for (int k = 0; k < dim; ++k, p += plane)
+            {
+                sum += coefs[k] * *p;
+            }
+            dst[x] = sum;
+        }
+    }
+
+    // bilinear taps of a cv::resize INTER_LINEAR, the left / top tap and the weight of the other one
+    static inline void mask_linear_taps(int src_size, int dst_size, std::vector<int>& offsets, std::vector<float>& weights)
+    {
+        const double scale = (double)src_size / dst_size;
+        offsets.resize(dst_size);
+        weights.resize(dst_size);
+        for (int d = 0; d < dst_size; ++d)
+        {
+            float f = (float)((d + 0.5) * scale - 0.5);
+            int s = (int)std::floor(f);
+            f -= s;
+            if (s < 0)
+            {
+                f = 0.f;
+                s = 0;
+            }
+            if (s >= src_size - 1)
+            {
+                f = 0.f;
+                s = src_size - 1;
+            }
+            offsets[d] = s;
+            weights[d] = f;
+        }
+    }
+
+    // the instance masks of one frame. assemble() runs the coefficients of all survivors against the
+    // proto tensor in one pass, only over the proto cells under each box, and keeps the raw logits.
+    // a mask at the box resolution is only made by decode(), sigmoid(v) > 0.5 is tested as v > 0.
+    struct InstanceMasks
+    {
+        std::vector<MaskRoi> rois;
+        std::vector<float> logits;
+
+        // proto is dim x proto_h x proto_w, boxes are x, y, width, height in letterbox pixels
+        void assemble(const float* proto, int dim, int proto_h, int proto_w, int stride, const float* boxes, const float* const* coefs, int count)
+        {
+            AX_TRACE_SCOPE("mask_assemble");
+            rois.resize(count);
+            size_t total = 0;
+            for (int i = 0; i < count; ++i)
+            {
+                const float* box = boxes + i * 4;
+                rois[i] = mask_roi(box[0], box[1], box[2], box[3], stride, proto_h, proto_w);
+                rois[i].offset = total;
+                total += (size_t)rois[i].width * rois[i].height;
+            }
+            logits.resize(total);
+
+            const size_t plane = (size_t)proto_h * proto_w;
+            for (int i = 0; i < count; ++i)
+            {
+                const MaskRoi& roi = rois[i];
+                for (int y = 0; y < roi.height; ++y)
+                {
+                    mask_gemm_row(coefs[i], dim, proto + (size_t)(roi.y + y) * proto_w + roi.x, plane, roi.width,
+                                  logits.data() + roi.offset + (size_t)y * roi.width);
+                }
+            }
+        }
+
+        int size() const
+        {
+            return (int)rois.size();
+        }
+
+        // logits of instance `index`, rois[index].height rows of rois[index].width
+        const float* roi_logits(int index) const
+        {
+            return logits.data() + rois[index].offset;
+        }
+
+        // mask of instance `index` resized to width x height into dst, 255 inside and 0 outside.
+        // the logits are interpolated as cv::resize would, v > 0 is then tested on the float bits as
+        // an int32 compare, which also keeps -0 out
+        void decode(int index, int width, int height, uint8_t* dst, size_t dst_stride)
+        {
+            AX_TRACE_SCOPE("mask_decode");
+            const MaskRoi& roi = rois[index];
+            if (roi.width <= 0 || roi.height <= 0)
+            {
+                for (int y = 0; y < height; ++y)
+                {
+                    memset(dst + y * dst_stride, 0, width);
+                }
+                return;
+            }
+
+            mask_linear_taps(roi.width, width, x_offsets, x_weights);
+            mask_linear_taps(roi.height, height, y_offsets, y_weights);
+
+            // the two horizontally resized source rows of the current output row
+            row_buffer.resize((size_t)width * 2);
+            float* rows_buf[2] = {row_buffer.data(), row_buffer.data() + width};
+            int cached[2] = {-1, -1};
+
+            const float* src = roi_logits(index);
+            for (int dy = 0; dy < height; ++dy)
+            {
+                const int sy[2] = {y_offsets[dy], std::min(y_offsets[dy] + 1, roi.height - 1)};
+                for (int t = 0; t < 2; ++t)
+                {
+                    if (cached[t] == sy[t])
+                    {
+                        continue;
+                    }
+                    if (t == 0 && cached[1] == sy[0])
+                    {
+                        // walking down, the bottom row becomes the top one
+                        std::swap(rows_buf[0], rows_buf[1]);
+                        std::swap(cached[0], cached[1]);
+                        continue;
+                    }
+                    const float* s = src + (size_t)sy[t] * roi.width;
+                    float* d = rows_buf[t];
+                    for (int dx = 0; dx < width; ++dx)
+                    {
+                        const int x0 = x_offsets[dx];
+                        const int x1 = std::min(x0 + 1, roi.width - 1);
+                        d[dx] = s[x0] + (s[x1] - s[x0]) * x_weights[dx];
+                    }
+                    cached[t] = sy[t];
+                }
+
+                const float* r0 = rows_buf[0];
+                const float* r1 = rows_buf[1];
+                const simd::v4f b1 = simd::set1(y_weights[dy]);
+                const simd::v4f b0 = simd::set1(1.f - y_weights[dy]);
+                uint8_t* out = dst + dy * dst_stride;
+                int x = 0;
+                for (; x + 15 < width; x += 16)
+                {
+                    simd::store_positive_u8x16(out + x,
+                                               simd::add(simd::mul(simd::load(r0 + x), b0), simd::mul(simd::load(r1 + x), b1)),
+                                               simd::add(simd::mul(simd::load(r0 + x + 4), b0), simd::mul(simd::load(r1 + x + 4), b1)),
+                                               simd::add(simd::mul(simd::load(r0 + x + 8), b0), simd::mul(simd::load(r1 + x + 8), b1)),
+                                               simd::add(simd::mul(simd::load(r0 + x + 12), b0), simd::mul(simd::load(r1 + x + 12), b1)));
+                }
+                for (; x < width; ++x)
+                {
+                    const float v = r0[x] * (1.f - y_weights[dy]) + r1[x] * y_weights[dy];
+                    int32_t bits;
+                    memcpy(&bits, &v, sizeof(bits));
+                    out[x] = bits > 0 ? 255 : 0;
+                }
+            }
+        }
+
+    private:
+        std::vector<int> x_offsets;
+        std::vector<int> y_offsets;
+        std::vector<float> x_weights;
+        std::vector<float> y_weights;
+        std::vector<float> row_buffer;
+    };
+} // namespace detection
@@ -0,0 +1,422 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "base/parallel.hpp"
+#include "base/simd.hpp"
+#include "base/superpoint.hpp"
+#include "utilities/trace.hpp"
+
+// brute force descriptor matching by l2 distance. |q - t|^2 = |q|^2 + |t|^2 - 2 q.t, so the distances
+// of a block of queries to a block of train descriptors are one small matrix product: 2 queries x 4
+// train rows per step through registers, blocks sized to stay in cache, query blocks on the pool.
+// every query keeps its best and second best train row, every train row its best query, which gives
+// the mutual nearest neighbour check and the ratio test without a second pass.
+
+namespace feature
+{
+    enum
+    {
+        MATCH_FLOAT = 0,  // float dot products, the exact distances
+        MATCH_INT8 = 1,   // descriptors scaled to int8 per row, int32 dot products
+        MATCH_BINARY = 2, // sign bits, the angle estimated from the hamming distance. coarse, for l2 normalised descriptors
+    };
+
+    const int MATCH_QUERY_BLOCK = 64;  // queries per pool chunk
+    const int MATCH_TRAIN_BLOCK = 128; // train rows per tile, 128 kB of float descriptors of 256
+
+    typedef struct
+    {
+        int query; // row of the query descriptors
+        int train; // row of the train descriptors
+        float distance;
+    } DescriptorMatch;
+
+    struct MatchParam
+    {
+        bool mutual;        // keep a match only when the query is also the best of its train row
+        float ratio;        // keep a match only when best < ratio * second best, >= 1 turns it off
+        float max_distance; // keep matches up to this distance
+
+        MatchParam(bool mutual = true, float ratio = 1.f, float max_distance = FLT_MAX)
+            : mutual(mutual), ratio(ratio), max_distance(max_distance)
+        {
+        }
+    };
+
+    // the descriptors of one image as the matcher reads them. the float rows are not copied and must
+    // outlive the set, the quantized ones are made by assign(), so keyframes matched against many
+    // frames are prepared once
+    struct MatchDescriptors
+    {
+        const float* data = nullptr; // count x dim
+        int count = 0;
+        int dim = 0;
+        int mode = MATCH_FLOAT;
+        std::vector<float> norm;      // |row|^2
+        std::vector<int8_t> q8;       // count x stride, MATCH_INT8
+        std::vector<float> scale;     // row = q8 row * scale, MATCH_INT8
+        std::vector<uint64_t> bits;   // count x words, bit set for rows > 0, MATCH_BINARY
+        int stride = 0;
+        int words = 0;
+
+        void assign(const float* data, int count, int dim, int mode = MATCH_FLOAT)
+        {
+            this->data = data;
+            this->count = count;
+            this->dim = dim;
+            this->mode = mode;
+            norm.resize(count);
+            for (int i = 0; i < count; ++i)
+            {
+                const float* row = data + (size_t)i * dim;
+                float sum = 0.f;
+                for (int k = 0; k < dim; ++k)
+                {
+                    sum += row[k] * row[k];
+                }
+                norm[i] = sum;
+            }
+
+            if (mode == MATCH_INT8)
+            {
+                // symmetric per row, zero padded to the 16 bytes of a dot_i8 step
+                stride = (dim + 15) & ~15;
+                q8.assign((size_t)count * stride, 0);
+                scale.resize(count);
+                for (int i = 0; i < count; ++i)
+                {
+                    const float* row = data + (size_t)i * dim;
+                    float peak = 0.f;
+                    for (int k = 0; k < dim; ++k)
+                    {
+                        peak = std::max(peak, std::fabs(row[k]));
+                    }
+                    scale[i] = peak > 0.f ? peak / 127.f : 1.f;
+                    int8_t* out = q8.data() + (size_t)i * stride;
+                    for (int k = 0; k < dim; ++k)
+                    {
+                        out[k] = (int8_t)std::lround(row[k] / scale[i]);
+                    }
+                }
+            }
+            else if (mode == MATCH_BINARY)
+            {
+                words = (dim + 63) / 64;
+                bits.assign((size_t)count * words, 0);
+                for (int i = 0; i < count; ++i)
+                {
+                    const float* row = data + (size_t)i * dim;
+                    uint64_t* out = bits.data() + (size_t)i * words;
+                    for (int k = 0; k < dim; ++k)
+                    {
+                        if (row[k] > 0.f)
+                            out[k / 64] |= (uint64_t)1 << (k % 64);
+                    }
+                }
+            }
+        }
+
+        void assign(const SuperPointFeatures& features, int mode = MATCH_FLOAT)
+        {
+            assign(features.descriptors.data(), features.size(), features.dim, mode);
+        }
+    };
+
+    // matches of query rows to train rows, the buffers are kept between calls
+    struct DescriptorMatcher
+    {
+        // matches in query order. both sets need the same dim and mode
+        void match(const MatchDescriptors& query, const MatchDescriptors& train, std::vector<DescriptorMatch>& matches,
+                   const MatchParam& param = MatchParam(), common::thread_pool* pool = nullptr)
+        {
+            AX_TRACE_SCOPE("descriptor_match");
+            matches.clear();
+            if (query.count == 0 || train.count == 0 || query.dim != train.dim || query.mode != train.mode)
+                return;
+
+            const int n = query.count;
+            const int m = train.count;
+            const int chunks = (n + MATCH_QUERY_BLOCK - 1) / MATCH_QUERY_BLOCK;
+            best.assign(n, FLT_MAX);
+            second.assign(n, FLT_MAX);
+            best_index.assign(n, -1);
+            column_best.assign((size_t)chunks * m, FLT_MAX);
+            column_index.assign((size_t)chunks * m, -1);
+            if (query.mode == MATCH_BINARY)
+            {
+                // 2 - 2 cos(angle), the angle pi h / dim for h differing signs
+                angle_table.resize(query.dim + 1);
+                for (int h = 0; h <= query.dim; ++h)
+                {
+                    angle_table[h] = 2.f - 2.f * std::cos(3.14159265f * h / query.dim);
+                }
+            }
+
+            common::thread_pool& workers = pool != nullptr ? *pool : common::thread_pool::shared();
+            workers.parallel_for(chunks, 1, [&](int begin, int end) {
+                std::vector<float> tile((size_t)MATCH_QUERY_BLOCK * MATCH_TRAIN_BLOCK);
+                for (int c = begin; c < end; ++c)
+                {
+                    match_block(query, train, c, tile.data());
+                }
+            });
+
+            // the best query of a train row, the first one on ties as the chunks come in query order
+            if (param.mutual)
+            {
+                for (int c = 1; c < chunks; ++c)
+                {
+                    for (int t = 0; t < m; ++t)
+                    {
+                        if (column_best[(size_t)c * m + t] < column_best[t])
+                        {
+                            column_best[t] = column_best[(size_t)c * m + t];
+                            column_index[t] = column_index[(size_t)c * m + t];
+                        }
+                    }
+                }
+            }
+
+            const float ratio2 = param.ratio * param.ratio;
+            for (int q = 0; q < n; ++q)
+            {
+                const int t = best_index[q];
+                if (t < 0 || (param.mutual && column_index[t] != q))
+                    continue;
+                const float d1 = std::max(best[q], 0.f);
+                if (param.ratio < 1.f && second[q] != FLT_MAX && !(d1 < ratio2 * std::max(second[q], 0.f)))
+                    continue;
+                const float distance = std::sqrt(d1);
+                if (distance > param.max_distance)
+                    continue;
+                matches.push_back({q, t, distance});
+            }
+        }
+
+    private:
+        // the 2 x 4 squared distance step of MATCH_FLOAT, dim floats per row
+        static inline void dot_2x4(const float* q0, const float* q1, const float* const* t, int dim, float* out0, float* out1)
+        {
+            simd::v4f a00 = simd::set1(0.f), a01 = a00, a02 = a00, a03 = a00;
+            simd::v4f a10 = a00, a11 = a00, a12 = a00, a13 = a00;
+            int k = 0;
+            for (; k + 3 < dim; k += 4)
+            {
+                const simd::v4f x0 = simd::load(q0 + k), x1 = simd::load(q1 + k);
+                const simd::v4f y0 = simd::load(t[0] + k), y1 = simd::load(t[1] + k);
+                const simd::v4f y2 = simd::load(t[2] + k), y3 = simd::load(t[3] + k);
+                a00 = simd::add(a00, simd::mul(x0, y0));
+                a01 = simd::add(a01, simd::mul(x0, y1));
+                a02 = simd::add(a02, simd::mul(x0, y2));
+                a03 = simd::add(a03, simd::mul(x0, y3));
+                a10 = simd::add(a10, simd::mul(x1, y0));
+                a11 = simd::add(a11, simd::mul(x1, y1));
+                a12 = simd::add(a12, simd::mul(x1, y2));
+                a13 = simd::add(a13, simd::mul(x1, y3));
+            }
+            out0[0] = simd::hsum(a00), out0[1] = simd::hsum(a01), out0[2] = simd::hsum(a02), out0[3] = simd::hsum(a03);
+            out1[0] = simd::hsum(a10), out1[1] = simd::hsum(a11), out1[2] = simd::hsum(a12), out1[3] = simd::hsum(a13);
+            for (; k < dim; ++k)
+            {
+                for (int j = 0; j < 4; ++j)
+                {
+                    out0[j] += q0[k] * t[j][k];
+                    out1[j] += q1[k] * t[j][k];
+                }
+            }
+        }
+
+        static inline float dot_1x1(const float* a, const float* b, int dim)
+        {
+            simd::v4f acc = simd::set1(0.f);
+            int k = 0;
+            for (; k + 3 < dim; k += 4)
+            {
+                acc = simd::add(acc, simd::mul(simd::load(a + k), simd::load(b + k)));
+            }
+            float sum = simd::hsum(acc);
+            for (; k < dim; ++k)
+            {
+                sum += a[k] * b[k];
+            }
+            return sum;
+        }
+
+        // differing bits, the per byte counts of up to 31 words are summed before the multiply that adds the bytes up
+        static inline int hamming(const uint64_t* a, const uint64_t* b, int words)
+        {
+            const uint64_t m1 = 0x5555555555555555ull, m2 = 0x3333333333333333ull, m4 = 0x0f0f0f0f0f0f0f0full;
+            int count = 0;
+            for (int w = 0; w < words; w += 31)
+            {
+                uint64_t bytes = 0;
+                for (int k = w; k < std::min(w + 31, words); ++k)
+                {
+                    uint64_t x = a[k] ^ b[k];
+                    x -= (x >> 1) & m1;
+                    x = (x & m2) + ((x >> 2) & m2);
+                    bytes += (x + (x >> 4)) & m4;
+                }
+                count += (int)((bytes * 0x0101010101010101ull) >> 56);
+            }
+            return count;
+        }
+
+        // squared distances of queries [q0, q1) to train rows [t0, t1), tile rows of MATCH_TRAIN_BLOCK
+        void distance_tile(const MatchDescriptors& query, const MatchDescriptors& train, int q0, int q1, int t0, int t1, float* tile) const
+        {
+            const int dim = query.dim;
+            if (query.mode == MATCH_FLOAT)
+            {
+                int q = q0;
+                for (; q + 1 < q1; q += 2)
+                {
+                    float* row0 = tile + (size_t)(q - q0) * MATCH_TRAIN_BLOCK;
+                    float* row1 = row0 + MATCH_TRAIN_BLOCK;
+                    const float* x0 = query.data + (size_t)q * dim;
+                    const float* x1 = x0 + dim;
+                    int t = t0;
+                    for (; t + 3 < t1; t += 4)
+                    {
+                        const float* rows[4] = {train.data + (size_t)t * dim, train.data + (size_t)(t + 1) * dim,
+                                                train.data + (size_t)(t + 2) * dim, train.data + (size_t)(t + 3) * dim};
+                        dot_2x4(x0, x1, rows, dim, row0 + t - t0, row1 + t - t0);
+                    }
+                    for (; t < t1; ++t)
+                    {
+                        row0[t - t0] = dot_1x1(x0, train.data + (size_t)t * dim, dim);
+                        row1[t - t0] = dot_1x1(x1, train.data + (size_t)t * dim, dim);
+                    }
+                }
+                for (; q < q1; ++q)
+                {
+                    float* row = tile + (size_t)(q - q0) * MATCH_TRAIN_BLOCK;
+                    for (int t = t0; t < t1; ++t)
+                    {
+                        row[t - t0] = dot_1x1(query.data + (size_t)q * dim, train.data + (size_t)t * dim, dim);
+                    }
+                }
+            }
+            else if (query.mode == MATCH_INT8)
+            {
+                for (int q = q0; q < q1; ++q)
+                {
+                    float* row = tile + (size_t)(q - q0) * MATCH_TRAIN_BLOCK;
+                    const int8_t* x = query.q8.data() + (size_t)q * query.stride;
+                    for (int t = t0; t < t1; ++t)
+                    {
+                        const int32_t dot = simd::dot_i8(x, train.q8.data() + (size_t)t * train.stride, query.stride);
+                        row[t - t0] = (float)dot * query.scale[q] * train.scale[t];
+                    }
+                }
+            }
+            else
+            {
+                const int words = query.words;
+                for (int q = q0; q < q1; ++q)
+                {
+                    float* row = tile + (size_t)(q - q0) * MATCH_TRAIN_BLOCK;
+                    const uint64_t* x = query.bits.data() + (size_t)q * words;
+                    for (int t = t0; t < t1; ++t)
+                    {
+                        row[t - t0] = angle_table[hamming(x, train.bits.data() + (size_t)t * words, words)];
+                    }
+                }
+                return;
+            }
+
+            // dot products to squared distances
+            for (int q = q0; q < q1; ++q)
+            {
+                float* row = tile + (size_t)(q - q0) * MATCH_TRAIN_BLOCK;
+                const simd::v4f nq = simd::set1(query.norm[q]);
+                const simd::v4f two = simd::set1(2.f);
+                int t = t0;
+                for (; t + 3 < t1; t += 4)
+                {
+                    const simd::v4f dot = simd::load(row + t - t0);
+                    simd::store(row + t - t0, simd::sub(simd::add(nq, simd::load(&train.norm[t])), simd::mul(two, dot)));
+                }
+                for (; t < t1; ++t)
+                {
+                    row[t - t0] = query.norm[q] + train.norm[t] - 2.f * row[t - t0];
+                }
+            }
+        }
+
+        // the best, second best and column best of one query block
+        void match_block(const MatchDescriptors& query, const MatchDescriptors& train, int chunk, float* tile)
+        {
+            const int m = train.count;
+            const int q0 = chunk * MATCH_QUERY_BLOCK;
+            const int q1 = std::min(q0 + MATCH_QUERY_BLOCK, query.count);
+            float* col_best = column_best.data() + (size_t)chunk * m;
+            int* col_index = column_index.data() + (size_t)chunk * m;
+            for (int t0 = 0; t0 < m; t0 += MATCH_TRAIN_BLOCK)
+            {
+                const int t1 = std::min(t0 + MATCH_TRAIN_BLOCK, m);
+                distance_tile(query, train, q0, q1, t0, t1, tile);
+                for (int q = q0; q < q1; ++q)
+                {
+                    const float* row = tile + (size_t)(q - q0) * MATCH_TRAIN_BLOCK;
+                    float b1 = best[q], b2 = second[q];
+                    int bi = best_index[q];
+                    for (int t = t0; t < t1; ++t)
+                    {
+                        const float d = row[t - t0];
+                        if (d < b1)
+                        {
+                            b2 = b1;
+                            b1 = d;
+                            bi = t;
+                        }
+                        else if (d < b2)
+                        {
+                            b2 = d;
+                        }
+                        if (d < col_best[t])
+                        {
+                            col_best[t] = d;
+                            col_index[t] = q;
+                        }
+                    }
+                    best[q] = b1;
+                    second[q] = b2;
+                    best_index[q] = bi;
+                }
+            }
+        }
+
+        std::vector<float> best;   // squared distances
+        std::vector<float> second;
+        std::vector<int> best_index;
+        std::vector<float> column_best; // chunks x train count
+        std::vector<int> column_index;
+        std::vector<float> angle_table;
+    };
+} // namespace feature
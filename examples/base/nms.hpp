@@ -0,0 +1,353 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "base/score_sort.hpp"
+#include "base/simd.hpp"
+#include "utilities/trace.hpp"
+
+namespace detection
+{
+    enum NmsMethod
+    {
+        NMS_GREEDY = 0, // compare every proposal with every picked box
+        NMS_GRID = 1,   // only compare with picked boxes sharing a grid cell, 4 boxes per simd step
+    };
+
+    // nms settings of every get_out_bbox*, a bare float still works and means class agnostic, no cap
+    struct NmsParam
+    {
+        float iou_threshold;
+        bool class_aware; // only boxes with the same label suppress each other
+        int max_det;      // keep at most max_det boxes, <= 0 keeps all of them
+        int top_k;        // only the top_k best proposals enter nms, <= 0 keeps all of them
+        int method;       // NmsMethod
+        int sort;         // SortMethod of the proposal ordering
+
+        NmsParam(float iou_threshold = 0.45f, bool class_aware = false, int max_det = 0, int top_k = 0,
+                 int method = NMS_GRID, int sort = SORT_AUTO)
+            : iou_threshold(iou_threshold), class_aware(class_aware), max_det(max_det), top_k(top_k), method(method), sort(sort)
+        {
+        }
+    };
+
+    // grid cells are kept under this count, wider grids only cost memory
+    const int NMS_GRID_MAX_CELLS = 4096;
+    // below this many proposals a single cell is as fast as a grid
+    const int NMS_GRID_MIN_BOXES = 64;
+
+    template<typename T>
+    static inline int nms_label(const T& obj)
+    {
+        return obj.label;
+    }
+
+    // the same arithmetic as cv::Rect_<float>::operator& followed by area()
+    template<typename T>
+    static inline float nms_intersection(const T& a, const T& b)
+    {
+        float x0 = std::max(a.rect.x, b.rect.x);
+        float y0 = std::max(a.rect.y, b.rect.y);
+        float w = std::min(a.rect.x + a.rect.width, b.rect.x + b.rect.width) - x0;
+        float h = std::min(a.rect.y + a.rect.height, b.rect.y + b.rect.height) - y0;
+        return (w <= 0.f || h <= 0.f) ? 0.f : w * h;
+    }
+
+    // plain greedy nms, proposals are visited in `order` (descending prob), kept as the reference of the grid path
+    template<typename T>
+    static void nms_greedy_bboxes(const std::vector<T>& faceobjects, const std::vector<int>& order, std::vector<int>& picked,
+                                  float nms_threshold, bool class_aware = false, int max_det = 0)
+    {
+        picked.clear();
+
+        const int n = faceobjects.size();
+
+        std::vector<float> areas(n);
+        for (int i = 0; i < n; i++)
+        {
+            areas[i] = faceobjects[i].rect.width * faceobjects[i].rect.height;
+        }
+
+        for (int i : order)
+        {
+            if (max_det > 0 && (int)picked.size() >= max_det)
+                break;
+
+            const T& a = faceobjects[i];
+
+            int keep = 1;
+            for (int j = 0; j < (int)picked.size(); j++)
+            {
+                const T& b = faceobjects[picked[j]];
+                if (class_aware && nms_label(a) != nms_label(b))
+                    continue;
+
+                // intersection over union
+                float inter_area = nms_intersection(a, b);
+                float union_area = areas[i] + areas[picked[j]] - inter_area;
+                if (inter_area / union_area > nms_threshold)
+                {
+                    keep = 0;
+                    break;
+                }
+            }
+
+            if (keep)
+                picked.push_back(i);
+        }
+    }
+
+    template<typename T>
+    static void nms_sorted_bboxes(const std::vector<T>& faceobjects, std::vector<int>& picked, float nms_threshold,
+                                  bool class_aware = false, int max_det = 0)
+    {
+        std::vector<int> order(faceobjects.size());
+        std::iota(order.begin(), order.end(), 0);
+        nms_greedy_bboxes(faceobjects, order, picked, nms_threshold, class_aware, max_det);
+    }
+
+    // picked boxes of one grid cell, packed 4 at a time as x0[4] y0[4] x1[4] y1[4] area[4]
+    struct NmsBucket
+    {
+        std::vector<float> data;
+        int count = 0;
+
+        void push(float x0, float y0, float x1, float y1, float area)
+        {
+            int lane = count & 3;
+            if (lane == 0)
+            {
+                // empty lanes never intersect anything
+                data.insert(data.end(), {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX,
+                                         -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX,
+                                         0.f, 0.f, 0.f, 0.f});
+            }
+            float* block = data.data() + data.size() - 20;
+            block[lane] = x0;
+            block[4 + lane] = y0;
+            block[8 + lane] = x1;
+            block[12 + lane] = y1;
+            block[16 + lane] = area;
+            count++;
+        }
+
+        // true if any box of the bucket overlaps (x0, y0, x1, y1) with iou > threshold
+        bool suppress(const simd::v4f& x0, const simd::v4f& y0, const simd::v4f& x1, const simd::v4f& y1,
+                      const simd::v4f& area, const simd::v4f& threshold) const
+        {
+            const simd::v4f zero = simd::set1(0.f);
+            for (size_t b = 0; b < data.size(); b += 20)
+            {
+                const float* block = data.data() + b;
+                simd::v4f w = simd::max(zero, simd::sub(simd::min(x1, simd::load(block + 8)), simd::max(x0, simd::load(block))));
+                simd::v4f h = simd::max(zero, simd::sub(simd::min(y1, simd::load(block + 12)), simd::max(y0, simd::load(block + 4))));
+                simd::v4f inter = simd::mul(w, h);
+                simd::v4f uni = simd::sub(simd::add(area, simd::load(block + 16)), inter);
+                if (simd::cmpgt_mask(simd::div(inter, uni), threshold))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    // class agnostic pass of nms_grid_bboxes over `order`. picked boxes are binned into a uniform grid
+    // sized by the average box, a proposal is only tested against the cells it covers.
+    template<typename T>
+    static void nms_grid_pass(const std::vector<T>& faceobjects, const std::vector<int>& order, std::vector<int>& picked, float iou_threshold, int max_det)
+    {
+        picked.clear();
+
+        const int n = order.size();
+        if (n == 0)
+            return;
+
+        std::vector<float> x0(n), y0(n), x1(n), y1(n), areas(n);
+        float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX;
+        float size_sum = 0.f;
+        for (int i = 0; i < n; i++)
+        {
+            const auto& rect = faceobjects[order[i]].rect;
+            x0[i] = rect.x;
+            y0[i] = rect.y;
+            x1[i] = rect.x + rect.width;
+            y1[i] = rect.y + rect.height;
+            areas[i] = rect.width * rect.height;
+            min_x = std::min(min_x, x0[i]);
+            min_y = std::min(min_y, y0[i]);
+            max_x = std::max(max_x, x1[i]);
+            max_y = std::max(max_y, y1[i]);
+            size_sum += std::max(rect.width, rect.height);
+        }
+
+        int cols = 1, rows = 1;
+        float cell = 1.f;
+        if (n >= NMS_GRID_MIN_BOXES)
+        {
+            cell = std::max(size_sum / n, 1.f);
+            float cells = std::ceil((max_x - min_x) / cell) * std::ceil((max_y - min_y) / cell);
+            if (cells > NMS_GRID_MAX_CELLS)
+            {
+                cell *= std::sqrt(cells / NMS_GRID_MAX_CELLS);
+            }
+            cols = std::max(1, std::min((int)std::ceil((max_x - min_x) / cell), NMS_GRID_MAX_CELLS));
+            rows = std::max(1, std::min((int)std::ceil((max_y - min_y) / cell), NMS_GRID_MAX_CELLS / cols));
+        }
+        const float inv_cell = 1.f / cell;
+
+        std::vector<NmsBucket> buckets(cols * rows);
+        const simd::v4f threshold = simd::set1(iou_threshold);
+        for (int i = 0; i < n; i++)
+        {
+            if (max_det > 0 && (int)picked.size() >= max_det)
+                break;
+
+            int c0 = std::min(std::max((int)((x0[i] - min_x) * inv_cell), 0), cols - 1);
+            int c1 = std::min(std::max((int)((x1[i] - min_x) * inv_cell), 0), cols - 1);
+            int r0 = std::min(std::max((int)((y0[i] - min_y) * inv_cell), 0), rows - 1);
+            int r1 = std::min(std::max((int)((y1[i] - min_y) * inv_cell), 0), rows - 1);
+
+            const simd::v4f bx0 = simd::set1(x0[i]);
+            const simd::v4f by0 = simd::set1(y0[i]);
+            const simd::v4f bx1 = simd::set1(x1[i]);
+            const simd::v4f by1 = simd::set1(y1[i]);
+            const simd::v4f barea = simd::set1(areas[i]);
+
+            bool keep = true;
+            for (int r = r0; r <= r1 && keep; r++)
+            {
+                for (int c = c0; c <= c1; c++)
+                {
+                    if (buckets[r * cols + c].suppress(bx0, by0, bx1, by1, barea, threshold))
+                    {
+                        keep = false;
+                        break;
+                    }
+                }
+            }
+
+            if (keep)
+            {
+                picked.push_back(order[i]);
+                for (int r = r0; r <= r1; r++)
+                {
+                    for (int c = c0; c <= c1; c++)
+                    {
+                        buckets[r * cols + c].push(x0[i], y0[i], x1[i], y1[i], areas[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    // greedy nms that gives the same picks as nms_sorted_bboxes while touching only nearby boxes.
+    // class aware mode runs one pass per label on that label's boxes, classes never suppress each
+    // other, and merges the picks back into the order they were visited in.
+    template<typename T>
+    static void nms_grid_bboxes(const std::vector<T>& faceobjects, const std::vector<int>& order, std::vector<int>& picked, const NmsParam& param)
+    {
+        if (!param.class_aware)
+        {
+            nms_grid_pass(faceobjects, order, picked, param.iou_threshold, param.max_det);
+            return;
+        }
+
+        // positions in `order` grouped by label, each group still in visiting order
+        const int n = order.size();
+        std::vector<int> positions(n);
+        std::iota(positions.begin(), positions.end(), 0);
+        std::stable_sort(positions.begin(), positions.end(), [&](int a, int b) {
+            return nms_label(faceobjects[order[a]]) < nms_label(faceobjects[order[b]]);
+        });
+
+        std::vector<int> rank(faceobjects.size());
+        for (int i = 0; i < n; i++)
+        {
+            rank[order[i]] = i;
+        }
+
+        std::vector<int> group, group_picked, picked_positions;
+        for (int begin = 0; begin < n;)
+        {
+            const int label = nms_label(faceobjects[order[positions[begin]]]);
+            int end = begin;
+            group.clear();
+            while (end < n && nms_label(faceobjects[order[positions[end]]]) == label)
+            {
+                group.push_back(order[positions[end]]);
+                end++;
+            }
+            // no class keeps more than max_det, the cap over all of them is applied after the merge
+            nms_grid_pass(faceobjects, group, group_picked, param.iou_threshold, param.max_det);
+            for (int index : group_picked)
+            {
+                picked_positions.push_back(rank[index]);
+            }
+            begin = end;
+        }
+
+        std::sort(picked_positions.begin(), picked_positions.end());
+        if (param.max_det > 0 && (int)picked_positions.size() > param.max_det)
+        {
+            picked_positions.resize(param.max_det);
+        }
+        picked.clear();
+        for (int position : picked_positions)
+        {
+            picked.push_back(order[position]);
+        }
+    }
+
+    template<typename T>
+    static void nms_grid_sorted_bboxes(const std::vector<T>& faceobjects, std::vector<int>& picked, const NmsParam& param)
+    {
+        std::vector<int> order(faceobjects.size());
+        std::iota(order.begin(), order.end(), 0);
+        nms_grid_bboxes(faceobjects, order, picked, param);
+    }
+
+    // order the proposals by prob (only the top_k best if set) and run nms on them.
+    // proposals stay where they are, picked holds their indices in descending prob.
+    template<typename T>
+    static void nms_bboxes(const std::vector<T>& proposals, std::vector<int>& picked, const NmsParam& param)
+    {
+        AX_TRACE_SCOPE("nms");
+        std::vector<int> order;
+        sort_descent_indices(proposals, order, param.top_k, param.sort);
+
+        // a negative threshold suppresses disjoint boxes too, which the grid cannot see
+        if (param.method == NMS_GREEDY || param.iou_threshold < 0.f)
+        {
+            nms_greedy_bboxes(proposals, order, picked, param.iou_threshold, param.class_aware, param.max_det);
+        }
+        else
+        {
+            nms_grid_bboxes(proposals, order, picked, param);
+        }
+    }
+} // namespace detection
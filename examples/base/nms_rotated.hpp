@@ -0,0 +1,177 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "base/nms.hpp"
+#include "base/simd.hpp"
+#include "utilities/trace.hpp"
+
+// nms of rotated boxes (center x / y in rect.x / rect.y, width, height, angle) by probiou, the
+// bhattacharyya coefficient bc = exp(-bd) of the gaussians the boxes span. as in ultralytics a box
+// is suppressed by every better box, picked or not, whose bc with it is at least the threshold.
+//
+// bd = t1 + t2 + t3, t1 + t2 = d' S^-1 d / 4 with S the sum of the covariances and t3 = log(q) / 2 >= 0,
+// so bd >= |d|^2 / (4 trace(S)): boxes further apart than that never suppress each other and are
+// rejected with a distance test before the full probiou. bc >= T is tested as q <= exp(2 (-log T - t1 - t2)),
+// which needs no log in the vector loop.
+
+namespace detection
+{
+    // the bc threshold of an ultralytics style probiou threshold, iou = 1 - sqrt(1 - bc + 1e-7)
+    static inline float probiou_threshold(float iou_threshold)
+    {
+        return 1.f + 1e-7f - (1.f - iou_threshold) * (1.f - iou_threshold);
+    }
+
+    // the covariance terms of the boxes, computed once, struct of arrays padded to a multiple of 4.
+    // padding boxes sit far away and never reach the probiou
+    struct RotatedNmsBoxes
+    {
+        std::vector<float> x, y; // centers
+        std::vector<float> a, b, c; // covariance [a c; c b]
+        std::vector<float> root;    // sqrt(max(ab - c^2, 0))
+        std::vector<float> trace;   // a + b
+        std::vector<float> label;
+        int count = 0;
+
+        template<typename T>
+        void assign(const std::vector<T>& boxes)
+        {
+            count = (int)boxes.size();
+            const size_t padded = (boxes.size() + 3) & ~(size_t)3;
+            for (auto* v : {&x, &y})
+            {
+                v->assign(padded, 1e18f);
+            }
+            for (auto* v : {&a, &b, &c, &root, &trace})
+            {
+                v->assign(padded, 0.f);
+            }
+            label.assign(padded, -1.f);
+
+            for (int i = 0; i < count; ++i)
+            {
+                const T& obj = boxes[i];
+                const float ww = obj.rect.width * obj.rect.width / 12.f;
+                const float hh = obj.rect.height * obj.rect.height / 12.f;
+                const float cs = std::cos(obj.angle);
+                const float sn = std::sin(obj.angle);
+                x[i] = obj.rect.x;
+                y[i] = obj.rect.y;
+                a[i] = ww * cs * cs + hh * sn * sn;
+                b[i] = ww * sn * sn + hh * cs * cs;
+                c[i] = (ww - hh) * cs * sn;
+                root[i] = std::sqrt(std::max(a[i] * b[i] - c[i] * c[i], 0.f));
+                trace[i] = a[i] + b[i];
+                label[i] = (float)nms_label(obj);
+            }
+        }
+    };
+
+    // boxes sorted by descending prob. picked gets the kept indices in order, at most max_det if > 0.
+    // a box is suppressed when bc >= bc_threshold with any earlier box, of the same label with class_aware
+    template<typename T>
+    static void nms_rotated_probiou(const std::vector<T>& boxes, std::vector<int>& picked, float bc_threshold, bool class_aware = false,
+                                    int max_det = 0)
+    {
+        AX_TRACE_SCOPE("nms_rotated");
+        picked.clear();
+        const int n = (int)boxes.size();
+        const float eps = 1e-7f;
+
+        // bd is clamped to [eps, 100] before the exp, nothing to test outside of that
+        const float limit = bc_threshold > 0.f ? -std::log(bc_threshold) : FLT_MAX;
+        const bool keep_all = limit < eps;
+        const bool suppress_all = limit >= 100.f;
+
+        RotatedNmsBoxes soa;
+        soa.assign(boxes);
+
+        // |d|^2 > 4 limit trace(S) can not suppress, 1% of slack for the rounding of t3 around 0
+        const simd::v4f reach = simd::set1(suppress_all ? FLT_MAX : 4.f * limit * 1.01f + 1e-3f);
+        const simd::v4f v_limit2 = simd::set1(2.f * std::min(limit, 100.f));
+        const simd::v4f v_eps = simd::set1(eps);
+        const simd::v4f v_quarter = simd::set1(0.25f);
+        const simd::v4f v_half = simd::set1(0.5f);
+        const simd::v4f v_four = simd::set1(4.f);
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (max_det > 0 && (int)picked.size() >= max_det)
+                break;
+
+            bool keep = true;
+            if (!keep_all)
+            {
+                const simd::v4f xi = simd::set1(soa.x[i]), yi = simd::set1(soa.y[i]);
+                const simd::v4f ai = simd::set1(soa.a[i]), bi = simd::set1(soa.b[i]), ci = simd::set1(soa.c[i]);
+                const simd::v4f ri = simd::set1(soa.root[i]), ti = simd::set1(soa.trace[i]), li = simd::set1(soa.label[i]);
+
+                for (int j = 0; j < i && keep; j += 4)
+                {
+                    const int valid = i - j >= 4 ? 0xF : (1 << (i - j)) - 1;
+                    const simd::v4f dx = simd::sub(xi, simd::load(&soa.x[j]));
+                    const simd::v4f dy = simd::sub(yi, simd::load(&soa.y[j]));
+                    const simd::v4f dx2 = simd::mul(dx, dx), dy2 = simd::mul(dy, dy);
+
+                    // the distance test, then the label
+                    int near = ~simd::cmpgt_mask(simd::add(dx2, dy2), simd::mul(reach, simd::add(ti, simd::load(&soa.trace[j])))) & valid;
+                    if (near != 0 && class_aware)
+                    {
+                        const simd::v4f lj = simd::load(&soa.label[j]);
+                        near &= ~(simd::cmpgt_mask(li, lj) | simd::cmpgt_mask(lj, li));
+                    }
+                    if (near == 0)
+                        continue;
+                    if (suppress_all)
+                    {
+                        keep = false;
+                        break;
+                    }
+
+                    const simd::v4f sa = simd::add(ai, simd::load(&soa.a[j]));
+                    const simd::v4f sb = simd::add(bi, simd::load(&soa.b[j]));
+                    const simd::v4f sc = simd::add(ci, simd::load(&soa.c[j]));
+                    const simd::v4f det = simd::sub(simd::mul(sa, sb), simd::mul(sc, sc));
+                    const simd::v4f inv = simd::div(simd::set1(1.f), simd::add(det, v_eps));
+                    // t1 + t2 = ((a dy^2 + b dx^2) / 4 - c dx dy / 2) / (det + eps)
+                    const simd::v4f t12 = simd::mul(simd::sub(simd::mul(simd::add(simd::mul(sa, dy2), simd::mul(sb, dx2)), v_quarter),
+                                                              simd::mul(simd::mul(sc, simd::mul(dx, dy)), v_half)),
+                                                    inv);
+                    const simd::v4f q = simd::add(simd::div(det, simd::add(simd::mul(v_four, simd::mul(ri, simd::load(&soa.root[j]))), v_eps)), v_eps);
+                    const simd::v4f bound = simd::exp(simd::sub(v_limit2, simd::add(t12, t12)));
+                    if ((~simd::cmpgt_mask(q, bound) & near) != 0)
+                    {
+                        keep = false;
+                    }
+                }
+            }
+
+            if (keep)
+                picked.push_back(i);
+        }
+    }
+} // namespace detection
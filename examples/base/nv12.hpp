@@ -0,0 +1,112 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "base/letterbox.hpp"
+#include "utilities/trace.hpp"
+
+namespace common
+{
+    // letterbox of an nv12 image, like letterbox_layout but with even sizes and offsets so the
+    // 2x2 subsampled chroma stays aligned. boxes move by at most one pixel against the bgr layout.
+    static inline LetterboxLayout nv12_letterbox_layout(int src_rows, int src_cols, int letterbox_rows, int letterbox_cols)
+    {
+        LetterboxLayout layout = letterbox_layout(src_rows, src_cols, letterbox_rows, letterbox_cols);
+        layout.resize_rows = std::min((layout.resize_rows + 1) & ~1, letterbox_rows & ~1);
+        layout.resize_cols = std::min((layout.resize_cols + 1) & ~1, letterbox_cols & ~1);
+        layout.top = ((letterbox_rows - layout.resize_rows) / 2) & ~1;
+        layout.left = ((letterbox_cols - layout.resize_cols) / 2) & ~1;
+        return layout;
+    }
+
+    // bilinear resize of one plane with `channels` interleaved channels (1 for y, 2 for the uv of nv12).
+    // same kernels as the bgr letterbox, so each plane matches cv::resize INTER_LINEAR.
+    static void resize_plane_linear(const uint8_t* src, int src_cols, int src_rows, size_t src_stride,
+                                    uint8_t* dst, int dst_cols, int dst_rows, size_t dst_stride, int channels)
+    {
+        std::vector<int> x_offsets, y_offsets;
+        std::vector<short> alpha, beta;
+        linear_coefs(src_cols, dst_cols, true, x_offsets, alpha);
+        linear_coefs(src_rows, dst_rows, false, y_offsets, beta);
+
+        const int n = dst_cols * channels;
+        std::vector<int> row0(n), row1(n);
+        auto hresize = [&](int sy, int* row) {
+            const uint8_t* line = src + sy * src_stride;
+            for (int dx = 0; dx < dst_cols; ++dx)
+            {
+                const uint8_t* p0 = line + x_offsets[dx] * channels;
+                const uint8_t* p1 = line + std::min(x_offsets[dx] + 1, src_cols - 1) * channels;
+                for (int c = 0; c < channels; ++c)
+                {
+                    row[dx * channels + c] = p0[c] * alpha[dx * 2] + p1[c] * alpha[dx * 2 + 1];
+                }
+            }
+        };
+
+        for (int dy = 0; dy < dst_rows; ++dy)
+        {
+            hresize(std::min(std::max(y_offsets[dy], 0), src_rows - 1), row0.data());
+            hresize(std::min(std::max(y_offsets[dy] + 1, 0), src_rows - 1), row1.data());
+            linear_vresize_row(row0.data(), row1.data(), beta[dy * 2], beta[dy * 2 + 1], n, dst + dy * dst_stride);
+        }
+    }
+
+    // cpu reference of the letterbox the ivps vpp does from an nv12 frame into an nv12 npu input.
+    // the source planes may have any stride, dst is y (dst_stride * letterbox_rows) followed by uv.
+    // used on hosts without ivps and to check the hardware path.
+    static void nv12_letterbox(const uint8_t* src_y, const uint8_t* src_uv, int src_rows, int src_cols, size_t src_stride,
+                               uint8_t* dst, int letterbox_rows, int letterbox_cols, size_t dst_stride = 0,
+                               uint8_t pad_y = 0, uint8_t pad_uv = 128)
+    {
+        AX_TRACE_SCOPE("nv12_letterbox");
+        if (dst_stride == 0)
+        {
+            dst_stride = letterbox_cols;
+        }
+        uint8_t* dst_y = dst;
+        uint8_t* dst_uv = dst + dst_stride * letterbox_rows;
+
+        for (int y = 0; y < letterbox_rows; ++y)
+        {
+            memset(dst_y + y * dst_stride, pad_y, letterbox_cols);
+        }
+        for (int y = 0; y < letterbox_rows / 2; ++y)
+        {
+            memset(dst_uv + y * dst_stride, pad_uv, letterbox_cols);
+        }
+
+        const LetterboxLayout layout = nv12_letterbox_layout(src_rows, src_cols, letterbox_rows, letterbox_cols);
+        if (layout.resize_rows <= 0 || layout.resize_cols <= 0)
+        {
+            return;
+        }
+        resize_plane_linear(src_y, src_cols, src_rows, src_stride,
+                            dst_y + layout.top * dst_stride + layout.left, layout.resize_cols, layout.resize_rows, dst_stride, 1);
+        resize_plane_linear(src_uv, src_cols / 2, src_rows / 2, src_stride,
+                            dst_uv + (layout.top / 2) * dst_stride + layout.left, layout.resize_cols / 2, layout.resize_rows / 2, dst_stride, 2);
+    }
+} // namespace common
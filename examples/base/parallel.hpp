@@ -0,0 +1,224 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utilities/trace.hpp"
+
+namespace common
+{
+    // fixed set of workers for the data parallel parts of the post process, i.e. row bands of an
+    // image or row tiles of the detection heads. parallel_for() deals the chunks out round robin to
+    // one queue per thread, a thread takes from the front of its own queue and steals from the back
+    // of the others once it is empty, so tiles of uneven cost still keep every core busy. the calling
+    // thread takes chunks too and returns when all of them are done. a parallel_for() from inside a
+    // chunk runs inline.
+    class thread_pool
+    {
+    public:
+        // `threads` counts the caller, 0 for one per core
+        explicit thread_pool(int threads = 0)
+        {
+            if (threads <= 0)
+            {
+                threads = std::max(1, (int)std::thread::hardware_concurrency());
+            }
+            for (int i = 0; i < threads; ++i)
+            {
+                this->queues.emplace_back(new queue_t);
+            }
+            for (int i = 1; i < threads; ++i)
+            {
+                this->workers.emplace_back([this, i]() { work(i); });
+            }
+        }
+
+        ~thread_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stopping = true;
+            }
+            this->wake.notify_all();
+            for (auto& worker : this->workers)
+            {
+                worker.join();
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        // the pool the post process helpers use when they are not given one
+        static thread_pool& shared()
+        {
+            static thread_pool pool;
+            return pool;
+        }
+
+        // threads working on a parallel_for, the caller included
+        int size() const
+        {
+            return (int)this->workers.size() + 1;
+        }
+
+        // func(begin, end) over [0, count) in chunks of `grain`
+        void parallel_for(int count, int grain, const std::function<void(int, int)>& func)
+        {
+            grain = std::max(grain, 1);
+            const int chunks = (count + grain - 1) / grain;
+            if (chunks <= 1 || this->workers.empty() || inside())
+            {
+                if (count > 0)
+                {
+                    func(0, count);
+                }
+                return;
+            }
+
+            // one job at a time, a second caller waits for the first one
+            std::lock_guard<std::mutex> submit_lock(this->submit);
+            for (int i = 0; i < chunks; ++i)
+            {
+                const int begin = i * grain;
+                queue_t& queue = *this->queues[i % this->queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.ranges.emplace_back(begin, std::min(begin + grain, count));
+            }
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->job = &func;
+                this->generation++;
+            }
+            this->wake.notify_all();
+
+            run_chunks(func, 0);
+
+            // every chunk is taken, wait for the workers still in one
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->done.wait(lock, [this] { return this->active == 0; });
+            this->job = nullptr;
+        }
+
+    private:
+        typedef std::pair<int, int> range_t;
+
+        struct queue_t
+        {
+            std::mutex mutex;
+            std::deque<range_t> ranges;
+        };
+
+        static bool& inside()
+        {
+            static thread_local bool flag = false;
+            return flag;
+        }
+
+        // the next chunk of thread `self`, its own oldest one or the newest one of another thread
+        bool next_chunk(int self, range_t& range)
+        {
+            const int threads = (int)this->queues.size();
+            for (int i = 0; i < threads; ++i)
+            {
+                queue_t& queue = *this->queues[(self + i) % threads];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.ranges.empty())
+                {
+                    continue;
+                }
+                if (i == 0)
+                {
+                    range = queue.ranges.front();
+                    queue.ranges.pop_front();
+                }
+                else
+                {
+                    range = queue.ranges.back();
+                    queue.ranges.pop_back();
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void run_chunks(const std::function<void(int, int)>& func, int self)
+        {
+            inside() = true;
+            range_t range;
+            while (next_chunk(self, range))
+            {
+                func(range.first, range.second);
+            }
+            inside() = false;
+        }
+
+        void work(int self)
+        {
+            AX_TRACE_THREAD("pool " + std::to_string(self));
+            size_t seen = 0;
+            for (;;)
+            {
+                const std::function<void(int, int)>* current = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->wake.wait(lock, [&] { return this->stopping || (this->job != nullptr && this->generation != seen); });
+                    if (this->stopping)
+                    {
+                        return;
+                    }
+                    seen = this->generation;
+                    current = this->job;
+                    this->active++;
+                }
+                run_chunks(*current, self);
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    if (--this->active == 0)
+                    {
+                        this->done.notify_all();
+                    }
+                }
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<queue_t> > queues; // one per thread, the caller's first
+        std::mutex submit;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        bool stopping = false;
+
+        const std::function<void(int, int)>* job = nullptr;
+        size_t generation = 0;
+        int active = 0; // workers inside run_chunks of the current job
+    };
+} // namespace common
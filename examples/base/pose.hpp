@@ -28,6 +28,8 @@
 #include <string>
 #include <iostream>
 
+#include "base/heatmap.hpp"
+
 namespace pose
 {
     typedef struct
@@ -361,46 +363,90 @@ namespace pose
         cv::imwrite("./hand_pose_out.png", img);
     }
 
-    static inline void post_process(float* data, ai_body_parts_s& pose, int joint_num, int img_h, int img_w)
+    // keypoints of `batch` crops of joint_num x (img_h / 4) x (img_w / 4) heatmaps, x and y in [0, 1)
+    // of the crop. like find_max_2d a joint whose max is not above -10 ends up at 0, 0 with -10.
+    static inline void heatmap_keypoints(const float* data, int batch, int joint_num, int img_h, int img_w, std::vector<ai_point_t>& keypoints,
+                                         int refine = HEATMAP_REFINE_NONE, bool channels_last = false)
     {
-        int heatmap_width = img_w / 4;
-        int heatmap_height = img_h / 4;
-        int max_idx_width, max_idx_height;
-        float max_score;
+        const int heatmap_width = img_w / 4;
+        const int heatmap_height = img_h / 4;
+        std::vector<HeatmapPeak> peaks((size_t)batch * joint_num);
+        decode_heatmaps(data, batch, joint_num, heatmap_height, heatmap_width, peaks.data(), refine, channels_last);
 
-        ai_point_t kp;
-        for (int c = 0; c < joint_num; ++c)
+        keypoints.resize(peaks.size());
+        for (size_t i = 0; i < peaks.size(); ++i)
         {
-            find_max_2d(data, heatmap_width, heatmap_height, &max_idx_width, &max_idx_height, &max_score, c);
-            kp.x = (float)max_idx_width / (float)heatmap_width;
-            kp.y = (float)max_idx_height / (float)heatmap_height;
-            kp.score = max_score;
-            pose.keypoints.push_back(kp);
-
-            //            std::cout << "x: " << pose.keypoints[c].x << ", y: " << pose.keypoints[c].y << ", score: "
-            //                      << pose.keypoints[c].score << std::endl;
+            const bool found = peaks[i].score > -10.f;
+            keypoints[i].x = found ? peaks[i].x / (float)heatmap_width : 0.f;
+            keypoints[i].y = found ? peaks[i].y / (float)heatmap_height : 0.f;
+            keypoints[i].score = found ? peaks[i].score : -10.f;
         }
     }
 
-    static inline void animal_post_process(float* data, ai_animal_parts_s& pose, int joint_num, int img_h, int img_w)
+    static inline void post_process(float* data, ai_body_parts_s& pose, int joint_num, int img_h, int img_w, int refine = HEATMAP_REFINE_NONE)
     {
-        int heatmap_width = img_w / 4;
-        int heatmap_height = img_h / 4;
-        int max_idx_width, max_idx_height;
-        float max_score;
+        std::vector<ai_point_t> keypoints;
+        heatmap_keypoints(data, 1, joint_num, img_h, img_w, keypoints, refine);
+        pose.keypoints.insert(pose.keypoints.end(), keypoints.begin(), keypoints.end());
+    }
 
-        ai_point_t kp;
-        for (int c = 0; c < joint_num; ++c)
-        {
-            find_max_2d(data, heatmap_width, heatmap_height, &max_idx_width, &max_idx_height, &max_score, c);
-            kp.x = (float)max_idx_width / (float)heatmap_width;
-            kp.y = (float)max_idx_height / (float)heatmap_height;
-            kp.score = max_score;
-            pose.keypoints.push_back(kp);
+    static inline void animal_post_process(float* data, ai_animal_parts_s& pose, int joint_num, int img_h, int img_w, int refine = HEATMAP_REFINE_NONE)
+    {
+        std::vector<ai_point_t> keypoints;
+        heatmap_keypoints(data, 1, joint_num, img_h, img_w, keypoints, refine);
+        pose.keypoints.insert(pose.keypoints.end(), keypoints.begin(), keypoints.end());
+    }
 
-            //            std::cout << "x: " << pose.keypoints[c].x << ", y: " << pose.keypoints[c].y << ", score: "
-            //                      << pose.keypoints[c].score << std::endl;
-        }
+    // crop input pixels to image pixels, x' = m[0] x + m[1] y + m[2], y' = m[3] x + m[4] y + m[5].
+    // the inverse of the warp that cut the crop out of the image
+    typedef struct
+    {
+        float m[6];
+    } CropAffine;
+
+    // a center / scale box resized to input_w x input_h, the way rtmpose / mmpose cut their crops
+    static inline CropAffine crop_affine(float center_x, float center_y, float scale_w, float scale_h, int input_w, int input_h)
+    {
+        CropAffine affine = {{scale_w / (float)input_w, 0.f, center_x - scale_w * 0.5f, 0.f, scale_h / (float)input_h, center_y - scale_h * 0.5f}};
+        return affine;
+    }
+
+    // keypoints of `batch` crops from simcc vectors, batch x joints x x_size and batch x joints x y_size.
+    // the argmax of a vector over split_ratio is the crop pixel, mapped into the image through the
+    // affine of its crop if `affines` is given. the score is the smaller of the x and y maxima as in
+    // mmpose, or their mean with mean_score. keypoints has batch * joints entries.
+    static inline void decode_simcc(const float* simcc_x, const float* simcc_y, int batch, int joints, int x_size, int y_size, float split_ratio,
+                                    const CropAffine* affines, ai_point_t* keypoints, bool mean_score = false, common::thread_pool* pool = nullptr)
+    {
+        AX_TRACE_SCOPE("simcc_decode");
+        common::thread_pool& workers = pool != nullptr ? *pool : common::thread_pool::shared();
+        // a crop is a few us of work, hand them out a few at a time
+        workers.parallel_for(batch, 4, [&](int begin, int end) {
+            for (int n = begin; n < end; ++n)
+            {
+                for (int k = 0; k < joints; ++k)
+                {
+                    const size_t row = (size_t)n * joints + k;
+                    float x_score, y_score;
+                    const float x = (float)heatmap_argmax(simcc_x + row * x_size, x_size, x_score) / split_ratio;
+                    const float y = (float)heatmap_argmax(simcc_y + row * y_size, y_size, y_score) / split_ratio;
+
+                    ai_point_t& kp = keypoints[row];
+                    if (affines != nullptr)
+                    {
+                        const float* m = affines[n].m;
+                        kp.x = m[0] * x + m[1] * y + m[2];
+                        kp.y = m[3] * x + m[4] * y + m[5];
+                    }
+                    else
+                    {
+                        kp.x = x;
+                        kp.y = y;
+                    }
+                    kp.score = mean_score ? (x_score + y_score) * 0.5f : std::min(x_score, y_score);
+                }
+            }
+        });
     }
 
     static inline void ppl_pose_post_process(float* data1, float* data2, ai_body_parts_s& pose, int joint_num, int img_h, int img_w, int offset_top, int offset_left, int offset_x, int offset_y, float ratio)
@@ -0,0 +1,121 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "base/candidate.hpp"
+#include "base/class_scan.hpp"
+#include "base/parallel.hpp"
+#include "utilities/trace.hpp"
+
+namespace detection
+{
+    // grid rows per tile, an 80 x 80 head gives 10 tiles and a 20 x 20 one 3
+    const int PROPOSAL_TILE_ROWS = 8;
+
+    static inline void clear_tile(Proposals& tile)
+    {
+        tile.clear();
+    }
+
+    template<typename T>
+    static inline void clear_tile(std::vector<T>& tile)
+    {
+        tile.clear();
+    }
+
+    static inline void append_tile(Proposals& dst, const Proposals& src)
+    {
+        dst.append(src);
+    }
+
+    template<typename T>
+    static inline void append_tile(std::vector<T>& dst, const std::vector<T>& src)
+    {
+        dst.insert(dst.end(), src.begin(), src.end());
+    }
+
+    // the heads of one frame decoded in row tiles on a common::thread_pool. every tile fills a buffer
+    // of its own, the buffers are appended in head and row order afterwards, so the candidates come
+    // out in the order of a serial decode and the stable sort and nms keep the same boxes. Buffer is
+    // Proposals or a std::vector<Object>. keep one around, the tile buffers stop allocating after the
+    // first frames.
+    template<typename Buffer>
+    struct ProposalTiles
+    {
+        // decode(head, rows, buffer) decodes the GridRows `rows` of head `head` into `buffer`, head_rows
+        // are the grid rows of each head, letterbox_rows / stride. tile_rows 0 keeps every head in one
+        // tile, for decoders without a row range, which are then only parallel across the heads.
+        // the candidates are appended to `merged`.
+        template<typename Decode>
+        void run(const int* head_rows, int heads, const Decode& decode, Buffer& merged, int tile_rows = PROPOSAL_TILE_ROWS,
+                 common::thread_pool* pool = nullptr)
+        {
+            AX_TRACE_SCOPE("decode");
+            tiles.clear();
+            for (int head = 0; head < heads; ++head)
+            {
+                const int step = tile_rows > 0 ? tile_rows : std::max(head_rows[head], 1);
+                for (int row = 0; row < head_rows[head]; row += step)
+                {
+                    tiles.push_back({head, GridRows(row, std::min(row + step, head_rows[head]))});
+                }
+            }
+            if (buffers.size() < tiles.size())
+            {
+                buffers.resize(tiles.size());
+            }
+
+            common::thread_pool& workers = pool != nullptr ? *pool : common::thread_pool::shared();
+            workers.parallel_for((int)tiles.size(), 1, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i)
+                {
+                    AX_TRACE_SCOPE("decode_tile");
+                    clear_tile(buffers[i]);
+                    decode(tiles[i].head, tiles[i].rows, buffers[i]);
+                }
+            });
+
+            AX_TRACE_SCOPE("decode_merge");
+            for (size_t i = 0; i < tiles.size(); ++i)
+            {
+                append_tile(merged, buffers[i]);
+            }
+        }
+
+        size_t tile_count() const
+        {
+            return tiles.size();
+        }
+
+    private:
+        typedef struct
+        {
+            int head;
+            GridRows rows;
+        } tile_t;
+
+        std::vector<tile_t> tiles;
+        std::vector<Buffer> buffers;
+    };
+} // namespace detection
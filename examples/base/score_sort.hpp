@@ -0,0 +1,161 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace detection
+{
+    enum SortMethod
+    {
+        SORT_AUTO = 0,  // comparison sort for small inputs, radix sort from SORT_RADIX_MIN on
+        SORT_STD = 1,   // std::sort on packed (key, index) words
+        SORT_RADIX = 2, // lsd radix sort on the float bits of the score
+    };
+
+    // below this many proposals the radix passes cost more than they save
+    const int SORT_RADIX_MIN = 2048;
+
+    // unsigned key whose ascending order is the descending order of the float
+    static inline uint32_t descent_key(float v)
+    {
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+        return ~bits;
+    }
+
+    static inline void radix_sort_indices(const std::vector<uint32_t>& keys, std::vector<int>& order)
+    {
+        const int n = keys.size();
+        if (n == 0)
+        {
+            order.clear();
+            return;
+        }
+        std::vector<uint32_t> key_a(keys), key_b(n);
+        std::vector<int> index_b(n);
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 0);
+
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            int count[257] = {0};
+            for (int i = 0; i < n; i++)
+            {
+                count[((key_a[i] >> shift) & 0xff) + 1]++;
+            }
+            // scores often share the high bytes, such a pass would only copy
+            if (count[((key_a[0] >> shift) & 0xff) + 1] == n)
+                continue;
+
+            for (int b = 0; b < 256; b++)
+            {
+                count[b + 1] += count[b];
+            }
+            for (int i = 0; i < n; i++)
+            {
+                int dst = count[(key_a[i] >> shift) & 0xff]++;
+                key_b[dst] = key_a[i];
+                index_b[dst] = order[i];
+            }
+            key_a.swap(key_b);
+            order.swap(index_b);
+        }
+    }
+
+    // indices of `objects` by descending prob, equal probs keep their original order.
+    // with 0 < top_k < size only the best top_k indices are returned, still fully ordered.
+    // the comparison paths sort (key << 32 | index) words, which is stable and never touches the objects again.
+    template<typename T>
+    static void sort_descent_indices(const std::vector<T>& objects, std::vector<int>& order, int top_k = 0, int method = SORT_AUTO)
+    {
+        const int n = objects.size();
+        const bool partial = top_k > 0 && top_k < n;
+
+        if (!partial && (method == SORT_RADIX || (method == SORT_AUTO && n >= SORT_RADIX_MIN)))
+        {
+            std::vector<uint32_t> keys(n);
+            for (int i = 0; i < n; i++)
+            {
+                keys[i] = descent_key(objects[i].prob);
+            }
+            radix_sort_indices(keys, order);
+            return;
+        }
+
+        std::vector<uint64_t> words(n);
+        for (int i = 0; i < n; i++)
+        {
+            words[i] = ((uint64_t)descent_key(objects[i].prob) << 32) | (uint32_t)i;
+        }
+
+        int keep = n;
+        if (partial)
+        {
+            keep = top_k;
+            if (top_k * 16 < n)
+            {
+                // a heap of top_k touches each of the n scores once
+                std::partial_sort(words.begin(), words.begin() + top_k, words.end());
+            }
+            else
+            {
+                std::nth_element(words.begin(), words.begin() + top_k, words.end());
+                std::sort(words.begin(), words.begin() + top_k);
+            }
+        }
+        else
+        {
+            std::sort(words.begin(), words.end());
+        }
+
+        order.resize(keep);
+        for (int i = 0; i < keep; i++)
+        {
+            order[i] = (int)(words[i] & 0xffffffffu);
+        }
+    }
+
+    // sort the objects themselves by descending prob, each object is moved once
+    template<typename T>
+    static void qsort_descent_inplace(std::vector<T>& faceobjects)
+    {
+        if (faceobjects.empty())
+            return;
+
+        std::vector<int> order;
+        sort_descent_indices(faceobjects, order);
+
+        std::vector<T> sorted;
+        sorted.reserve(faceobjects.size());
+        for (int index : order)
+        {
+            sorted.push_back(std::move(faceobjects[index]));
+        }
+        faceobjects.swap(sorted);
+    }
+} // namespace detection
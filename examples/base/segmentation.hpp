@@ -0,0 +1,329 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "base/class_scan.hpp"
+#include "base/parallel.hpp"
+#include "base/simd.hpp"
+#include "utilities/trace.hpp"
+
+// post process of the semantic segmentation models: a label map from the scores, drawn at the
+// output resolution with a nearest upscale and a palette. every step runs over row bands on a
+// common::thread_pool, the shared one when none is given.
+namespace segmentation
+{
+    // color of one label in bgr, `a` is its weight over the image when blending: 255 paints the
+    // color, 0 keeps the image
+    typedef struct
+    {
+        uint8_t b;
+        uint8_t g;
+        uint8_t r;
+        uint8_t a;
+    } LabelColor;
+
+    // rows per chunk handed to the pool
+    const int SEG_BAND_ROWS = 16;
+
+    static inline common::thread_pool& pool_or_shared(common::thread_pool* pool)
+    {
+        return pool != nullptr ? *pool : common::thread_pool::shared();
+    }
+
+    // the pascal voc colormap of 256 labels
+    static inline std::vector<LabelColor> voc_palette(uint8_t alpha = 255)
+    {
+        std::vector<LabelColor> palette(256);
+        for (int i = 0; i < 256; ++i)
+        {
+            int r = 0, g = 0, b = 0;
+            int c = i;
+            for (int j = 0; j < 8; ++j)
+            {
+                r |= ((c >> 0) & 1) << (7 - j);
+                g |= ((c >> 1) & 1) << (7 - j);
+                b |= ((c >> 2) & 1) << (7 - j);
+                c >>= 3;
+            }
+            palette[i] = {(uint8_t)b, (uint8_t)g, (uint8_t)r, alpha};
+        }
+        return palette;
+    }
+
+    // label of every pixel of a channels x rows x cols score map, the first channel on ties like a
+    // strict `>` loop. pixels whose best score is not above min_score get label 0.
+    // 8 pixels are reduced side by side, the running max and its channel index in 2 vector pairs
+    static inline void argmax_nchw(const float* data, int channels, int rows, int cols, uint8_t* labels, size_t label_stride,
+                                   float min_score = -FLT_MAX, common::thread_pool* pool = nullptr)
+    {
+        AX_TRACE_SCOPE("seg_argmax");
+        const size_t plane = (size_t)rows * cols;
+        pool_or_shared(pool).parallel_for(rows, SEG_BAND_ROWS, [&](int begin, int end) {
+            const simd::v4f vmin = simd::set1(min_score);
+            const simd::v4f zero = simd::set1(0.f);
+            for (int y = begin; y < end; ++y)
+            {
+                const float* row = data + (size_t)y * cols;
+                uint8_t* out = labels + y * label_stride;
+                int x = 0;
+                for (; x + 7 < cols; x += 8)
+                {
+                    simd::v4f max0 = simd::load(row + x), max1 = simd::load(row + x + 4);
+                    simd::v4f idx0 = zero, idx1 = zero;
+                    const float* p = row + x + plane;
+                    for (int c = 1; c < channels; ++c, p += plane)
+                    {
+                        const simd::v4f vc = simd::set1((float)c);
+                        const simd::v4f v0 = simd::load(p), v1 = simd::load(p + 4);
+                        idx0 = simd::select_gt(v0, max0, vc, idx0);
+                        idx1 = simd::select_gt(v1, max1, vc, idx1);
+                        max0 = simd::max(v0, max0);
+                        max1 = simd::max(v1, max1);
+                    }
+                    idx0 = simd::select_gt(max0, vmin, idx0, zero);
+                    idx1 = simd::select_gt(max1, vmin, idx1, zero);
+                    float idx[8];
+                    simd::store(idx, idx0);
+                    simd::store(idx + 4, idx1);
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        out[x + k] = (uint8_t)idx[k];
+                    }
+                }
+                for (; x < cols; ++x)
+                {
+                    int best = 0;
+                    float best_score = row[x];
+                    for (int c = 1; c < channels; ++c)
+                    {
+                        const float v = row[x + c * plane];
+                        if (v > best_score)
+                        {
+                            best_score = v;
+                            best = c;
+                        }
+                    }
+                    out[x] = best_score > min_score ? (uint8_t)best : 0;
+                }
+            }
+        });
+    }
+
+    // the same for a rows x cols x channels score map
+    static inline void argmax_nhwc(const float* data, int channels, int rows, int cols, uint8_t* labels, size_t label_stride,
+                                   float min_score = -FLT_MAX, common::thread_pool* pool = nullptr)
+    {
+        AX_TRACE_SCOPE("seg_argmax");
+        pool_or_shared(pool).parallel_for(rows, SEG_BAND_ROWS, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y)
+            {
+                const float* p = data + (size_t)y * cols * channels;
+                uint8_t* out = labels + y * label_stride;
+                for (int x = 0; x < cols; ++x, p += channels)
+                {
+                    const float best_score = detection::max_score(p, channels);
+                    out[x] = best_score > min_score ? (uint8_t)detection::find_score(p, channels, best_score) : 0;
+                }
+            }
+        });
+    }
+
+    // label map of a model that outputs the class ids itself (int32 or float), ids outside
+    // [0, classes) become `invalid`
+    template<typename T>
+    static inline void labels_from_ids(const T* ids, int rows, int cols, int classes, uint8_t invalid, uint8_t* labels, size_t label_stride,
+                                       common::thread_pool* pool = nullptr)
+    {
+        pool_or_shared(pool).parallel_for(rows, SEG_BAND_ROWS, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y)
+            {
+                const T* p = ids + (size_t)y * cols;
+                uint8_t* out = labels + y * label_stride;
+                for (int x = 0; x < cols; ++x)
+                {
+                    const int id = (int)p[x];
+                    out[x] = id >= 0 && id < classes ? (uint8_t)id : invalid;
+                }
+            }
+        });
+    }
+
+    // source element of every output column / row of a nearest resize, cv::resize INTER_NEAREST
+    static inline void nearest_taps(int src_size, int dst_size, std::vector<int>& offsets)
+    {
+        const double scale = 1.0 / ((double)dst_size / src_size);
+        offsets.resize(dst_size);
+        for (int d = 0; d < dst_size; ++d)
+        {
+            offsets[d] = std::min((int)std::floor(d * scale), src_size - 1);
+        }
+    }
+
+    // the nearest upscale of a label map, shared by upscale_nearest() and render(). with `transpose`
+    // the source is read transposed, the rotate 90 + flip some models need, at no extra cost.
+    struct NearestMap
+    {
+        std::vector<int> x_offsets; // element offsets into a source row
+        std::vector<int> y_offsets; // element offsets of the source rows
+        int dst_rows = 0;
+        int dst_cols = 0;
+
+        NearestMap(int src_rows, int src_cols, size_t src_stride, int dst_rows, int dst_cols, bool transpose)
+            : dst_rows(dst_rows), dst_cols(dst_cols)
+        {
+            const int rows = transpose ? src_cols : src_rows;
+            const int cols = transpose ? src_rows : src_cols;
+            nearest_taps(cols, dst_cols, x_offsets);
+            nearest_taps(rows, dst_rows, y_offsets);
+            for (auto& x : x_offsets)
+            {
+                x = transpose ? (int)(x * src_stride) : x;
+            }
+            for (auto& y : y_offsets)
+            {
+                y = transpose ? y : (int)(y * src_stride);
+            }
+        }
+
+        void gather_row(const uint8_t* src, int dst_row, uint8_t* dst) const
+        {
+            const uint8_t* s = src + y_offsets[dst_row];
+            const int* xo = x_offsets.data();
+            for (int x = 0; x < dst_cols; ++x)
+            {
+                dst[x] = s[xo[x]];
+            }
+        }
+    };
+
+    static inline void upscale_nearest(const uint8_t* src, int src_rows, int src_cols, size_t src_stride,
+                                       uint8_t* dst, int dst_rows, int dst_cols, size_t dst_stride, bool transpose = false,
+                                       common::thread_pool* pool = nullptr)
+    {
+        const NearestMap map(src_rows, src_cols, src_stride, dst_rows, dst_cols, transpose);
+        pool_or_shared(pool).parallel_for(dst_rows, SEG_BAND_ROWS, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y)
+            {
+                uint8_t* out = dst + y * dst_stride;
+                if (y > begin && map.y_offsets[y] == map.y_offsets[y - 1])
+                {
+                    memcpy(out, out - dst_stride, dst_cols);
+                    continue;
+                }
+                map.gather_row(src, y, out);
+            }
+        });
+    }
+
+    // one row of labels to bgr with the palette, blended over `image` (bgr) when it is given:
+    // out = (image * (256 - w) + color * w + 128) >> 8 with w = a + a / 128, so 255 is all color
+    static inline void paint_row(const uint8_t* labels, int cols, const LabelColor* palette, const uint16_t* weights,
+                                 const uint8_t* image, uint8_t* out)
+    {
+        if (image == nullptr)
+        {
+            // 4 byte stores that overlap the next pixel, the last one is stored by bytes
+            int x = 0;
+            for (; x + 1 < cols; ++x, out += 3)
+            {
+                memcpy(out, &palette[labels[x]], 4);
+            }
+            for (; x < cols; ++x, out += 3)
+            {
+                const LabelColor& color = palette[labels[x]];
+                out[0] = color.b;
+                out[1] = color.g;
+                out[2] = color.r;
+            }
+            return;
+        }
+        for (int x = 0; x < cols; ++x, out += 3, image += 3)
+        {
+            const LabelColor& color = palette[labels[x]];
+            const int w = weights[labels[x]];
+            const int keep = 256 - w;
+            out[0] = (uint8_t)((image[0] * keep + color.b * w + 128) >> 8);
+            out[1] = (uint8_t)((image[1] * keep + color.g * w + 128) >> 8);
+            out[2] = (uint8_t)((image[2] * keep + color.r * w + 128) >> 8);
+        }
+    }
+
+    static inline void blend_weights(const LabelColor* palette, uint16_t* weights)
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            weights[i] = (uint16_t)(palette[i].a + (palette[i].a >> 7));
+        }
+    }
+
+    // rows x cols labels to bgr, see paint_row
+    static inline void colorize(const uint8_t* labels, size_t label_stride, int rows, int cols, const LabelColor* palette,
+                                const uint8_t* image, size_t image_stride, uint8_t* dst, size_t dst_stride,
+                                common::thread_pool* pool = nullptr)
+    {
+        uint16_t weights[256];
+        blend_weights(palette, weights);
+        pool_or_shared(pool).parallel_for(rows, SEG_BAND_ROWS, [&](int begin, int end) {
+            for (int y = begin; y < end; ++y)
+            {
+                paint_row(labels + y * label_stride, cols, palette, weights, image != nullptr ? image + y * image_stride : nullptr,
+                          dst + y * dst_stride);
+            }
+        });
+    }
+
+    // upscale_nearest and colorize in one pass, the full resolution label map is never stored.
+    // rows that read the same label row as the one above and blend over nothing are copied.
+    static inline void render(const uint8_t* labels, int rows, int cols, size_t label_stride, const LabelColor* palette,
+                              const uint8_t* image, size_t image_stride, uint8_t* dst, int dst_rows, int dst_cols, size_t dst_stride,
+                              bool transpose = false, common::thread_pool* pool = nullptr)
+    {
+        AX_TRACE_SCOPE("seg_render");
+        const NearestMap map(rows, cols, label_stride, dst_rows, dst_cols, transpose);
+        uint16_t weights[256];
+        blend_weights(palette, weights);
+        pool_or_shared(pool).parallel_for(dst_rows, SEG_BAND_ROWS, [&](int begin, int end) {
+            std::vector<uint8_t> row(dst_cols);
+            for (int y = begin; y < end; ++y)
+            {
+                uint8_t* out = dst + y * dst_stride;
+                const bool same = y > begin && map.y_offsets[y] == map.y_offsets[y - 1];
+                if (same && image == nullptr)
+                {
+                    memcpy(out, out - dst_stride, (size_t)dst_cols * 3);
+                    continue;
+                }
+                if (!same)
+                {
+                    map.gather_row(labels, y, row.data());
+                }
+                paint_row(row.data(), dst_cols, palette, weights, image != nullptr ? image + y * image_stride : nullptr, out);
+            }
+        });
+    }
+} // namespace segmentation
@@ -0,0 +1,351 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// 4 x float32 helpers shared by the post process kernels.
+// NEON on aarch64 / armv7, SSE2 on x86, plain arrays elsewhere (AX_SIMD_NONE).
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AX_SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AX_SIMD_SSE 1
+#else
+#define AX_SIMD_NONE 1
+#endif
+
+namespace simd
+{
+#if AX_SIMD_NEON
+    typedef float32x4_t v4f;
+
+    static inline v4f load(const float* p) { return vld1q_f32(p); }
+    static inline void store(float* p, v4f a) { vst1q_f32(p, a); }
+    static inline v4f set1(float v) { return vdupq_n_f32(v); }
+    static inline v4f set4(float a, float b, float c, float d)
+    {
+        float v[4] = {a, b, c, d};
+        return vld1q_f32(v);
+    }
+    static inline v4f add(v4f a, v4f b) { return vaddq_f32(a, b); }
+    static inline v4f sub(v4f a, v4f b) { return vsubq_f32(a, b); }
+    static inline v4f mul(v4f a, v4f b) { return vmulq_f32(a, b); }
+    static inline v4f max(v4f a, v4f b) { return vmaxq_f32(a, b); }
+    static inline v4f min(v4f a, v4f b) { return vminq_f32(a, b); }
+    static inline v4f div(v4f a, v4f b)
+    {
+#if defined(__aarch64__)
+        return vdivq_f32(a, b);
+#else
+        // armv7 has no vector divide, two newton steps on the reciprocal estimate
+        v4f r = vrecpeq_f32(b);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        return vmulq_f32(a, r);
+#endif
+    }
+    // lane mask of a > b, as bits 0..3
+    static inline int cmpgt_mask(v4f a, v4f b)
+    {
+        uint32x4_t m = vcgtq_f32(a, b);
+        uint32_t v[4];
+        vst1q_u32(v, m);
+        return (v[0] & 1) | (v[1] & 2) | (v[2] & 4) | (v[3] & 8);
+    }
+    // lane mask of a >= b, false for NaN lanes
+    static inline int cmpge_mask(v4f a, v4f b)
+    {
+        uint32x4_t m = vcgeq_f32(a, b);
+        uint32_t v[4];
+        vst1q_u32(v, m);
+        return (v[0] & 1) | (v[1] & 2) | (v[2] & 4) | (v[3] & 8);
+    }
+    // lane wise a > b ? x : y
+    static inline v4f select_gt(v4f a, v4f b, v4f x, v4f y) { return vbslq_f32(vcgtq_f32(a, b), x, y); }
+    static inline float hmax(v4f a)
+    {
+#if defined(__aarch64__)
+        return vmaxvq_f32(a);
+#else
+        float32x2_t m = vpmax_f32(vget_low_f32(a), vget_high_f32(a));
+        m = vpmax_f32(m, m);
+        return vget_lane_f32(m, 0);
+#endif
+    }
+    static inline float hsum(v4f a)
+    {
+#if defined(__aarch64__)
+        return vaddvq_f32(a);
+#else
+        float32x2_t s = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+        s = vpadd_f32(s, s);
+        return vget_lane_f32(s, 0);
+#endif
+    }
+    // round towards minus infinity
+    static inline v4f floor(v4f a)
+    {
+        v4f t = vcvtq_f32_s32(vcvtq_s32_f32(a));
+        uint32x4_t gt = vcgtq_f32(t, a);
+        return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(gt, vreinterpretq_u32_f32(vdupq_n_f32(1.f)))));
+    }
+    // 2^n for integral valued n
+    static inline v4f pow2n(v4f n)
+    {
+        int32x4_t i = vcvtq_s32_f32(n);
+        i = vshlq_n_s32(vaddq_s32(i, vdupq_n_s32(127)), 23);
+        return vreinterpretq_f32_s32(i);
+    }
+    static inline void transpose4x4(v4f& r0, v4f& r1, v4f& r2, v4f& r3)
+    {
+        float32x4x2_t t01 = vtrnq_f32(r0, r1);
+        float32x4x2_t t23 = vtrnq_f32(r2, r3);
+        r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+        r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+        r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+    // 16 bytes of 255 where the lane is > 0 and 0 elsewhere, compared as int32 on the float bits
+    static inline void store_positive_u8x16(uint8_t* p, v4f a, v4f b, v4f c, v4f d)
+    {
+        const int32x4_t zero = vdupq_n_s32(0);
+        uint16x8_t lo = vcombine_u16(vmovn_u32(vcgtq_s32(vreinterpretq_s32_f32(a), zero)), vmovn_u32(vcgtq_s32(vreinterpretq_s32_f32(b), zero)));
+        uint16x8_t hi = vcombine_u16(vmovn_u32(vcgtq_s32(vreinterpretq_s32_f32(c), zero)), vmovn_u32(vcgtq_s32(vreinterpretq_s32_f32(d), zero)));
+        vst1q_u8(p, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+    // sum of a[i] * b[i] over n int8, n a multiple of 16. sdot where the core has it, else int16
+    // products pairwise added into int32
+    static inline int32_t dot_i8(const int8_t* a, const int8_t* b, int n)
+    {
+        int32x4_t acc = vdupq_n_s32(0);
+        for (int i = 0; i < n; i += 16)
+        {
+            const int8x16_t va = vld1q_s8(a + i), vb = vld1q_s8(b + i);
+#if defined(__ARM_FEATURE_DOTPROD)
+            acc = vdotq_s32(acc, va, vb);
+#else
+            acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+            acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+#endif
+        }
+#if defined(__aarch64__)
+        return vaddvq_s32(acc);
+#else
+        int32x2_t s = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        s = vpadd_s32(s, s);
+        return vget_lane_s32(s, 0);
+#endif
+    }
+#elif AX_SIMD_SSE
+    typedef __m128 v4f;
+
+    static inline v4f load(const float* p) { return _mm_loadu_ps(p); }
+    static inline void store(float* p, v4f a) { _mm_storeu_ps(p, a); }
+    static inline v4f set1(float v) { return _mm_set1_ps(v); }
+    static inline v4f set4(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+    static inline v4f add(v4f a, v4f b) { return _mm_add_ps(a, b); }
+    static inline v4f sub(v4f a, v4f b) { return _mm_sub_ps(a, b); }
+    static inline v4f mul(v4f a, v4f b) { return _mm_mul_ps(a, b); }
+    static inline v4f max(v4f a, v4f b) { return _mm_max_ps(a, b); }
+    static inline v4f min(v4f a, v4f b) { return _mm_min_ps(a, b); }
+    static inline v4f div(v4f a, v4f b) { return _mm_div_ps(a, b); }
+    static inline int cmpgt_mask(v4f a, v4f b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+    static inline int cmpge_mask(v4f a, v4f b) { return _mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+    static inline v4f select_gt(v4f a, v4f b, v4f x, v4f y)
+    {
+        __m128 m = _mm_cmpgt_ps(a, b);
+        return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y));
+    }
+    static inline float hmax(v4f a)
+    {
+        v4f m = _mm_max_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(m);
+    }
+    static inline float hsum(v4f a)
+    {
+        v4f s = _mm_add_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+        s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(s);
+    }
+    static inline v4f floor(v4f a)
+    {
+        v4f t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.f)));
+    }
+    static inline v4f pow2n(v4f n)
+    {
+        __m128i i = _mm_cvttps_epi32(n);
+        i = _mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23);
+        return _mm_castsi128_ps(i);
+    }
+    static inline void transpose4x4(v4f& r0, v4f& r1, v4f& r2, v4f& r3)
+    {
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    }
+    static inline void store_positive_u8x16(uint8_t* p, v4f a, v4f b, v4f c, v4f d)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_packs_epi32(_mm_cmpgt_epi32(_mm_castps_si128(a), zero), _mm_cmpgt_epi32(_mm_castps_si128(b), zero));
+        __m128i hi = _mm_packs_epi32(_mm_cmpgt_epi32(_mm_castps_si128(c), zero), _mm_cmpgt_epi32(_mm_castps_si128(d), zero));
+        _mm_storeu_si128((__m128i*)p, _mm_packs_epi16(lo, hi));
+    }
+    // sse2 has no signed int8 multiply, both sides are sign extended to int16 for _mm_madd_epi16
+    static inline int32_t dot_i8(const int8_t* a, const int8_t* b, int n)
+    {
+        __m128i acc = _mm_setzero_si128();
+        for (int i = 0; i < n; i += 16)
+        {
+            const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+            const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8), _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8)));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8), _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8)));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(acc);
+    }
+#else
+    struct v4f
+    {
+        float v[4];
+    };
+
+    static inline v4f load(const float* p)
+    {
+        v4f r;
+        memcpy(r.v, p, sizeof(r.v));
+        return r;
+    }
+    static inline void store(float* p, v4f a) { memcpy(p, a.v, sizeof(a.v)); }
+    static inline v4f set4(float a, float b, float c, float d) { return {{a, b, c, d}}; }
+    static inline v4f set1(float v) { return {{v, v, v, v}}; }
+#define AX_SIMD_LANEWISE(name, expr)               \
+    static inline v4f name(v4f a, v4f b)           \
+    {                                              \
+        v4f r;                                     \
+        for (int i = 0; i < 4; ++i)                \
+        {                                          \
+            float x = a.v[i], y = b.v[i];          \
+            r.v[i] = (expr);                       \
+        }                                          \
+        return r;                                  \
+    }
+    AX_SIMD_LANEWISE(add, x + y)
+    AX_SIMD_LANEWISE(sub, x - y)
+    AX_SIMD_LANEWISE(mul, x * y)
+    AX_SIMD_LANEWISE(div, x / y)
+    AX_SIMD_LANEWISE(max, x > y ? x : y)
+    AX_SIMD_LANEWISE(min, x < y ? x : y)
+#undef AX_SIMD_LANEWISE
+    static inline int cmpgt_mask(v4f a, v4f b)
+    {
+        return (a.v[0] > b.v[0]) | ((a.v[1] > b.v[1]) << 1) | ((a.v[2] > b.v[2]) << 2) | ((a.v[3] > b.v[3]) << 3);
+    }
+    static inline int cmpge_mask(v4f a, v4f b)
+    {
+        return (a.v[0] >= b.v[0]) | ((a.v[1] >= b.v[1]) << 1) | ((a.v[2] >= b.v[2]) << 2) | ((a.v[3] >= b.v[3]) << 3);
+    }
+    static inline v4f select_gt(v4f a, v4f b, v4f x, v4f y)
+    {
+        v4f r;
+        for (int i = 0; i < 4; ++i)
+        {
+            r.v[i] = a.v[i] > b.v[i] ? x.v[i] : y.v[i];
+        }
+        return r;
+    }
+    static inline float hmax(v4f a)
+    {
+        float m = a.v[0] > a.v[1] ? a.v[0] : a.v[1];
+        m = m > a.v[2] ? m : a.v[2];
+        return m > a.v[3] ? m : a.v[3];
+    }
+    static inline float hsum(v4f a) { return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]); }
+    static inline v4f floor(v4f a) { return {{std::floor(a.v[0]), std::floor(a.v[1]), std::floor(a.v[2]), std::floor(a.v[3])}}; }
+    static inline v4f pow2n(v4f n)
+    {
+        v4f r;
+        for (int i = 0; i < 4; ++i)
+        {
+            int32_t e = ((int32_t)n.v[i] + 127) << 23;
+            memcpy(&r.v[i], &e, sizeof(e));
+        }
+        return r;
+    }
+    static inline void transpose4x4(v4f& r0, v4f& r1, v4f& r2, v4f& r3)
+    {
+        v4f t0 = {{r0.v[0], r1.v[0], r2.v[0], r3.v[0]}};
+        v4f t1 = {{r0.v[1], r1.v[1], r2.v[1], r3.v[1]}};
+        v4f t2 = {{r0.v[2], r1.v[2], r2.v[2], r3.v[2]}};
+        v4f t3 = {{r0.v[3], r1.v[3], r2.v[3], r3.v[3]}};
+        r0 = t0, r1 = t1, r2 = t2, r3 = t3;
+    }
+    static inline void store_positive_u8x16(uint8_t* p, v4f a, v4f b, v4f c, v4f d)
+    {
+        const v4f* lanes[4] = {&a, &b, &c, &d};
+        for (int i = 0; i < 16; ++i)
+        {
+            int32_t bits;
+            memcpy(&bits, &lanes[i / 4]->v[i % 4], sizeof(bits));
+            p[i] = bits > 0 ? 255 : 0;
+        }
+    }
+    static inline int32_t dot_i8(const int8_t* a, const int8_t* b, int n)
+    {
+        int32_t sum = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            sum += (int32_t)a[i] * b[i];
+        }
+        return sum;
+    }
+#endif
+
+    // cephes style exp, ~1 ulp over the clamped range [-88.37, 88.37]
+    static inline v4f exp(v4f x)
+    {
+        const v4f one = set1(1.f);
+        x = min(x, set1(88.3762626647949f));
+        x = max(x, set1(-88.3762626647949f));
+
+        v4f fx = add(mul(x, set1(1.44269504088896341f)), set1(0.5f));
+        fx = floor(fx);
+
+        x = sub(x, mul(fx, set1(0.693359375f)));
+        x = sub(x, mul(fx, set1(-2.12194440e-4f)));
+        v4f z = mul(x, x);
+
+        v4f y = set1(1.9875691500E-4f);
+        y = add(mul(y, x), set1(1.3981999507E-3f));
+        y = add(mul(y, x), set1(8.3334519073E-3f));
+        y = add(mul(y, x), set1(4.1665795894E-2f));
+        y = add(mul(y, x), set1(1.6666665459E-1f));
+        y = add(mul(y, x), set1(5.0000001201E-1f));
+        y = add(mul(y, z), add(x, one));
+
+        return mul(y, pow2n(fx));
+    }
+} // namespace simd
@@ -0,0 +1,180 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include "base/candidate.hpp"
+#include "base/detection.hpp"
+#include "base/letterbox.hpp"
+#include "base/nms.hpp"
+#include "utilities/trace.hpp"
+
+// sliced inference of large images, as sahi does it: the image is cut into overlapping windows of
+// about the model input size, every window is letterboxed and decoded on its own, the candidates are
+// moved back into the image and one class aware nms over all windows, by intersection over the
+// smaller box, removes the duplicates and the cut off parts that objects in the overlaps leave. a
+// small object keeps its pixels instead of being scaled down with the whole frame. the frame itself
+// can go along as one more slice for the objects larger than a window.
+
+namespace detection
+{
+    // sahi's default overlap ratio of neighbouring slices
+    const float SLICE_OVERLAP = 0.2f;
+
+    // window origins along one axis: a step of (1 - overlap) slices, the last window moved back to end
+    // at the border. an axis shorter than a slice gets one window over all of it
+    static inline void slice_starts(int size, int slice, float overlap, std::vector<int>& starts)
+    {
+        starts.clear();
+        if (size <= slice)
+        {
+            starts.push_back(0);
+            return;
+        }
+        const int step = std::max(1, (int)(slice * (1.f - overlap)));
+        for (int start = 0;; start += step)
+        {
+            if (start + slice >= size)
+            {
+                starts.push_back(size - slice);
+                break;
+            }
+            starts.push_back(start);
+        }
+    }
+
+    // the windows of a src_rows x src_cols image in raster order, full_frame appends the whole image
+    static inline void slice_image(int src_rows, int src_cols, int slice_rows, int slice_cols, std::vector<cv::Rect>& slices,
+                                   float overlap = SLICE_OVERLAP, bool full_frame = false)
+    {
+        std::vector<int> ys, xs;
+        slice_starts(src_rows, slice_rows, overlap, ys);
+        slice_starts(src_cols, slice_cols, overlap, xs);
+        slices.clear();
+        for (int y : ys)
+        {
+            for (int x : xs)
+            {
+                slices.push_back(cv::Rect(x, y, std::min(slice_cols, src_cols), std::min(slice_rows, src_rows)));
+            }
+        }
+        if (full_frame && (ys.size() > 1 || xs.size() > 1))
+        {
+            slices.push_back(cv::Rect(0, 0, src_cols, src_rows));
+        }
+    }
+
+    // candidates [first, end) of a slice letterboxed into letterbox_rows x letterbox_cols, decoded in
+    // letterbox pixels, moved to the source image and clipped to the slice. keypoints and landmarks
+    // move along, mask features are left as they are, they only mean something with the protos of the slice
+    static inline void shift_slice_proposals(Proposals& proposals, const cv::Rect& slice, int letterbox_rows, int letterbox_cols, size_t first = 0)
+    {
+        const common::LetterboxLayout layout = common::letterbox_layout(slice.height, slice.width, letterbox_rows, letterbox_cols);
+        const float ratio_x = (float)slice.width / layout.resize_cols;
+        const float ratio_y = (float)slice.height / layout.resize_rows;
+        const float offset_x = slice.x - layout.left * ratio_x;
+        const float offset_y = slice.y - layout.top * ratio_y;
+        const float min_x = (float)slice.x, max_x = (float)(slice.x + slice.width - 1);
+        const float min_y = (float)slice.y, max_y = (float)(slice.y + slice.height - 1);
+
+        for (size_t i = first; i < proposals.candidates.size(); ++i)
+        {
+            Candidate& candidate = proposals.candidates[i];
+            float x0 = candidate.rect.x * ratio_x + offset_x;
+            float y0 = candidate.rect.y * ratio_y + offset_y;
+            float x1 = (candidate.rect.x + candidate.rect.width) * ratio_x + offset_x;
+            float y1 = (candidate.rect.y + candidate.rect.height) * ratio_y + offset_y;
+            x0 = std::max(std::min(x0, max_x), min_x);
+            y0 = std::max(std::min(y0, max_y), min_y);
+            x1 = std::max(std::min(x1, max_x), min_x);
+            y1 = std::max(std::min(y1, max_y), min_y);
+            candidate.rect.x = x0;
+            candidate.rect.y = y0;
+            candidate.rect.width = x1 - x0;
+            candidate.rect.height = y1 - y0;
+
+            if (candidate.feat < 0 || (proposals.feat_kind != CANDIDATE_FEAT_KPS && proposals.feat_kind != CANDIDATE_FEAT_LANDMARK))
+                continue;
+            // x y score per keypoint, x y per landmark
+            const int step = proposals.feat_kind == CANDIDATE_FEAT_KPS ? 3 : 2;
+            float* feat = proposals.feats.data() + candidate.feat;
+            for (int k = 0; k + 1 < proposals.feat_dim; k += step)
+            {
+                feat[k] = feat[k] * ratio_x + offset_x;
+                feat[k + 1] = feat[k + 1] * ratio_y + offset_y;
+            }
+        }
+    }
+
+    // greedy nms with the intersection over the smaller box (ios) as the overlap, as sahi matches the
+    // boxes of neighbouring slices. an object cut by a slice edge leaves a clipped box inside the whole
+    // one of the next slice, their iou is about the visible part but their ios is 1
+    template<typename T>
+    static void nms_ios_bboxes(const std::vector<T>& proposals, std::vector<int>& picked, const NmsParam& nms)
+    {
+        std::vector<int> order;
+        sort_descent_indices(proposals, order, nms.top_k, nms.sort);
+
+        picked.clear();
+        std::vector<float> areas;
+        for (int i : order)
+        {
+            if (nms.max_det > 0 && (int)picked.size() >= nms.max_det)
+                break;
+
+            const T& a = proposals[i];
+            const float area = a.rect.width * a.rect.height;
+            bool keep = true;
+            for (size_t j = 0; j < picked.size(); j++)
+            {
+                const T& b = proposals[picked[j]];
+                if (nms.class_aware && nms_label(a) != nms_label(b))
+                    continue;
+                const float inter_area = nms_intersection(a, b);
+                if (inter_area > 0.f && inter_area > nms.iou_threshold * std::min(area, areas[j]))
+                {
+                    keep = false;
+                    break;
+                }
+            }
+
+            if (keep)
+            {
+                picked.push_back(i);
+                areas.push_back(area);
+            }
+        }
+    }
+
+    // one nms over the candidates of every slice, already in source image pixels. class aware is what
+    // keeps two objects of different classes in the same place, sahi merges per class too. the threshold
+    // of `nms` applies to the ios, so the clipped boxes at slice edges go with the whole box they belong to
+    static inline void merge_slice_proposals(const Proposals& proposals, std::vector<Object>& objects, const NmsParam& nms)
+    {
+        AX_TRACE_SCOPE("slice_merge");
+        std::vector<int> picked;
+        nms_ios_bboxes(proposals.candidates, picked, nms);
+        materialize_objects(proposals, picked, objects);
+    }
+} // namespace detection
@@ -0,0 +1,308 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "base/parallel.hpp"
+#include "base/simd.hpp"
+#include "utilities/trace.hpp"
+
+namespace feature
+{
+    typedef struct
+    {
+        float x; // score map pixels
+        float y;
+        float score;
+    } KeyPoint;
+
+    // higher score first, raster order between equal scores
+    static inline bool keypoint_before(const KeyPoint& a, const KeyPoint& b)
+    {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    }
+
+    // the best `count` keypoints, best first, none when count <= 0. a heap of `count` over the
+    // candidates, n log count
+    static inline void select_top_keypoints(std::vector<KeyPoint>& keypoints, int count)
+    {
+        if (count <= 0)
+        {
+            keypoints.clear();
+            return;
+        }
+        if ((int)keypoints.size() <= count)
+        {
+            std::sort(keypoints.begin(), keypoints.end(), keypoint_before);
+            return;
+        }
+        // the heap top is the worst of the best `count` so far
+        std::make_heap(keypoints.begin(), keypoints.begin() + count, keypoint_before);
+        for (size_t i = count; i < keypoints.size(); ++i)
+        {
+            if (keypoint_before(keypoints[i], keypoints.front()))
+            {
+                std::pop_heap(keypoints.begin(), keypoints.begin() + count, keypoint_before);
+                keypoints[count - 1] = keypoints[i];
+                std::push_heap(keypoints.begin(), keypoints.begin() + count, keypoint_before);
+            }
+        }
+        keypoints.resize(count);
+        std::sort_heap(keypoints.begin(), keypoints.end(), keypoint_before);
+    }
+
+    // dst[p * channels + c] = src[c * pixels + p], 4 x 4 blocks through registers
+    static inline void transpose_chw(const float* src, int channels, int pixels, float* dst, common::thread_pool* pool = nullptr)
+    {
+        AX_TRACE_SCOPE("transpose_chw");
+        const int c4 = channels & ~3;
+        common::thread_pool& workers = pool != nullptr ? *pool : common::thread_pool::shared();
+        // pixel ranges, the rows written stay within a few kB
+        workers.parallel_for(pixels, 1024, [&](int begin, int end) {
+            int p = begin;
+            for (; p + 3 < end; p += 4)
+            {
+                for (int c = 0; c < c4; c += 4)
+                {
+                    simd::v4f r0 = simd::load(src + (size_t)c * pixels + p);
+                    simd::v4f r1 = simd::load(src + (size_t)(c + 1) * pixels + p);
+                    simd::v4f r2 = simd::load(src + (size_t)(c + 2) * pixels + p);
+                    simd::v4f r3 = simd::load(src + (size_t)(c + 3) * pixels + p);
+                    simd::transpose4x4(r0, r1, r2, r3);
+                    simd::store(dst + (size_t)p * channels + c, r0);
+                    simd::store(dst + (size_t)(p + 1) * channels + c, r1);
+                    simd::store(dst + (size_t)(p + 2) * channels + c, r2);
+                    simd::store(dst + (size_t)(p + 3) * channels + c, r3);
+                }
+                for (int c = c4; c < channels; ++c)
+                {
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        dst[(size_t)(p + k) * channels + c] = src[(size_t)c * pixels + p + k];
+                    }
+                }
+            }
+            for (; p < end; ++p)
+            {
+                for (int c = 0; c < channels; ++c)
+                {
+                    dst[(size_t)p * channels + c] = src[(size_t)c * pixels + p];
+                }
+            }
+        });
+    }
+
+    // superpoint keypoints and descriptors of one image. the buffers are kept between frames.
+    //     keypoints: pixels above threshold that are the max of their (2 radius + 1)^2 window,
+    //                the best max_points of them, best first
+    //     descriptors: keypoints.size() rows of dim floats, bilinear from the coarse map, l2 normalised
+    struct SuperPointFeatures
+    {
+        std::vector<KeyPoint> keypoints;
+        std::vector<float> descriptors;
+        int dim = 0;
+
+        // score is h x w, desc is desc_c x desc_h x desc_w with one cell per `cell` score pixels
+        void extract(const float* score, int h, int w, const float* desc, int desc_c, int desc_h, int desc_w, float threshold, int max_points,
+                     int radius = 4, int cell = 8)
+        {
+            detect(score, h, w, threshold, radius);
+            select_top_keypoints(keypoints, max_points);
+            describe(desc, desc_c, desc_h, desc_w, cell);
+        }
+
+        // radius nms as a separable max filter: the max over 2 radius + 1 columns of each row, then
+        // over 2 radius + 1 of those rows, 4 pixels per step. plateaus keep all their pixels
+        void detect(const float* score, int h, int w, float threshold, int radius)
+        {
+            AX_TRACE_SCOPE("keypoint_nms");
+            keypoints.clear();
+            radius = std::max(radius, 0);
+            const int stride = (w + 3) & ~3;
+            padded.assign((size_t)stride + 2 * radius + 4, -FLT_MAX);
+            row_max.resize((size_t)h * stride);
+            for (int y = 0; y < h; ++y)
+            {
+                std::copy(score + (size_t)y * w, score + (size_t)(y + 1) * w, padded.begin() + radius);
+                float* out = row_max.data() + (size_t)y * stride;
+                for (int x = 0; x < w; x += 4)
+                {
+                    simd::v4f m = simd::load(padded.data() + x);
+                    for (int k = 1; k <= 2 * radius; ++k)
+                    {
+                        m = simd::max(m, simd::load(padded.data() + x + k));
+                    }
+                    simd::store(out + x, m);
+                }
+            }
+
+            const simd::v4f v_threshold = simd::set1(threshold);
+            for (int y = 0; y < h; ++y)
+            {
+                const int y0 = std::max(y - radius, 0), y1 = std::min(y + radius, h - 1);
+                const float* s = score + (size_t)y * w;
+                int x = 0;
+                for (; x + 3 < w; x += 4)
+                {
+                    const simd::v4f v = simd::load(s + x);
+                    if (simd::cmpgt_mask(v, v_threshold) == 0)
+                        continue;
+                    simd::v4f m = simd::load(row_max.data() + (size_t)y0 * stride + x);
+                    for (int r = y0 + 1; r <= y1; ++r)
+                    {
+                        m = simd::max(m, simd::load(row_max.data() + (size_t)r * stride + x));
+                    }
+                    int keep = simd::cmpgt_mask(v, v_threshold) & ~simd::cmpgt_mask(m, v);
+                    for (int lane = 0; keep != 0; ++lane, keep >>= 1)
+                    {
+                        if (keep & 1)
+                        {
+                            keypoints.push_back({(float)(x + lane), (float)y, s[x + lane]});
+                        }
+                    }
+                }
+                for (; x < w; ++x)
+                {
+                    if (s[x] <= threshold)
+                        continue;
+                    float m = -FLT_MAX;
+                    for (int r = y0; r <= y1; ++r)
+                    {
+                        m = std::max(m, row_max[(size_t)r * stride + x]);
+                    }
+                    if (s[x] >= m)
+                    {
+                        keypoints.push_back({(float)x, (float)y, s[x]});
+                    }
+                }
+            }
+        }
+
+        // the descriptors of `keypoints`. with many keypoints the map is turned channels last first, so a
+        // keypoint reads 4 contiguous rows of desc_c floats instead of 4 x desc_c scattered ones. the
+        // transpose costs about as much as sampling one keypoint per 5 cells from the planar map, below
+        // that the planar map is sampled as it is
+        void describe(const float* desc, int desc_c, int desc_h, int desc_w, int cell = 8)
+        {
+            AX_TRACE_SCOPE("descriptor_sample");
+            dim = desc_c;
+            descriptors.resize(keypoints.size() * desc_c);
+            if (keypoints.empty())
+                return;
+            const size_t plane = (size_t)desc_h * desc_w;
+            const bool channels_last = keypoints.size() * 5 >= plane;
+            if (channels_last)
+            {
+                hwc.resize((size_t)desc_c * plane);
+                transpose_chw(desc, desc_c, (int)plane, hwc.data());
+            }
+
+            const int c4 = desc_c & ~3;
+            for (size_t i = 0; i < keypoints.size(); ++i)
+            {
+                const float x = keypoints[i].x / (float)cell;
+                const float y = keypoints[i].y / (float)cell;
+                int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+                int x1 = x0 + 1, y1 = y0 + 1;
+                x0 = std::max(0, std::min(x0, desc_w - 1));
+                x1 = std::max(0, std::min(x1, desc_w - 1));
+                y0 = std::max(0, std::min(y0, desc_h - 1));
+                y1 = std::max(0, std::min(y1, desc_h - 1));
+
+                const float wa = (x1 - x) * (y1 - y);
+                const float wb = (x1 - x) * (y - y0);
+                const float wc = (x - x0) * (y1 - y);
+                const float wd = (x - x0) * (y - y0);
+                float* out = descriptors.data() + i * desc_c;
+                if (!channels_last)
+                {
+                    float sum = 0.f;
+                    for (int c = 0; c < desc_c; ++c)
+                    {
+                        const float* map = desc + c * plane;
+                        out[c] = map[y0 * desc_w + x0] * wa + map[y1 * desc_w + x0] * wb + map[y0 * desc_w + x1] * wc + map[y1 * desc_w + x1] * wd;
+                        sum += out[c] * out[c];
+                    }
+                    scale_row(out, desc_c, 1.f / std::sqrt(sum + 1e-6f));
+                    continue;
+                }
+
+                const float* tl = hwc.data() + ((size_t)y0 * desc_w + x0) * desc_c;
+                const float* bl = hwc.data() + ((size_t)y1 * desc_w + x0) * desc_c;
+                const float* tr = hwc.data() + ((size_t)y0 * desc_w + x1) * desc_c;
+                const float* br = hwc.data() + ((size_t)y1 * desc_w + x1) * desc_c;
+                const simd::v4f va = simd::set1(wa), vb = simd::set1(wb), vc = simd::set1(wc), vd = simd::set1(wd);
+                simd::v4f norm = simd::set1(0.f);
+                int c = 0;
+                for (; c < c4; c += 4)
+                {
+                    simd::v4f v = simd::add(simd::mul(simd::load(tl + c), va), simd::mul(simd::load(bl + c), vb));
+                    v = simd::add(simd::add(v, simd::mul(simd::load(tr + c), vc)), simd::mul(simd::load(br + c), vd));
+                    simd::store(out + c, v);
+                    norm = simd::add(norm, simd::mul(v, v));
+                }
+                float sum = simd::hsum(norm);
+                for (; c < desc_c; ++c)
+                {
+                    out[c] = tl[c] * wa + bl[c] * wb + tr[c] * wc + br[c] * wd;
+                    sum += out[c] * out[c];
+                }
+
+                scale_row(out, desc_c, 1.f / std::sqrt(sum + 1e-6f));
+            }
+        }
+
+        int size() const
+        {
+            return (int)keypoints.size();
+        }
+
+        const float* descriptor(int index) const
+        {
+            return descriptors.data() + (size_t)index * dim;
+        }
+
+    private:
+        static void scale_row(float* row, int count, float scale)
+        {
+            const simd::v4f v_scale = simd::set1(scale);
+            int c = 0;
+            for (; c + 3 < count; c += 4)
+            {
+                simd::store(row + c, simd::mul(simd::load(row + c), v_scale));
+            }
+            for (; c < count; ++c)
+            {
+                row[c] *= scale;
+            }
+        }
+
+        std::vector<float> padded;
+        std::vector<float> row_max;
+        std::vector<float> hwc;
+    };
+} // namespace feature
@@ -0,0 +1,603 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ax_sys_api.h"
+#include "ax_engine_api.h"
+#include "utilities/capture.hpp"
+
+namespace
+{
+    const int MOCK_ERR_INVALID = -1;
+    const int MOCK_ERR_NO_MEM = -2;
+
+    struct mock_tensor
+    {
+        std::string name;
+        std::vector<AX_S32> shape;
+        AX_ENGINE_DATA_TYPE_T data_type;
+    };
+
+    struct mock_model
+    {
+        std::vector<mock_tensor> inputs;
+        std::vector<mock_tensor> outputs;
+        float latency_ms = 0.f;
+        float latency_jitter_ms = 0.f; // every run takes up to this much longer, uniformly
+        float load_ms = 0.f;
+        AX_U32 max_batch = 1;
+        AX_U32 model_size = 0; // reported as the cmm of the handle
+        std::vector<std::vector<uint8_t> > replay; // outputs every run writes, from a capture
+
+        // storage the io info points into, must stay put once io_info is built
+        std::deque<std::string> names;
+        std::deque<std::vector<AX_S32> > shapes;
+        std::vector<AX_ENGINE_IOMETA_EX_T> extra;
+        std::vector<AX_ENGINE_IOMETA_T> input_meta;
+        std::vector<AX_ENGINE_IOMETA_T> output_meta;
+        AX_ENGINE_IO_INFO_T io_info;
+
+        bool has_context = false;
+        std::vector<AX_ENGINE_CONTEXT_T> contexts;
+    };
+
+    // a counting semaphore standing in for the npu cores
+    class npu_cores
+    {
+    public:
+        explicit npu_cores(int count)
+            : free_count(count > 0 ? count : 1)
+        {
+        }
+
+        void acquire()
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->cond.wait(lock, [this] { return this->free_count > 0; });
+            --this->free_count;
+        }
+
+        void release()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                ++this->free_count;
+            }
+            this->cond.notify_one();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable cond;
+        int free_count;
+    };
+
+    std::mutex g_mem_mutex;
+    std::map<AX_VOID*, AX_U32> g_mem_blocks;
+
+    const char* env_or(const char* key, const char* fallback)
+    {
+        const char* value = std::getenv(key);
+        return value != nullptr && value[0] != '\0' ? value : fallback;
+    }
+
+    npu_cores& get_npu_cores()
+    {
+        static npu_cores cores(std::atoi(env_or("AX_MOCK_NPU_CORES", "1")));
+        return cores;
+    }
+
+    size_t data_type_size(AX_ENGINE_DATA_TYPE_T data_type)
+    {
+        switch (data_type)
+        {
+        case AX_ENGINE_DT_UINT8:
+        case AX_ENGINE_DT_SINT8:
+            return 1;
+        case AX_ENGINE_DT_UINT16:
+        case AX_ENGINE_DT_SINT16:
+            return 2;
+        case AX_ENGINE_DT_FLOAT64:
+            return 8;
+        default:
+            return 4;
+        }
+    }
+
+    bool parse_data_type(const std::string& text, AX_ENGINE_DATA_TYPE_T& data_type)
+    {
+        static const std::map<std::string, AX_ENGINE_DATA_TYPE_T> types = {
+            {"uint8", AX_ENGINE_DT_UINT8},
+            {"int8", AX_ENGINE_DT_SINT8},
+            {"uint16", AX_ENGINE_DT_UINT16},
+            {"int16", AX_ENGINE_DT_SINT16},
+            {"int32", AX_ENGINE_DT_SINT32},
+            {"uint32", AX_ENGINE_DT_UINT32},
+            {"float32", AX_ENGINE_DT_FLOAT32},
+            {"float64", AX_ENGINE_DT_FLOAT64},
+        };
+        auto it = types.find(text);
+        if (it == types.end())
+        {
+            return false;
+        }
+        data_type = it->second;
+        return true;
+    }
+
+    bool parse_shape(const std::string& text, std::vector<AX_S32>& shape)
+    {
+        shape.clear();
+        std::stringstream ss(text);
+        std::string dim;
+        while (std::getline(ss, dim, 'x'))
+        {
+            int value = std::atoi(dim.c_str());
+            if (value <= 0)
+            {
+                return false;
+            }
+            shape.push_back(value);
+        }
+        return !shape.empty();
+    }
+
+    bool parse_tensor(const std::string& name, const std::string& shape, const std::string& data_type, mock_tensor& tensor)
+    {
+        tensor.name = name;
+        if (!parse_shape(shape, tensor.shape) || !parse_data_type(data_type, tensor.data_type))
+        {
+            fprintf(stderr, "[mock] bad tensor description {%s %s %s}\n", name.c_str(), shape.c_str(), data_type.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // "<name>:<shape>:<dtype>;<name>:<shape>:<dtype>"
+    bool parse_tensor_list(const std::string& text, std::vector<mock_tensor>& tensors)
+    {
+        std::stringstream ss(text);
+        std::string item;
+        while (std::getline(ss, item, ';'))
+        {
+            if (item.empty())
+            {
+                continue;
+            }
+            std::stringstream fields(item);
+            std::string name, shape, data_type;
+            std::getline(fields, name, ':');
+            std::getline(fields, shape, ':');
+            std::getline(fields, data_type, ':');
+
+            mock_tensor tensor;
+            if (!parse_tensor(name, shape, data_type, tensor))
+            {
+                return false;
+            }
+            tensors.push_back(tensor);
+        }
+        return true;
+    }
+
+    bool parse_mock_model(const char* data, size_t size, mock_model& model)
+    {
+        std::stringstream ss(std::string(data, size));
+        std::string line;
+        std::getline(ss, line);
+        while (std::getline(ss, line))
+        {
+            std::stringstream fields(line);
+            std::string key;
+            fields >> key;
+            if (key.empty() || key[0] == '#')
+            {
+                continue;
+            }
+            if (key == "input" || key == "output")
+            {
+                std::string name, shape, data_type;
+                fields >> name >> shape >> data_type;
+                mock_tensor tensor;
+                if (!parse_tensor(name, shape, data_type, tensor))
+                {
+                    return false;
+                }
+                (key == "input" ? model.inputs : model.outputs).push_back(tensor);
+            }
+            else if (key == "latency_ms")
+            {
+                fields >> model.latency_ms;
+            }
+            else if (key == "latency_jitter_ms")
+            {
+                fields >> model.latency_jitter_ms;
+            }
+            else if (key == "load_ms")
+            {
+                fields >> model.load_ms;
+            }
+            else if (key == "max_batch")
+            {
+                fields >> model.max_batch;
+            }
+            else
+            {
+                fprintf(stderr, "[mock] unknown key '%s' in mock model\n", key.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // a utilities::tensor_capture as the model: its io layout, and runs give the captured outputs
+    bool parse_capture_model(const void* data, size_t size, mock_model& model)
+    {
+        utilities::tensor_capture capture;
+        if (!capture.parse(data, size))
+        {
+            fprintf(stderr, "[mock] bad capture\n");
+            return false;
+        }
+        for (int kind = 0; kind < 2; ++kind)
+        {
+            for (auto& captured : kind == 0 ? capture.inputs : capture.outputs)
+            {
+                mock_tensor tensor;
+                tensor.name = captured.name;
+                tensor.shape.assign(captured.shape.begin(), captured.shape.end());
+                tensor.data_type = (AX_ENGINE_DATA_TYPE_T)captured.data_type;
+                (kind == 0 ? model.inputs : model.outputs).push_back(tensor);
+            }
+        }
+        for (auto& captured : capture.outputs)
+        {
+            model.replay.push_back(std::move(captured.data));
+        }
+        model.latency_ms = (float)std::atof(env_or("AX_MOCK_LATENCY_MS", "0"));
+        model.latency_jitter_ms = (float)std::atof(env_or("AX_MOCK_LATENCY_JITTER_MS", "0"));
+        return true;
+    }
+
+    bool parse_env_model(mock_model& model)
+    {
+        // default to a yolov8 native head, which is what most samples run
+        auto inputs = env_or("AX_MOCK_INPUTS", "images:1x640x640x3:uint8");
+        auto outputs = env_or("AX_MOCK_OUTPUTS", "output0:1x80x80x144:float32;output1:1x40x40x144:float32;output2:1x20x20x144:float32");
+        if (!parse_tensor_list(inputs, model.inputs) || !parse_tensor_list(outputs, model.outputs))
+        {
+            return false;
+        }
+        model.latency_ms = (float)std::atof(env_or("AX_MOCK_LATENCY_MS", "0"));
+        model.latency_jitter_ms = (float)std::atof(env_or("AX_MOCK_LATENCY_JITTER_MS", "0"));
+        model.load_ms = (float)std::atof(env_or("AX_MOCK_LOAD_MS", "0"));
+        model.max_batch = (AX_U32)std::atoi(env_or("AX_MOCK_MAX_BATCH", "1"));
+        return true;
+    }
+
+    void build_meta(mock_model& model, const mock_tensor& tensor, AX_ENGINE_IOMETA_EX_T* extra, AX_ENGINE_IOMETA_T& meta)
+    {
+        memset(&meta, 0, sizeof(meta));
+        model.names.push_back(tensor.name);
+        model.shapes.push_back(tensor.shape);
+
+        size_t size = data_type_size(tensor.data_type);
+        for (auto dim : tensor.shape)
+        {
+            size *= (size_t)dim;
+        }
+
+        meta.pName = (AX_CHAR*)model.names.back().c_str();
+        meta.pShape = model.shapes.back().data();
+        meta.nShapeSize = (AX_U8)tensor.shape.size();
+        meta.eMemoryType = AX_ENGINE_MT_PHYSICAL;
+        meta.eDataType = tensor.data_type;
+        meta.pExtraMeta = extra;
+        meta.nSize = (AX_U32)(size * (model.max_batch > 0 ? model.max_batch : 1));
+    }
+
+    void build_io_info(mock_model& model)
+    {
+        model.extra.resize(model.inputs.size());
+        model.input_meta.resize(model.inputs.size());
+        model.output_meta.resize(model.outputs.size());
+
+        for (size_t i = 0; i < model.inputs.size(); ++i)
+        {
+            memset(&model.extra[i], 0, sizeof(model.extra[i]));
+            auto& shape = model.inputs[i].shape;
+            bool image = model.inputs[i].data_type == AX_ENGINE_DT_UINT8 && shape.size() == 4 && shape[3] == 3;
+            model.extra[i].eColorSpace = image ? AX_ENGINE_CS_BGR : AX_ENGINE_CS_FEATUREMAP;
+            build_meta(model, model.inputs[i], &model.extra[i], model.input_meta[i]);
+        }
+        for (size_t i = 0; i < model.outputs.size(); ++i)
+        {
+            build_meta(model, model.outputs[i], nullptr, model.output_meta[i]);
+        }
+
+        memset(&model.io_info, 0, sizeof(model.io_info));
+        model.io_info.pInputs = model.input_meta.data();
+        model.io_info.nInputSize = (AX_U32)model.input_meta.size();
+        model.io_info.pOutputs = model.output_meta.data();
+        model.io_info.nOutputSize = (AX_U32)model.output_meta.size();
+        model.io_info.nMaxBatchSize = model.max_batch > 0 ? model.max_batch : 1;
+        model.io_info.bDynamicBatchSize = model.max_batch > 1 ? AX_TRUE : AX_FALSE;
+    }
+
+    AX_S32 mock_alloc(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align)
+    {
+        if (phyaddr == nullptr || pviraddr == nullptr || size == 0)
+        {
+            return MOCK_ERR_INVALID;
+        }
+        size_t alignment = align < sizeof(void*) ? sizeof(void*) : align;
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, alignment, size) != 0)
+        {
+            return MOCK_ERR_NO_MEM;
+        }
+        memset(ptr, 0, size);
+
+        {
+            std::lock_guard<std::mutex> lock(g_mem_mutex);
+            g_mem_blocks[ptr] = size;
+        }
+        *pviraddr = ptr;
+        *phyaddr = (AX_U64)(uintptr_t)ptr;
+        return AX_SUCCESS;
+    }
+
+    AX_S32 mock_run(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_T* pIO)
+    {
+        auto model = (mock_model*)handle;
+        if (model == nullptr || pIO == nullptr || !model->has_context)
+        {
+            return MOCK_ERR_INVALID;
+        }
+        if (pIO->nInputSize != model->io_info.nInputSize || pIO->nOutputSize != model->io_info.nOutputSize)
+        {
+            return MOCK_ERR_INVALID;
+        }
+
+        auto& cores = get_npu_cores();
+        cores.acquire();
+        float latency_ms = model->latency_ms;
+        if (model->latency_jitter_ms > 0.f)
+        {
+            static thread_local std::mt19937 rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            latency_ms += std::uniform_real_distribution<float>(0.f, model->latency_jitter_ms)(rng);
+        }
+        if (latency_ms > 0.f)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(latency_ms * 1000.f)));
+        }
+        cores.release();
+
+        for (size_t i = 0; i < model->replay.size(); ++i)
+        {
+            auto& buffer = pIO->pOutputs[i];
+            if (buffer.pVirAddr != nullptr)
+            {
+                memcpy(buffer.pVirAddr, model->replay[i].data(), std::min((size_t)buffer.nSize, model->replay[i].size()));
+            }
+        }
+        return AX_SUCCESS;
+    }
+} // namespace
+
+extern "C" {
+
+AX_S32 AX_SYS_Init(AX_VOID)
+{
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_SYS_Deinit(AX_VOID)
+{
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_SYS_MemAlloc(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align, const AX_S8* token)
+{
+    (void)token;
+    return mock_alloc(phyaddr, pviraddr, size, align);
+}
+
+AX_S32 AX_SYS_MemAllocCached(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align, const AX_S8* token)
+{
+    (void)token;
+    return mock_alloc(phyaddr, pviraddr, size, align);
+}
+
+AX_S32 AX_SYS_MemFree(AX_U64 phyaddr, AX_VOID* pviraddr)
+{
+    (void)phyaddr;
+    {
+        std::lock_guard<std::mutex> lock(g_mem_mutex);
+        auto it = g_mem_blocks.find(pviraddr);
+        if (it == g_mem_blocks.end())
+        {
+            return MOCK_ERR_INVALID;
+        }
+        g_mem_blocks.erase(it);
+    }
+    free(pviraddr);
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_SYS_MflushCache(AX_U64 phyaddr, AX_VOID* pviraddr, AX_U32 size)
+{
+    (void)phyaddr, (void)pviraddr, (void)size;
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_SYS_MinvalidateCache(AX_U64 phyaddr, AX_VOID* pviraddr, AX_U32 size)
+{
+    (void)phyaddr, (void)pviraddr, (void)size;
+    return AX_SUCCESS;
+}
+
+const AX_CHAR* AX_ENGINE_GetVersion(AX_VOID)
+{
+    return "mock";
+}
+
+AX_S32 AX_ENGINE_Init(AX_ENGINE_NPU_ATTR_T* pNpuAttr)
+{
+    (void)pNpuAttr;
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_Deinit(AX_VOID)
+{
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_NPUReset(AX_VOID)
+{
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_CreateHandle(AX_ENGINE_HANDLE* pHandle, const AX_VOID* pData, AX_U32 nDataSize)
+{
+    if (pHandle == nullptr || pData == nullptr || nDataSize == 0)
+    {
+        return MOCK_ERR_INVALID;
+    }
+
+    auto model = new mock_model;
+    const char* magic = "AXMOCK";
+    bool ok;
+    if (nDataSize >= strlen(magic) && memcmp(pData, magic, strlen(magic)) == 0)
+    {
+        ok = parse_mock_model((const char*)pData, nDataSize, *model);
+    }
+    else if (utilities::tensor_capture::is_capture(pData, nDataSize))
+    {
+        ok = parse_capture_model(pData, nDataSize, *model);
+    }
+    else
+    {
+        ok = parse_env_model(*model);
+    }
+    if (!ok || model->inputs.empty() || model->outputs.empty())
+    {
+        delete model;
+        return MOCK_ERR_INVALID;
+    }
+
+    if (model->load_ms > 0.f)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(model->load_ms * 1000.f)));
+    }
+    build_io_info(*model);
+    model->model_size = nDataSize;
+    *pHandle = model;
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_DestroyHandle(AX_ENGINE_HANDLE nHandle)
+{
+    auto model = (mock_model*)nHandle;
+    if (model == nullptr)
+    {
+        return MOCK_ERR_INVALID;
+    }
+    delete model;
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_CreateContext(AX_ENGINE_HANDLE handle)
+{
+    auto model = (mock_model*)handle;
+    if (model == nullptr)
+    {
+        return MOCK_ERR_INVALID;
+    }
+    model->has_context = true;
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_CreateContextV2(AX_ENGINE_HANDLE nHandle, AX_ENGINE_CONTEXT_T* pContext)
+{
+    auto model = (mock_model*)nHandle;
+    if (model == nullptr || pContext == nullptr)
+    {
+        return MOCK_ERR_INVALID;
+    }
+    model->has_context = true;
+    // any distinct non-null token works as a context
+    model->contexts.push_back((AX_ENGINE_CONTEXT_T)(uintptr_t)(model->contexts.size() + 1));
+    *pContext = model->contexts.back();
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_GetIOInfo(AX_ENGINE_HANDLE nHandle, AX_ENGINE_IO_INFO_T** pIO)
+{
+    auto model = (mock_model*)nHandle;
+    if (model == nullptr || pIO == nullptr)
+    {
+        return MOCK_ERR_INVALID;
+    }
+    *pIO = &model->io_info;
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_GetCMMUsage(AX_ENGINE_HANDLE nHandle, AX_ENGINE_CMM_INFO* pCMMInfo)
+{
+    auto model = (mock_model*)nHandle;
+    if (model == nullptr || pCMMInfo == nullptr)
+    {
+        return MOCK_ERR_INVALID;
+    }
+    // there are no weights, the model buffer stands in for them
+    pCMMInfo->nCMMSize = model->model_size;
+    return AX_SUCCESS;
+}
+
+AX_S32 AX_ENGINE_RunSync(AX_ENGINE_HANDLE handle, AX_ENGINE_IO_T* pIO)
+{
+    return mock_run(handle, pIO);
+}
+
+AX_S32 AX_ENGINE_RunSyncV2(AX_ENGINE_HANDLE handle, AX_ENGINE_CONTEXT_T context, AX_ENGINE_IO_T* pIO)
+{
+    if (context == nullptr)
+    {
+        return MOCK_ERR_INVALID;
+    }
+    return mock_run(handle, pIO);
+}
+
+} // extern "C"
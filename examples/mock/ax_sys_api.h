@@ -0,0 +1,92 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+/*
+ * host-side mock of the AX_SYS subset used by ax-samples, enabled by -DAXERA_MOCK_ENGINE=ON.
+ * CMM memory is plain aligned host memory and the "physical" address is the virtual one.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t AX_U8;
+typedef uint16_t AX_U16;
+typedef uint32_t AX_U32;
+typedef uint64_t AX_U64;
+typedef int8_t AX_S8;
+typedef int16_t AX_S16;
+typedef int32_t AX_S32;
+typedef int64_t AX_S64;
+typedef float AX_F32;
+typedef double AX_F64;
+typedef char AX_CHAR;
+typedef void AX_VOID;
+
+typedef enum
+{
+    AX_FALSE = 0,
+    AX_TRUE = 1,
+} AX_BOOL;
+
+#define AX_SUCCESS 0
+
+typedef enum
+{
+    AX_FORMAT_INVALID = -1,
+    AX_FORMAT_YUV400 = 0x0,
+    AX_FORMAT_YUV420_PLANAR = 0x1,
+    AX_FORMAT_YUV420_SEMIPLANAR = 0x3,
+    AX_FORMAT_YUV420_SEMIPLANAR_VU = 0x4,
+    AX_FORMAT_RGB888 = 0xA1,
+    AX_FORMAT_BGR888 = 0xA2,
+} AX_IMG_FORMAT_E;
+
+typedef struct
+{
+    AX_U32 u32Width;
+    AX_U32 u32Height;
+    AX_IMG_FORMAT_E enImgFormat;
+    AX_U32 u32PicStride[3];
+    AX_U64 u64PhyAddr[3];
+    AX_U64 u64VirAddr[3];
+    AX_U32 u32BlkId[3];
+    AX_U64 u64PTS;
+    AX_U64 u64SeqNum;
+    AX_U32 u32FrameSize;
+} AX_VIDEO_FRAME_T;
+
+AX_S32 AX_SYS_Init(AX_VOID);
+AX_S32 AX_SYS_Deinit(AX_VOID);
+
+AX_S32 AX_SYS_MemAlloc(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align, const AX_S8* token);
+AX_S32 AX_SYS_MemAllocCached(AX_U64* phyaddr, AX_VOID** pviraddr, AX_U32 size, AX_U32 align, const AX_S8* token);
+AX_S32 AX_SYS_MemFree(AX_U64 phyaddr, AX_VOID* pviraddr);
+
+AX_S32 AX_SYS_MflushCache(AX_U64 phyaddr, AX_VOID* pviraddr, AX_U32 size);
+AX_S32 AX_SYS_MinvalidateCache(AX_U64 phyaddr, AX_VOID* pviraddr, AX_U32 size);
+
+#ifdef __cplusplus
+}
+#endif
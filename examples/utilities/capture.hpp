@@ -0,0 +1,264 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// the tensors of one engine run in a single file, so the post process can be run on a host.
+// little endian, every count and size is a uint32:
+//     "AXCAPT01"
+//     attributes: count, then key length, key, value length, value
+//     inputs, outputs: the two counts
+//     per tensor (the inputs, then the outputs):
+//         name length, name, dims, int32 dim x dims, data type, quantization, size, data bytes, data
+// data bytes is 0 for a tensor captured without its data, i.e. the inputs by default.
+
+namespace utilities
+{
+    const char CAPTURE_MAGIC[] = "AXCAPT01";
+    const size_t CAPTURE_MAGIC_SIZE = sizeof(CAPTURE_MAGIC) - 1;
+    // name length, dims, data type, quantization, size and data length of a tensor with no name, shape or data
+    const size_t CAPTURE_MIN_TENSOR_BYTES = 6 * sizeof(uint32_t);
+
+    typedef struct
+    {
+        std::string name;
+        std::vector<int32_t> shape;
+        uint32_t data_type;    // AX_ENGINE_DATA_TYPE_T
+        uint32_t quantization; // nQuantizationValue
+        uint32_t size;         // nSize of the engine, in bytes
+        std::vector<uint8_t> data;
+    } CapturedTensor;
+
+    class tensor_capture
+    {
+    public:
+        std::map<std::string, std::string> attributes; // e.g. the source image size
+        std::vector<CapturedTensor> inputs;
+        std::vector<CapturedTensor> outputs;
+
+        bool save(const std::string& path) const
+        {
+            FILE* fp = fopen(path.c_str(), "wb");
+            if (fp == nullptr)
+            {
+                fprintf(stderr, "Open %s failed.\n", path.c_str());
+                return false;
+            }
+            bool ok = fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_SIZE, fp) == CAPTURE_MAGIC_SIZE;
+            ok = ok && put_u32(fp, (uint32_t)this->attributes.size());
+            for (auto& attribute : this->attributes)
+            {
+                ok = ok && put_string(fp, attribute.first) && put_string(fp, attribute.second);
+            }
+            ok = ok && put_u32(fp, (uint32_t)this->inputs.size()) && put_u32(fp, (uint32_t)this->outputs.size());
+            for (auto& tensor : this->inputs)
+            {
+                ok = ok && put_tensor(fp, tensor);
+            }
+            for (auto& tensor : this->outputs)
+            {
+                ok = ok && put_tensor(fp, tensor);
+            }
+            ok = fclose(fp) == 0 && ok;
+            if (!ok)
+            {
+                fprintf(stderr, "Write %s failed.\n", path.c_str());
+            }
+            return ok;
+        }
+
+        bool load(const std::string& path)
+        {
+            // not utilities::read_file, the mock engine includes this too and file.hpp is not inline
+            std::vector<char> data;
+            FILE* fp = fopen(path.c_str(), "rb");
+            bool ok = fp != nullptr;
+            char buffer[65536];
+            size_t count = 0;
+            while (ok && (count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+            {
+                data.insert(data.end(), buffer, buffer + count);
+            }
+            if (fp != nullptr)
+            {
+                ok = !ferror(fp) && ok;
+                fclose(fp);
+            }
+            if (!ok)
+            {
+                fprintf(stderr, "Read %s failed.\n", path.c_str());
+                return false;
+            }
+            if (!parse(data.data(), data.size()))
+            {
+                fprintf(stderr, "%s is not a valid capture.\n", path.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        // from memory, e.g. a capture handed to the mock engine as the model
+        bool parse(const void* data, size_t size)
+        {
+            this->attributes.clear();
+            this->inputs.clear();
+            this->outputs.clear();
+
+            reader in = {(const uint8_t*)data, (const uint8_t*)data + size};
+            if (!is_capture(data, size))
+            {
+                return false;
+            }
+            in.pos += CAPTURE_MAGIC_SIZE;
+
+            uint32_t count = 0;
+            if (!in.u32(count))
+            {
+                return false;
+            }
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                std::string key, value;
+                if (!in.string(key) || !in.string(value))
+                {
+                    return false;
+                }
+                this->attributes[key] = value;
+            }
+
+            uint32_t input_count = 0, output_count = 0;
+            // every tensor takes at least its 6 u32 fields, larger counts can not be in the data left
+            if (!in.u32(input_count) || !in.u32(output_count)
+                || (uint64_t)input_count + output_count > (size_t)(in.end - in.pos) / CAPTURE_MIN_TENSOR_BYTES)
+            {
+                return false;
+            }
+            this->inputs.resize(input_count);
+            this->outputs.resize(output_count);
+            for (auto& tensor : this->inputs)
+            {
+                if (!in.tensor(tensor))
+                {
+                    return false;
+                }
+            }
+            for (auto& tensor : this->outputs)
+            {
+                if (!in.tensor(tensor))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static bool is_capture(const void* data, size_t size)
+        {
+            return size >= CAPTURE_MAGIC_SIZE && memcmp(data, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) == 0;
+        }
+
+        // an integer attribute, `fallback` when it is missing
+        int get_int(const std::string& key, int fallback) const
+        {
+            auto it = this->attributes.find(key);
+            return it == this->attributes.end() ? fallback : std::atoi(it->second.c_str());
+        }
+
+    private:
+        typedef struct
+        {
+            const uint8_t* pos;
+            const uint8_t* end;
+
+            bool bytes(void* dst, size_t size)
+            {
+                if ((size_t)(end - pos) < size)
+                {
+                    return false;
+                }
+                memcpy(dst, pos, size);
+                pos += size;
+                return true;
+            }
+
+            bool u32(uint32_t& value)
+            {
+                return bytes(&value, sizeof(value));
+            }
+
+            bool string(std::string& value)
+            {
+                uint32_t size = 0;
+                if (!u32(size) || (size_t)(end - pos) < size)
+                {
+                    return false;
+                }
+                value.assign((const char*)pos, size);
+                pos += size;
+                return true;
+            }
+
+            bool tensor(CapturedTensor& tensor)
+            {
+                uint32_t dims = 0, data_bytes = 0;
+                if (!string(tensor.name) || !u32(dims) || dims > 16)
+                {
+                    return false;
+                }
+                tensor.shape.resize(dims);
+                if (!bytes(tensor.shape.data(), dims * sizeof(int32_t)) || !u32(tensor.data_type) || !u32(tensor.quantization)
+                    || !u32(tensor.size) || !u32(data_bytes) || (size_t)(end - pos) < data_bytes)
+                {
+                    return false;
+                }
+                tensor.data.assign(pos, pos + data_bytes);
+                pos += data_bytes;
+                return true;
+            }
+        } reader;
+
+        static bool put_u32(FILE* fp, uint32_t value)
+        {
+            return fwrite(&value, sizeof(value), 1, fp) == 1;
+        }
+
+        static bool put_string(FILE* fp, const std::string& value)
+        {
+            return put_u32(fp, (uint32_t)value.size()) && fwrite(value.data(), 1, value.size(), fp) == value.size();
+        }
+
+        static bool put_tensor(FILE* fp, const CapturedTensor& tensor)
+        {
+            bool ok = put_string(fp, tensor.name) && put_u32(fp, (uint32_t)tensor.shape.size());
+            ok = ok && fwrite(tensor.shape.data(), sizeof(int32_t), tensor.shape.size(), fp) == tensor.shape.size();
+            ok = ok && put_u32(fp, tensor.data_type) && put_u32(fp, tensor.quantization) && put_u32(fp, tensor.size);
+            ok = ok && put_u32(fp, (uint32_t)tensor.data.size());
+            return ok && fwrite(tensor.data.data(), 1, tensor.data.size(), fp) == tensor.data.size();
+        }
+    };
+} // namespace utilities
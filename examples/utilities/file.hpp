@@ -21,10 +21,16 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <fstream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace utilities
 {
     bool file_exist(const std::string& path)
@@ -47,22 +53,115 @@ namespace utilities
             return false;
         }
 
-        fs.seekg(std::ios::end);
-        auto fs_end = fs.tellg();
-        fs.seekg(std::ios::beg);
-        auto fs_beg = fs.tellg();
+        fs.seekg(0, std::ios::end);
+        auto file_size = static_cast<size_t>(fs.tellg());
+        fs.seekg(0, std::ios::beg);
 
-        auto file_size = static_cast<size_t>(fs_end - fs_beg);
         auto vector_size = data.size();
-
-        data.reserve(vector_size + file_size);
-        data.insert(data.end(), std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+        data.resize(vector_size + file_size);
+        fs.read(data.data() + vector_size, file_size);
+        auto read_size = static_cast<size_t>(fs.gcount());
+        data.resize(vector_size + read_size);
 
         fs.close();
 
-        return true;
+        return read_size == file_size;
     }
 
+    // read only view of a whole file through mmap, for handing a model to AX_ENGINE_CreateHandle
+    // without reading it into the heap first. the fd is closed right after mapping.
+    class mapped_file
+    {
+    public:
+        mapped_file() = default;
+
+        explicit mapped_file(const std::string& path)
+        {
+            open(path);
+        }
+
+        ~mapped_file()
+        {
+            close();
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        // `populate` faults every page in now, e.g. to keep a model resident for later reloads
+        bool open(const std::string& path, bool populate = false)
+        {
+            close();
+
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size <= 0)
+            {
+                ::close(fd);
+                return false;
+            }
+
+            int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+            flags |= populate ? MAP_POPULATE : 0;
+#endif
+            void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+            ::close(fd);
+            if (addr == MAP_FAILED)
+            {
+                return false;
+            }
+            // the engine parses the model front to back
+            madvise(addr, (size_t)st.st_size, populate ? MADV_WILLNEED : MADV_SEQUENTIAL);
+
+            this->addr = addr;
+            this->length = (size_t)st.st_size;
+            return true;
+        }
+
+        // drop the pages from this process, they come back from the page cache if touched again
+        void drop_pages()
+        {
+            if (this->addr != nullptr)
+            {
+                madvise(this->addr, this->length, MADV_DONTNEED);
+            }
+        }
+
+        void close()
+        {
+            if (this->addr != nullptr)
+            {
+                munmap(this->addr, this->length);
+                this->addr = nullptr;
+                this->length = 0;
+            }
+        }
+
+        bool is_open() const
+        {
+            return this->addr != nullptr;
+        }
+
+        const char* data() const
+        {
+            return (const char*)this->addr;
+        }
+
+        size_t size() const
+        {
+            return this->length;
+        }
+
+    private:
+        void* addr = nullptr;
+        size_t length = 0;
+    };
+
     bool dump_file(const std::string& path, std::vector<char>& data)
     {
         std::fstream fs(path, std::ios::out | std::ios::binary);
@@ -0,0 +1,109 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace utilities
+{
+    // latencies of many runs in ms, with the percentiles a single avg / max / min hides.
+    // percentiles are nearest rank, p99.9 only means something from about 1000 runs on.
+    class latency_stats
+    {
+    public:
+        void add(float ms)
+        {
+            this->samples.push_back(ms);
+            this->sorted = false;
+        }
+
+        void merge(const latency_stats& other)
+        {
+            this->samples.insert(this->samples.end(), other.samples.begin(), other.samples.end());
+            this->sorted = false;
+        }
+
+        void clear()
+        {
+            this->samples.clear();
+            this->sorted = true;
+        }
+
+        size_t size() const
+        {
+            return this->samples.size();
+        }
+
+        bool empty() const
+        {
+            return this->samples.empty();
+        }
+
+        float mean() const
+        {
+            if (this->samples.empty())
+            {
+                return 0.f;
+            }
+            double sum = 0.0;
+            for (float ms : this->samples)
+            {
+                sum += ms;
+            }
+            return (float)(sum / (double)this->samples.size());
+        }
+
+        float min() const
+        {
+            return percentile(0.f);
+        }
+
+        float max() const
+        {
+            return percentile(100.f);
+        }
+
+        // the smallest sample that `p` percent of the samples are not above, p in [0, 100]
+        float percentile(float p) const
+        {
+            if (this->samples.empty())
+            {
+                return 0.f;
+            }
+            if (!this->sorted)
+            {
+                std::sort(this->samples.begin(), this->samples.end());
+                this->sorted = true;
+            }
+            const size_t count = this->samples.size();
+            size_t rank = (size_t)std::ceil((double)p / 100.0 * (double)count);
+            rank = std::min(std::max(rank, (size_t)1), count);
+            return this->samples[rank - 1];
+        }
+
+    private:
+        // sorted on the first percentile() after a change
+        mutable std::vector<float> samples;
+        mutable bool sorted = true;
+    };
+} // namespace utilities
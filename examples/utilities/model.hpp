@@ -0,0 +1,128 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "utilities/file.hpp"
+#include "utilities/timer.hpp"
+
+namespace utilities
+{
+    // peak resident set size of the process in KB
+    static inline long peak_rss_kb()
+    {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+        return usage.ru_maxrss;
+    }
+
+    // model files kept mapped and resident between loads, so creating the handle again (a reload,
+    // another process wide handle of the same model) does not wait for the disk
+    class model_cache
+    {
+    public:
+        static model_cache& shared()
+        {
+            static model_cache cache;
+            return cache;
+        }
+
+        std::shared_ptr<mapped_file> get(const std::string& path)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->files.find(path);
+            if (it != this->files.end())
+            {
+                return it->second;
+            }
+            auto file = std::make_shared<mapped_file>();
+            if (!file->open(path, true))
+            {
+                return nullptr;
+            }
+            this->files[path] = file;
+            return file;
+        }
+
+        void drop(const std::string& path)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->files.erase(path);
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->files.clear();
+        }
+
+        size_t bytes() const
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            size_t total = 0;
+            for (auto& file : this->files)
+            {
+                total += file.second->size();
+            }
+            return total;
+        }
+
+    private:
+        mutable std::mutex mutex;
+        std::map<std::string, std::shared_ptr<mapped_file> > files;
+    };
+
+    // map the model and hand it to `create(data, size)`, i.e. AX_ENGINE_CreateHandle or
+    // session::load. the engine keeps its own copy of what it needs, so the pages are dropped and
+    // unmapped right after, unless `cache` keeps the model resident. returns what create returned.
+    template<typename Create>
+    int load_model(const std::string& path, Create create, model_cache* cache = nullptr)
+    {
+        timer load_timer;
+        std::shared_ptr<mapped_file> file = cache != nullptr ? cache->get(path) : std::make_shared<mapped_file>();
+        if (file == nullptr || (!file->is_open() && !file->open(path)))
+        {
+            fprintf(stderr, "Read Run-Joint model(%s) file failed.\n", path.c_str());
+            return -1;
+        }
+
+        const size_t size = file->size();
+        auto ret = create((const void*)file->data(), size);
+        if (cache == nullptr)
+        {
+            file->drop_pages();
+            file->close();
+        }
+        fprintf(stdout, "Load model(%s) %.2f MB in %.2f ms (mmap%s), peak rss %.2f MB.\n", path.c_str(), size / 1048576.0,
+                load_timer.cost(), cache != nullptr ? ", resident" : "", peak_rss_kb() / 1024.0);
+        return ret;
+    }
+} // namespace utilities
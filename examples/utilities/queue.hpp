@@ -0,0 +1,102 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace utilities
+{
+    // blocking fifo with a fixed capacity. push() waits while the queue is full,
+    // pop() waits while it is empty. after close() pushes fail and pop() drains
+    // what is left, then returns false.
+    template <typename T>
+    class bounded_queue
+    {
+    public:
+        explicit bounded_queue(size_t capacity)
+            : capacity(capacity > 0 ? capacity : 1)
+        {
+        }
+
+        bool push(T item)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->not_full.wait(lock, [this] { return this->closed || this->items.size() < this->capacity; });
+            if (this->closed)
+            {
+                return false;
+            }
+            this->items.push_back(std::move(item));
+            lock.unlock();
+            this->not_empty.notify_one();
+            return true;
+        }
+
+        bool pop(T& item)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->not_empty.wait(lock, [this] { return this->closed || !this->items.empty(); });
+            if (this->items.empty())
+            {
+                return false;
+            }
+            item = std::move(this->items.front());
+            this->items.pop_front();
+            lock.unlock();
+            this->not_full.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->closed = true;
+            }
+            this->not_full.notify_all();
+            this->not_empty.notify_all();
+        }
+
+        bool is_closed()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->closed;
+        }
+
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->items.size();
+        }
+
+    private:
+        size_t capacity;
+        bool closed = false;
+        std::deque<T> items;
+        std::mutex mutex;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+    };
+} // namespace utilities
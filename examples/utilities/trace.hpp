@@ -0,0 +1,241 @@
+/*
+ * AXERA is pleased to support the open source community by making ax-samples available.
+ *
+ * Copyright (c) 2022, AXERA Semiconductor (Shanghai) Co., Ltd. All rights reserved.
+ *
+ * Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+ * in compliance with the License. You may obtain a copy of the License at
+ *
+ * https://opensource.org/licenses/BSD-3-Clause
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ */
+
+/*
+ * Author:
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// scoped tracing of the inference path. with AXERA_TRACE defined (cmake -DAXERA_TRACE=ON)
+//     AX_TRACE_SCOPE("letterbox");
+// records the begin and end of the enclosing scope into a ring buffer of the calling thread, and
+//     AX_TRACE_WRITE("trace.json");
+// writes what all threads recorded as chrome trace event json, for chrome://tracing or perfetto.
+// without AXERA_TRACE both expand to nothing. names have to outlive the trace, i.e. be literals.
+
+#ifndef AX_TRACE_RING_EVENTS
+#define AX_TRACE_RING_EVENTS 65536 // per thread, older events are overwritten
+#endif
+
+namespace utilities
+{
+    namespace trace
+    {
+        typedef struct
+        {
+            const char* name;
+            int64_t begin_ns;
+            int64_t end_ns;
+        } event;
+
+        // monotonic, in ns
+        inline int64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // the events of one thread. only that thread writes, write_chrome_json() reads the last
+        // `capacity` of them, so flush while the traced threads are idle, e.g. between frames.
+        class ring
+        {
+        public:
+            explicit ring(int tid)
+                : tid(tid), events(AX_TRACE_RING_EVENTS)
+            {
+            }
+
+            void push(const char* name, int64_t begin_ns, int64_t end_ns)
+            {
+                const uint64_t index = this->head.load(std::memory_order_relaxed);
+                event& slot = this->events[index % this->events.size()];
+                slot.name = name;
+                slot.begin_ns = begin_ns;
+                slot.end_ns = end_ns;
+                this->head.store(index + 1, std::memory_order_release);
+            }
+
+            // oldest first
+            std::vector<event> snapshot() const
+            {
+                const uint64_t end = this->head.load(std::memory_order_acquire);
+                const uint64_t begin = end > this->events.size() ? end - this->events.size() : 0;
+                std::vector<event> out;
+                out.reserve((size_t)(end - begin));
+                for (uint64_t i = begin; i < end; ++i)
+                {
+                    out.push_back(this->events[i % this->events.size()]);
+                }
+                return out;
+            }
+
+            void clear()
+            {
+                this->head.store(0, std::memory_order_release);
+            }
+
+            const int tid;
+            std::string thread_name;
+
+        private:
+            std::vector<event> events;
+            std::atomic<uint64_t> head{0};
+        };
+
+        // every ring ever made, they outlive their threads so a pool that is gone still shows up
+        typedef struct
+        {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<ring> > all;
+        } ring_list;
+
+        inline ring_list& rings()
+        {
+            static ring_list list;
+            return list;
+        }
+
+        inline ring& local_ring()
+        {
+            static thread_local std::shared_ptr<ring> local;
+            if (!local)
+            {
+                ring_list& list = rings();
+                std::lock_guard<std::mutex> lock(list.mutex);
+                local = std::make_shared<ring>((int)list.all.size() + 1);
+                list.all.push_back(local);
+            }
+            return *local;
+        }
+
+        inline void record(const char* name, int64_t begin_ns, int64_t end_ns)
+        {
+            local_ring().push(name, begin_ns, end_ns);
+        }
+
+        // how the calling thread shows up in the trace
+        inline void set_thread_name(const std::string& name)
+        {
+            ring& local = local_ring();
+            std::lock_guard<std::mutex> lock(rings().mutex);
+            local.thread_name = name;
+        }
+
+        inline void clear()
+        {
+            ring_list& list = rings();
+            std::lock_guard<std::mutex> lock(list.mutex);
+            for (auto& r : list.all)
+            {
+                r->clear();
+            }
+        }
+
+        // records the scope it lives in
+        class scope
+        {
+        public:
+            explicit scope(const char* name)
+                : name(name), begin_ns(now_ns())
+            {
+            }
+
+            ~scope()
+            {
+                record(this->name, this->begin_ns, now_ns());
+            }
+
+            scope(const scope&) = delete;
+            scope& operator=(const scope&) = delete;
+
+        private:
+            const char* name;
+            int64_t begin_ns;
+        };
+
+        // chrome trace event json, one complete ("X") event per scope, times in us
+        inline bool write_chrome_json(const std::string& path)
+        {
+            FILE* fp = fopen(path.c_str(), "w");
+            if (fp == nullptr)
+            {
+                fprintf(stderr, "Open %s failed.\n", path.c_str());
+                return false;
+            }
+            const int pid = (int)getpid();
+            ring_list& list = rings();
+            std::lock_guard<std::mutex> lock(list.mutex);
+            const auto& all = list.all;
+
+            // times relative to the first event, chrome copes badly with huge timestamps
+            int64_t origin = INT64_MAX;
+            std::vector<std::vector<event> > snapshots;
+            for (auto& r : all)
+            {
+                snapshots.push_back(r->snapshot());
+                for (const auto& e : snapshots.back())
+                {
+                    origin = std::min(origin, e.begin_ns);
+                }
+            }
+
+            fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+            bool first = true;
+            for (size_t i = 0; i < all.size(); ++i)
+            {
+                if (!all[i]->thread_name.empty())
+                {
+                    fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                            first ? "" : ",\n", pid, all[i]->tid, all[i]->thread_name.c_str());
+                    first = false;
+                }
+                for (const auto& e : snapshots[i])
+                {
+                    fprintf(fp, "%s{\"name\": \"%s\", \"cat\": \"ax\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                            first ? "" : ",\n", e.name, pid, all[i]->tid, (e.begin_ns - origin) / 1000.0, (e.end_ns - e.begin_ns) / 1000.0);
+                    first = false;
+                }
+            }
+            fprintf(fp, "\n]}\n");
+            fclose(fp);
+            return true;
+        }
+    } // namespace trace
+} // namespace utilities
+
+#define AX_TRACE_CONCAT_(a, b) a##b
+#define AX_TRACE_CONCAT(a, b) AX_TRACE_CONCAT_(a, b)
+
+#ifdef AXERA_TRACE
+#define AX_TRACE_SCOPE(name) utilities::trace::scope AX_TRACE_CONCAT(ax_trace_scope_, __LINE__)(name)
+#define AX_TRACE_THREAD(name) utilities::trace::set_thread_name(name)
+#define AX_TRACE_WRITE(path) utilities::trace::write_chrome_json(path)
+#else
+#define AX_TRACE_SCOPE(name) (void)0
+#define AX_TRACE_THREAD(name) (void)0
+#define AX_TRACE_WRITE(path) (void)0
+#endif